@@ -0,0 +1,254 @@
+/*
+  Host benchmark suite (target HMS_BLE_bench): the library against the desktop simulated controller, one JSON document out.
+  Covers the boot path (runtime registration + begin(), begin<Schema>()), UUID lookup (findServiceIndex() and
+  findCharacteristicIndex() through getCharacteristicHandle()), the send path, write ingestion from a central, callback
+  dispatch on writes and reads, and reading the runtime statistics. Every case runs a warmup, then SAMPLES timed batches;
+  percentiles are over the per-operation time of each batch, so the clock read is amortised over the batch and still shows
+  scheduling and cache outliers.
+
+  Usage: HMS_BLE_bench [--samples N] [--out file.json]
+  Without --out the JSON goes to stdout. A one-line summary per case goes to stderr.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "HMS_BLE.h"
+
+static size_t SAMPLES = 2000;
+static const size_t WARMUP = 50;
+
+#define BENCH_UUID(s, c)    "6E400000-B5A3-F393-E0A9-E50E24DC" #s #c
+#define BENCH_CHAR(s, c)    HMS_BLE_MakeCharacteristic(BENCH_UUID(s, c), "Char", HMS_BLE_PROPERTY_READ_WRITE_NOTIFY)
+#define BENCH_SERVICE(s)    HMS_BLE_MakeService(BENCH_UUID(00, s), "Service",                                                        \
+                                BENCH_CHAR(s, 01), BENCH_CHAR(s, 02), BENCH_CHAR(s, 03), BENCH_CHAR(s, 04),                         \
+                                BENCH_CHAR(s, 05), BENCH_CHAR(s, 06), BENCH_CHAR(s, 07), BENCH_CHAR(s, 08))
+
+static constexpr auto schema = HMS_BLE_MakeSchema(BENCH_SERVICE(10), BENCH_SERVICE(11), BENCH_SERVICE(12), BENCH_SERVICE(13));
+static const size_t SERVICES = 4, CHARACTERISTICS = 8;
+
+struct Result {
+    const char* name;
+    size_t      opsPerSample;
+    size_t      bytesPerOp;                                                                                     // 0 when throughput in bytes does not apply
+    double      mean, p50, p90, p99, max;                                                                       // ns per operation
+};
+
+static std::vector<Result> results;
+
+// op(i) is one operation, a batch runs opsPerSample of them back to back
+template <typename Op>
+static void measure(const char* name, size_t opsPerSample, size_t bytesPerOp, Op&& op) {
+    std::vector<double> samples;
+    samples.reserve(SAMPLES);
+    size_t i = 0;
+    for(size_t s = 0; s < WARMUP + SAMPLES; s++) {
+        auto start = std::chrono::steady_clock::now();
+        for(size_t k = 0; k < opsPerSample; k++) op(i++);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / opsPerSample;
+        if(s >= WARMUP) samples.push_back(ns);
+    }
+
+    Result r = { name, opsPerSample, bytesPerOp, 0, 0, 0, 0, 0 };
+    for(double ns : samples) r.mean += ns;
+    r.mean /= samples.size();
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) { return samples[std::min(samples.size() - 1, (size_t)(p * samples.size()))]; };
+    r.p50 = percentile(0.50);
+    r.p90 = percentile(0.90);
+    r.p99 = percentile(0.99);
+    r.max = samples.back();
+    results.push_back(r);
+    fprintf(stderr, "%-38s p50 %9.1f ns  p99 %9.1f ns  %12.0f ops/s\n", name, r.p50, r.p99, 1e9 / r.mean);
+}
+
+static void writeJson(FILE* out) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"library\": \"HMS_BLE\",\n");
+    fprintf(out, "  \"backend\": \"desktop_sim\",\n");
+    fprintf(out, "  \"config\": { \"max_services\": %d, \"max_characteristics_per_service\": %d, \"max_clients\": %d, "
+                 "\"max_data_length\": %d, \"runtime_registration\": %d, \"legacy_api\": %d, \"notify_queue\": %d, \"rx_ring_depth\": %d, "
+                 "\"value_cache\": %d, \"tx_credits\": %d },\n",
+        HMS_BLE_MAX_SERVICES, HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE, HMS_BLE_MAX_CLIENTS, HMS_BLE_MAX_DATA_LENGTH,
+        HMS_BLE_RUNTIME_REGISTRATION, HMS_BLE_LEGACY_API, HMS_BLE_NOTIFY_QUEUE, HMS_BLE_RX_RING_DEPTH, HMS_BLE_VALUE_CACHE, HMS_BLE_TX_CREDITS);
+    fprintf(out, "  \"sizeof_hms_ble\": %zu,\n", sizeof(HMS_BLE));
+    fprintf(out, "  \"samples\": %zu,\n", SAMPLES);
+    fprintf(out, "  \"results\": [\n");
+    for(size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(out, "    { \"name\": \"%s\", \"unit\": \"ns/op\", \"ops_per_sample\": %zu, \"mean\": %.1f, \"p50\": %.1f, "
+                     "\"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f, \"ops_per_sec\": %.0f",
+            r.name, r.opsPerSample, r.mean, r.p50, r.p90, r.p99, r.max, 1e9 / r.mean);
+        if(r.bytesPerOp) fprintf(out, ", \"bytes_per_op\": %zu, \"mb_per_sec\": %.2f", r.bytesPerOp, r.bytesPerOp * 1e3 / r.mean);
+        fprintf(out, " }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static void benchBoot() {
+    char svcUUIDs[SERVICES][40], charUUIDs[SERVICES][CHARACTERISTICS][40];
+    for(size_t s = 0; s < SERVICES; s++) {
+        snprintf(svcUUIDs[s], sizeof(svcUUIDs[s]), "6E400000-B5A3-F393-E0A9-E50E24DC00%02zu", 10 + s);
+        for(size_t c = 0; c < CHARACTERISTICS; c++) {
+            snprintf(charUUIDs[s][c], sizeof(charUUIDs[s][c]), "6E400000-B5A3-F393-E0A9-E50E24DC%02zu%02zu", 10 + s, c + 1);
+        }
+    }
+
+    #if HMS_BLE_RUNTIME_REGISTRATION
+        measure("boot.runtime_registration", 1, 0, [&](size_t) {
+            HMS_BLE ble("Bench");
+            for(size_t s = 0; s < SERVICES; s++) {
+                HMS_BLE_Service svc = { svcUUIDs[s], "Service" };
+                ble.addService(&svc);
+                for(size_t c = 0; c < CHARACTERISTICS; c++) {
+                    HMS_BLE_Characteristic chr = { charUUIDs[s][c], "Char", HMS_BLE_PROPERTY_READ_WRITE_NOTIFY };
+                    ble.addCharacteristicToService(svcUUIDs[s], &chr);
+                }
+            }
+            ble.begin(false);
+        });
+    #endif
+    measure("boot.schema", 1, 0, [&](size_t) {
+        HMS_BLE ble("Bench");
+        ble.begin<schema>(false);
+    });
+}
+
+static void benchLookup(HMS_BLE& ble) {
+    // Last service and characteristic: the longest walk for the string compares
+    const char* svc = schema.services[SERVICES - 1].uuidStr;
+    const char* chr = schema.characteristics[SERVICES * CHARACTERISTICS - 1].uuidStr;
+    const HMS_BLE_UUID& svcUUID = schema.services[SERVICES - 1].uuid;
+    const HMS_BLE_UUID& chrUUID = schema.characteristics[SERVICES * CHARACTERISTICS - 1].uuid;
+    volatile uint32_t sink = 0;
+
+    measure("lookup.service_and_char_string", 256, 0, [&](size_t) { sink = sink + ble.getCharacteristicHandle(svc, chr).id; });
+    #if HMS_BLE_LEGACY_API
+    measure("lookup.char_string_all_services", 256, 0, [&](size_t) { sink = sink + ble.getCharacteristicHandle(chr).id; });
+    #endif
+    measure("lookup.service_and_char_uuid", 256, 0, [&](size_t) { sink = sink + ble.getCharacteristicHandle(svcUUID, chrUUID).id; });
+    measure("lookup.uuid_parse", 256, 0, [&](size_t) {
+        HMS_BLE_UUID uuid{};
+        HMS_BLE::parseUUID(chr, &uuid);
+        sink = sink + uuid.val[0];
+    });
+}
+
+static void benchSend(HMS_BLE& ble) {
+    const char* svc = schema.services[0].uuidStr;
+    const char* chr = schema.characteristics[0].uuidStr;
+    HMS_BLE_CharHandle handle = ble.getCharacteristicHandle(svc, chr);
+    uint8_t value[HMS_BLE_MAX_DATA_LENGTH];
+    memset(value, 0x5A, sizeof(value));
+
+    HMS_BLE_VirtualCentral centrals[4];
+    for(auto& central : centrals) central.connect(&ble);
+    measure("send.handle_no_subscriber", 256, 20, [&](size_t i) { value[0] = (uint8_t)i; ble.sendData(handle, value, 20); });
+
+    centrals[0].subscribe(svc, chr);
+    measure("send.handle_1_subscriber", 256, 20, [&](size_t i) { value[0] = (uint8_t)i; ble.sendData(handle, value, 20); });
+    measure("send.service_char_string_1_subscriber", 256, 20, [&](size_t i) { value[0] = (uint8_t)i; ble.sendDataToService(svc, chr, value, 20); });
+    measure("send.handle_1_subscriber_max_length", 256, HMS_BLE_MAX_DATA_LENGTH, [&](size_t i) {
+        value[0] = (uint8_t)i;
+        ble.sendData(handle, value, HMS_BLE_MAX_DATA_LENGTH);
+    });
+
+    for(auto& central : centrals) central.subscribe(svc, chr);
+    measure("send.handle_4_subscribers", 256, 20, [&](size_t i) { value[0] = (uint8_t)i; ble.sendData(handle, value, 20); });
+    for(auto& central : centrals) central.disconnect();
+}
+
+static void benchIngest(HMS_BLE& ble) {
+    const char* svc = schema.services[1].uuidStr;
+    const char* chr = schema.characteristics[CHARACTERISTICS].uuidStr;
+    HMS_BLE_CharHandle handle = ble.getCharacteristicHandle(svc, chr);
+    uint8_t value[20];
+    memset(value, 0xA5, sizeof(value));
+    volatile uint32_t sink = 0;
+
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+
+    // Ingestion: a central writes, the application polls the per-service buffer
+    ble.setWriteCallback(nullptr);
+    measure("write.ingest_polled", 256, sizeof(value), [&](size_t i) {
+        value[0] = (uint8_t)i;
+        central.write(svc, chr, value, sizeof(value));
+        if(ble.hasReceivedData(handle)) {
+            sink = sink + ble.getReceivedData(handle)[0];
+            ble.clearReceivedData(handle);
+        }
+    });
+
+    // Dispatch: the same write delivered through each callback style, the difference to the polled case is the dispatch cost
+    ble.setWriteCallback([&](const char*, const char*, const uint8_t* data, size_t length, const uint8_t*) { sink = sink + data[length - 1]; });
+    measure("dispatch.write_callback", 256, sizeof(value), [&](size_t i) { value[0] = (uint8_t)i; central.write(svc, chr, value, sizeof(value)); });
+    ble.setWriteViewCallback([&](HMS_BLE_CharHandle, HMS_BLE_ValueView view, const uint8_t*) { sink = sink + view.data[view.length - 1]; });
+    measure("dispatch.write_view_callback", 256, sizeof(value), [&](size_t i) { value[0] = (uint8_t)i; central.write(svc, chr, value, sizeof(value)); });
+    ble.setWriteViewCallback(nullptr);
+
+    uint8_t response[64];
+    ble.setReadCallback([&](const char*, const char*, uint8_t* data, size_t* length, const uint8_t*) {
+        memcpy(data, value, sizeof(value));
+        *length = sizeof(value);
+    });
+    measure("dispatch.read_callback", 256, sizeof(value), [&](size_t) {
+        size_t length = sizeof(response);
+        central.read(svc, chr, response, &length);
+    });
+    ble.setReadIntoCallback([&](HMS_BLE_CharHandle, HMS_BLE_ValueBuffer out, const uint8_t*) -> size_t {
+        memcpy(out.data, value, sizeof(value));
+        return sizeof(value);
+    });
+    measure("dispatch.read_into_callback", 256, sizeof(value), [&](size_t) {
+        size_t length = sizeof(response);
+        central.read(svc, chr, response, &length);
+    });
+    ble.setReadIntoCallback(nullptr);
+    ble.setReadCallback(nullptr);
+    ble.setWriteCallback(nullptr);
+
+    central.disconnect();
+}
+
+static void benchStats(HMS_BLE& ble) {
+    HMS_BLE_CharHandle handle = ble.getCharacteristicHandle(schema.services[1].uuidStr, schema.characteristics[CHARACTERISTICS].uuidStr);
+    volatile uint32_t sink = 0;
+
+    // What a telemetry task pays per report; the counting itself is inside the send/write/read numbers above
+    measure("stats.snapshot", 64, 0, [&](size_t) { sink = sink + ble.getStats().notifications; });
+    measure("stats.characteristic", 256, 0, [&](size_t) { sink = sink + ble.getCharacteristicStats(handle).writes; });
+}
+
+int main(int argc, char** argv) {
+    const char* outPath = nullptr;
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--samples") && i + 1 < argc)  SAMPLES = (size_t)atol(argv[++i]);
+        else if(!strcmp(argv[i], "--out") && i + 1 < argc) outPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--samples N] [--out file.json]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(SAMPLES < 10) SAMPLES = 10;
+
+    benchBoot();
+
+    HMS_BLE ble("BenchSuite");
+    if(ble.begin<schema>(false) != HMS_BLE_STATUS_SUCCESS) return 1;
+    benchLookup(ble);
+    benchSend(ble);
+    benchIngest(ble);
+    benchStats(ble);
+
+    FILE* out = outPath ? fopen(outPath, "w") : stdout;
+    if(!out) {
+        fprintf(stderr, "cannot open %s\n", outPath);
+        return 1;
+    }
+    writeJson(out);
+    if(outPath) fclose(out);
+    return 0;
+}
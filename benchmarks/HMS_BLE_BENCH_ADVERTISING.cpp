@@ -0,0 +1,155 @@
+/*
+  Advertising payload benchmark: a four-service schema (two SIG 16-bit, two vendor 128-bit) under a 27-character name,
+  with 8 bytes of manufacturer data and 4 bytes of service data.
+  - packing: the two 31-byte packets for several advertised service sets, what went where and what had to be cut. Every
+    packet is walked as AD structures and must add up exactly, and the values must sit at the offsets the payload reports,
+  - live updates: ns per updateManufacturerData() and updateServiceData() of the same length while advertising, with no
+    heap allocation and no advertiser restart, against the ns of a re-pack when the length changes,
+  - refusal: manufacturer data that fits in neither packet is turned down and leaves the payload as it was.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#include "HMS_BLE.h"
+
+static const size_t UPDATES = 1000000;
+static const size_t REPACKS = 100000;
+
+static std::atomic<bool>   countAllocations{false};
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size) {
+    if(countAllocations.load(std::memory_order_relaxed)) allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept                          { free(p); }
+void operator delete(void* p, size_t) noexcept                  { free(p); }
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("180D", "Heart Rate",
+        HMS_BLE_MakeCharacteristic("2A37", "Measurement", HMS_BLE_PROPERTY_NOTIFY)
+    ),
+    HMS_BLE_MakeService("180F", "Battery",
+        HMS_BLE_MakeCharacteristic("2A19", "Level", HMS_BLE_PROPERTY_NOTIFY)
+    ),
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Telemetry",
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "Samples", HMS_BLE_PROPERTY_NOTIFY)
+    ),
+    HMS_BLE_MakeService("A0B40001-926D-4D61-98DF-8C5C62EE53B3", "Config",
+        HMS_BLE_MakeCharacteristic("A0B40002-926D-4D61-98DF-8C5C62EE53B3", "Mode", HMS_BLE_PROPERTY_WRITE)
+    )
+);
+
+static const uint8_t  manufacturerValue[8] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+static const uint8_t  serviceValue[4]      = { 0x64, 0x00, 0x10, 0x27 };
+
+static double nsSince(std::chrono::steady_clock::time_point start, size_t ops) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ops;
+}
+
+// Walks one packet as AD structures: every length in range and the structures end exactly at the packet length
+static bool wellFormed(const uint8_t* packet, uint8_t length, int* structures) {
+    uint8_t at = 0;
+    *structures = 0;
+    while(at < length) {
+        if(packet[at] == 0 || at + 1 + packet[at] > length) return false;
+        at += packet[at] + 1;
+        (*structures)++;
+    }
+    return at == length && length <= HMS_BLE_ADV_PACKET_LENGTH;
+}
+
+static bool holds(const HMS_BLE_AdvPayload& payload, HMS_BLE_AdvField field, const uint8_t* value, size_t length) {
+    const uint8_t* packet = field.scanResponse ? payload.scanResponse : payload.advertising;
+    return field.offset && field.length == length && memcmp(packet + field.offset, value, length) == 0;
+}
+
+static const char* where(HMS_BLE_AdvField field) {
+    return !field.offset ? "-" : field.scanResponse ? "scan rsp" : "adv";
+}
+
+static bool layout(HMS_BLE& ble, const char* name, const char** services, size_t count, uint8_t expectedFit) {
+    ble.setAdvertisedServices(services, count);
+    HMS_BLE_AdvPayload payload = ble.getAdvertisingPayload();
+    int adStructures = 0, srStructures = 0;
+    bool ok = wellFormed(payload.advertising, payload.advertisingLength, &adStructures) &&
+              wellFormed(payload.scanResponse, payload.scanResponseLength, &srStructures) &&
+              holds(payload, payload.manufacturer, manufacturerValue, sizeof(manufacturerValue)) &&
+              holds(payload, payload.serviceData, serviceValue, sizeof(serviceValue)) && payload.fit == expectedFit;
+    printf("%-30s %4u/%-3d %4u/%-3d %10s %10s %6s%s%s %7s\n", name, payload.advertisingLength, adStructures,
+        payload.scanResponseLength, srStructures, where(payload.manufacturer), where(payload.serviceData),
+        payload.fit & HMS_BLE_ADV_UUIDS_INCOMPLETE ? " uuids" : "", payload.fit & HMS_BLE_ADV_NAME_SHORTENED ? " name" : "",
+        payload.fit ? "" : " -", ok ? "yes" : "NO");
+    return ok;
+}
+
+int main(void) {
+    HMS_BLE ble("HMS Environmental Node 0042");
+    ble.setManufacturerData(0x02E5, manufacturerValue, sizeof(manufacturerValue));
+    ble.setServiceData("181A", serviceValue, sizeof(serviceValue));
+    ble.begin<schema>(false);
+    bool ok = true;
+
+    printf("HMS_BLE advertising payload, name \"%s\", 8 B manufacturer data, 4 B service data\n", "HMS Environmental Node 0042");
+    printf("%-30s %8s %8s %10s %10s %6s %7s\n", "advertised services", "adv B/AD", "rsp B/AD", "mfg data", "svc data", "cut", "checks");
+    const char* sig[] = { "180D", "180F" };
+    const char* vendor[] = { "6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "A0B40001-926D-4D61-98DF-8C5C62EE53B3" };
+    const char* mixed[] = { "180D", "180F", "6E400001-B5A3-F393-E0A9-E50E24DCCA9E" };
+    const char* all[] = { "180D", "180F", "6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "A0B40001-926D-4D61-98DF-8C5C62EE53B3" };
+    ok = layout(ble, "primary only (16-bit)", nullptr, 0, 0) && ok;
+    ok = layout(ble, "two 16-bit", sig, 2, 0) && ok;
+    ok = layout(ble, "16-bit + 128-bit", mixed, 3, HMS_BLE_ADV_NAME_SHORTENED) && ok;
+    ok = layout(ble, "two 128-bit", vendor, 2, HMS_BLE_ADV_UUIDS_INCOMPLETE | HMS_BLE_ADV_NAME_SHORTENED) && ok;
+    ok = layout(ble, "all four", all, 4, HMS_BLE_ADV_UUIDS_INCOMPLETE | HMS_BLE_ADV_NAME_SHORTENED) && ok;
+
+    // Live updates on the default layout, advertising the whole time
+    ble.setAdvertisedServices(nullptr, 0);
+    uint32_t starts = ble.getAdvertisingStarts();
+    uint8_t value[8];
+    memcpy(value, manufacturerValue, sizeof(value));
+    allocations = 0;
+    countAllocations = true;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < UPDATES; n++) {
+        value[0] = (uint8_t)n;
+        ble.updateManufacturerData(value, sizeof(value));
+    }
+    double manufacturerNs = nsSince(start, UPDATES);
+    uint8_t reading[4];
+    memcpy(reading, serviceValue, sizeof(reading));
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < UPDATES; n++) {
+        reading[0] = (uint8_t)n;
+        ble.updateServiceData(reading, sizeof(reading));
+    }
+    double serviceNs = nsSince(start, UPDATES);
+    countAllocations = false;
+    size_t updateAllocations = allocations;
+    HMS_BLE_AdvPayload payload = ble.getAdvertisingPayload();
+    bool live = holds(payload, payload.manufacturer, value, sizeof(value)) && holds(payload, payload.serviceData, reading, sizeof(reading)) &&
+                ble.getAdvertisingStarts() == starts && ble.isAdvertising() && updateAllocations == 0;
+
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < REPACKS; n++) ble.updateManufacturerData(value, n & 1 ? 8 : 6);
+    double repackNs = nsSince(start, REPACKS);
+    ble.updateManufacturerData(manufacturerValue, sizeof(manufacturerValue));
+    live = live && ble.getAdvertisingStarts() == starts;
+
+    // 27 bytes of manufacturer data fill a whole scan response, 28 fit nowhere
+    HMS_BLE_AdvPayload before = ble.getAdvertisingPayload();
+    uint8_t large[28] = {};
+    HMS_BLE_Status refused = ble.setManufacturerData(0x02E5, large, sizeof(large));
+    HMS_BLE_AdvPayload after = ble.getAdvertisingPayload();
+    bool unchanged = refused == HMS_BLE_STATUS_ERROR_OVERFLOW && memcmp(&before, &after, sizeof(before)) == 0;
+
+    printf("\n%-50s %10.1f\n", "updateManufacturerData(), same length, ns", manufacturerNs);
+    printf("%-50s %10.1f\n", "updateServiceData(), same length, ns", serviceNs);
+    printf("%-50s %10.1f\n", "updateManufacturerData(), new length (re-pack), ns", repackNs);
+    printf("%-50s %10zu\n", "heap allocations during same-length updates", updateAllocations);
+    printf("%-50s %10u\n", "advertiser restarts during updates", ble.getAdvertisingStarts() - starts);
+    printf("%-50s %10s\n", "28 B manufacturer data refused, payload unchanged", unchanged ? "yes" : "NO");
+    return (ok && live && unchanged) ? 0 : 1;
+}
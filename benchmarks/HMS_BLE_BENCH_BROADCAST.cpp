@@ -0,0 +1,267 @@
+/*
+  Broadcaster benchmark (HMS_BLE_BROADCAST_SETS=3, HMS_BLE_BROADCAST_FRAMES=4): virtual scanners listen to broadcast sets
+  that rotate four full frames. Each frame carries its index and a pattern derived from it; every report is checked.
+  - modes: legacy, extended and periodic sets at 100 ms and 20 ms, one advertising event per frame. Reports events/s, new
+    frames heard (a report whose frame differs from the previous one), the share of frames sent that were heard, and the
+    effective payload bytes/s against the ideal of one full frame per interval,
+  - loss: an extended set at 20 ms to a scanner that misses 30% of the events, with 1 to 4 events per frame. Repeating a
+    frame trades payload rate for coverage,
+  - concurrent sets: one set of each mode at once, heard by one scanner,
+  - live updates: ns per setBroadcastFrame() on a stopped set (copy only) and on the frame on air (copy and hand-off to
+    the stack), with no heap allocation.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#include "HMS_BLE.h"
+
+#if HMS_BLE_BROADCAST_SETS < 3 || HMS_BLE_BROADCAST_FRAMES < 4
+  #error "Build with HMS_BLE_BROADCAST_SETS=3 (or more) and HMS_BLE_BROADCAST_FRAMES of at least 4"
+#endif
+
+static const uint16_t COMPANY       = 0x02E5;
+static const int      FRAMES        = 4;
+static const uint32_t RUN_MS        = 1000;
+static const uint32_t LOSS_RUN_MS   = 2000;
+static const uint8_t  LOSS          = 30;                                                                       // Percent of events the scanner misses
+static const size_t   UPDATES       = 200000;
+
+static std::atomic<bool>   countAllocations{false};
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size) {
+    if(countAllocations.load(std::memory_order_relaxed)) allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept                          { free(p); }
+void operator delete(void* p, size_t) noexcept                  { free(p); }
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("180F", "Battery",
+        HMS_BLE_MakeCharacteristic("2A19", "Level", HMS_BLE_PROPERTY_NOTIFY)
+    )
+);
+
+static const char* const modeNames[] = { "legacy", "extended", "periodic" };
+
+static void fillFrame(uint8_t* frame, int index, size_t length) {
+    frame[0] = (uint8_t)index;
+    for(size_t i = 1; i < length; i++) frame[i] = (uint8_t)(index * 31 + i);
+}
+
+// What one scanner heard from one set; touched only by that set's event thread until the set stops
+struct Heard {
+    uint32_t reports = 0;
+    uint32_t newFrames = 0;
+    uint32_t skipped = 0;                                                                                           // Frames the rotation sent that were never heard
+    uint32_t malformed = 0;
+    int      last = -1;
+    size_t   payload = 0;                                                                                           // Expected payload bytes per frame
+
+    void hear(const uint8_t* data, size_t length) {
+        reports++;
+        if(length != payload + 4 || data[0] != payload + 3 || data[1] != 0xFF || data[2] != (COMPANY & 0xFF) || data[3] != COMPANY >> 8) {
+            malformed++;
+            return;
+        }
+        const uint8_t* frame = data + 4;
+        for(size_t i = 1; i < payload; i++) {
+            if(frame[i] != (uint8_t)(frame[0] * 31 + i)) { malformed++; return; }
+        }
+        int index = frame[0];
+        if(index == last) return;
+        if(last >= 0) skipped += (index - last - 1 + FRAMES) % FRAMES;
+        newFrames++;
+        last = index;
+    }
+};
+
+static HMS_BLE_BroadcastParams params(HMS_BLE_BroadcastMode mode, uint16_t intervalMs, uint16_t eventsPerFrame) {
+    HMS_BLE_BroadcastParams p = {};
+    p.mode = mode;
+    p.companyId = COMPANY;
+    p.interval = intervalMs * 8 / 5;                                                                               // 0.625 ms units
+    p.periodicInterval = intervalMs * 4 / 5;                                                                       // 1.25 ms units
+    p.phy = mode == HMS_BLE_BROADCAST_LEGACY ? HMS_BLE_PHY_1M : HMS_BLE_PHY_2M;
+    p.eventsPerFrame = eventsPerFrame;
+    return p;
+}
+
+static int createRotating(HMS_BLE& ble, const HMS_BLE_BroadcastParams& p) {
+    int set = -1;
+    if(ble.createBroadcast(p, &set) != HMS_BLE_STATUS_SUCCESS) return -1;
+    uint8_t frame[HMS_BLE_BROADCAST_DATA_LENGTH];
+    size_t capacity = ble.getBroadcastCapacity(set);
+    for(int f = 0; f < FRAMES; f++) {
+        fillFrame(frame, f, capacity);
+        ble.setBroadcastFrame(set, f, frame, capacity);
+    }
+    return set;
+}
+
+struct Run {
+    Heard    heard;
+    uint32_t events;
+    uint32_t rotations;
+    uint32_t failed;
+    double   seconds;
+};
+
+static bool sound(const Run& r) {
+    return r.heard.newFrames > 0 && r.heard.malformed == 0 && r.failed == 0;
+}
+
+// One set, one scanner, for ms milliseconds
+static Run broadcast(HMS_BLE& ble, const HMS_BLE_BroadcastParams& p, uint8_t loss, uint32_t ms) {
+    Run r = {};
+    int set = createRotating(ble, p);
+    if(set < 0) return r;
+    r.heard.payload = ble.getBroadcastCapacity(set);
+    HMS_BLE_VirtualScanner scanner;
+    scanner.setLoss(loss);
+    scanner.setReportCallback([&](int, HMS_BLE_BroadcastMode, const uint8_t* data, size_t length) { r.heard.hear(data, length); });
+    scanner.start(&ble);
+
+    auto start = std::chrono::steady_clock::now();
+    ble.startBroadcast(set);
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    ble.stopBroadcast(set);
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    scanner.stop();
+
+    HMS_BLE_BroadcastStats stats = ble.getBroadcastStats(set);
+    r.events = ble.getBroadcastEvents(set);
+    r.rotations = stats.rotations;
+    r.failed = stats.failed;
+    ble.removeBroadcast(set);
+    return r;
+}
+
+static double coverage(const Run& r) {
+    uint32_t sent = r.heard.newFrames + r.heard.skipped;
+    return sent ? 100.0 * r.heard.newFrames / sent : 0;
+}
+
+static void print(const char* name, uint16_t intervalMs, const Run& r) {
+    double ideal = r.heard.payload * 1000.0 / intervalMs;
+    double effective = r.heard.newFrames * r.heard.payload / r.seconds;
+    printf("%-22s %8u %8zu %9.1f %9u %9.1f %10.0f %10.0f %7.0f%% %7s\n", name, intervalMs, r.heard.payload, r.events / r.seconds,
+        r.heard.newFrames, coverage(r), effective, ideal, 100 * effective / ideal, sound(r) ? "yes" : "NO");
+}
+
+int main(void) {
+    HMS_BLE ble("BenchBroadcast");
+    ble.begin<schema>(true);                                                                                       // The background task runs the rotation
+    bool ok = true;
+
+    // Refusals and capacities
+    int set = -1, extra[HMS_BLE_BROADCAST_SETS];
+    HMS_BLE_BroadcastParams legacy2M = params(HMS_BLE_BROADCAST_LEGACY, 100, 1);
+    legacy2M.phy = HMS_BLE_PHY_2M;
+    bool refusals = ble.createBroadcast(legacy2M, &set) == HMS_BLE_STATUS_ERROR_PROTOCOL;
+    for(int i = 0; i < HMS_BLE_BROADCAST_SETS; i++) refusals = refusals && ble.createBroadcast(params(HMS_BLE_BROADCAST_EXTENDED, 100, 1), &extra[i]) == HMS_BLE_STATUS_SUCCESS;
+    refusals = refusals && ble.createBroadcast(params(HMS_BLE_BROADCAST_EXTENDED, 100, 1), &set) == HMS_BLE_STATUS_ERROR_BUSY;
+    uint8_t large[HMS_BLE_BROADCAST_DATA_LENGTH] = {};
+    refusals = refusals && ble.setBroadcastFrame(extra[0], 0, large, ble.getBroadcastCapacity(extra[0]) + 1) == HMS_BLE_STATUS_ERROR_OVERFLOW;
+    refusals = refusals && ble.getBroadcastCapacity(extra[0]) == HMS_BLE_BROADCAST_DATA_LENGTH - 4;
+    ble.removeBroadcast(extra[1]);
+    refusals = refusals && ble.createBroadcast(params(HMS_BLE_BROADCAST_LEGACY, 100, 1), &extra[1]) == HMS_BLE_STATUS_SUCCESS &&
+               ble.getBroadcastCapacity(extra[1]) == HMS_BLE_ADV_PACKET_LENGTH - 4;
+    for(int i = 0; i < HMS_BLE_BROADCAST_SETS; i++) ble.removeBroadcast(extra[i]);
+    ok = ok && refusals;
+
+    printf("HMS_BLE broadcaster, %d frames per set, HMS_BLE_BROADCAST_DATA_LENGTH=%d, one event per frame\n", FRAMES, HMS_BLE_BROADCAST_DATA_LENGTH);
+    printf("%-22s %8s %8s %9s %9s %9s %10s %10s %8s %7s\n", "set", "interval", "B/frame", "events/s", "new", "heard %",
+        "B/s", "ideal B/s", "of ideal", "checks");
+    const uint16_t intervals[] = { 100, 20 };
+    char name[32];
+    for(int m = HMS_BLE_BROADCAST_LEGACY; m <= HMS_BLE_BROADCAST_PERIODIC; m++) {
+        for(uint16_t intervalMs : intervals) {
+            Run r = broadcast(ble, params((HMS_BLE_BroadcastMode)m, intervalMs, 1), 0, RUN_MS);
+            snprintf(name, sizeof(name), "%s", modeNames[m]);
+            print(name, intervalMs, r);
+            ok = ok && sound(r);
+        }
+    }
+
+    printf("\nextended set at 20 ms, scanner missing %u%% of the events\n", LOSS);
+    printf("%-22s %8s %8s %9s %9s %9s %10s %10s %8s %7s\n", "events per frame", "interval", "B/frame", "events/s", "new", "heard %",
+        "B/s", "ideal B/s", "of ideal", "checks");
+    for(uint16_t eventsPerFrame = 1; eventsPerFrame <= 4; eventsPerFrame++) {
+        Run r = broadcast(ble, params(HMS_BLE_BROADCAST_EXTENDED, 20, eventsPerFrame), LOSS, LOSS_RUN_MS);
+        snprintf(name, sizeof(name), "%u", eventsPerFrame);
+        print(name, 20, r);
+        ok = ok && sound(r);
+    }
+
+    // One set of each mode at once
+    printf("\none set of each mode at 20 ms, one scanner\n");
+    printf("%-22s %9s %9s %10s %7s\n", "set", "events/s", "new", "B/s", "checks");
+    {
+        Heard heard[HMS_BLE_BROADCAST_SETS];
+        int sets[3];
+        for(int m = 0; m < 3; m++) {
+            sets[m] = createRotating(ble, params((HMS_BLE_BroadcastMode)m, 20, 1));
+            heard[sets[m]].payload = ble.getBroadcastCapacity(sets[m]);
+        }
+        HMS_BLE_VirtualScanner scanner;
+        scanner.setReportCallback([&](int set, HMS_BLE_BroadcastMode, const uint8_t* data, size_t length) { heard[set].hear(data, length); });
+        scanner.start(&ble);
+        auto start = std::chrono::steady_clock::now();
+        for(int m = 0; m < 3; m++) ble.startBroadcast(sets[m]);
+        std::this_thread::sleep_for(std::chrono::milliseconds(RUN_MS));
+        for(int m = 0; m < 3; m++) ble.stopBroadcast(sets[m]);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        scanner.stop();
+        double total = 0;
+        for(int m = 0; m < 3; m++) {
+            const Heard& h = heard[sets[m]];
+            double rate = h.newFrames * h.payload / seconds;
+            total += rate;
+            bool fine = h.newFrames > 0 && h.malformed == 0 && ble.getBroadcastStats(sets[m]).failed == 0;
+            printf("%-22s %9.1f %9u %10.0f %7s\n", modeNames[m], ble.getBroadcastEvents(sets[m]) / seconds, h.newFrames, rate, fine ? "yes" : "NO");
+            ok = ok && fine;
+            ble.removeBroadcast(sets[m]);
+        }
+        printf("%-22s %9s %9s %10.0f\n", "all three", "", "", total);
+    }
+
+    // Live updates: a stopped set only copies, a running one also hands the frame on air to the stack
+    int live = -1;
+    ble.createBroadcast(params(HMS_BLE_BROADCAST_EXTENDED, 100, 1), &live);
+    uint8_t value[64];
+    fillFrame(value, 0, sizeof(value));
+    allocations = 0;
+    countAllocations = true;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < UPDATES; n++) {
+        value[1] = (uint8_t)n;
+        ble.setBroadcastFrame(live, 0, value, sizeof(value));
+    }
+    double stoppedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / UPDATES;
+    countAllocations = false;
+    ble.startBroadcast(live);
+    ble.resetBroadcastStats(live);
+    countAllocations = true;
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < UPDATES; n++) {
+        value[1] = (uint8_t)n;
+        ble.setBroadcastFrame(live, 0, value, sizeof(value));
+    }
+    double runningNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / UPDATES;
+    countAllocations = false;
+    size_t updateAllocations = allocations;
+    HMS_BLE_BroadcastStats stats = ble.getBroadcastStats(live);
+    ble.removeBroadcast(live);
+    ok = ok && updateAllocations == 0 && stats.updates == UPDATES && stats.failed == 0;
+
+    printf("\n%-50s %10.1f\n", "setBroadcastFrame(), stopped set, ns", stoppedNs);
+    printf("%-50s %10.1f\n", "setBroadcastFrame(), frame on air, ns", runningNs);
+    printf("%-50s %10u\n", "hand-offs to the stack for the frame on air", stats.updates);
+    printf("%-50s %10zu\n", "heap allocations during updates", updateAllocations);
+    printf("%-50s %10s\n", "legacy 2M, sets full, oversize frame refused", refusals ? "yes" : "NO");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+/*
+  Connection table benchmark (HMS_BLE_MAX_CLIENTS=32): 32 virtual centrals connect, then one random central at a time
+  disconnects and reconnects, so the controller hands out handles that wrap and land anywhere in the hash index.
+  - after every reconnect, findConnection() must return the slot that getConnection() reports for that handle,
+  - the old scheme (slot = handle % HMS_BLE_MAX_CLIENTS) is replayed on the same handles to count two live links sharing a slot,
+  - every central subscribes and must receive exactly the notifications sent while it was subscribed, and its slot's
+    notificationsSent counter must agree.
+  Reports ns per findConnection() against a linear scan of the handles, ns per isSubscribed() against a scan of one bool per
+  client (the layout before the subscription bitsets), and ns per sendData() fanned out to all 32 links.
+*/
+#include <stdio.h>
+#include <random>
+#include <memory>
+
+#include "HMS_BLE.h"
+
+#if HMS_BLE_MAX_CLIENTS < 32
+  #error "Build with HMS_BLE_MAX_CLIENTS=32"
+#endif
+
+static const int    CENTRALS = 32;
+static const int    CHURN    = 20000;
+static const size_t LOOKUPS  = 10000000;
+static const size_t SENDS    = 100000;
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Telemetry",
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "Samples", HMS_BLE_PROPERTY_NOTIFY)
+    )
+);
+
+static std::unique_ptr<HMS_BLE_VirtualCentral> makeCentral(int i) {
+    uint8_t address[6] = { 0xC0, 0x00, 0x00, 0x00, 0x00, (uint8_t)i };
+    return std::unique_ptr<HMS_BLE_VirtualCentral>(new HMS_BLE_VirtualCentral(address));
+}
+
+int main(void) {
+    HMS_BLE ble("BenchConnections");
+    ble.begin<schema>(false);
+    HMS_BLE_CharHandle handle = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[0].uuid);
+
+    std::unique_ptr<HMS_BLE_VirtualCentral> centrals[CENTRALS];
+    for(int i = 0; i < CENTRALS; i++) {
+        centrals[i] = makeCentral(i);
+        centrals[i]->connect(&ble);
+    }
+
+    // Churn
+    std::mt19937 rng(2024);
+    std::uniform_int_distribution<int> pick(0, CENTRALS - 1);
+    size_t mismatches = 0, oldCollisions = 0;
+    for(int n = 0; n < CHURN; n++) {
+        int i = pick(rng);
+        centrals[i]->disconnect();
+        centrals[i] = makeCentral(i);
+        if(centrals[i]->connect(&ble) != HMS_BLE_STATUS_SUCCESS) mismatches++;
+
+        bool slotUsed[HMS_BLE_MAX_CLIENTS] = { false };
+        for(int k = 0; k < CENTRALS; k++) {
+            uint16_t connHandle = centrals[k]->getConnHandle();
+            int slot = ble.findConnection(connHandle);
+            HMS_BLE_Connection connection;
+            if(slot < 0 || !ble.getConnection(slot, &connection) || connection.connHandle != connHandle ||
+               memcmp(connection.address, centrals[k]->getAddress(), 6) != 0) {
+                mismatches++;
+            }
+            int oldSlot = connHandle % HMS_BLE_MAX_CLIENTS;
+            if(slotUsed[oldSlot]) oldCollisions++;
+            slotUsed[oldSlot] = true;
+        }
+    }
+    bool lookupOk = mismatches == 0 && ble.getConnectedClients() == CENTRALS && ble.findConnection(0x0EFF) < 0;
+
+    // Lookup cost
+    uint16_t handles[CENTRALS];
+    for(int k = 0; k < CENTRALS; k++) handles[k] = centrals[k]->getConnHandle();
+    volatile int sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < LOOKUPS; n++) sink = sink + ble.findConnection(handles[n % CENTRALS]);
+    double hashNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / LOOKUPS;
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < LOOKUPS; n++) {
+        uint16_t wanted = handles[n % CENTRALS];
+        int found = -1;
+        for(int k = 0; k < CENTRALS; k++) {
+            if(handles[k] == wanted) { found = k; break; }
+        }
+        sink = sink + found;
+    }
+    double scanNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / LOOKUPS;
+
+    // Subscription check: nobody subscribed yet, the worst case for a per-client scan
+    bool enabled[HMS_BLE_MAX_CLIENTS] = { false };
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < LOOKUPS; n++) sink = sink + ble.isSubscribed(handle);
+    double bitsetNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / LOOKUPS;
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < LOOKUPS; n++) {
+        bool any = false;
+        for(int k = 0; k < HMS_BLE_MAX_CLIENTS && !any; k++) any = ((volatile bool*)enabled)[k];
+        sink = sink + any;
+    }
+    double boolsNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / LOOKUPS;
+
+    // Fan-out: half the centrals subscribe first, the rest join halfway through
+    for(int k = 0; k < CENTRALS / 2; k++) centrals[k]->subscribe(schema.services[0].uuidStr, schema.characteristics[0].uuidStr);
+    uint8_t value[20];
+    memset(value, 0x3C, sizeof(value));
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < SENDS; n++) {
+        if(n == SENDS / 2) {
+            for(int k = CENTRALS / 2; k < CENTRALS; k++) centrals[k]->subscribe(schema.services[0].uuidStr, schema.characteristics[0].uuidStr);
+        }
+        ble.sendData(handle, value, sizeof(value));
+    }
+    double sendNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / SENDS;
+    bool fanOutOk = true;
+    for(int k = 0; k < CENTRALS; k++) {
+        size_t expected = k < CENTRALS / 2 ? SENDS : SENDS / 2;
+        HMS_BLE_Connection connection;
+        ble.getConnection(ble.findConnection(centrals[k]->getConnHandle()), &connection);
+        fanOutOk = fanOutOk && centrals[k]->getNotificationCount() == expected && connection.stats.notificationsSent == expected;
+    }
+
+    printf("HMS_BLE connection table, %d centrals, %d disconnect/reconnect cycles (HMS_BLE_MAX_CLIENTS=%d, index %zu entries)\n",
+        CENTRALS, CHURN, HMS_BLE_MAX_CLIENTS, HMS_BLE_ConnectionIndexSize());
+    printf("%-40s %10zu\n", "handle -> slot mismatches", mismatches);
+    printf("%-40s %10zu\n", "shared slots with handle % MAX_CLIENTS", oldCollisions);
+    printf("%-40s %10.1f\n", "findConnection() ns", hashNs);
+    printf("%-40s %10.1f\n", "linear scan of 32 handles ns", scanNs);
+    printf("%-40s %10.1f\n", "isSubscribed() ns, nobody subscribed", bitsetNs);
+    printf("%-40s %10.1f\n", "scan of per-client bools ns", boolsNs);
+    printf("%-40s %10.1f\n", "sendData() to 16..32 links ns", sendNs);
+    printf("%-40s %10s\n", "per-central notification counts", fanOutOk ? "exact" : "WRONG");
+
+    for(int k = 0; k < CENTRALS; k++) centrals[k]->disconnect();
+    return (lookupOk && fanOutOk && ble.getConnectedClients() == 0) ? 0 : 1;
+}
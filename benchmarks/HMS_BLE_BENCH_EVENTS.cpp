@@ -0,0 +1,117 @@
+/*
+  Background task benchmark: the event-driven task (signalEvent() -> condition variable -> loop()) against the fixed 50 ms
+  polling task it replaced. Reports wakeups per second while idle and the latency from a central's write to the background
+  handler. The polling baseline is reproduced with a plain thread that sleeps 50 ms and checks a timestamp, like the old
+  desktopTask()/bleTask() did.
+*/
+#include <stdio.h>
+#include <random>
+
+#include "HMS_BLE.h"
+
+static const int      IDLE_MS     = 2000;
+static const int      WRITES      = 40;
+static const int      MAX_GAP_MS  = 60;                                                                         // Writes arrive at random points of a poll period
+static const int      POLL_MS     = 50;                                                                         // Old bleTask()/desktopTask() period
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Control",
+        HMS_BLE_MakeCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", "Command", HMS_BLE_PROPERTY_WRITE)
+    )
+);
+
+static uint32_t nowMicros() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Result {
+    double wakeupsPerSecond;
+    double meanLatencyUs;
+    uint32_t maxLatencyUs;
+};
+
+static void print(const char* name, const Result& r) {
+    printf("%-22s %14.1f %14.1f %14u\n", name, r.wakeupsPerSecond, r.meanLatencyUs, r.maxLatencyUs);
+}
+
+template <typename F>
+static void writeRandomly(F&& write) {
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> gap(1, MAX_GAP_MS);
+    for(int i = 0; i < WRITES; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(gap(rng)));
+        write(i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS + 10));                                     // Let the last write be handled
+}
+
+static Result runEventDriven() {
+    HMS_BLE ble("BenchEvents");
+    ble.begin<schema>(true);
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    Result r;
+    ble.resetTaskStats();
+    std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_MS));
+    r.wakeupsPerSecond = ble.getTaskStats().wakeups * 1000.0 / IDLE_MS;
+
+    ble.resetTaskStats();
+    writeRandomly([&](int i) {
+        uint8_t value = (uint8_t)i;
+        central.write(schema.services[0].uuidStr, schema.characteristics[0].uuidStr, &value, 1);
+    });
+    HMS_BLE_TaskStats stats = ble.getTaskStats();
+    r.meanLatencyUs = stats.handled ? (double)stats.totalLatencyUs / stats.handled : 0;
+    r.maxLatencyUs = stats.maxLatencyUs;
+
+    central.disconnect();
+    return r;
+}
+
+static Result runPolling() {
+    std::atomic<bool> running{true};
+    std::atomic<uint32_t> writeTime{0};
+    std::atomic<uint32_t> wakeups{0}, handled{0}, total{0}, worst{0};
+    std::thread task([&] {
+        while(running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+            wakeups++;
+            uint32_t t = writeTime.exchange(0);
+            if(t) {
+                uint32_t latency = nowMicros() - t;
+                handled++;
+                total += latency;
+                if(latency > worst) worst = latency;
+            }
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_MS));
+    Result r;
+    r.wakeupsPerSecond = wakeups * 1000.0 / IDLE_MS;
+    writeRandomly([&](int) {
+        uint32_t expected = 0;
+        writeTime.compare_exchange_strong(expected, nowMicros());                                              // Oldest unhandled write, like signalEvent()
+    });
+    r.meanLatencyUs = handled ? (double)total / handled : 0;
+    r.maxLatencyUs = worst;
+
+    running = false;
+    task.join();
+    return r;
+}
+
+int main(void) {
+    printf("HMS_BLE background task, %d ms idle, then %d writes spaced 1..%d ms apart\n", IDLE_MS, WRITES, MAX_GAP_MS);
+    printf("%-22s %14s %14s %14s\n", "task", "idle wakeups/s", "mean lat (us)", "max lat (us)");
+
+    Result polled = runPolling();
+    print("poll every 50 ms", polled);
+    Result events = runEventDriven();
+    print("event-driven", events);
+
+    return events.wakeupsPerSecond == 0 ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+/*
+  Footprint report: sizeof(HMS_BLE) for the configuration this file was compiled with, and where the bytes go, counted from
+  the public types (padding between members lands in "everything else"). Built twice, HMS_BLE_bench_footprint with the
+  defaults and HMS_BLE_bench_footprint_lean with HMS_BLE_LEGACY_API=0 HMS_BLE_RUNTIME_REGISTRATION=0, so the two reports
+  side by side show what the lean build saves. Either build then runs the schema + handle path a lean application is left
+  with: begin<Schema>(), a write from a virtual central read back per service, and a notification out.
+*/
+#include <stdio.h>
+
+#include "HMS_BLE.h"
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("181A", "Environment",
+        HMS_BLE_MakeCharacteristic("2A6E", "Temperature", HMS_BLE_PROPERTY_NOTIFY),
+        HMS_BLE_MakeCharacteristic("2A6F", "Humidity", HMS_BLE_PROPERTY_NOTIFY)
+    ),
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Control",
+        HMS_BLE_MakeCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", "Command", HMS_BLE_PROPERTY_WRITE)
+    )
+);
+
+static void row(const char* name, size_t bytes) {
+    printf("%-44s %8zu\n", name, bytes);
+}
+
+int main(void) {
+    const size_t total = sizeof(HMS_BLE);
+    const size_t descriptors = HMS_BLE_MAX_SERVICES * sizeof(HMS_BLE_ServiceDescriptor);
+    size_t pools = 0;
+    #if HMS_BLE_RUNTIME_REGISTRATION
+        pools = HMS_BLE_MAX_SERVICES * sizeof(HMS_BLE_ServiceEntry) +
+                HMS_BLE_MAX_SERVICES * HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE * sizeof(HMS_BLE_CharacteristicEntry);
+    #endif
+    size_t legacy = 0;
+    #if HMS_BLE_LEGACY_API
+        legacy = 40 + sizeof(bool) + sizeof(size_t) + HMS_BLE_MAX_DATA_LENGTH;                          // serviceUUID, received, dataLength, data
+        #if HMS_BLE_RUNTIME_REGISTRATION
+            legacy += sizeof(bool) + sizeof(size_t) + HMS_BLE_MAX_CHARACTERISTICS * sizeof(HMS_BLE_Characteristic);
+        #endif
+    #endif
+
+    printf("HMS_BLE footprint, HMS_BLE_LEGACY_API=%d HMS_BLE_RUNTIME_REGISTRATION=%d, %d services x %d characteristics, "
+           "%d-byte values, %d clients\n", HMS_BLE_LEGACY_API, HMS_BLE_RUNTIME_REGISTRATION, HMS_BLE_MAX_SERVICES,
+           HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE, HMS_BLE_MAX_DATA_LENGTH, HMS_BLE_MAX_CLIENTS);
+    printf("%-44s %8s\n", "part", "bytes");
+    row("service descriptors", descriptors);
+    row("runtime registration pools", pools);
+    row("legacy flat array and shared buffer", legacy);
+    row("everything else", total - descriptors - pools - legacy);
+    row("sizeof(HMS_BLE)", total);
+    bool ok = descriptors + pools + legacy <= total;
+
+    // What is left after the legacy API is gone still carries an application end to end
+    HMS_BLE ble("BenchFootprint");
+    ok = ble.begin<schema>(false) == HMS_BLE_STATUS_SUCCESS && ok;
+    HMS_BLE_CharHandle command = ble.getCharacteristicHandle(schema.services[1].uuid, schema.characteristics[2].uuid);
+    HMS_BLE_CharHandle temperature = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[0].uuid);
+
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+    central.subscribe(schema.services[0].uuidStr, schema.characteristics[0].uuidStr);
+    const uint8_t start[] = { 'G', 'O' };
+    central.write(schema.services[1].uuidStr, schema.characteristics[2].uuidStr, start, sizeof(start));
+    bool written = ble.hasReceivedData(command) && ble.getReceivedDataLength(command) == sizeof(start) &&
+                   memcmp(ble.getReceivedData(command), start, sizeof(start)) == 0;
+
+    size_t before = central.getNotificationCount();
+    const uint8_t reading[] = { 0x34, 0x08 };
+    bool sent = ble.sendData(temperature, reading, sizeof(reading)) == HMS_BLE_STATUS_SUCCESS;
+    for(int i = 0; i < 100 && central.getNotificationCount() == before; i++) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    sent = sent && central.getNotificationCount() > before;
+    central.disconnect();
+
+    printf("\n%-44s %8s\n", "write read back through its service", written ? "yes" : "NO");
+    printf("%-44s %8s\n", "notification through a handle", sent ? "yes" : "NO");
+    return (ok && written && sent) ? 0 : 1;
+}
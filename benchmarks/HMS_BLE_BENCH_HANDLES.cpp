@@ -0,0 +1,73 @@
+/*
+  Send-path microbenchmark: UUID-string lookup vs pre-resolved HMS_BLE_CharHandle.
+  Runs against the desktop simulated controller with HMS_BLE_MAX_SERVICES x HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE
+  characteristics registered and targets the last one, i.e. the worst case for the linear strcmp walk.
+*/
+#include <stdio.h>
+
+#include "HMS_BLE.h"
+
+static const size_t ITERATIONS = 1000000;
+
+template <typename F>
+static double nsPerCall(F&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+        fn(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ITERATIONS;
+}
+
+int main(void) {
+    HMS_BLE ble("BenchHandles");
+    char svcUUIDs[HMS_BLE_MAX_SERVICES][40];
+    char charUUIDs[HMS_BLE_MAX_SERVICES][HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE][40];
+
+    for(int s = 0; s < HMS_BLE_MAX_SERVICES; s++) {
+        snprintf(svcUUIDs[s], sizeof(svcUUIDs[s]), "6E400000-B5A3-F393-E0A9-E50E24DC%04X", s);
+        HMS_BLE_Service svc = { svcUUIDs[s], "Service" };
+        ble.addService(&svc);
+        for(int c = 0; c < HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE; c++) {
+            snprintf(charUUIDs[s][c], sizeof(charUUIDs[s][c]), "6E400000-B5A3-F393-E0A9-E50E24DC%02X%02X", s, c + 1);
+            HMS_BLE_Characteristic chr = { charUUIDs[s][c], "Char", HMS_BLE_PROPERTY_READ_NOTIFY };
+            ble.addCharacteristicToService(svcUUIDs[s], &chr);
+        }
+    }
+    ble.begin(false);
+
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+
+    const char* svcUUID  = svcUUIDs[HMS_BLE_MAX_SERVICES - 1];
+    const char* charUUID = charUUIDs[HMS_BLE_MAX_SERVICES - 1][HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE - 1];
+    HMS_BLE_CharHandle handle = ble.getCharacteristicHandle(svcUUID, charUUID);
+
+    uint8_t payload[8] = {0};
+    volatile int sink = 0;
+
+    printf("HMS_BLE send path, %d services x %d characteristics, %zu iterations\n",
+        HMS_BLE_MAX_SERVICES, HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE, ITERATIONS);
+    printf("%-40s %10s\n", "path", "ns/call");
+
+    for(int subscribed = 0; subscribed < 2; subscribed++) {
+        if(subscribed) central.subscribe(svcUUID, charUUID);
+        const char* suffix = subscribed ? " (notify)" : " (no sub)";
+
+        double uuidPath   = nsPerCall([&](size_t i) { payload[0] = i; sink += ble.sendDataToService(svcUUID, charUUID, payload, sizeof(payload)); });
+        double legacyPath = nsPerCall([&](size_t i) { payload[0] = i; sink += ble.sendData(charUUID, payload, sizeof(payload)); });
+        double handlePath = nsPerCall([&](size_t i) { payload[0] = i; sink += ble.sendData(handle, payload, sizeof(payload)); });
+
+        printf("%-40s %10.1f\n", (std::string("sendDataToService(svc, char)") + suffix).c_str(), uuidPath);
+        printf("%-40s %10.1f\n", (std::string("sendData(charUUID)") + suffix).c_str(), legacyPath);
+        printf("%-40s %10.1f\n", (std::string("sendData(handle)") + suffix).c_str(), handlePath);
+    }
+
+    double subUUID   = nsPerCall([&](size_t) { sink += ble.isSubscribed(ble.getCharacteristicHandle(svcUUID, charUUID)); });
+    double subHandle = nsPerCall([&](size_t) { sink += ble.isSubscribed(handle); });
+    printf("%-40s %10.1f\n", "isSubscribed(resolve + check)", subUUID);
+    printf("%-40s %10.1f\n", "isSubscribed(handle)", subHandle);
+
+    central.disconnect();
+    return sink == 42 ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+/*
+  Indication pipeline benchmark (HMS_BLE_INDICATE_DEPTH=8, HMS_BLE_INDICATE_BEARERS=4), one virtual central indicating on
+  four characteristics:
+  - indicate() with a central that confirms on receipt: ns per indication from the call to its completion callback,
+  - a central that confirms once per simulated connection event (1 ms), every indication outstanding at that point: the
+    sender keeps the queues full, retrying on ERROR_BUSY, in order and per characteristic. Reports indications/s and the mean
+    round trip, and checks that every value arrived once, in order (per characteristic, and overall in order mode),
+  - a central that never confirms: loop() must fail the indication in flight and the ones queued behind it with
+    ERROR_TIMEOUT, call the timeout callback once, refuse the stalled link, ignore the late confirmation, and take
+    indications again after a reconnect,
+  - a full queue refuses with ERROR_BUSY and queues nothing, a disconnect fails what is left with ERROR_NOT_CONNECTED, oldest first.
+*/
+#include <stdio.h>
+#include <vector>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_INDICATE_DEPTH
+  #error "Build with HMS_BLE_INDICATE_DEPTH set"
+#endif
+
+static const int      CHARS       = 4;
+static const size_t   TIMED       = 200000;
+static const size_t   PIPELINED   = 1000;
+static const int      EVENT_US    = 1000;                                                                       // Simulated connection event
+static const uint32_t TIMEOUT_MS  = 20;
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Alarms",
+        HMS_BLE_MakeCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", "A", HMS_BLE_PROPERTY_INDICATE),
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "B", HMS_BLE_PROPERTY_INDICATE),
+        HMS_BLE_MakeCharacteristic("6E400004-B5A3-F393-E0A9-E50E24DCCA9E", "C", HMS_BLE_PROPERTY_INDICATE),
+        HMS_BLE_MakeCharacteristic("6E400005-B5A3-F393-E0A9-E50E24DCCA9E", "D", HMS_BLE_PROPERTY_INDICATE)
+    )
+);
+
+struct Received {
+    int64_t  lastPerChar[CHARS];
+    int64_t  lastOverall;
+    uint64_t outOfOrder;                                                                                            // Per characteristic
+    uint64_t interleaved;                                                                                           // Overall, only an error in order mode
+    uint64_t count;
+
+    void reset() {
+        for(int c = 0; c < CHARS; c++) lastPerChar[c] = -1;
+        lastOverall = -1;
+        outOfOrder = interleaved = count = 0;
+    }
+};
+
+struct Pipelined {
+    double   seconds;
+    double   meanRoundTripUs;
+    uint32_t maxInFlight;
+    uint32_t confirmed;
+    uint64_t busy;
+    bool     exact;
+};
+
+static int charOf(const char* uuid) {
+    int c = uuid[7] - '2';                                                                                          // 6E40000x: the UUIDs differ in that digit only
+    return (c >= 0 && c < CHARS) ? c : -1;
+}
+
+static Pipelined pipelined(HMS_BLE& ble, HMS_BLE_VirtualCentral& central, HMS_BLE_CharHandle* handles, Received& received, HMS_BLE_IndicateOrder order) {
+    std::atomic<bool> running{true};
+    std::atomic<uint32_t> done{0}, failed{0}, maxInFlight{0};
+    received.reset();
+    ble.setIndicationOrder(order);
+    ble.resetIndicationStats();
+    central.setAutoConfirm(false);
+
+    // Every connection event the central confirms what it has, as a link with that many bearers would
+    std::thread confirmer([&] {
+        auto next = std::chrono::steady_clock::now();
+        while(running) {
+            next += std::chrono::microseconds(EVENT_US);
+            std::this_thread::sleep_until(next);
+            uint32_t outstanding = (uint32_t)central.getUnconfirmed();
+            if(outstanding > maxInFlight) maxInFlight = outstanding;
+            for(uint32_t i = 0; i < outstanding; i++) central.confirm();
+        }
+    });
+
+    uint64_t busy = 0;
+    uint8_t value[8];
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t n = 0; n < PIPELINED; n++) {
+        memcpy(value, &n, sizeof(n));
+        memset(value + 4, (int)n, 4);
+        while(ble.indicate(handles[n % CHARS], value, sizeof(value), [&](HMS_BLE_CharHandle, int, HMS_BLE_Status status, uint32_t) {
+                  if(status == HMS_BLE_STATUS_SUCCESS) done++;
+                  else                                 failed++;
+              }) == HMS_BLE_STATUS_ERROR_BUSY) {
+            busy++;
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+    while(done + failed < PIPELINED) std::this_thread::yield();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    running = false;
+    confirmer.join();
+    central.setAutoConfirm(true);
+
+    HMS_BLE_IndicationStats stats = ble.getIndicationStats();
+    Pipelined r;
+    r.seconds = seconds;
+    r.meanRoundTripUs = stats.confirmed ? (double)stats.totalRoundTripUs / stats.confirmed : 0;
+    r.maxInFlight = maxInFlight;
+    r.confirmed = stats.confirmed;
+    r.busy = busy;
+    r.exact = failed == 0 && received.count == PIPELINED && received.outOfOrder == 0 && stats.confirmed == PIPELINED &&
+              (order != HMS_BLE_INDICATE_IN_ORDER || received.interleaved == 0);
+    return r;
+}
+
+int main(void) {
+    HMS_BLE ble("BenchIndicate");
+    ble.begin<schema>(false);                                                                                       // loop() is called here, deadlines included
+    HMS_BLE_CharHandle handles[CHARS];
+    for(int c = 0; c < CHARS; c++) handles[c] = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[c].uuid);
+
+    Received received;
+    received.reset();
+    HMS_BLE_VirtualCentral central;
+    central.setNotificationCallback([&](const char*, const char* charUUID, const uint8_t* data, size_t length) {
+        int c = charOf(charUUID);
+        uint32_t n;
+        if(c < 0 || length < sizeof(n)) return;
+        memcpy(&n, data, sizeof(n));
+        if((int64_t)n <= received.lastPerChar[c]) received.outOfOrder++;
+        if((int64_t)n <= received.lastOverall) received.interleaved++;
+        received.lastPerChar[c] = n;
+        received.lastOverall = n;
+        received.count++;
+    });
+    central.connect(&ble);
+    for(int c = 0; c < CHARS; c++) central.subscribe(schema.services[0].uuidStr, schema.characteristics[c].uuidStr, true, true);
+
+    // Confirmed on receipt: the whole round trip runs inside indicate()
+    uint8_t value[20];
+    memset(value, 0x42, sizeof(value));
+    uint64_t immediate = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < TIMED; n++) {
+        ble.indicate(handles[0], value, sizeof(value), [&](HMS_BLE_CharHandle, int, HMS_BLE_Status status, uint32_t) {
+            if(status == HMS_BLE_STATUS_SUCCESS) immediate++;
+        });
+    }
+    double immediateNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / TIMED;
+    HMS_BLE_IndicationStats stats = ble.getIndicationStats();
+    bool immediateOk = immediate == TIMED && stats.confirmed == TIMED && stats.pending == 0 && ble.getCharacteristicStats(handles[0]).indications == TIMED;
+
+    Pipelined inOrder = pipelined(ble, central, handles, received, HMS_BLE_INDICATE_IN_ORDER);
+    Pipelined perChar = pipelined(ble, central, handles, received, HMS_BLE_INDICATE_PER_CHARACTERISTIC);
+    ble.setIndicationOrder(HMS_BLE_INDICATE_IN_ORDER);
+
+    // Never confirmed
+    ble.resetIndicationStats();
+    central.setAutoConfirm(false);
+    ble.setIndicationTimeout(TIMEOUT_MS);
+    std::vector<HMS_BLE_Status> timeoutResults;
+    int timeoutCalls = 0;
+    ble.setIndicationTimeoutCallback([&](HMS_BLE_CharHandle, int) { timeoutCalls++; });
+    start = std::chrono::steady_clock::now();
+    for(int i = 0; i < 3; i++) {
+        ble.indicate(handles[i], value, sizeof(value), [&](HMS_BLE_CharHandle, int, HMS_BLE_Status status, uint32_t) { timeoutResults.push_back(status); });
+    }
+    while(timeoutResults.size() < 3 && std::chrono::steady_clock::now() - start < std::chrono::seconds(1)) {
+        ble.loop();
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    double detectedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    bool timedOut = timeoutResults.size() == 3 && timeoutCalls == 1;
+    for(HMS_BLE_Status status : timeoutResults) timedOut = timedOut && status == HMS_BLE_STATUS_ERROR_TIMEOUT;
+    bool stalledRefused = ble.indicate(handles[0], value, sizeof(value)) == HMS_BLE_STATUS_ERROR_TIMEOUT;
+    central.confirm();                                                                                              // Late confirmation of the entry that timed out
+    stats = ble.getIndicationStats();
+    bool lateIgnored = stats.confirmed == 0 && stats.timedOut == 3 && stats.pending == 0;
+
+    central.disconnect();
+    central.setAutoConfirm(true);
+    central.connect(&ble);
+    for(int c = 0; c < CHARS; c++) central.subscribe(schema.services[0].uuidStr, schema.characteristics[c].uuidStr, true, true);
+    bool recovered = ble.indicate(handles[0], value, sizeof(value)) == HMS_BLE_STATUS_SUCCESS && ble.getIndicationStats().confirmed == 1;
+
+    // Full queue, then a disconnect with everything still pending
+    central.setAutoConfirm(false);
+    ble.resetIndicationStats();
+    std::vector<uint32_t> aborted;
+    HMS_BLE_Status last = HMS_BLE_STATUS_SUCCESS;
+    for(uint32_t n = 0; n <= HMS_BLE_INDICATE_DEPTH; n++) {
+        last = ble.indicate(handles[n % CHARS], value, sizeof(value), [&aborted, n](HMS_BLE_CharHandle, int, HMS_BLE_Status status, uint32_t) {
+            if(status == HMS_BLE_STATUS_ERROR_NOT_CONNECTED) aborted.push_back(n);
+        });
+    }
+    bool busyRefused = last == HMS_BLE_STATUS_ERROR_BUSY && ble.getIndicationStats().busy == 1 && ble.getPendingIndications(0) == HMS_BLE_INDICATE_DEPTH;
+    central.disconnect();
+    bool abortedInOrder = aborted.size() == HMS_BLE_INDICATE_DEPTH && ble.getPendingIndications(0) == 0;
+    for(size_t i = 0; i < aborted.size(); i++) abortedInOrder = abortedInOrder && aborted[i] == i;
+
+    printf("HMS_BLE indications, depth %d per link, %d bearers\n", HMS_BLE_INDICATE_DEPTH, HMS_BLE_INDICATE_BEARERS);
+    printf("%-52s %10.1f\n", "confirmed on receipt, indicate() to onDone, ns", immediateNs);
+    printf("%-26s %10s %12s %12s %10s %8s %8s\n", "order", "indicated", "per second", "mean rtt us", "in flight", "busy", "order");
+    printf("%-26s %10u %12.0f %12.0f %10u %8llu %8s\n", "in order", inOrder.confirmed, inOrder.confirmed / inOrder.seconds,
+        inOrder.meanRoundTripUs, inOrder.maxInFlight, (unsigned long long)inOrder.busy, inOrder.exact ? "exact" : "WRONG");
+    printf("%-26s %10u %12.0f %12.0f %10u %8llu %8s\n", "per characteristic", perChar.confirmed, perChar.confirmed / perChar.seconds,
+        perChar.meanRoundTripUs, perChar.maxInFlight, (unsigned long long)perChar.busy, perChar.exact ? "exact" : "WRONG");
+    printf("%-52s %10.1f\n", "timeout detected by loop(), ms after indicate()", detectedMs);
+    printf("%-52s %10s\n", "3 x ERROR_TIMEOUT, one timeout callback", timedOut ? "yes" : "NO");
+    printf("%-52s %10s\n", "stalled link refused, late confirmation ignored", stalledRefused && lateIgnored ? "yes" : "NO");
+    printf("%-52s %10s\n", "indications again after a reconnect", recovered ? "yes" : "NO");
+    printf("%-52s %10s\n", "full queue: ERROR_BUSY, nothing queued", busyRefused ? "yes" : "NO");
+    printf("%-52s %10s\n", "disconnect: ERROR_NOT_CONNECTED, oldest first", abortedInOrder ? "yes" : "NO");
+    return (immediateOk && inOrder.exact && perChar.exact && timedOut && stalledRefused && lateIgnored && recovered && busyRefused && abortedInOrder) ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+/*
+  Write Without Response ingest benchmark (HMS_BLE_INGEST_BYTES=16384): a virtual central with a 247-byte ATT MTU writes
+  244-byte values, each carrying a sequence number and a pattern derived from it.
+  - stack-side cost: ns the central's write call holds the peripheral's BLE host, a write request whose zero-copy write
+    callback checks the value in place against a write command that is only copied into the ingest ring (the same check
+    runs when the ring is drained between batches, outside the timing),
+  - saturation: one thread writes commands back-to-back for a fixed count while the background task drains the ring into
+    the ingest callback, which checks every value. Reports writes/s and MB/s delivered, and the drops,
+  - paced: the same at a fixed rate, far above what a BLE link carries, where nothing should be dropped.
+  Every run checks that delivered + dropped = written, that the sequence gaps add up to the drops, that no value came out
+  corrupted, and that no heap allocation happened on either side while writes were flowing.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_INGEST_BYTES
+  #error "Build with HMS_BLE_INGEST_BYTES set"
+#endif
+
+static const size_t   VALUE         = 244;                                                                      // MTU 247 - 3
+static const size_t   TIMED         = 200000;
+static const size_t   BATCH         = 16;                                                                       // Writes per timed batch, fits the ring
+static const size_t   SATURATION    = 1000000;
+static const uint32_t PACED_RATE    = 5000;                                                                     // Writes per second
+static const size_t   PACED         = 10000;
+static const double   AIR_WRITES    = 700;                                                                      // About the most 244-byte write commands a 2M PHY link carries per second
+
+static std::atomic<bool>   countAllocations{false};
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size) {
+    if(countAllocations.load(std::memory_order_relaxed)) allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept                          { free(p); }
+void operator delete(void* p, size_t) noexcept                  { free(p); }
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Uplink",
+        HMS_BLE_MakeCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", "Ingest", HMS_BLE_PROPERTY_WRITE_NR),
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "Command", HMS_BLE_PROPERTY_WRITE)
+    )
+);
+
+static void fill(uint8_t* value, uint32_t sequence) {
+    memcpy(value, &sequence, sizeof(sequence));
+    for(size_t i = sizeof(sequence); i < VALUE; i++) value[i] = (uint8_t)(sequence + i);
+}
+
+struct Checker {
+    int64_t  expected = 0;
+    uint64_t gaps = 0;
+    uint64_t corrupted = 0;
+    uint64_t delivered = 0;
+
+    void check(HMS_BLE_ValueView value) {
+        uint32_t sequence;
+        if(value.length != VALUE) { corrupted++; return; }
+        memcpy(&sequence, value.data, sizeof(sequence));
+        for(size_t i = sizeof(sequence); i < VALUE; i++) {
+            if(value.data[i] != (uint8_t)(sequence + i)) { corrupted++; return; }
+        }
+        if((int64_t)sequence < expected) corrupted++;                                                           // Duplicate or out of order
+        else gaps += sequence - expected;
+        expected = (int64_t)sequence + 1;
+        delivered++;
+    }
+};
+
+struct Run {
+    size_t   written;
+    double   seconds;
+    HMS_BLE_IngestStats stats;
+    Checker  checker;
+    size_t   allocations;
+};
+
+static bool accounted(const Run& r) {
+    return r.checker.corrupted == 0 && r.checker.delivered == r.stats.received && r.stats.received + r.stats.dropped == r.written &&
+           r.checker.gaps + (r.written - r.checker.expected) == r.stats.dropped && r.allocations == 0;
+}
+
+static void print(const char* name, const Run& r) {
+    printf("%-22s %9zu %9u %9u %12.0f %9.1f %10zu %9s %7zu\n", name, r.written, r.stats.received, r.stats.dropped,
+        r.stats.received / r.seconds, r.stats.bytes / r.seconds / 1e6, r.stats.maxFill, accounted(r) ? "exact" : "WRONG", r.allocations);
+}
+
+static Run drive(HMS_BLE& ble, HMS_BLE_VirtualCentral& central, Checker& checker, size_t count, uint32_t rate) {
+    uint8_t value[VALUE];
+    Run r;
+    checker = Checker();
+    ble.resetIngestStats();
+    allocations = 0;
+    countAllocations = true;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < count; n++) {
+        if(rate) std::this_thread::sleep_until(start + std::chrono::nanoseconds((uint64_t)n * 1000000000ull / rate));
+        fill(value, (uint32_t)n);
+        central.writeCommand(schema.services[0].uuidStr, schema.characteristics[0].uuidStr, value, VALUE);
+    }
+    while(ble.getIngestFill() > 0) std::this_thread::yield();                                                 // Let the background task finish
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    countAllocations = false;
+    r.allocations = allocations;
+    r.written = count;
+    r.stats = ble.getIngestStats();
+    r.checker = checker;
+    return r;
+}
+
+int main(void) {
+    Checker checker;
+    static uint8_t values[BATCH][VALUE];
+
+    // Stack-side cost, no background task: only the write calls are timed
+    double requestNs = 0, commandNs = 0;
+    bool timedOk;
+    {
+        HMS_BLE ble("BenchIngest");
+        ble.setIngestCallback([&](HMS_BLE_CharHandle, HMS_BLE_ValueView value, int) { checker.check(value); });
+        Checker requestChecker;
+        ble.setWriteViewCallback([&](HMS_BLE_CharHandle, HMS_BLE_ValueView value, const uint8_t*) { requestChecker.check(value); });
+        ble.begin<schema>(false);
+        HMS_BLE_VirtualCentral central;
+        central.connect(&ble);
+        central.exchangeMTU(247);
+
+        for(size_t n = 0; n < TIMED; n += BATCH) {
+            for(size_t k = 0; k < BATCH; k++) fill(values[k], (uint32_t)(n + k));
+            auto start = std::chrono::steady_clock::now();
+            for(size_t k = 0; k < BATCH; k++) central.write(schema.services[0].uuidStr, schema.characteristics[1].uuidStr, values[k], VALUE);
+            requestNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            for(size_t k = 0; k < BATCH; k++) central.writeCommand(schema.services[0].uuidStr, schema.characteristics[0].uuidStr, values[k], VALUE);
+            commandNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            ble.processIngest();
+        }
+        timedOk = requestChecker.delivered == TIMED && requestChecker.corrupted == 0 && checker.corrupted == 0 && ble.getIngestStats().received == TIMED && ble.getIngestStats().dropped == 0;
+        central.disconnect();
+    }
+
+    // A fresh instance whose background task drains the ring
+    HMS_BLE ble("BenchIngest");
+    ble.setIngestCallback([&](HMS_BLE_CharHandle, HMS_BLE_ValueView value, int) { checker.check(value); });
+    ble.begin<schema>(true);
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+    central.exchangeMTU(247);
+    Run saturated = drive(ble, central, checker, SATURATION, 0);
+    Run paced = drive(ble, central, checker, PACED, PACED_RATE);
+    central.disconnect();
+
+    printf("HMS_BLE write command ingest, %zu-byte values, HMS_BLE_INGEST_BYTES=%d\n", VALUE, HMS_BLE_INGEST_BYTES);
+    printf("%-50s %10.1f\n", "write request, value checked in the callback, ns", requestNs / TIMED);
+    printf("%-50s %10.1f\n", "write command, copied into the ingest ring, ns", commandNs / TIMED);
+    printf("%-22s %9s %9s %9s %12s %9s %10s %9s %7s\n", "run", "written", "delivered", "dropped", "delivered/s", "MB/s", "max fill", "accounts", "allocs");
+    print("saturation", saturated);
+    print("paced 5k writes/s", paced);
+    printf("%-50s %10.0fx\n", "saturation rate / a 2M PHY link's rate", saturated.stats.received / saturated.seconds / AIR_WRITES);
+    return (timedOk && accounted(saturated) && accounted(paced) && paced.stats.dropped == 0) ? 0 : 1;
+}
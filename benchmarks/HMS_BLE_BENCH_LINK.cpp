@@ -0,0 +1,229 @@
+/*
+  Link profile benchmark (HMS_BLE_LINK_PROFILES=1, HMS_BLE_TX_CREDITS=16, HMS_BLE_NOTIFY_QUEUE=1, HMS_BLE_MAX_STREAMS=1):
+  a virtual central with a 247-byte ATT MTU and a 7.5 ms default interval. The simulated link carries the notifications per
+  connection event the library estimates from the negotiated interval, PHY and data length.
+  - negotiation: each profile requested on connect, what the central settled on, the callbacks and whether it matched;
+    then a central limited to the 1M PHY and 27-octet payloads, and one that rejects the requested interval range,
+  - throughput: a 32 KB sendStream() per profile, notifications and kB per second, and the most the stack held at once,
+  - batching: a 1 kHz sensor updating one queued characteristic, what arrives and how old it is on arrival while the send
+    passes keep at most getSendBatch() notifications with the stack.
+*/
+#include <stdio.h>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_LINK_PROFILES || !HMS_BLE_TX_CREDITS || !HMS_BLE_NOTIFY_QUEUE || !HMS_BLE_MAX_STREAMS
+  #error "Build with HMS_BLE_LINK_PROFILES=1, HMS_BLE_TX_CREDITS, HMS_BLE_NOTIFY_QUEUE=1 and HMS_BLE_MAX_STREAMS set"
+#endif
+
+static const size_t   BLOB          = 32768;
+static const uint32_t SAMPLE_US     = 1000;                                                                     // 1 kHz sensor
+static const uint32_t SAMPLE_MS     = 1000;                                                                     // Sampling time per profile
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Telemetry",
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "Samples", HMS_BLE_PROPERTY_NOTIFY),
+        HMS_BLE_MakeCharacteristic("6E400004-B5A3-F393-E0A9-E50E24DCCA9E", "Blob", HMS_BLE_PROPERTY_NOTIFY)
+    )
+);
+
+static const char* const profileNames[HMS_BLE_LINK_PROFILE_COUNT] = { "default", "low latency", "high throughput", "low power" };
+
+static const char* phyName(uint8_t phy) {
+    return phy == HMS_BLE_PHY_2M ? "2M" : phy == HMS_BLE_PHY_CODED ? "coded" : "1M";
+}
+
+static uint64_t nowMicros() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Reports {
+    std::atomic<int> calls{0};
+    std::atomic<int> refused{0};
+    std::atomic<int> slot{-1};
+};
+
+static void printLink(const char* name, HMS_BLE& ble, const Reports& reports) {
+    HMS_BLE_LinkInfo info;
+    if(!ble.getLinkInfo(reports.slot, &info)) {
+        printf("%-26s not connected\n", name);
+        return;
+    }
+    printf("%-26s %9.2f %7u %8u %5s %6u %6u %10u %9d %8d %7s\n", name, info.interval * 1.25, info.latency, info.supervisionTimeout * 10,
+        phyName(info.txPhy), info.txOctets, info.mtu, info.notificationsPerEvent, reports.calls.load(), reports.refused.load(),
+        info.matched ? "yes" : "no");
+}
+
+// Connects a central (the simulator answers the profile request before connect() returns) and exchanges the MTU
+static void connect(HMS_BLE& ble, HMS_BLE_VirtualCentral& central) {
+    central.connect(&ble);
+    central.exchangeMTU(247);
+    central.subscribe(schema.services[0].uuidStr, schema.characteristics[0].uuidStr);
+    central.subscribe(schema.services[0].uuidStr, schema.characteristics[1].uuidStr);
+}
+
+struct Transfer {
+    double   seconds;
+    size_t   notifications;
+    size_t   maxInFlight;
+    bool     complete;
+};
+
+static Transfer stream(HMS_BLE& ble, HMS_BLE_LinkProfile profile) {
+    static uint8_t blob[BLOB];
+    for(size_t i = 0; i < BLOB; i++) blob[i] = (uint8_t)(i * 7);
+    HMS_BLE_CharHandle handle = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[1].uuid);
+
+    ble.setDefaultLinkProfile(profile);
+    HMS_BLE_VirtualCentral central;
+    connect(ble, central);
+    ble.resetTxStats();
+
+    std::atomic<bool> done{false};
+    std::atomic<size_t> sent{0};
+    size_t before = central.getNotificationCount();
+    auto start = std::chrono::steady_clock::now();
+    ble.sendStream(handle, blob, BLOB, [&](HMS_BLE_CharHandle, HMS_BLE_Status status, size_t length) {
+        sent = status == HMS_BLE_STATUS_SUCCESS ? length : 0;
+        done = true;
+    });
+    while(!done) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    while(ble.getTxStats().inFlight > 0) std::this_thread::sleep_for(std::chrono::microseconds(200));      // Until the central has it all
+
+    Transfer t;
+    t.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    t.notifications = central.getNotificationCount() - before;
+    t.maxInFlight = ble.getTxStats().maxInFlight;
+    t.complete = sent == BLOB;
+    central.disconnect();
+    return t;
+}
+
+struct Sampling {
+    size_t   produced;
+    size_t   delivered;
+    uint32_t coalesced;
+    double   meanAgeUs;
+    uint64_t maxAgeUs;
+    size_t   maxInFlight;
+    size_t   batch;
+};
+
+static Sampling sample(HMS_BLE& ble, HMS_BLE_LinkProfile profile) {
+    HMS_BLE_CharHandle handle = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[0].uuid);
+    ble.setDefaultLinkProfile(profile);
+    HMS_BLE_VirtualCentral central;
+    std::atomic<size_t> delivered{0};
+    std::atomic<uint64_t> totalAge{0}, maxAge{0};
+    central.setNotificationCallback([&](const char*, const char* charUUID, const uint8_t* data, size_t length) {
+        if(strcmp(charUUID, schema.characteristics[0].uuidStr) != 0 || length < sizeof(uint64_t)) return;
+        uint64_t stamp;
+        memcpy(&stamp, data, sizeof(stamp));
+        uint64_t age = nowMicros() - stamp;
+        totalAge += age;
+        if(age > maxAge) maxAge = age;
+        delivered++;
+    });
+    connect(ble, central);
+    ble.resetTxStats();
+    ble.resetNotifyQueueStats();
+
+    Sampling s = {};
+    uint8_t value[20] = {};
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t n = 0; n < SAMPLE_MS * 1000 / SAMPLE_US; n++) {
+        std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t)n * SAMPLE_US));
+        uint64_t stamp = nowMicros();
+        memcpy(value, &stamp, sizeof(stamp));
+        ble.sendData(handle, value, sizeof(value));
+        s.produced++;
+    }
+    s.batch = ble.getSendBatch();
+    while(ble.getNotifyQueueDepth() > 0 || ble.getTxStats().inFlight > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    s.delivered = delivered;
+    s.coalesced = ble.getNotifyQueueStats().coalesced;
+    s.meanAgeUs = delivered ? (double)totalAge / delivered : 0;
+    s.maxAgeUs = maxAge;
+    s.maxInFlight = ble.getTxStats().maxInFlight;
+    central.disconnect();
+    return s;
+}
+
+int main(void) {
+    HMS_BLE ble("BenchLink");
+    Reports reports;
+    ble.setLinkCallback([&](int slot, const HMS_BLE_LinkInfo&, HMS_BLE_Status status) {
+        reports.slot = slot;
+        reports.calls++;
+        if(status != HMS_BLE_STATUS_SUCCESS) reports.refused++;
+    });
+    ble.begin<schema>(true);
+    bool ok = true;
+
+    printf("HMS_BLE link profiles, 247-byte ATT MTU, HMS_BLE_TX_CREDITS=%d\n", HMS_BLE_TX_CREDITS);
+    printf("%-26s %9s %7s %8s %5s %6s %6s %10s %9s %8s %7s\n", "central / profile", "interval", "latency", "timeout", "phy", "octets",
+        "mtu", "notif/evt", "callbacks", "refused", "matched");
+    for(int p = 0; p < HMS_BLE_LINK_PROFILE_COUNT; p++) {
+        ble.setDefaultLinkProfile((HMS_BLE_LinkProfile)p);
+        reports.calls = 0;
+        reports.refused = 0;
+        HMS_BLE_VirtualCentral central;
+        connect(ble, central);
+        printLink(profileNames[p], ble, reports);
+        HMS_BLE_LinkInfo info;
+        ok = ok && ble.getLinkInfo(reports.slot, &info) && info.matched && reports.refused == 0;
+        central.disconnect();
+    }
+
+    ble.setDefaultLinkProfile(HMS_BLE_LINK_PROFILE_HIGH_THROUGHPUT);
+    {
+        reports.calls = 0;
+        reports.refused = 0;
+        HMS_BLE_VirtualCentral central;
+        central.setLinkSupport(HMS_BLE_PHY_1M, 27);
+        connect(ble, central);
+        printLink("1M/27 central, throughput", ble, reports);
+        HMS_BLE_LinkInfo info;
+        ok = ok && ble.getLinkInfo(reports.slot, &info) && !info.matched && info.txPhy == HMS_BLE_PHY_1M && info.txOctets == 27;
+        central.disconnect();
+    }
+    ble.setDefaultLinkProfile(HMS_BLE_LINK_PROFILE_DEFAULT);
+    {
+        reports.calls = 0;
+        reports.refused = 0;
+        HMS_BLE_VirtualCentral central;
+        central.setConnectionInterval(32);
+        central.setIntervalRange(24, 40);                                                                   // 30..50 ms only
+        connect(ble, central);
+        ble.requestLinkProfile(reports.slot, HMS_BLE_LINK_PROFILE_LOW_LATENCY);
+        printLink("30-50 ms central, latency", ble, reports);
+        HMS_BLE_LinkInfo info;
+        ok = ok && ble.getLinkInfo(reports.slot, &info) && !info.matched && reports.refused == 1;
+        central.disconnect();
+    }
+
+    printf("\n%zu KB sendStream(), 244-byte notifications\n", BLOB / 1024);
+    printf("%-26s %10s %10s %10s %10s\n", "profile", "seconds", "notif/s", "kB/s", "in flight");
+    Transfer transfers[HMS_BLE_LINK_PROFILE_COUNT];
+    for(int p = 0; p < HMS_BLE_LINK_PROFILE_COUNT; p++) {
+        Transfer& t = transfers[p];
+        t = stream(ble, (HMS_BLE_LinkProfile)p);
+        printf("%-26s %10.2f %10.0f %10.1f %10zu\n", profileNames[p], t.seconds, t.notifications / t.seconds, BLOB / t.seconds / 1000,
+            t.maxInFlight);
+        ok = ok && t.complete;
+    }
+    printf("%-26s %9.1fx\n", "high throughput / default", transfers[HMS_BLE_LINK_PROFILE_DEFAULT].seconds / transfers[HMS_BLE_LINK_PROFILE_HIGH_THROUGHPUT].seconds);
+
+    printf("\n1 kHz sensor on one queued characteristic, %u ms per profile\n", SAMPLE_MS);
+    printf("%-26s %9s %9s %9s %13s %12s %7s %10s\n", "profile", "produced", "delivered", "coalesced", "mean age (us)", "max age (us)", "batch",
+        "in flight");
+    for(int p = 0; p < HMS_BLE_LINK_PROFILE_COUNT; p++) {
+        Sampling s = sample(ble, (HMS_BLE_LinkProfile)p);
+        printf("%-26s %9zu %9zu %9u %13.0f %12llu %7zu %10zu\n", profileNames[p], s.produced, s.delivered, s.coalesced, s.meanAgeUs,
+            (unsigned long long)s.maxAgeUs, s.batch, s.maxInFlight);
+        ok = ok && s.delivered > 0 && s.delivered + s.coalesced <= s.produced && s.maxInFlight <= s.batch;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+/*
+  Deferred log benchmark (HMS_BLE_LOG_DEFERRED=1):
+  - cost of one deferred BLE_LOGGER call, against snprintf of the same line (what ChronoLog does on the calling thread
+    before its own timestamp and output),
+  - sendData() to one subscriber with the simulator's debug line recorded on every send,
+  - flushLog() output must equal snprintf of the same format and arguments, for the argument kinds the library logs,
+  - 4 threads log while the main thread flushes: every line must come out whole and in order per thread, and lines
+    formatted plus records reported lost must add up to the calls made.
+  With --dump <file> the records left after a disconnect are written in dumpLog() format for HMS_BLE_log_decode.
+*/
+#include <stdio.h>
+#include <vector>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_LOG_DEFERRED
+  #error "Build with HMS_BLE_LOG_DEFERRED=1"
+#endif
+
+static const size_t CALLS   = 2000000;
+static const size_t SENDS   = 1000000;
+static const int    THREADS = 4;
+static const size_t PER_THREAD = 50000;
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Telemetry",
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "Samples", HMS_BLE_PROPERTY_NOTIFY)
+    )
+);
+
+static double nsSince(std::chrono::steady_clock::time_point start, size_t ops) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ops;
+}
+
+static char   lastLine[160];
+static size_t threadLines = 0, threadErrors = 0;
+static long   lastCall[THREADS];
+
+static uint32_t lostSoFar() {
+    HMS_BLE_LogDumpHeader header;
+    HMS_BLE::dumpLog((uint8_t*)&header, sizeof(header));                                                     // Room for the header only, consumes nothing
+    return header.lost;
+}
+
+// Logs through BLE_LOGGER, formats with snprintf, and counts a mismatch when flushLog() prints something else
+#define CHECK_LINE(level, format, ...)                                                                          \
+    do {                                                                                                        \
+        char expected[160];                                                                                     \
+        BLE_LOGGER(level, format, __VA_ARGS__);                                                                 \
+        snprintf(expected, sizeof(expected), format, __VA_ARGS__);                                              \
+        lastLine[0] = 0;                                                                                        \
+        if(HMS_BLE::flushLog() != 1 || strcmp(lastLine, expected) != 0) {                                      \
+            printf("  mismatch: \"%s\" expected \"%s\"\n", lastLine, expected);                                \
+            mismatches++;                                                                                       \
+        }                                                                                                       \
+    } while(0)
+
+int main(int argc, char** argv) {
+    const char* dumpPath = (argc == 3 && !strcmp(argv[1], "--dump")) ? argv[2] : nullptr;
+
+    HMS_BLE ble("BenchLog");
+    ble.begin<schema>(false);
+    HMS_BLE_CharHandle handle = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[0].uuid);
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+    central.subscribe(schema.services[0].uuidStr, schema.characteristics[0].uuidStr);
+    uint8_t value[20];
+    memset(value, 0x42, sizeof(value));
+
+    // Caller cost, nobody consumes so the ring just wraps
+    auto start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < CALLS; n++) {
+        BLE_LOGGER(info, "Notification sent on %s: %d bytes to %d client(s)", schema.characteristics[0].uuidStr, (int)(n & 0xFF), 1);
+    }
+    double deferredNs = nsSince(start, CALLS);
+
+    char line[160];
+    volatile size_t sink = 0;
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < CALLS; n++) {
+        sink = sink + snprintf(line, sizeof(line), "Notification sent on %s: %d bytes to %d client(s)",
+            schema.characteristics[0].uuidStr, (int)(n & 0xFF), 1);
+    }
+    double formatNs = nsSince(start, CALLS);
+
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < SENDS; n++) ble.sendData(handle, value, sizeof(value));
+    double sendNs = nsSince(start, SENDS);
+
+    // Formatting on the consumer side
+    HMS_BLE::setLogHandler([](uint8_t, uint32_t, const char* text) {
+        snprintf(lastLine, sizeof(lastLine), "%s", text);
+    });
+    HMS_BLE::flushLog();
+    size_t mismatches = 0;
+    CHECK_LINE(info, "size %zu, negative %d, hex 0x%04X, unsigned %u, name %s, 100%%", (size_t)12345, -42, 0xBEEFu, 4000000000u, "Samples");
+    CHECK_LINE(warn, "long %ld %lld %llu, fixed %5.2f, left |%-6s|", -7L, -(1LL << 40), 1ULL << 63, 3.14159, "ab");
+    CHECK_LINE(error, "char %c, %%x of -1 %x, width %8d|, status %d", 'Z', -1, 77, HMS_BLE_STATUS_ERROR_BUSY);
+    CHECK_LINE(debug, "%s %u", schema.characteristics[0].uuidStr, (uint16_t)0xFFFF);
+
+    // Past HMS_BLE_LOG_PAYLOAD a string is cut and the arguments after it are gone
+    char cut[160];
+    BLE_LOGGER(warn, "%s/%s %d", schema.services[0].uuidStr, schema.characteristics[0].uuidStr, 5);
+    snprintf(cut, sizeof(cut), "%s/%.*s <?>", schema.services[0].uuidStr, HMS_BLE_LOG_PAYLOAD - 4 - 36, schema.characteristics[0].uuidStr);
+    if(HMS_BLE::flushLog() != 1 || strcmp(lastLine, cut) != 0) {
+        printf("  mismatch: \"%s\" expected \"%s\"\n", lastLine, cut);
+        mismatches++;
+    }
+
+    // Concurrent writers against one consumer
+    HMS_BLE::setLogHandler([](uint8_t, uint32_t, const char* text) {
+        int thread;
+        long call;
+        if(sscanf(text, "thread %d call %ld", &thread, &call) != 2) return;
+        threadLines++;
+        if(thread < 0 || thread >= THREADS || call <= lastCall[thread]) threadErrors++;
+        else lastCall[thread] = call;
+    });
+    for(int t = 0; t < THREADS; t++) lastCall[t] = -1;
+    HMS_BLE::flushLog();
+    uint32_t lostBefore = lostSoFar();
+    std::atomic<bool> go{false};
+    std::atomic<int> running{THREADS};
+    std::vector<std::thread> writers;
+    for(int t = 0; t < THREADS; t++) {
+        writers.emplace_back([&, t] {
+            while(!go) std::this_thread::yield();
+            for(size_t n = 0; n < PER_THREAD; n++) BLE_LOGGER(info, "thread %d call %ld", t, (long)n);
+            running--;
+        });
+    }
+    go = true;
+    while(running > 0) {
+        HMS_BLE::flushLog();
+        std::this_thread::yield();
+    }
+    for(auto& writer : writers) writer.join();
+    HMS_BLE::flushLog();
+    uint32_t lost = lostSoFar() - lostBefore;
+    bool accounted = threadLines + lost == THREADS * PER_THREAD;
+
+    printf("HMS_BLE deferred log, ring of %d records, %d argument bytes each\n", HMS_BLE_LOG_DEPTH, HMS_BLE_LOG_PAYLOAD);
+    printf("%-44s %10.1f\n", "deferred BLE_LOGGER call, ns", deferredNs);
+    printf("%-44s %10.1f\n", "snprintf of the same line, ns", formatNs);
+    printf("%-44s %10.1f\n", "sendData() to 1 subscriber, debug logged, ns", sendNs);
+    printf("%-44s %10zu\n", "flushLog() lines different from snprintf", mismatches);
+    printf("%-44s %10zu\n", "lines from 4 concurrent writers", threadLines);
+    printf("%-44s %10u\n", "records lost (ring full)", lost);
+    printf("%-44s %10zu\n", "garbled or out-of-order lines", threadErrors);
+    printf("%-44s %10s\n", "lines + lost = calls", accounted ? "yes" : "NO");
+
+    HMS_BLE::setLogHandler(nullptr);
+    central.disconnect(0x08);
+    if(dumpPath) {
+        std::vector<uint8_t> dump(sizeof(HMS_BLE_LogDumpHeader) + HMS_BLE_LOG_DEPTH * sizeof(HMS_BLE_LogRecord));
+        size_t bytes = HMS_BLE::dumpLog(dump.data(), dump.size());
+        FILE* out = fopen(dumpPath, "wb");
+        if(out) {
+            fwrite(dump.data(), 1, bytes, out);
+            fclose(out);
+        }
+    }
+    return (mismatches == 0 && threadErrors == 0 && accounted) ? 0 : 1;
+}
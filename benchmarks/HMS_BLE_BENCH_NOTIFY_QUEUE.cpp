@@ -0,0 +1,82 @@
+/*
+  Notification queue benchmark (HMS_BLE_NOTIFY_QUEUE=1): an application bursting sensor updates much faster than the link drains.
+  4 notify characteristics are updated round-robin and loop() runs once every DRAIN_EVERY updates, like the background task
+  would between connection events. Reports the cost of sendData() on the app side, how many updates were coalesced, and
+  checks that the central ends up with the newest value of every characteristic.
+*/
+#include <stdio.h>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_NOTIFY_QUEUE
+  #error "Build with HMS_BLE_NOTIFY_QUEUE=1"
+#endif
+
+static const size_t UPDATES     = 1000000;
+static const size_t DRAIN_EVERY = 64;
+static const int    CHARS       = 4;
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Stream",
+        HMS_BLE_MakeCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", "Accel", HMS_BLE_PROPERTY_READ_NOTIFY),
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "Gyro",  HMS_BLE_PROPERTY_READ_NOTIFY),
+        HMS_BLE_MakeCharacteristic("6E400004-B5A3-F393-E0A9-E50E24DCCA9E", "Mag",   HMS_BLE_PROPERTY_READ_NOTIFY),
+        HMS_BLE_MakeCharacteristic("6E400005-B5A3-F393-E0A9-E50E24DCCA9E", "Baro",  HMS_BLE_PROPERTY_READ_NOTIFY)
+    )
+);
+
+int main(void) {
+    HMS_BLE ble("BenchQueue");
+    ble.begin<schema>(false);
+
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+
+    HMS_BLE_CharHandle handles[CHARS];
+    uint32_t lastReceived[CHARS] = {0};
+    for(int c = 0; c < CHARS; c++) {
+        const HMS_BLE_CharacteristicEntry& chr = schema.characteristics[c];
+        handles[c] = ble.getCharacteristicHandle(schema.services[0].uuid, chr.uuid);
+        central.subscribe(schema.services[0].uuidStr, chr.uuidStr);
+    }
+    central.setNotificationCallback([&](const char*, const char* charUUID, const uint8_t* data, size_t length) {
+        for(int c = 0; c < CHARS; c++) {
+            if(charUUID == schema.characteristics[c].uuidStr && length == sizeof(uint32_t)) {                          // Callbacks get the schema's own strings
+                memcpy(&lastReceived[c], data, sizeof(uint32_t));
+            }
+        }
+    });
+
+    uint32_t lastSent[CHARS] = {0};
+    size_t failed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < UPDATES; i++) {
+        int c = i % CHARS;
+        lastSent[c] = (uint32_t)i;
+        if(ble.sendData(handles[c], (const uint8_t*)&lastSent[c], sizeof(uint32_t)) != HMS_BLE_STATUS_SUCCESS) failed++;
+        if((i + 1) % DRAIN_EVERY == 0) ble.loop();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ble.flushNotifyQueue();
+
+    HMS_BLE_NotifyQueueStats stats = ble.getNotifyQueueStats();
+    bool fresh = true;
+    for(int c = 0; c < CHARS; c++) {
+        fresh = fresh && (lastReceived[c] == lastSent[c]);
+    }
+
+    printf("HMS_BLE notify queue, %zu updates over %d characteristics, loop() every %zu updates\n", UPDATES, CHARS, DRAIN_EVERY);
+    printf("%-28s %12.1f\n", "ns/update (send + drain)", std::chrono::duration<double, std::nano>(elapsed).count() / UPDATES);
+    printf("%-28s %12zu\n", "failed sends", failed);
+    printf("%-28s %12u\n", "queued", stats.queued);
+    printf("%-28s %12u\n", "coalesced", stats.coalesced);
+    printf("%-28s %12u\n", "sent", stats.sent);
+    printf("%-28s %12u\n", "deferred", stats.deferred);
+    printf("%-28s %12u\n", "dropped", stats.dropped);
+    printf("%-28s %12zu\n", "high water", stats.highWater);
+    printf("%-28s %12zu\n", "notifications received", central.getNotificationCount());
+    printf("%-28s %12s\n", "newest value delivered", fresh ? "yes" : "NO");
+
+    central.disconnect();
+    return fresh && failed == 0 ? 0 : 1;
+}
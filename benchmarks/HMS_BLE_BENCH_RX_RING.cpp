@@ -0,0 +1,139 @@
+/*
+  Receive-ring benchmark (HMS_BLE_RX_RING_DEPTH=16): a virtual central writes as fast as it can from its own thread while the
+  application thread consumes. Every payload repeats its sequence number, so a value mixing two writes is detected as torn.
+  Compares the lock-free rings (queue and mailbox mode) with polling the per-service compatibility buffer.
+  A write longer than HMS_BLE_MAX_DATA_LENGTH must come out cut to a slot and counted by getReceiveTruncations().
+*/
+#include <stdio.h>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_RX_RING_DEPTH
+  #error "Build with HMS_BLE_RX_RING_DEPTH set"
+#endif
+
+static const uint32_t WRITES = 200000;
+static const uint32_t BURST  = 8;                                                                               // Writes back-to-back before the producer yields
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Control",
+        HMS_BLE_MakeCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", "Command",  HMS_BLE_PROPERTY_WRITE),
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "Setpoint", HMS_BLE_PROPERTY_WRITE)
+    )
+);
+
+struct Payload {
+    uint32_t seq[6];                                                                                            // Same sequence number six times
+};
+
+static bool intact(const uint8_t* data, size_t length, uint32_t* seq) {
+    if(length != sizeof(Payload)) return false;
+    Payload p;
+    memcpy(&p, data, sizeof(p));
+    for(int i = 1; i < 6; i++) {
+        if(p.seq[i] != p.seq[0]) return false;
+    }
+    *seq = p.seq[0];
+    return true;
+}
+
+struct Result {
+    uint32_t received;
+    uint32_t torn;
+    uint32_t outOfOrder;
+    uint32_t overflows;
+};
+
+static Result run(HMS_BLE& ble, HMS_BLE_VirtualCentral& central, HMS_BLE_CharHandle handle, const char* charUUID, int consumer) {
+    std::atomic<bool> done{false};
+    std::thread producer([&] {
+        Payload p;
+        for(uint32_t n = 1; n <= WRITES; n++) {
+            for(int i = 0; i < 6; i++) p.seq[i] = n;
+            central.write(schema.services[0].uuidStr, charUUID, (const uint8_t*)&p, sizeof(p));
+            if(n % BURST == 0) std::this_thread::yield();                                                      // Let the consumer in on single-core hosts
+        }
+        done = true;
+    });
+
+    Result r = {0, 0, 0, 0};
+    uint32_t last = 0;
+    uint8_t buffer[HMS_BLE_MAX_DATA_LENGTH];
+    while(true) {
+        bool finished = done.load();
+        uint32_t seq;
+        if(consumer == 0) {                                                                                     // Compatibility layer: poll the per-service buffer
+            if(ble.hasReceivedData(handle)) {
+                ble.clearReceivedData(handle);
+                r.received++;
+                if(!intact(ble.getReceivedData(handle), ble.getReceivedDataLength(handle), &seq)) r.torn++;
+                else if(seq < last) r.outOfOrder++;
+                else last = seq;
+            }
+        } else {
+            size_t length = sizeof(buffer);
+            while(ble.receive(handle, buffer, &length)) {
+                r.received++;
+                if(!intact(buffer, length, &seq)) r.torn++;
+                else if(seq <= last) r.outOfOrder++;
+                else last = seq;
+                length = sizeof(buffer);
+            }
+        }
+        if(finished && (consumer == 0 || ble.getReceiveDepth(handle) == 0)) break;
+        std::this_thread::yield();
+    }
+    producer.join();
+    r.overflows = (consumer == 0) ? WRITES - r.received : ble.getReceiveOverflows(handle);                     // Buffer: every write not seen was overwritten
+    return r;
+}
+
+static void print(const char* name, const Result& r) {
+    printf("%-26s %10u %10u %10u %10u\n", name, r.received, r.torn, r.outOfOrder, r.overflows);
+}
+
+int main(void) {
+    static_assert(sizeof(Payload) < HMS_BLE_MAX_DATA_LENGTH, "payload must fit the compatibility buffer");
+
+    HMS_BLE ble("BenchRxRing");
+    ble.begin<schema>(false);
+
+    const HMS_BLE_CharacteristicEntry& command  = schema.characteristics[0];
+    const HMS_BLE_CharacteristicEntry& setpoint = schema.characteristics[1];
+    HMS_BLE_CharHandle commandHandle  = ble.getCharacteristicHandle(schema.services[0].uuid, command.uuid);
+    HMS_BLE_CharHandle setpointHandle = ble.getCharacteristicHandle(schema.services[0].uuid, setpoint.uuid);
+    ble.setReceiveMode(commandHandle, HMS_BLE_RX_MODE_QUEUE);
+    ble.setReceiveMode(setpointHandle, HMS_BLE_RX_MODE_MAILBOX);
+
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+
+    printf("HMS_BLE receive path, %u writes of %zu bytes from a central thread, ring depth %d\n",
+        WRITES, sizeof(Payload), HMS_BLE_RX_RING_DEPTH);
+    printf("%-26s %10s %10s %10s %10s\n", "consumer", "received", "torn", "reordered", "overflows");
+
+    Result legacy  = run(ble, central, commandHandle, command.uuidStr, 0);
+    print("per-service buffer", legacy);
+    central.disconnect();                                                                                       // The legacy run filled the ring too, start clean
+    ble.setReceiveMode(commandHandle, HMS_BLE_RX_MODE_QUEUE);
+    central.connect(&ble);
+
+    Result queue   = run(ble, central, commandHandle, command.uuidStr, 1);
+    print("ring, queue mode", queue);
+    Result mailbox = run(ble, central, setpointHandle, setpoint.uuidStr, 1);
+    print("ring, mailbox mode", mailbox);
+
+    // A write longer than a slot is received cut to it, and counted
+    uint8_t longValue[HMS_BLE_MAX_DATA_LENGTH + 8] = {};
+    uint8_t slotValue[sizeof(longValue)];
+    size_t slotLength = sizeof(slotValue);
+    central.write(schema.services[0].uuidStr, command.uuidStr, longValue, sizeof(longValue));
+    bool cut = ble.receive(commandHandle, slotValue, &slotLength) && slotLength == HMS_BLE_MAX_DATA_LENGTH &&
+               ble.getReceiveTruncations(commandHandle) == 1;
+    printf("\n%-26s %10s\n", "long write cut and counted", cut ? "yes" : "NO");
+
+    central.disconnect();
+    bool ok = cut && queue.torn == 0 && queue.outOfOrder == 0 && queue.received + queue.overflows == WRITES &&
+              mailbox.torn == 0 && mailbox.outOfOrder == 0;
+    return ok ? 0 : 1;
+}
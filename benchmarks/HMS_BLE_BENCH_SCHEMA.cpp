@@ -0,0 +1,100 @@
+/*
+  Boot-path benchmark: runtime registration (addService()/addCharacteristicToService()/begin()) vs a constexpr
+  HMS_BLE_Schema started with begin<Schema>(). Both build the same 4 services x 8 characteristics with 128-bit UUIDs on the
+  desktop simulated controller. Heap traffic is counted by replacing the global operator new.
+
+  Built twice by CMake: HMS_BLE_bench_schema (default build) and HMS_BLE_bench_schema_lean (HMS_BLE_RUNTIME_REGISTRATION=0),
+  so sizeof(HMS_BLE) can be compared with and without the runtime registration pools.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#include "HMS_BLE.h"
+
+static const size_t ITERATIONS = 20000;
+
+static size_t heapAllocations = 0;
+static size_t heapBytes       = 0;
+
+void* operator new(size_t size) {
+    heapAllocations++;
+    heapBytes += size;
+    void* p = malloc(size ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept               { free(p); }
+void operator delete(void* p, size_t) noexcept       { free(p); }
+
+#define BENCH_UUID(s, c)    "6E400000-B5A3-F393-E0A9-E50E24DC" #s #c
+#define BENCH_CHAR(s, c)    HMS_BLE_MakeCharacteristic(BENCH_UUID(s, c), "Char", HMS_BLE_PROPERTY_READ_NOTIFY)
+#define BENCH_SERVICE(s)    HMS_BLE_MakeService(BENCH_UUID(00, s), "Service",                                                        \
+                                BENCH_CHAR(s, 01), BENCH_CHAR(s, 02), BENCH_CHAR(s, 03), BENCH_CHAR(s, 04),                         \
+                                BENCH_CHAR(s, 05), BENCH_CHAR(s, 06), BENCH_CHAR(s, 07), BENCH_CHAR(s, 08))
+
+static constexpr auto schema = HMS_BLE_MakeSchema(BENCH_SERVICE(10), BENCH_SERVICE(11), BENCH_SERVICE(12), BENCH_SERVICE(13));
+
+struct BootResult {
+    double us;                                                                                                  // Mean microseconds per boot
+    double allocations;                                                                                         // Mean heap allocations per boot
+    double bytes;                                                                                               // Mean heap bytes per boot
+};
+
+template <typename F>
+static BootResult measureBoot(F&& boot) {
+    size_t allocations = heapAllocations, bytes = heapBytes;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+        boot();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return {
+        std::chrono::duration<double, std::micro>(elapsed).count() / ITERATIONS,
+        (double)(heapAllocations - allocations) / ITERATIONS,
+        (double)(heapBytes - bytes) / ITERATIONS
+    };
+}
+
+static void printResult(const char* path, const BootResult& result) {
+    printf("%-32s %10.2f %12.1f %12.1f\n", path, result.us, result.allocations, result.bytes);
+}
+
+int main(void) {
+    static_assert(sizeof(schema.services) / sizeof(schema.services[0]) == 4, "bench schema shape");
+
+    printf("HMS_BLE boot path, 4 services x 8 characteristics, %zu iterations\n", ITERATIONS);
+    printf("sizeof(HMS_BLE) = %zu bytes (HMS_BLE_RUNTIME_REGISTRATION=%d), schema = %zu bytes of constant data\n",
+        sizeof(HMS_BLE), HMS_BLE_RUNTIME_REGISTRATION, sizeof(schema));
+    printf("%-32s %10s %12s %12s\n", "path", "us/boot", "allocs/boot", "bytes/boot");
+
+    #if HMS_BLE_RUNTIME_REGISTRATION
+        BootResult runtime = measureBoot([] {
+            HMS_BLE ble("BenchSchema");
+            char svcUUID[40], charUUID[40];
+            for(int s = 0; s < 4; s++) {
+                snprintf(svcUUID, sizeof(svcUUID), "6E400000-B5A3-F393-E0A9-E50E24DC00%02d", 10 + s);
+                HMS_BLE_Service svc = { svcUUID, "Service" };
+                ble.addService(&svc);
+                for(int c = 0; c < 8; c++) {
+                    snprintf(charUUID, sizeof(charUUID), "6E400000-B5A3-F393-E0A9-E50E24DC%02d%02d", 10 + s, c + 1);
+                    HMS_BLE_Characteristic chr = { charUUID, "Char", HMS_BLE_PROPERTY_READ_NOTIFY };
+                    ble.addCharacteristicToService(svcUUID, &chr);
+                }
+            }
+            ble.begin(false);
+        });
+        printResult("addService()/begin()", runtime);
+    #endif
+
+    BootResult compiled = measureBoot([] {
+        HMS_BLE ble("BenchSchema");
+        ble.begin<schema>(false);
+    });
+    printResult("begin<schema>()", compiled);
+
+    // Sanity check: the schema resolves like the runtime registration does
+    HMS_BLE ble("BenchSchema");
+    ble.begin<schema>(false);
+    return ble.getCharacteristicHandle("6E400000-B5A3-F393-E0A9-E50E24DC0013", "6E400000-B5A3-F393-E0A9-E50E24DC1308").valid() ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+/*
+  Static allocation benchmark (HMS_BLE_STATIC_ALLOCATION=1, HMS_BLE_LEGACY_API=0): counts every operator new of the process.
+  - cycles: construct, begin() with the background task, connect a virtual central, write, notify, disconnect and destroy,
+    20 times from a schema and 20 times through runtime registration. The heap blocks still live after each cycle must not
+    grow from one cycle to the next. The simulator's own threads allocate while they run, the blocks are counted per cycle
+    but all of them must be gone when the cycle ends,
+  - steady state: with a subscribed central, SENDS notifications through a handle, WRITES write requests and READS read
+    requests, with a write and a read-into callback installed; none of them may allocate.
+  Only the shared code and the desktop simulator run here: the ESP32 pools and static task, the Zephyr arena and thread stack
+  are not exercised and need checking on the target.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_STATIC_ALLOCATION
+  #error "Build with HMS_BLE_STATIC_ALLOCATION=1 and HMS_BLE_LEGACY_API=0"
+#endif
+
+static const size_t CYCLES  = 20;
+static const size_t SENDS   = 100000;
+static const size_t WRITES  = 100000;
+static const size_t READS   = 100000;
+
+static std::atomic<size_t> allocations{0};
+static std::atomic<long>   live{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    live.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept {
+    if(p) live.fetch_sub(1, std::memory_order_relaxed);
+    free(p);
+}
+void operator delete(void* p, size_t) noexcept                  { operator delete(p); }
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Telemetry",
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "Samples", HMS_BLE_PROPERTY_NOTIFY),
+        HMS_BLE_MakeCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", "Command", HMS_BLE_PROPERTY_WRITE),
+        HMS_BLE_MakeCharacteristic("6E400004-B5A3-F393-E0A9-E50E24DCCA9E", "Status", HMS_BLE_PROPERTY_READ)
+    )
+);
+
+static const char* const SERVICE  = "6E400001-B5A3-F393-E0A9-E50E24DCCA9E";
+static const char* const SAMPLES  = "6E400003-B5A3-F393-E0A9-E50E24DCCA9E";
+static const char* const COMMAND  = "6E400002-B5A3-F393-E0A9-E50E24DCCA9E";
+static const char* const STATUS   = "6E400004-B5A3-F393-E0A9-E50E24DCCA9E";
+
+static void waitNotifications(HMS_BLE_VirtualCentral& central, size_t count) {
+    for(int i = 0; i < 1000 && central.getNotificationCount() < count; i++) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+// One full life of an instance; returns true when the write arrived and the notification went out
+static bool cycle(bool runtime) {
+    HMS_BLE ble("BenchStatic");
+    if(runtime) {
+        #if HMS_BLE_RUNTIME_REGISTRATION
+            HMS_BLE_Service svc = { SERVICE, "Telemetry" };
+            HMS_BLE_Characteristic samples = { SAMPLES, "Samples", HMS_BLE_PROPERTY_NOTIFY };
+            HMS_BLE_Characteristic command = { COMMAND, "Command", HMS_BLE_PROPERTY_WRITE };
+            HMS_BLE_Characteristic status = { STATUS, "Status", HMS_BLE_PROPERTY_READ };
+            ble.addService(&svc);
+            ble.addCharacteristicToService(SERVICE, &samples);
+            ble.addCharacteristicToService(SERVICE, &command);
+            ble.addCharacteristicToService(SERVICE, &status);
+            if(ble.begin(true) != HMS_BLE_STATUS_SUCCESS) return false;
+        #endif
+    } else if(ble.begin<schema>(true) != HMS_BLE_STATUS_SUCCESS) {
+        return false;
+    }
+
+    HMS_BLE_CharHandle samples = ble.getCharacteristicHandle(SERVICE, SAMPLES);
+    HMS_BLE_CharHandle command = ble.getCharacteristicHandle(SERVICE, COMMAND);
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+    central.subscribe(SERVICE, SAMPLES);
+    const uint8_t go[] = { 'G', 'O' };
+    central.write(SERVICE, COMMAND, go, sizeof(go));
+    const uint8_t value[] = { 1, 2, 3, 4 };
+    ble.sendData(samples, value, sizeof(value));
+    waitNotifications(central, 1);
+    bool ok = ble.getReceivedDataLength(command) == sizeof(go) && central.getNotificationCount() == 1;
+    central.disconnect();
+    return ok;
+}
+
+static bool cycles(const char* name, bool runtime) {
+    long base = live.load();
+    long first = 0, last = 0;
+    size_t before = allocations.load();
+    bool ok = true;
+    for(size_t n = 0; n < CYCLES; n++) {
+        ok = cycle(runtime) && ok;
+        last = live.load() - base;
+        if(n == 0) first = last;
+    }
+    bool flat = last == first && last == 0;
+    printf("%-34s %8zu %14.1f %12ld %12ld %7s\n", name, CYCLES, (double)(allocations.load() - before) / CYCLES, first, last,
+        ok && flat ? "yes" : "NO");
+    return ok && flat;
+}
+
+int main(void) {
+    bool ok = true;
+    printf("HMS_BLE static allocation, HMS_BLE_RUNTIME_REGISTRATION=%d\n", HMS_BLE_RUNTIME_REGISTRATION);
+    printf("%-34s %8s %14s %12s %12s %7s\n", "begin()/destroy cycles", "cycles", "new per cycle", "live after 1", "live after N",
+        "flat");
+    ok = cycles("begin<schema>(), background task", false) && ok;
+    #if HMS_BLE_RUNTIME_REGISTRATION
+        ok = cycles("addService() + begin(), task", true) && ok;
+    #endif
+
+    HMS_BLE ble("BenchStatic");
+    ble.begin<schema>(true);
+    HMS_BLE_CharHandle samples = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[0].uuid);
+    volatile size_t written = 0;
+    ble.setWriteCallback([&written](const char*, const char*, const uint8_t*, size_t length, const uint8_t*) { written = written + length; });
+    ble.setReadIntoCallback([](HMS_BLE_CharHandle, HMS_BLE_ValueBuffer response, const uint8_t*) {
+        response.data[0] = 0x2A;
+        return (size_t)1;
+    });
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+    central.subscribe(SERVICE, SAMPLES);
+
+    uint8_t value[20] = {};
+    uint8_t readBack[HMS_BLE_ATT_MAX_VALUE_LENGTH];
+    size_t readLength;
+    for(int i = 0; i < 1000; i++) {                                                                     // Warm up every path once
+        ble.sendData(samples, value, sizeof(value));
+        central.write(SERVICE, COMMAND, value, sizeof(value));
+        readLength = sizeof(readBack);
+        central.read(SERVICE, STATUS, readBack, &readLength);
+    }
+    waitNotifications(central, 1000);
+
+    size_t before = allocations.load();
+    for(size_t n = 0; n < SENDS; n++) {
+        value[0] = (uint8_t)n;
+        ble.sendData(samples, value, sizeof(value));
+    }
+    waitNotifications(central, 1000 + SENDS);
+    size_t sendAllocations = allocations.load() - before;
+
+    before = allocations.load();
+    for(size_t n = 0; n < WRITES; n++) central.write(SERVICE, COMMAND, value, sizeof(value));
+    size_t writeAllocations = allocations.load() - before;
+
+    before = allocations.load();
+    size_t reads = 0;
+    for(size_t n = 0; n < READS; n++) {
+        readLength = sizeof(readBack);
+        if(central.read(SERVICE, STATUS, readBack, &readLength) == HMS_BLE_STATUS_SUCCESS && readLength == 1) reads++;
+    }
+    size_t readAllocations = allocations.load() - before;
+    central.disconnect();
+
+    printf("\n%-34s %10s %12s\n", "steady state", "operations", "allocations");
+    printf("%-34s %10zu %12zu\n", "sendData(handle), notified", central.getNotificationCount() - 1000, sendAllocations);
+    printf("%-34s %10zu %12zu\n", "write request + write callback", (size_t)written / sizeof(value) - 1000, writeAllocations);
+    printf("%-34s %10zu %12zu\n", "read request + read-into callback", reads, readAllocations);
+    ok = ok && sendAllocations == 0 && writeAllocations == 0 && readAllocations == 0 && reads == READS &&
+         central.getNotificationCount() == 1000 + SENDS && written == (WRITES + 1000) * sizeof(value);
+    return ok ? 0 : 1;
+}
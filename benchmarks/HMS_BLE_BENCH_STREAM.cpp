@@ -0,0 +1,128 @@
+/*
+  Streaming benchmark (HMS_BLE_MAX_STREAMS=2): a 4 KB blob is sent with sendStream() to a virtual central and written back
+  by the central into receiveStream(), at several negotiated ATT MTUs. The central side segments and reassembles with the
+  documented format (HMS_BLE_STREAM_FIRST/LAST, sequence, 32-bit total length in the first segment).
+
+  Reports host throughput of the library + simulated controller and the share of each ATT PDU that is payload, which is what
+  the MTU changes on air (3-byte ATT header + 4-byte L2CAP header per PDU, plus the stream header).
+*/
+#include <stdio.h>
+#include <vector>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_MAX_STREAMS
+  #error "Build with HMS_BLE_MAX_STREAMS set"
+#endif
+
+static const size_t BLOB   = 4096;
+static const int    ROUNDS = 2000;
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Transfer",
+        HMS_BLE_MakeCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", "Blob", HMS_BLE_PROPERTY_WRITE_NOTIFY)
+    )
+);
+
+// Central side of the segment format
+struct CentralReassembler {
+    std::vector<uint8_t> data;
+    size_t expected = 0;
+    size_t segments = 0;
+    bool complete = false;
+
+    void onSegment(const uint8_t* segment, size_t length) {
+        size_t header = (segment[0] & HMS_BLE_STREAM_FIRST) ? 5 : 1;
+        if(segment[0] & HMS_BLE_STREAM_FIRST) {
+            expected = segment[1] | (segment[2] << 8) | (segment[3] << 16) | ((size_t)segment[4] << 24);
+            data.clear();
+        }
+        data.insert(data.end(), segment + header, segment + length);
+        segments++;
+        complete = (segment[0] & HMS_BLE_STREAM_LAST) && data.size() == expected;
+    }
+};
+
+static size_t centralWriteStream(HMS_BLE_VirtualCentral& central, const uint8_t* blob, size_t length) {
+    uint8_t segment[HMS_BLE_ATT_MAX_VALUE_LENGTH];
+    size_t segmentSize = central.getMTU() - 3, offset = 0, count = 0;
+    while(offset < length) {
+        size_t header = 1;
+        segment[0] = count & HMS_BLE_STREAM_SEQUENCE_MASK;
+        if(count == 0) {
+            segment[0] |= HMS_BLE_STREAM_FIRST;
+            for(int i = 0; i < 4; i++) segment[1 + i] = (length >> (8 * i)) & 0xFF;
+            header = 5;
+        }
+        size_t payload = std::min(segmentSize - header, length - offset);
+        if(offset + payload == length) segment[0] |= HMS_BLE_STREAM_LAST;
+        memcpy(segment + header, blob + offset, payload);
+        central.write(schema.services[0].uuidStr, schema.characteristics[0].uuidStr, segment, header + payload);
+        offset += payload;
+        count++;
+    }
+    return count;
+}
+
+int main(void) {
+    HMS_BLE ble("BenchStream");
+    ble.begin<schema>(false);
+    HMS_BLE_CharHandle handle = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[0].uuid);
+
+    std::vector<uint8_t> blob(BLOB), received(BLOB);
+    for(size_t i = 0; i < BLOB; i++) blob[i] = (uint8_t)(i * 31 + 7);
+
+    printf("HMS_BLE streams, %zu-byte blob x %d rounds each way (HMS_BLE_PREFERRED_MTU=%d)\n", BLOB, ROUNDS, HMS_BLE_PREFERRED_MTU);
+    printf("%6s %10s %14s %14s %12s\n", "MTU", "segments", "notify MB/s", "write MB/s", "payload/PDU");
+
+    bool ok = true;
+    const uint16_t mtus[] = { 23, 64, 128, 185, 247 };
+    for(uint16_t requested : mtus) {
+        HMS_BLE_VirtualCentral central;
+        central.connect(&ble);
+        uint16_t mtu = central.exchangeMTU(requested);
+        central.subscribe(schema.services[0].uuidStr, schema.characteristics[0].uuidStr);
+
+        CentralReassembler reassembler;
+        reassembler.data.reserve(BLOB);
+        central.setNotificationCallback([&](const char*, const char*, const uint8_t* data, size_t length) {
+            reassembler.onSegment(data, length);
+        });
+
+        // Peripheral -> central
+        bool sent = false;
+        auto start = std::chrono::steady_clock::now();
+        for(int r = 0; r < ROUNDS; r++) {
+            reassembler.segments = 0;
+            sent = false;
+            ble.sendStream(handle, blob.data(), BLOB, [&](HMS_BLE_CharHandle, HMS_BLE_Status status, size_t) {
+                sent = (status == HMS_BLE_STATUS_SUCCESS);
+            });
+            while(ble.isStreaming(handle)) ble.loop();
+        }
+        double notifySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ok = ok && sent && reassembler.complete && memcmp(reassembler.data.data(), blob.data(), BLOB) == 0;
+
+        // Central -> peripheral
+        bool got = false;
+        size_t segments = 0;
+        start = std::chrono::steady_clock::now();
+        for(int r = 0; r < ROUNDS; r++) {
+            got = false;
+            ble.receiveStream(handle, received.data(), received.size(), [&](HMS_BLE_CharHandle, HMS_BLE_Status status, size_t length) {
+                got = (status == HMS_BLE_STATUS_SUCCESS && length == BLOB);
+            });
+            segments = centralWriteStream(central, blob.data(), BLOB);
+        }
+        double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ok = ok && got && memcmp(received.data(), blob.data(), BLOB) == 0 && segments == reassembler.segments;
+
+        double pduBytes = reassembler.segments * 7.0 + BLOB + reassembler.segments + 4;                      // ATT + L2CAP headers, stream headers, length field
+        printf("%6u %10zu %14.1f %14.1f %11.1f%%\n", mtu, reassembler.segments,
+            BLOB * ROUNDS / notifySeconds / 1e6, BLOB * ROUNDS / writeSeconds / 1e6, 100.0 * BLOB / pduBytes);
+        central.disconnect();
+    }
+
+    printf("%-28s %s\n", "reassembled blobs intact", ok ? "yes" : "NO");
+    return ok ? 0 : 1;
+}
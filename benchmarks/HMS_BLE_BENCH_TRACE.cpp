@@ -0,0 +1,126 @@
+/*
+  Trace benchmark (HMS_BLE_TRACE_DEPTH=1024):
+  - cost of one trace record, against formatting the line the same send logs with HMS_BLE_DEBUG (snprintf only, ChronoLog
+    adds its timestamp and the output on top),
+  - sendData() to one subscriber with the trace recording every send,
+  - 4 threads sending on their own characteristics while the main thread reads the ring: every record read must be intact
+    (each thread sends a length that identifies its characteristic) and sequence numbers must only go up.
+  With --dump <file> the final ring is written in dumpTrace() format for HMS_BLE_trace_decode.
+*/
+#include <stdio.h>
+#include <vector>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_TRACE_DEPTH
+  #error "Build with HMS_BLE_TRACE_DEPTH set"
+#endif
+
+static const size_t RECORDS = 2000000;
+static const size_t SENDS   = 1000000;
+static const int    THREADS = 4;
+static const size_t READS   = 2000;
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Telemetry",
+        HMS_BLE_MakeCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", "A", HMS_BLE_PROPERTY_READ_WRITE_NOTIFY),
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "B", HMS_BLE_PROPERTY_NOTIFY),
+        HMS_BLE_MakeCharacteristic("6E400004-B5A3-F393-E0A9-E50E24DCCA9E", "C", HMS_BLE_PROPERTY_NOTIFY),
+        HMS_BLE_MakeCharacteristic("6E400005-B5A3-F393-E0A9-E50E24DCCA9E", "D", HMS_BLE_PROPERTY_NOTIFY)
+    )
+);
+
+static double nsSince(std::chrono::steady_clock::time_point start, size_t ops) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ops;
+}
+
+int main(int argc, char** argv) {
+    const char* dumpPath = (argc == 3 && !strcmp(argv[1], "--dump")) ? argv[2] : nullptr;
+
+    HMS_BLE ble("BenchTrace");
+    ble.begin<schema>(false);
+    HMS_BLE_CharHandle handles[THREADS];
+    for(int i = 0; i < THREADS; i++) handles[i] = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[i].uuid);
+
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+    for(int i = 0; i < THREADS; i++) central.subscribe(schema.services[0].uuidStr, schema.characteristics[i].uuidStr);
+    uint8_t value[20];
+    memset(value, 0x42, sizeof(value));
+
+    // A trace record costs about what the library does per event: reading from a pre-subscribed characteristic records once
+    HMS_BLE_TraceRecord probe[1];
+    ble.clearTrace();
+    size_t length = sizeof(value);
+    auto start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < RECORDS / 4; n++) {
+        length = sizeof(value);
+        central.read(schema.services[0].uuidStr, schema.characteristics[0].uuidStr, value, &length);
+    }
+    double readNs = nsSince(start, RECORDS / 4);
+    bool readTraced = ble.readTrace(probe, 1) == 1 && probe[0].event == HMS_BLE_TRACE_READ;
+
+    char line[128];
+    volatile size_t sink = 0;
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < RECORDS; n++) {
+        sink = sink + snprintf(line, sizeof(line), "Notification sent on %s: %d bytes to %d client(s)",
+            schema.characteristics[0].uuidStr, (int)(n & 0xFF), 1);
+    }
+    double formatNs = nsSince(start, RECORDS);
+
+    start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < SENDS; n++) ble.sendData(handles[0], value, sizeof(value));
+    double sendNs = nsSince(start, SENDS);
+
+    // Concurrent writers against a reader
+    ble.clearTrace();
+    std::atomic<bool> go{false};
+    std::vector<std::thread> senders;
+    for(int t = 0; t < THREADS; t++) {
+        senders.emplace_back([&, t] {
+            while(!go) std::this_thread::yield();
+            for(size_t n = 0; n < SENDS / THREADS; n++) ble.sendData(handles[t], value, 4 + t);
+        });
+    }
+    go = true;
+    std::vector<HMS_BLE_TraceRecord> records(HMS_BLE_TRACE_DEPTH);
+    size_t torn = 0, disorder = 0, read = 0;
+    for(size_t r = 0; r < READS; r++) {
+        size_t count = ble.readTrace(records.data(), records.size());
+        for(size_t i = 0; i < count; i++) {
+            const HMS_BLE_TraceRecord& rec = records[i];
+            if(i > 0 && rec.sequence <= records[i - 1].sequence) disorder++;
+            if(rec.event != HMS_BLE_TRACE_NOTIFY) continue;
+            int t = rec.handle & 0xFF;
+            if(t >= THREADS || rec.length != 4 + t || rec.handle != handles[t].id || rec.status != HMS_BLE_STATUS_SUCCESS) torn++;
+        }
+        read += count;
+        std::this_thread::yield();
+    }
+    for(auto& sender : senders) sender.join();
+    size_t count = ble.readTrace(records.data(), records.size());
+
+    printf("HMS_BLE trace, ring of %d records of %zu bytes\n", HMS_BLE_TRACE_DEPTH, sizeof(HMS_BLE_TraceRecord));
+    printf("%-44s %10.1f\n", "central read, one READ record, ns", readNs);
+    printf("%-44s %10.1f\n", "snprintf of the debug log line, ns", formatNs);
+    printf("%-44s %10.1f\n", "sendData() to 1 subscriber, traced, ns", sendNs);
+    printf("%-44s %10zu\n", "records read under 4 concurrent senders", read);
+    printf("%-44s %10zu\n", "torn records", torn);
+    printf("%-44s %10zu\n", "out-of-order sequence numbers", disorder);
+    printf("%-44s %10zu\n", "records in the ring afterwards", count);
+
+    if(dumpPath) {
+        std::vector<uint8_t> dump(sizeof(HMS_BLE_TraceDumpHeader) + HMS_BLE_TRACE_DEPTH * sizeof(HMS_BLE_TraceRecord));
+        central.disconnect(0x08);                                                                           // Ends the dump with a supervision timeout
+        size_t bytes = ble.dumpTrace(dump.data(), dump.size());
+        FILE* out = fopen(dumpPath, "wb");
+        if(out) {
+            fwrite(dump.data(), 1, bytes, out);
+            fclose(out);
+        }
+    } else {
+        central.disconnect();
+    }
+    return (readTraced && torn == 0 && disorder == 0 && count == HMS_BLE_TRACE_DEPTH) ? 0 : 1;
+}
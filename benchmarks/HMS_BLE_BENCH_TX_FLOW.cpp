@@ -0,0 +1,126 @@
+/*
+  TX flow control benchmark (HMS_BLE_TX_CREDITS=3): a virtual central on a 7.5 ms connection interval that could carry 6
+  notifications per connection event, while the host may only have HMS_BLE_TX_CREDITS in the controller at once.
+  - fire-and-forget: the application sends back-to-back and ignores the result, like sendData() before flow control,
+  - blocking: setSendTimeout(100), sendData() waits for a credit instead of failing,
+  - chained: timeout 0, every onSent callback submits the next value (the pattern for ISR/workqueue senders).
+  Reports notifications per connection event, refused sends, and submit-to-onSent latency.
+*/
+#include <stdio.h>
+#include <mutex>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_TX_CREDITS
+  #error "Build with HMS_BLE_TX_CREDITS set"
+#endif
+
+static const size_t   NOTIFICATIONS = 600;
+static const size_t   VALUE         = 20;
+static const uint16_t INTERVAL      = 6;                                                                        // 7.5 ms
+static const uint8_t  LINK_PDUS     = 6;                                                                        // What the link could carry per event
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Telemetry",
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "Samples", HMS_BLE_PROPERTY_NOTIFY)
+    )
+);
+
+static uint32_t nowMicros() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Result {
+    size_t   accepted;
+    size_t   delivered;
+    uint32_t refused;
+    uint32_t events;
+    double   meanLatencyUs;
+    size_t   maxInFlight;
+};
+
+static void print(const char* name, const Result& r) {
+    printf("%-24s %9zu %9zu %9u %9u %11.2f %13.0f %10zu\n", name, r.accepted, r.delivered, r.refused, r.events,
+        r.events ? (double)r.delivered / r.events : 0.0, r.meanLatencyUs, r.maxInFlight);
+}
+
+static Result run(HMS_BLE& ble, int mode, uint8_t linkPdus) {
+    HMS_BLE_CharHandle handle = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[0].uuid);
+    HMS_BLE_VirtualCentral central;
+    central.setConnectionInterval(INTERVAL);
+    central.setMaxPdusPerEvent(linkPdus);
+    central.connect(&ble);
+    central.subscribe(schema.services[0].uuidStr, schema.characteristics[0].uuidStr);
+    ble.resetTxStats();
+
+    static uint32_t submittedAt[NOTIFICATIONS];
+    std::atomic<size_t> submitted{0}, completed{0};
+    std::atomic<uint64_t> totalLatency{0};
+    std::mutex sender;                                                                                          // Chained mode sends from the main and the link thread
+    uint8_t value[VALUE];
+    memset(value, 0xA5, sizeof(value));
+
+    std::function<bool()> trySend;
+    HMS_BLE_SendCallback done = [&](HMS_BLE_CharHandle, HMS_BLE_Status) {
+        totalLatency += nowMicros() - submittedAt[completed++];                                                 // Completions come back in submission order
+        if(mode == 2) {
+            std::lock_guard<std::mutex> lock(sender);
+            if(submitted < NOTIFICATIONS) trySend();
+        }
+    };
+    trySend = [&]() {
+        size_t seq = submitted;
+        submittedAt[seq] = nowMicros();
+        if(ble.sendData(handle, value, VALUE, done) != HMS_BLE_STATUS_SUCCESS) return false;
+        submitted++;
+        return true;
+    };
+
+    Result r = {0, 0, 0, 0, 0, 0};
+    uint32_t startEvents = central.getConnectionEvents();
+    ble.setSendTimeout(mode == 1 ? 100 : 0);
+    if(mode == 2) {
+        {
+            std::lock_guard<std::mutex> lock(sender);
+            while(trySend()) {}                                                                                 // Fill every credit, completions keep them busy
+        }
+        while(completed < NOTIFICATIONS) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } else {
+        for(size_t i = 0; i < NOTIFICATIONS; i++) trySend();
+    }
+    r.accepted = submitted;
+    while(ble.getTxStats().inFlight > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    HMS_BLE_TxStats stats = ble.getTxStats();
+    r.delivered = central.getNotificationCount();
+    r.refused = stats.busy;
+    r.events = central.getConnectionEvents() - startEvents;
+    r.meanLatencyUs = completed ? (double)totalLatency / completed : 0;
+    r.maxInFlight = stats.maxInFlight;
+    central.disconnect();
+    return r;
+}
+
+int main(void) {
+    HMS_BLE ble("BenchTxFlow");
+    ble.begin<schema>(false);
+
+    printf("HMS_BLE TX flow control, %zu notifications of %zu bytes, %.2f ms interval, HMS_BLE_TX_CREDITS=%d\n",
+        NOTIFICATIONS, VALUE, INTERVAL * 1.25, HMS_BLE_TX_CREDITS);
+    printf("%-24s %9s %9s %9s %9s %11s %13s %10s\n", "sender", "accepted", "delivered", "refused", "events", "notif/event", "onSent (us)", "in flight");
+
+    Result fire    = run(ble, 0, LINK_PDUS);
+    print("fire-and-forget", fire);
+    Result blocking = run(ble, 1, LINK_PDUS);
+    print("blocking (100 ms)", blocking);
+    Result chained = run(ble, 2, LINK_PDUS);
+    print("chained onSent", chained);
+    Result narrow  = run(ble, 1, 2);
+    print("blocking, 2 PDUs/event", narrow);
+
+    bool ok = fire.delivered == fire.accepted && fire.refused > 0 &&
+              blocking.delivered == NOTIFICATIONS && blocking.refused > 0 && chained.delivered == NOTIFICATIONS &&
+              narrow.delivered == NOTIFICATIONS && blocking.maxInFlight <= HMS_BLE_TX_CREDITS;
+    return ok ? 0 : 1;
+}
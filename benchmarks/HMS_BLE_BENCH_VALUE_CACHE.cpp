@@ -0,0 +1,116 @@
+/*
+  Value cache benchmark (HMS_BLE_VALUE_CACHE=1):
+  - reads answered from the cache vs through the read callback (HMS_BLE_READ_REFRESH, the previous behaviour),
+  - a sensor stream that repeats its value 9 times out of 10, sent with and without setNotifyOnChange(),
+  - a thread flipping the value between two patterns while a central reads, to check no read mixes both.
+*/
+#include <stdio.h>
+
+#include "HMS_BLE.h"
+
+#if !HMS_BLE_VALUE_CACHE
+  #error "Build with HMS_BLE_VALUE_CACHE=1"
+#endif
+
+static const size_t READS   = 1000000;
+static const size_t SAMPLES = 1000000;
+static const size_t REPEAT  = 10;                                                                               // Sensor value changes every REPEAT samples
+static const size_t VALUE   = 16;
+
+static constexpr auto schema = HMS_BLE_MakeSchema(
+    HMS_BLE_MakeService("6E400001-B5A3-F393-E0A9-E50E24DCCA9E", "Sensor",
+        HMS_BLE_MakeCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", "Status",      HMS_BLE_PROPERTY_READ),
+        HMS_BLE_MakeCharacteristic("6E400003-B5A3-F393-E0A9-E50E24DCCA9E", "Temperature", HMS_BLE_PROPERTY_READ_NOTIFY)
+    )
+);
+
+int main(void) {
+    HMS_BLE ble("BenchCache");
+    ble.begin<schema>(false);
+    HMS_BLE_VirtualCentral central;
+    central.connect(&ble);
+
+    const char* svc = schema.services[0].uuidStr;
+    const char* status = schema.characteristics[0].uuidStr;
+    const char* temperature = schema.characteristics[1].uuidStr;
+    HMS_BLE_CharHandle statusHandle = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[0].uuid);
+    HMS_BLE_CharHandle tempHandle   = ble.getCharacteristicHandle(schema.services[0].uuid, schema.characteristics[1].uuid);
+
+    uint8_t value[VALUE];
+    memset(value, 0x5A, sizeof(value));
+    size_t appCalls = 0;
+    ble.setReadCallback([&](const char*, const char*, uint8_t* data, size_t* length, const uint8_t*) {
+        appCalls++;
+        memcpy(data, value, VALUE);
+        *length = VALUE;
+    });
+    ble.setValue(statusHandle, value, VALUE);
+
+    // Reads
+    auto timeReads = [&](HMS_BLE_ReadPolicy policy, size_t* calls) {
+        ble.setReadPolicy(statusHandle, policy);
+        appCalls = 0;
+        uint8_t buffer[64];
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < READS; i++) {
+            size_t length = sizeof(buffer);
+            central.read(svc, status, buffer, &length);
+        }
+        *calls = appCalls;
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / READS;
+    };
+    size_t refreshCalls, cachedCalls;
+    double refreshNs = timeReads(HMS_BLE_READ_REFRESH, &refreshCalls);
+    double cachedNs  = timeReads(HMS_BLE_READ_CACHED, &cachedCalls);
+
+    // Notify-on-change
+    central.subscribe(svc, temperature);
+    auto stream = [&](bool onChange) {
+        ble.setNotifyOnChange(tempHandle, onChange);
+        size_t before = central.getNotificationCount();
+        for(size_t i = 0; i < SAMPLES; i++) {
+            int16_t reading = (int16_t)(i / REPEAT);
+            ble.sendData(tempHandle, (const uint8_t*)&reading, sizeof(reading));
+        }
+        return central.getNotificationCount() - before;
+    };
+    size_t notifiedAll     = stream(false);
+    size_t notifiedChanged = stream(true);
+
+    // Consistency under a concurrent writer
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        uint8_t a[VALUE], b[VALUE];
+        memset(a, 0x11, sizeof(a));
+        memset(b, 0x22, sizeof(b));
+        for(size_t i = 0; !done; i++) {
+            ble.setValue(statusHandle, (i & 1) ? a : b, VALUE);
+            if(i % 8 == 0) std::this_thread::yield();
+        }
+    });
+    size_t torn = 0;
+    for(size_t i = 0; i < READS / 10; i++) {
+        uint8_t buffer[VALUE];
+        size_t length = sizeof(buffer);
+        central.read(svc, status, buffer, &length);
+        for(size_t k = 1; k < length; k++) {
+            if(buffer[k] != buffer[0]) { torn++; break; }
+        }
+        if(i % 8 == 0) std::this_thread::yield();
+    }
+    done = true;
+    writer.join();
+
+    HMS_BLE_ValueCacheStats stats = ble.getValueCacheStats();
+    printf("HMS_BLE value cache, %zu reads of a %zu-byte value, %zu samples changing every %zu\n", READS, VALUE, SAMPLES, REPEAT);
+    printf("%-34s %10s %14s\n", "read path", "ns/read", "app callbacks");
+    printf("%-34s %10.1f %14zu\n", "read callback (READ_REFRESH)", refreshNs, refreshCalls);
+    printf("%-34s %10.1f %14zu\n", "cache (READ_CACHED)", cachedNs, cachedCalls);
+    printf("%-34s %10zu\n", "notifications, every sample", notifiedAll);
+    printf("%-34s %10zu\n", "notifications, notify-on-change", notifiedChanged);
+    printf("%-34s %10u\n", "sends skipped as unchanged", stats.unchangedSkipped);
+    printf("%-34s %10zu\n", "torn reads under a writer", torn);
+
+    central.disconnect();
+    return (cachedCalls == 0 && torn == 0 && notifiedChanged == SAMPLES / REPEAT) ? 0 : 1;
+}
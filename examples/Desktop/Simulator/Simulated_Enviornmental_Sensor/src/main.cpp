@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "HMS_BLE.h"
+
+#define SERVICE_UUID            "181A"                              // Environment Sensing Service (standard)
+#define CHAR_UUID_HUMIDITY      "2A6F"                              // Humidity (%RH)
+#define CHAR_UUID_TEMPERATURE   "2A6E"                              // Temperature (°C)
+#define CHAR_UUID_COMMAND       "2A9F"                              // User Control Point (used here as a command sink)
+
+int16_t     temperature         = 250;                              // 25.0°C (in 0.01°C units for BLE standard)
+uint16_t    humidity            = 650;                              // 65.0% (in 0.01% units for BLE standard)
+
+
+HMS_BLE      *ble = nullptr;
+
+int32_t random_range(int32_t min, int32_t max) {                    // Helper for random range [min, max]
+    return min + (rand() % (max - min + 1));
+}
+
+HMS_BLE_ConnectionCallback onConnect = [](bool connected, const uint8_t* deviceMac) {
+    printf("[peripheral] Device %02X:%02X:%02X:%02X:%02X:%02X %s\n",
+        deviceMac[5], deviceMac[4], deviceMac[3],
+        deviceMac[2], deviceMac[1], deviceMac[0],
+        connected ? "connected" : "disconnected"
+    );
+};
+
+HMS_BLE_NotifyCallback onNotify = [](const char *svcUUID, const char *charUUID, bool enabled, const uint8_t*) {
+    printf("[peripheral] Notification %s on %s/%s\n", enabled ? "enabled" : "disabled", svcUUID, charUUID);
+};
+
+HMS_BLE_ReadCallback onRead = [](const char *, const char *charUUID, uint8_t *data, size_t *length, const uint8_t *) {
+    if(strcmp(charUUID, CHAR_UUID_TEMPERATURE) == 0) {
+        memcpy(data, &temperature, sizeof(temperature));
+        *length = sizeof(temperature);
+    } else if(strcmp(charUUID, CHAR_UUID_HUMIDITY) == 0) {
+        memcpy(data, &humidity, sizeof(humidity));
+        *length = sizeof(humidity);
+    }
+};
+
+HMS_BLE_WriteCallback onWrite = [](const char *svcUUID, const char *charUUID, const uint8_t *, size_t length, const uint8_t *) {
+    printf("[peripheral] Write on %s/%s: %zu bytes\n", svcUUID, charUUID, length);
+};
+
+void setup() {
+    ble = new HMS_BLE("SimulatedSensor");
+
+    HMS_BLE_Service envService = {
+        .uuid               = SERVICE_UUID,
+        .name               = "Environmental Sensing"
+    };
+
+    HMS_BLE_Characteristic tempChar = {
+        .uuid               = CHAR_UUID_TEMPERATURE,
+        .name               = "TempSensor",
+        .properties         = HMS_BLE_PROPERTY_READ_NOTIFY
+    };
+
+    HMS_BLE_Characteristic humidityChar = {
+        .uuid               = CHAR_UUID_HUMIDITY,
+        .name               = "HumiditySensor",
+        .properties         = HMS_BLE_PROPERTY_READ_NOTIFY
+    };
+
+    HMS_BLE_Characteristic commandChar = {
+        .uuid               = CHAR_UUID_COMMAND,
+        .name               = "Command",
+        .properties         = HMS_BLE_PROPERTY_WRITE
+    };
+
+    ble->setReadCallback(onRead);
+    ble->setWriteCallback(onWrite);
+    ble->setNotifyCallback(onNotify);
+    ble->setConnectionCallback(onConnect);
+
+    ble->addService(&envService);
+    ble->addCharacteristicToService(SERVICE_UUID, &tempChar);
+    ble->addCharacteristicToService(SERVICE_UUID, &humidityChar);
+    ble->addCharacteristicToService(SERVICE_UUID, &commandChar);
+
+    ble->begin(false);
+}
+
+int main(void) {
+    setup();
+
+    HMS_BLE_VirtualCentral phone;
+    phone.setNotificationCallback([](const char* svcUUID, const char* charUUID, const uint8_t*, size_t length) {
+        printf("[central] Notification on %s/%s: %zu bytes\n", svcUUID, charUUID, length);
+    });
+
+    if(phone.connect(ble) != HMS_BLE_STATUS_SUCCESS) {
+        printf("Connection failed\n");
+        return 1;
+    }
+    phone.subscribe(SERVICE_UUID, CHAR_UUID_TEMPERATURE);
+    phone.subscribe(SERVICE_UUID, CHAR_UUID_HUMIDITY);
+
+    uint8_t value[HMS_BLE_MAX_DATA_LENGTH];
+    size_t length = sizeof(value);
+    if(phone.read(SERVICE_UUID, CHAR_UUID_TEMPERATURE, value, &length) == HMS_BLE_STATUS_SUCCESS && length == sizeof(int16_t)) {
+        int16_t t;
+        memcpy(&t, value, sizeof(t));
+        printf("[central] Read temperature: %.2f C\n", t / 100.0);
+    }
+
+    const uint8_t command[] = {0x01};
+    phone.write(SERVICE_UUID, CHAR_UUID_COMMAND, command, sizeof(command));
+
+    for(int i = 0; i < 5; i++) {
+        temperature += random_range(-50, 50);
+        humidity += random_range(-30, 30);
+        ble->sendData(CHAR_UUID_TEMPERATURE, (uint8_t*)&temperature, sizeof(temperature));
+        ble->sendData(CHAR_UUID_HUMIDITY, (uint8_t*)&humidity, sizeof(humidity));
+    }
+
+    printf("[central] %zu notifications received\n", phone.getNotificationCount());
+    phone.disconnect();
+
+    delete ble;
+    return 0;
+}
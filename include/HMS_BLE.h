@@ -34,6 +34,7 @@
 #if defined(ARDUINO)
   #include <Arduino.h>
   #if defined(ESP32)
+    #include <atomic>
     #include <NimBLEDevice.h>
     #include <freertos/task.h>
     #include <freertos/FreeRTOS.h>
@@ -48,9 +49,11 @@
   #define HMS_BLE_PLATFORM_ESP_IDF
 #elif defined(__ZEPHYR__)
   #include <array>
+  #include <atomic>
   #include <string>
   #include <stdio.h>
   #include <stdlib.h>
+  #include <cstring>
   #include <functional>
   #include <zephyr/kernel.h>
   #include <zephyr/bluetooth/bluetooth.h>
@@ -65,10 +68,26 @@
   // STM32 HAL specific includes
   #define HMS_BLE_PLATFORM_STM32_HAL
 #elif defined(__linux__) || defined(_WIN32) || defined(__APPLE__)
-  // Desktop specific includes
+  #include <array>
+  #include <mutex>
+  #include <atomic>
+  #include <algorithm>
+  #include <chrono>
+  #include <condition_variable>
+  #include <string>
+  #include <thread>
+  #include <cstring>
+  #include <functional>
+  #if !defined(HMS_BLE_DESKTOP_BLUEZ)
+    #define HMS_BLE_DESKTOP_SIM                                                                                                             // In-process simulated controller (default desktop backend)
+  #endif
   #define HMS_BLE_PLATFORM_DESKTOP
 #else
+  #include <array>
+  #include <atomic>
   #include <string>
+  #include <cstring>
+  #include <functional>
   
   #define HMS_BLE_PLATFORM_UNKNOWN
   #define HMS_BLE_CONTROLLER_TEMPLATE
@@ -82,10 +101,43 @@
   #define HMS_BLE_DEBUG_ENABLED                     HMS_BLE_DEBUG
 #endif
 
+#define HMS_BLE_LOG_debug                           0                                                                                               // BLE_LOGGER levels, for HMS_BLE_LOG_MIN_LEVEL
+#define HMS_BLE_LOG_info                            1
+#define HMS_BLE_LOG_warn                            2
+#define HMS_BLE_LOG_error                           3
+
+#ifndef HMS_BLE_LOG_MIN_LEVEL
+  #define HMS_BLE_LOG_MIN_LEVEL                     HMS_BLE_LOG_debug                                                                               // BLE_LOGGER calls below this level compile to nothing
+#endif
+
+#ifndef HMS_BLE_LOG_DEFERRED
+  #define HMS_BLE_LOG_DEFERRED                      0                                                                                               // Set to 1 to record BLE_LOGGER calls as format id + raw arguments, formatted later
+#endif
+
+#ifndef HMS_BLE_LOG_DEPTH
+  #define HMS_BLE_LOG_DEPTH                         32                                                                                              // Deferred log records kept until formatted or dumped (power of two)
+#endif
+
+#ifndef HMS_BLE_LOG_PAYLOAD
+  #define HMS_BLE_LOG_PAYLOAD                       48                                                                                              // Argument bytes per deferred record (multiple of 4), longer strings are cut
+#endif
+
+#ifndef HMS_BLE_LOG_FLUSH_MS
+  #define HMS_BLE_LOG_FLUSH_MS                      50                                                                                              // Background task formats pending deferred records at least this often
+#endif
+
+#if HMS_BLE_LOG_DEFERRED && ((HMS_BLE_LOG_DEPTH & (HMS_BLE_LOG_DEPTH - 1)) || (HMS_BLE_LOG_PAYLOAD % 4) || HMS_BLE_LOG_PAYLOAD > 252)
+  #error "HMS_BLE_LOG_DEPTH must be a power of two and HMS_BLE_LOG_PAYLOAD a multiple of 4 up to 252"
+#endif
+
 #ifndef HMS_BLE_MAX_DATA_LENGTH
   #define HMS_BLE_MAX_DATA_LENGTH                   32                                                                                              // Maximum data length for BLE characteristics
 #endif
 
+#ifndef HMS_BLE_ATT_MAX_VALUE_LENGTH
+  #define HMS_BLE_ATT_MAX_VALUE_LENGTH              512                                                                                             // Largest attribute value a zero-copy read may produce (Core spec limit)
+#endif
+
 #ifndef HMS_BLE_MAX_SERVICES
   #define HMS_BLE_MAX_SERVICES                      4                                                                                               // Maximum number of services supported
 #endif
@@ -98,10 +150,175 @@
     #define HMS_BLE_MAX_CHARACTERISTICS             (HMS_BLE_MAX_SERVICES * HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE)                                // Total maximum characteristics (derived)
   #endif
 
+#ifndef HMS_BLE_MAX_NAME_LENGTH
+  #define HMS_BLE_MAX_NAME_LENGTH                   32                                                                                              // Maximum service/characteristic name length (incl. terminator, longer names are truncated)
+#endif
+
 #ifndef HMS_BLE_MAX_CLIENTS
   #define HMS_BLE_MAX_CLIENTS                       4                                                                                               // Maximum number of simultaneous BLE clients (increase for multi-client support)
 #endif
 
+#ifndef HMS_BLE_RUNTIME_REGISTRATION
+  #define HMS_BLE_RUNTIME_REGISTRATION              1                                                                                               // Set to 0 when only begin<Schema>() is used (drops the addService()/addCharacteristic() pools)
+#endif
+
+#ifndef HMS_BLE_LEGACY_API
+  #define HMS_BLE_LEGACY_API                        1                                                                                               // Set to 0 to drop the single-service API (begin(uuid), addCharacteristic(), sendData(uuid), getReceivedData()) and its buffers
+#endif
+
+#ifndef HMS_BLE_STATIC_ALLOCATION
+  #define HMS_BLE_STATIC_ALLOCATION                 0                                                                                               // Set to 1 to take every library object from fixed pools and static storage (no heap after startup, flat across begin()/stop())
+#endif
+
+#ifndef HMS_BLE_NOTIFY_QUEUE
+  #define HMS_BLE_NOTIFY_QUEUE                      0                                                                                               // Set to 1 to route notifications through the coalescing queue (drained by loop())
+#endif
+
+#ifndef HMS_BLE_RX_RING_DEPTH
+  #define HMS_BLE_RX_RING_DEPTH                     0                                                                                               // Slots per characteristic receive ring (power of two >= 4), 0 disables the rings; writes longer than HMS_BLE_MAX_DATA_LENGTH are cut to it and counted
+#endif
+
+#ifndef HMS_BLE_INGEST_BYTES
+  #define HMS_BLE_INGEST_BYTES                      0                                                                                               // Ring for writes to WRITE_NR characteristics (power of two, >= 2 * (HMS_BLE_ATT_MAX_VALUE_LENGTH + 8)), 0 = normal write path
+#endif
+
+#ifndef HMS_BLE_VALUE_CACHE
+  #define HMS_BLE_VALUE_CACHE                       0                                                                                               // Set to 1 to serve reads from a per-characteristic value cache instead of the read callback
+#endif
+
+#ifndef HMS_BLE_MAX_STREAMS
+  #define HMS_BLE_MAX_STREAMS                       0                                                                                               // Characteristics that can carry sendStream()/receiveStream() blobs, 0 disables streaming
+#endif
+
+#ifndef HMS_BLE_PREFERRED_MTU
+  #define HMS_BLE_PREFERRED_MTU                     247                                                                                             // ATT MTU offered in the MTU exchange (Zephyr: CONFIG_BT_L2CAP_TX_MTU instead)
+#endif
+
+#ifndef HMS_BLE_NOTIFY_RETRY_MS
+  #define HMS_BLE_NOTIFY_RETRY_MS                   5                                                                                               // Background task re-check interval while queued notifications wait for TX buffers
+#endif
+
+#ifndef HMS_BLE_TX_CREDITS
+  #if defined(HMS_BLE_ZEPHYR_nRF) && defined(CONFIG_BT_BUF_ACL_TX_COUNT)
+    #define HMS_BLE_TX_CREDITS                      CONFIG_BT_BUF_ACL_TX_COUNT                                                                      // Notifications in flight, one per ACL TX buffer
+  #elif defined(HMS_BLE_ZEPHYR_nRF)
+    #define HMS_BLE_TX_CREDITS                      3                                                                                               // Zephyr's default ACL TX buffer count
+  #else
+    #define HMS_BLE_TX_CREDITS                      0                                                                                               // 0: the backend paces sends itself (NimBLE) / synchronous desktop controller
+  #endif
+#endif
+
+#if defined(HMS_BLE_ZEPHYR_nRF) && !HMS_BLE_TX_CREDITS
+  #error "HMS_BLE_TX_CREDITS must be > 0 on nRF, notifications complete asynchronously"
+#endif
+
+#if defined(HMS_BLE_ARDUINO_ESP32) && HMS_BLE_TX_CREDITS
+  #error "HMS_BLE_TX_CREDITS is not supported on ESP32, NimBLE paces notify() itself"
+#endif
+
+#if HMS_BLE_TX_CREDITS > 255
+  #error "HMS_BLE_TX_CREDITS must be <= 255"
+#endif
+
+#ifndef HMS_BLE_INDICATE_DEPTH
+  #define HMS_BLE_INDICATE_DEPTH                    0                                                                                               // Indications queued per connection until confirmed (<= 255), 0 disables the indication pipeline
+#endif
+
+#ifndef HMS_BLE_INDICATE_BEARERS
+  #if defined(HMS_BLE_ZEPHYR_nRF) && defined(CONFIG_BT_EATT_MAX)
+    #define HMS_BLE_INDICATE_BEARERS                (CONFIG_BT_EATT_MAX + 1)                                                                        // Unenhanced ATT bearer + EATT channels, one outstanding indication each
+  #else
+    #define HMS_BLE_INDICATE_BEARERS                1                                                                                               // ATT allows one outstanding indication per bearer
+  #endif
+#endif
+
+#ifndef HMS_BLE_INDICATE_TIMEOUT_MS
+  #define HMS_BLE_INDICATE_TIMEOUT_MS               30000                                                                                           // Default confirmation deadline (the ATT transaction timeout), see setIndicationTimeout()
+#endif
+
+#if HMS_BLE_INDICATE_DEPTH > 255
+  #error "HMS_BLE_INDICATE_DEPTH must be <= 255"
+#endif
+
+#if HMS_BLE_INDICATE_DEPTH && HMS_BLE_INDICATE_BEARERS < 1
+  #error "HMS_BLE_INDICATE_BEARERS must be >= 1"
+#endif
+
+#ifndef HMS_BLE_LINK_PROFILES
+  #define HMS_BLE_LINK_PROFILES                     0                                                                                               // Set to 1 for link profiles (connection parameters, PHY, data length), the link callback and send passes sized to the link
+#endif
+
+#ifndef HMS_BLE_LINK_EVENT_US
+  #if defined(HMS_BLE_ZEPHYR_nRF) && defined(CONFIG_BT_CTLR_SDC_MAX_CONN_EVENT_LEN_DEFAULT)
+    #define HMS_BLE_LINK_EVENT_US                   CONFIG_BT_CTLR_SDC_MAX_CONN_EVENT_LEN_DEFAULT                                                   // Air time the SoftDevice Controller gives one connection event
+  #else
+    #define HMS_BLE_LINK_EVENT_US                   0                                                                                               // Air time of one connection event in us, 0 = the whole connection interval
+  #endif
+#endif
+
+#ifndef HMS_BLE_BROADCAST_SETS
+  #define HMS_BLE_BROADCAST_SETS                    0                                                                                               // Non-connectable advertising sets the broadcaster runs next to the connectable advertiser, 0 disables broadcasting
+#endif
+
+#ifndef HMS_BLE_BROADCAST_FRAMES
+  #define HMS_BLE_BROADCAST_FRAMES                  4                                                                                               // Frames each broadcast set rotates through (<= 255)
+#endif
+
+#ifndef HMS_BLE_BROADCAST_DATA_LENGTH
+  #if defined(HMS_BLE_ZEPHYR_nRF) && defined(CONFIG_BT_CTLR_ADV_DATA_LEN_MAX) && CONFIG_BT_CTLR_ADV_DATA_LEN_MAX < 255
+    #define HMS_BLE_BROADCAST_DATA_LENGTH           CONFIG_BT_CTLR_ADV_DATA_LEN_MAX                                                                 // Advertising data the controller takes per set
+  #else
+    #define HMS_BLE_BROADCAST_DATA_LENGTH           255                                                                                             // Extended/periodic advertising data per frame: one manufacturer data AD structure at most
+  #endif
+#endif
+
+#if HMS_BLE_BROADCAST_SETS > 16
+  #error "HMS_BLE_BROADCAST_SETS must be <= 16"
+#endif
+
+#if HMS_BLE_BROADCAST_SETS && (HMS_BLE_BROADCAST_FRAMES < 1 || HMS_BLE_BROADCAST_FRAMES > 255)
+  #error "HMS_BLE_BROADCAST_FRAMES must be between 1 and 255"
+#endif
+
+#if HMS_BLE_BROADCAST_SETS && (HMS_BLE_BROADCAST_DATA_LENGTH < 31 || HMS_BLE_BROADCAST_DATA_LENGTH > 255)
+  #error "HMS_BLE_BROADCAST_DATA_LENGTH must be between 31 and 255"
+#endif
+
+#if defined(HMS_BLE_ZEPHYR_nRF) && HMS_BLE_BROADCAST_SETS && !defined(CONFIG_BT_EXT_ADV)
+  #error "HMS_BLE_BROADCAST_SETS needs CONFIG_BT_EXT_ADV (and CONFIG_BT_EXT_ADV_MAX_ADV_SET >= HMS_BLE_BROADCAST_SETS + 1)"
+#endif
+
+#if defined(HMS_BLE_ARDUINO_ESP32) && HMS_BLE_BROADCAST_SETS
+  #error "HMS_BLE_BROADCAST_SETS is not supported on ESP32, NimBLE's legacy advertiser has a single instance"
+#endif
+
+#ifndef HMS_BLE_TRACE_DEPTH
+  #define HMS_BLE_TRACE_DEPTH                 0                                                                                                     // Binary trace ring entries (power of two >= 16), 0 compiles tracing out
+#endif
+
+#if HMS_BLE_TRACE_DEPTH && ((HMS_BLE_TRACE_DEPTH < 16) || (HMS_BLE_TRACE_DEPTH & (HMS_BLE_TRACE_DEPTH - 1)))
+  #error "HMS_BLE_TRACE_DEPTH must be 0 or a power of two >= 16"
+#endif
+
+#if HMS_BLE_STATIC_ALLOCATION && HMS_BLE_LEGACY_API && HMS_BLE_RUNTIME_REGISTRATION
+  #error "HMS_BLE_STATIC_ALLOCATION needs HMS_BLE_LEGACY_API 0 or HMS_BLE_RUNTIME_REGISTRATION 0 (the legacy characteristic list keeps std::string copies on the heap)"
+#endif
+
+#if HMS_BLE_MAX_CLIENTS < 1 || HMS_BLE_MAX_CLIENTS > 254
+  #error "HMS_BLE_MAX_CLIENTS must be between 1 and 254"
+#endif
+
+#define HMS_BLE_CLIENT_WORDS                        ((HMS_BLE_MAX_CLIENTS + 31) / 32)                                                               // 32-bit words in a bitset over connection slots
+#define HMS_BLE_SUBSCRIPTION_WORDS                  ((HMS_BLE_MAX_SERVICES * HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE + 31) / 32)                    // 32-bit words in a bitset over characteristics
+
+#if HMS_BLE_RX_RING_DEPTH && ((HMS_BLE_RX_RING_DEPTH < 4) || (HMS_BLE_RX_RING_DEPTH & (HMS_BLE_RX_RING_DEPTH - 1)))
+  #error "HMS_BLE_RX_RING_DEPTH must be 0 or a power of two >= 4"
+#endif
+
+#if HMS_BLE_INGEST_BYTES && ((HMS_BLE_INGEST_BYTES & (HMS_BLE_INGEST_BYTES - 1)) || HMS_BLE_INGEST_BYTES < 2 * (HMS_BLE_ATT_MAX_VALUE_LENGTH + 8))
+  #error "HMS_BLE_INGEST_BYTES must be 0 or a power of two that holds two records of HMS_BLE_ATT_MAX_VALUE_LENGTH"
+#endif
+
 #ifndef HMS_BLE_BACKGROUND_PROCESS_PRIORITY
   #define HMS_BLE_BACKGROUND_PROCESS_PRIORITY       5                                                                                               // Background process task priority
 #endif
@@ -116,19 +333,32 @@
     #ifndef HMS_BLE_LOG_LEVEL
       #define HMS_BLE_LOG_LEVEL CHRONOLOG_LEVEL_DEBUG
     #endif
-    extern ChronoLogger *bleLogger;
+    #if !HMS_BLE_LOG_DEFERRED
+      extern ChronoLogger *bleLogger;                                                                                                      // Defined by HMS_BLE.cpp, the deferred log replaces it
+    #endif
   #else
     #error "HMS_BLE_DEBUG is enabled but ChronoLog.h is missing. Please include the https://github.com/Hamas888/ChronoLog in your project."
   #endif
 #endif
 
-#if HMS_BLE_DEBUG_ENABLED
+#if HMS_BLE_LOG_DEFERRED
+  // The call site keeps a constant record (format id, level, format) and hands over only the raw arguments, see HMS_BLE_LogWrite()
+  #define BLE_LOGGER(level, msg, ...)                                                                                                           \
+    do {                                                                                                                                        \
+      if constexpr (HMS_BLE_LOG_##level >= HMS_BLE_LOG_MIN_LEVEL) {                                                                             \
+        static constexpr HMS_BLE_LogSite hmsBleLogSite = { HMS_BLE_LogFormatId(msg), HMS_BLE_LOG_##level, msg };                                \
+        HMS_BLE_LogWrite(&hmsBleLogSite, ##__VA_ARGS__);                                                                                        \
+      }                                                                                                                                         \
+    } while (0)
+#elif HMS_BLE_DEBUG_ENABLED
   #define BLE_LOGGER(level, msg, ...)   \
     do {                                \
-      if (bleLogger)                    \
-        bleLogger->level(               \
-          msg, ##__VA_ARGS__            \
-        );                              \
+      if constexpr (HMS_BLE_LOG_##level >= HMS_BLE_LOG_MIN_LEVEL) { \
+        if (bleLogger)                  \
+          bleLogger->level(             \
+            msg, ##__VA_ARGS__          \
+          );                            \
+      }                                 \
     } while (0);  
 #else
     #define BLE_LOGGER(level, msg, ...)    do {} while (0)
@@ -144,31 +374,53 @@ typedef enum {
   HMS_BLE_STATUS_ERROR_MAX_CHARS      = -5,
   HMS_BLE_STATUS_ERROR_INVALID_CHAR   = -6,
   HMS_BLE_STATUS_ERROR_NOT_CONNECTED  = -7,
+  HMS_BLE_STATUS_ERROR_BUSY           = -8,
+  HMS_BLE_STATUS_ERROR_OVERFLOW       = -9,
+  HMS_BLE_STATUS_ERROR_PROTOCOL       = -10,
+  HMS_BLE_STATUS_ERROR_TIMEOUT        = -11,
 } HMS_BLE_Status;
+#define HMS_BLE_STATUS_COUNT 12                                                                                                             // SUCCESS down to ERROR_TIMEOUT, sizes arrays indexed by -status
 
 typedef enum {
   #if defined(HMS_BLE_ZEPHYR_nRF)
     HMS_BLE_PROPERTY_READ                 = BT_GATT_CHRC_READ,
     HMS_BLE_PROPERTY_WRITE                = BT_GATT_CHRC_WRITE,
+    HMS_BLE_PROPERTY_WRITE_NR             = BT_GATT_CHRC_WRITE_WITHOUT_RESP,
     HMS_BLE_PROPERTY_NOTIFY               = BT_GATT_CHRC_NOTIFY,
     HMS_BLE_PROPERTY_INDICATE             = BT_GATT_CHRC_INDICATE,
     HMS_BLE_PROPERTY_BROADCAST            = BT_GATT_CHRC_BROADCAST,
     HMS_BLE_PROPERTY_READ_WRITE           = BT_GATT_CHRC_READ  | BT_GATT_CHRC_WRITE,
     HMS_BLE_PROPERTY_READ_NOTIFY          = BT_GATT_CHRC_READ  | BT_GATT_CHRC_NOTIFY,
     HMS_BLE_PROPERTY_WRITE_NOTIFY         = BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+    HMS_BLE_PROPERTY_WRITE_NR_NOTIFY      = BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_NOTIFY,
     HMS_BLE_PROPERTY_READ_WRITE_NOTIFY    = BT_GATT_CHRC_READ  | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
     HMS_BLE_PROPERTY_READ_WRITE_INDICATE  = BT_GATT_CHRC_READ  | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_INDICATE,
   #elif defined(HMS_BLE_ARDUINO_ESP32)
     HMS_BLE_PROPERTY_READ                 = NIMBLE_PROPERTY::READ,
     HMS_BLE_PROPERTY_WRITE                = NIMBLE_PROPERTY::WRITE,
+    HMS_BLE_PROPERTY_WRITE_NR             = NIMBLE_PROPERTY::WRITE_NR,
     HMS_BLE_PROPERTY_NOTIFY               = NIMBLE_PROPERTY::NOTIFY,
     HMS_BLE_PROPERTY_INDICATE             = NIMBLE_PROPERTY::INDICATE,
     HMS_BLE_PROPERTY_BROADCAST            = NIMBLE_PROPERTY::BROADCAST,
     HMS_BLE_PROPERTY_READ_WRITE           = NIMBLE_PROPERTY::READ  | NIMBLE_PROPERTY::WRITE,
     HMS_BLE_PROPERTY_READ_NOTIFY          = NIMBLE_PROPERTY::READ  | NIMBLE_PROPERTY::NOTIFY,
     HMS_BLE_PROPERTY_WRITE_NOTIFY         = NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY,
+    HMS_BLE_PROPERTY_WRITE_NR_NOTIFY      = NIMBLE_PROPERTY::WRITE_NR | NIMBLE_PROPERTY::NOTIFY,
     HMS_BLE_PROPERTY_READ_WRITE_NOTIFY    = NIMBLE_PROPERTY::READ  | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY,
     HMS_BLE_PROPERTY_READ_WRITE_INDICATE  = NIMBLE_PROPERTY::READ  | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::INDICATE,
+  #else                                                                                                                                     // Bluetooth Core Spec Vol 3, Part G, 3.3.1.1
+    HMS_BLE_PROPERTY_READ                 = 0x02,
+    HMS_BLE_PROPERTY_WRITE                = 0x08,
+    HMS_BLE_PROPERTY_WRITE_NR             = 0x04,                                                                                           // Write Without Response (ATT Write Command)
+    HMS_BLE_PROPERTY_NOTIFY               = 0x10,
+    HMS_BLE_PROPERTY_INDICATE             = 0x20,
+    HMS_BLE_PROPERTY_BROADCAST            = 0x01,
+    HMS_BLE_PROPERTY_READ_WRITE           = 0x02 | 0x08,
+    HMS_BLE_PROPERTY_READ_NOTIFY          = 0x02 | 0x10,
+    HMS_BLE_PROPERTY_WRITE_NOTIFY         = 0x08 | 0x10,
+    HMS_BLE_PROPERTY_WRITE_NR_NOTIFY      = 0x04 | 0x10,
+    HMS_BLE_PROPERTY_READ_WRITE_NOTIFY    = 0x02 | 0x08 | 0x10,
+    HMS_BLE_PROPERTY_READ_WRITE_INDICATE  = 0x02 | 0x08 | 0x20,
   #endif
 } HMS_BLE_CharacteristicProperty;                                                                                                           // Characteristic properties enum
 
@@ -183,30 +435,716 @@ typedef struct {
   std::string name;                                                                                                                         // Human-readable service name
 } HMS_BLE_Service;                                                                                                                          // Service definition structure
 
+typedef enum {
+  HMS_BLE_UUID_TYPE_INVALID           = 0,
+  HMS_BLE_UUID_TYPE_16                = 2,                                                                                                  // SIG-assigned 16-bit UUID
+  HMS_BLE_UUID_TYPE_32                = 4,                                                                                                  // SIG-assigned 32-bit UUID
+  HMS_BLE_UUID_TYPE_128               = 16,                                                                                                 // Vendor-specific 128-bit UUID
+} HMS_BLE_UUIDType;                                                                                                                         // UUID width, value equals the encoded size in bytes
+
+#define HMS_BLE_UUID_STR_LENGTH                     37                                                                                      // "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx" + terminator
+
+/*
+  Binary UUID parsed once at registration (see HMS_BLE::parseUUID()).
+  val always holds the full 128-bit value in Bluetooth (little-endian) byte order, 16/32-bit UUIDs expanded over the SIG base UUID,
+  so equality is a single 16-byte compare. type records the shortest encoding, which backends use for attributes and advertising.
+*/
+typedef struct HMS_BLE_UUID {
+  uint8_t val[16];                                                                                                                          // 128-bit value, little-endian
+  uint8_t type;                                                                                                                             // HMS_BLE_UUIDType
+
+  bool valid() const                                               { return type != HMS_BLE_UUID_TYPE_INVALID;              }
+  uint8_t size() const                                             { return type;                                           }
+  const uint8_t* encoded() const                                   { return (type == HMS_BLE_UUID_TYPE_128) ? val : &val[12]; }            // Shortest little-endian encoding (size() bytes)
+  uint16_t value16() const                                         { return (uint16_t)(val[12] | (val[13] << 8));           }
+  uint32_t value32() const                                         { return (uint32_t)value16() | ((uint32_t)val[14] << 16) | ((uint32_t)val[15] << 24); }
+  bool operator==(const HMS_BLE_UUID& other) const {
+    uint64_t a[2], b[2];
+    memcpy(a, val, sizeof(a));
+    memcpy(b, other.val, sizeof(b));
+    return ((a[0] ^ b[0]) | (a[1] ^ b[1])) == 0;
+  }
+  bool operator!=(const HMS_BLE_UUID& other) const                 { return !(*this == other);                              }
+} HMS_BLE_UUID;
+
+typedef struct {
+  uint8_t nibble[256];                                                                                                                      // Hex digit -> value, 0xFF for anything else
+} HMS_BLE_HexTable;                                                                                                                         // One table load per character instead of three range checks
+
+inline constexpr HMS_BLE_HexTable HMS_BLE_HEX_TABLE = [] {
+  HMS_BLE_HexTable table{};
+  for(int i = 0; i < 256; i++) table.nibble[i] = 0xFF;
+  for(int i = 0; i < 10; i++)  table.nibble['0' + i] = (uint8_t)i;
+  for(int i = 0; i < 6; i++)   table.nibble['A' + i] = table.nibble['a' + i] = (uint8_t)(10 + i);
+  return table;
+}();
+
+inline constexpr uint8_t HMS_BLE_BASE_UUID[16] = {                                                                                          // Bluetooth Base UUID 00000000-0000-1000-8000-00805F9B34FB, little-endian
+  0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80,
+  0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+typedef struct {
+  HMS_BLE_UUID uuid;                                                                                                                        // Parsed service UUID
+  char uuidStr[HMS_BLE_UUID_STR_LENGTH];                                                                                                    // UUID text as registered (passed to callbacks)
+  char name[HMS_BLE_MAX_NAME_LENGTH];                                                                                                       // Human-readable service name
+} HMS_BLE_ServiceEntry;                                                                                                                     // Registered service (no heap)
+
+typedef struct {
+  HMS_BLE_UUID uuid;                                                                                                                        // Parsed characteristic UUID
+  char uuidStr[HMS_BLE_UUID_STR_LENGTH];                                                                                                    // UUID text as registered (passed to callbacks)
+  char name[HMS_BLE_MAX_NAME_LENGTH];                                                                                                       // Human-readable characteristic name (CUD)
+  HMS_BLE_CharacteristicProperty properties;                                                                                                // Characteristic properties
+} HMS_BLE_CharacteristicEntry;                                                                                                              // Registered characteristic (no heap)
+
+#if HMS_BLE_RX_RING_DEPTH
+typedef enum {
+  HMS_BLE_RX_MODE_QUEUE               = 0,                                                                                                  // Every write is kept until read, full ring drops the new write
+  HMS_BLE_RX_MODE_MAILBOX             = 1,                                                                                                  // Only the newest write is kept (last writer wins)
+} HMS_BLE_RxMode;
+
+/*
+  Single-producer/single-consumer receive ring for one characteristic. The BLE host context is the only producer (push),
+  the application the only consumer (pop); neither side ever blocks or takes a lock.
+  Queue mode is a classic ring over free-running head/tail counters. Mailbox mode is a triple buffer over slots 0..2:
+  the producer fills its back slot and swaps it with the shared middle slot, the consumer swaps its front slot with the
+  middle one when the fresh bit is set, so a reader never sees a half-written value.
+*/
+typedef struct HMS_BLE_RxRing {
+  uint8_t data[HMS_BLE_RX_RING_DEPTH][HMS_BLE_MAX_DATA_LENGTH];                                                                            // Slot payloads
+  uint16_t lengths[HMS_BLE_RX_RING_DEPTH];                                                                                                  // Slot payload lengths
+  std::atomic<uint16_t> head{0};                                                                                                            // Queue: next slot to write (producer)
+  std::atomic<uint16_t> tail{0};                                                                                                            // Queue: next slot to read (consumer)
+  std::atomic<uint8_t> middle{1};                                                                                                           // Mailbox: shared slot | MAILBOX_FRESH
+  uint8_t back = 0;                                                                                                                         // Mailbox: slot owned by the producer
+  uint8_t front = 2;                                                                                                                        // Mailbox: slot owned by the consumer
+  uint8_t mode = HMS_BLE_RX_MODE_QUEUE;                                                                                                     // HMS_BLE_RxMode
+  std::atomic<uint32_t> overflows{0};                                                                                                       // Queue: writes dropped on a full ring, mailbox: values replaced unread
+  std::atomic<uint32_t> truncations{0};                                                                                                     // Writes longer than HMS_BLE_MAX_DATA_LENGTH, stored cut to it
+
+  static constexpr uint8_t MAILBOX_FRESH = 0x80;
+
+  bool push(const uint8_t* value, size_t length) {                                                                                          // Producer side
+    if(length > HMS_BLE_MAX_DATA_LENGTH) {
+      length = HMS_BLE_MAX_DATA_LENGTH;
+      truncations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if(mode == HMS_BLE_RX_MODE_MAILBOX) {
+      memcpy(data[back], value, length);
+      lengths[back] = (uint16_t)length;
+      uint8_t previous = middle.exchange(back | MAILBOX_FRESH, std::memory_order_acq_rel);
+      if(previous & MAILBOX_FRESH) overflows.fetch_add(1, std::memory_order_relaxed);
+      back = previous & ~MAILBOX_FRESH;
+      return true;
+    }
+    uint16_t h = head.load(std::memory_order_relaxed);
+    if((uint16_t)(h - tail.load(std::memory_order_acquire)) >= HMS_BLE_RX_RING_DEPTH) {
+      overflows.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    uint8_t slot = h & (HMS_BLE_RX_RING_DEPTH - 1);
+    memcpy(data[slot], value, length);
+    lengths[slot] = (uint16_t)length;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(uint8_t* value, size_t* length) {                                                                                                // Consumer side, *length is buffer size in / value size out
+    const uint8_t* src;
+    size_t srcLength;
+    uint16_t t = 0;
+    if(mode == HMS_BLE_RX_MODE_MAILBOX) {
+      if(!(middle.load(std::memory_order_relaxed) & MAILBOX_FRESH)) return false;
+      front = middle.exchange(front, std::memory_order_acq_rel) & ~MAILBOX_FRESH;
+      src = data[front];
+      srcLength = lengths[front];
+    } else {
+      t = tail.load(std::memory_order_relaxed);
+      if(t == head.load(std::memory_order_acquire)) return false;
+      src = data[t & (HMS_BLE_RX_RING_DEPTH - 1)];
+      srcLength = lengths[t & (HMS_BLE_RX_RING_DEPTH - 1)];
+    }
+    if(srcLength > *length) srcLength = *length;
+    memcpy(value, src, srcLength);
+    *length = srcLength;
+    if(mode != HMS_BLE_RX_MODE_MAILBOX) tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t available() const {
+    if(mode == HMS_BLE_RX_MODE_MAILBOX) return (middle.load(std::memory_order_acquire) & MAILBOX_FRESH) ? 1 : 0;
+    return (uint16_t)(head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire));
+  }
+
+  void reset(HMS_BLE_RxMode newMode) {                                                                                                      // Only while no producer is running
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    middle.store(1, std::memory_order_relaxed);
+    back = 0;
+    front = 2;
+    mode = newMode;
+    overflows.store(0, std::memory_order_relaxed);
+    truncations.store(0, std::memory_order_relaxed);
+  }
+} HMS_BLE_RxRing;
+#endif
+
+#if HMS_BLE_VALUE_CACHE
+typedef enum {
+  HMS_BLE_READ_CACHED                       = 0,                                                                                            // Reads are answered from the cache, the read callback is not called
+  HMS_BLE_READ_REFRESH                      = 1                                                                                             // The read callback refreshes the cache when a read starts (offset 0)
+} HMS_BLE_ReadPolicy;                                                                                                                       // How reads of a cached characteristic are served
+
 typedef struct {
-  HMS_BLE_Service service;                                                                                                                  // Service definition
-  HMS_BLE_Characteristic characteristics[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                                                          // Characteristics for this service
+  uint32_t cachedReads;                                                                                                                     // Reads answered without calling the application
+  uint32_t refreshedReads;                                                                                                                  // Reads that called the read callback first (HMS_BLE_READ_REFRESH)
+  uint32_t unchangedSkipped;                                                                                                                // Sends dropped because the value was identical (notify-on-change)
+} HMS_BLE_ValueCacheStats;                                                                                                                  // Value cache counters (HMS_BLE_VALUE_CACHE)
+#endif
+
+typedef struct {
+  const HMS_BLE_ServiceEntry* service;                                                                                                      // Service definition (runtime pool or compile-time schema)
+  const HMS_BLE_CharacteristicEntry* characteristics;                                                                                       // Characteristics for this service (runtime pool or compile-time schema)
   size_t characteristicCount;                                                                                                               // Number of characteristics in this service
   uint8_t data[HMS_BLE_MAX_DATA_LENGTH];                                                                                                    // Per-service received data buffer
   size_t dataLength;                                                                                                                        // Per-service received data length
   bool received;                                                                                                                            // Per-service data received flag
+  uint32_t subscribers[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE][HMS_BLE_CLIENT_WORDS];                                                      // Per characteristic, bit per connection slot with notifications/indications enabled
+  #if HMS_BLE_INDICATE_DEPTH
+    uint32_t indicators[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE][HMS_BLE_CLIENT_WORDS];                                                     // Subset of subscribers that enabled indications
+  #endif
+  #if HMS_BLE_RX_RING_DEPTH
+    HMS_BLE_RxRing rxRings[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                                                                        // Lock-free receive ring per characteristic
+  #endif
+  #if HMS_BLE_VALUE_CACHE
+    uint8_t cachedValues[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE][HMS_BLE_MAX_DATA_LENGTH];                                                 // Last value set/sent per characteristic, guarded by the cache lock
+    uint16_t cachedLengths[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                                                                        // Length of the cached value
+    uint8_t readPolicies[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                                                                          // HMS_BLE_ReadPolicy per characteristic
+    bool notifyOnChange[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                                                                           // Skip sends identical to the cached value
+  #endif
+  #if HMS_BLE_NOTIFY_QUEUE
+    uint8_t pendingValues[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE][HMS_BLE_MAX_DATA_LENGTH];                                                // Newest not-yet-sent value per characteristic
+    uint16_t pendingLengths[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                                                                       // Length of the pending value
+    bool pendingQueued[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                                                                            // Characteristic has an entry in the notify queue
+    bool pendingDirty[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                                                                             // Pending value changed since the drain last copied it
+  #endif
   #if defined(HMS_BLE_ARDUINO_ESP32)
     NimBLEService* bleService;                                                                                                              // Platform-specific service handle (ESP32)
     NimBLECharacteristic* bleCharacteristics[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                                                      // Platform-specific characteristic pointers
-    bool notificationEnabled[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE][HMS_BLE_MAX_CLIENTS];                                                 // Notification tracking per characteristic per client
+  #elif defined(HMS_BLE_DESKTOP_SIM)
+    uint8_t values[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE][HMS_BLE_MAX_DATA_LENGTH];                                                       // Attribute values held by the virtual controller
+    size_t valueLengths[HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                                                                           // Attribute value lengths
   #endif
 } HMS_BLE_ServiceDescriptor;                                                                                                                // Internal service descriptor with tracking data
 
+typedef struct {
+  uint16_t id;                                                                                                                              // Packed (serviceIndex << 8 | charIndex), opaque to the application
+  bool valid() const { return id != 0xFFFF; }
+} HMS_BLE_CharHandle;                                                                                                                       // Pre-resolved service/characteristic pair (see getCharacteristicHandle())
+
+#define HMS_BLE_INVALID_CHAR_HANDLE                 (HMS_BLE_CharHandle{0xFFFF})
+#define HMS_BLE_CONN_HANDLE_NONE                    0xFFFF                                                                                          // Connection handle of a free slot
+
+typedef struct {
+  uint32_t notificationsSent;                                                                                                               // Notifications handed to the stack for this link
+  uint32_t bytesSent;                                                                                                                       // Their payload bytes
+  uint32_t writesReceived;                                                                                                                  // ATT writes from this central
+  uint32_t bytesReceived;                                                                                                                   // Their payload bytes
+  uint32_t readsServed;                                                                                                                     // ATT reads answered (read blobs not counted)
+} HMS_BLE_LinkStats;                                                                                                                        // Per-connection traffic counters
+
+typedef struct {
+  uint16_t connHandle;                                                                                                                      // Stack connection handle (Zephyr: bt_conn_index())
+  uint8_t address[6];                                                                                                                       // Peer address
+  uint16_t mtu;                                                                                                                             // Negotiated ATT MTU (23 until exchanged)
+  uint16_t interval;                                                                                                                        // Connection interval, 1.25 ms units
+  uint16_t latency;                                                                                                                         // Peripheral latency, connection events
+  uint16_t supervisionTimeout;                                                                                                              // Supervision timeout, 10 ms units
+  uint32_t subscriptions[HMS_BLE_SUBSCRIPTION_WORDS];                                                                                       // Bit (service * HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE + char) set while subscribed
+  HMS_BLE_LinkStats stats;
+} HMS_BLE_Connection;                                                                                                                       // Snapshot of one connection slot (see HMS_BLE::getConnection())
+
+constexpr size_t HMS_BLE_ConnectionIndexSize(size_t size = 4) {
+  return size >= 2 * HMS_BLE_MAX_CLIENTS ? size : HMS_BLE_ConnectionIndexSize(size * 2);                                                    // Power of two, load factor <= 1/2
+}
+
+typedef struct {
+  size_t depth;                                                                                                                             // Characteristics with an update waiting to be sent
+  size_t highWater;                                                                                                                         // Largest depth seen since the last reset
+  uint32_t queued;                                                                                                                          // Updates that entered the queue
+  uint32_t coalesced;                                                                                                                       // Pending updates replaced by a newer value before being sent
+  uint32_t sent;                                                                                                                            // Updates handed to the stack
+  uint32_t deferred;                                                                                                                        // Drain attempts put off because the stack had no TX buffer
+  uint32_t dropped;                                                                                                                         // Updates discarded (link lost, characteristic invalid)
+} HMS_BLE_NotifyQueueStats;                                                                                                                 // Outbound notification queue counters (HMS_BLE_NOTIFY_QUEUE)
+
+typedef enum {
+  HMS_BLE_EVENT_CONNECT                     = 0x01,                                                                                         // A central connected
+  HMS_BLE_EVENT_DISCONNECT                  = 0x02,                                                                                         // A central disconnected
+  HMS_BLE_EVENT_WRITE                       = 0x04,                                                                                         // A central wrote a characteristic
+  HMS_BLE_EVENT_SUBSCRIBE                   = 0x08,                                                                                         // A CCC descriptor changed
+  HMS_BLE_EVENT_SEND                        = 0x10,                                                                                         // The application queued a notification
+  HMS_BLE_EVENT_BROADCAST                   = 0x20,                                                                                         // A broadcast set started, the background task reschedules its frame rotation
+  HMS_BLE_EVENT_STOP                        = 0x80                                                                                          // stop() wants the background task to exit
+} HMS_BLE_Event;                                                                                                                            // Background task wake reasons, OR-ed into one pending mask
+
+typedef struct {
+  uint32_t wakeups;                                                                                                                         // Times the background task returned from its wait
+  uint32_t handled;                                                                                                                         // loop() passes that found at least one pending event
+  uint32_t lastLatencyUs;                                                                                                                   // Event-to-handler latency of the last handled pass
+  uint32_t maxLatencyUs;                                                                                                                    // Worst event-to-handler latency since the last reset
+  uint32_t totalLatencyUs;                                                                                                                  // Sum of latencies (divide by handled for the mean)
+} HMS_BLE_TaskStats;                                                                                                                        // Background task counters (see getTaskStats())
+
+typedef enum {
+  HMS_BLE_DISCONNECT_TIMEOUT                = 0,                                                                                            // HCI 0x08, supervision timeout (range, interference)
+  HMS_BLE_DISCONNECT_REMOTE_USER,                                                                                                           // HCI 0x13, the central closed the link
+  HMS_BLE_DISCONNECT_REMOTE_POWER,                                                                                                          // HCI 0x14/0x15, the central ran low on resources or powered off
+  HMS_BLE_DISCONNECT_LOCAL_HOST,                                                                                                            // HCI 0x16, this side closed the link
+  HMS_BLE_DISCONNECT_MIC_FAILURE,                                                                                                           // HCI 0x3D, encryption integrity check failed
+  HMS_BLE_DISCONNECT_FAILED_TO_ESTABLISH,                                                                                                   // HCI 0x3E, the link never came up
+  HMS_BLE_DISCONNECT_OTHER,                                                                                                                 // Anything else, see HMS_BLE_Stats::lastDisconnectReason
+  HMS_BLE_DISCONNECT_REASON_COUNT
+} HMS_BLE_DisconnectReason;                                                                                                                 // Buckets of HCI disconnect reasons counted by getStats()
+
+typedef struct {
+  uint32_t notifications;                                                                                                                   // Notifications handed to the stack with at least one subscriber
+  uint32_t indications;                                                                                                                     // Indications handed to the stack
+  uint32_t bytesSent;                                                                                                                       // Value bytes of both
+  uint32_t reads;                                                                                                                           // Reads served to centrals
+  uint32_t writes;                                                                                                                          // Writes received from centrals
+  uint32_t bytesWritten;                                                                                                                    // Value bytes of those writes
+} HMS_BLE_CharStats;                                                                                                                        // Per-characteristic counters (see getCharacteristicStats())
+
+typedef struct {
+  uint32_t connections;                                                                                                                     // Links that got a connection slot
+  uint32_t refusedConnections;                                                                                                              // Links dropped because the connection table was full
+  uint32_t disconnections;                                                                                                                  // Links closed, any reason
+  uint32_t disconnectReasons[HMS_BLE_DISCONNECT_REASON_COUNT];                                                                              // Indexed by HMS_BLE_DisconnectReason
+  uint8_t lastDisconnectReason;                                                                                                             // Raw HCI reason of the latest disconnect
+  uint32_t sendErrors[HMS_BLE_STATUS_COUNT];                                                                                                // Sends the stack refused, indexed by -status (every retry counts)
+  uint32_t notifications;                                                                                                                   // Totals of the per-characteristic counters
+  uint32_t indications;
+  uint32_t bytesSent;
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t bytesWritten;
+  uint32_t coalesced;                                                                                                                       // Updates replaced by a newer value, or skipped as unchanged, before reaching the stack
+  uint32_t dropped;                                                                                                                         // Queued updates discarded without being sent
+  uint32_t wakeups;                                                                                                                         // Background task wakeups (as HMS_BLE_TaskStats::wakeups)
+  uint32_t stackFree;                                                                                                                       // Background task stack never touched so far, bytes (0 = not available)
+} HMS_BLE_Stats;                                                                                                                            // Library-wide counters (see getStats())
+
+typedef enum {
+  HMS_BLE_TRACE_CONNECT                     = 1,                                                                                            // slot taken; length = connection handle, status = slot or -1 when the table was full
+  HMS_BLE_TRACE_DISCONNECT                  = 2,                                                                                            // length = connection handle, status = HCI reason
+  HMS_BLE_TRACE_SUBSCRIBE                   = 3,                                                                                            // CCC write; length = 1 subscribed, 2 indications, 0 unsubscribed
+  HMS_BLE_TRACE_WRITE                       = 4,                                                                                            // A central wrote length bytes
+  HMS_BLE_TRACE_READ                        = 5,                                                                                            // A central read the value, length 0 (the request, not the value served)
+  HMS_BLE_TRACE_NOTIFY                      = 6,                                                                                            // Value handed to the stack; status = result (every retry is one record)
+  HMS_BLE_TRACE_TX_DONE                     = 7,                                                                                            // TX credit returned, every link sent or failed; status = combined result
+  HMS_BLE_TRACE_QUEUE                       = 8,                                                                                            // Update entered the notification queue; status = 1 when it replaced a pending value
+  HMS_BLE_TRACE_TASK                        = 9,                                                                                            // loop() handled events; length = HMS_BLE_Event mask, status = latency in us (saturated)
+  HMS_BLE_TRACE_MTU                         = 10,                                                                                           // length = new ATT MTU
+  HMS_BLE_TRACE_INDICATE                    = 11,                                                                                           // Indication handed to the stack for one link; status = result
+  HMS_BLE_TRACE_CONFIRM                     = 12,                                                                                           // Indication finished on one link; length = round trip in us (saturated), status = result
+  HMS_BLE_TRACE_LINK                        = 13,                                                                                           // The stack reported link parameters; length = connection interval (1.25 ms units), status = HMS_BLE_LinkChange bits or a refused request's status
+  HMS_BLE_TRACE_BROADCAST                   = 14,                                                                                           // Broadcast frame handed to the stack; handle = set << 8 | frame, length = advertising data bytes, status = result
+} HMS_BLE_TraceEventId;                                                                                                                     // Event ids of HMS_BLE_TraceRecord
+
+typedef struct {
+  uint32_t timestamp;                                                                                                                       // Microseconds, same clock as the task latency (wraps after 71 minutes)
+  uint32_t sequence;                                                                                                                        // Position in the trace since start/clearTrace(), 1-based; gaps mean overwritten records
+  uint16_t handle;                                                                                                                          // HMS_BLE_CharHandle id (service << 8 | characteristic), 0xFFFF when not about a characteristic
+  uint16_t length;                                                                                                                          // Value length, or the per-event field documented in HMS_BLE_TraceEventId
+  uint8_t event;                                                                                                                            // HMS_BLE_TraceEventId
+  uint8_t slot;                                                                                                                             // Connection slot, 0xFF when not about one link
+  int16_t status;                                                                                                                           // HMS_BLE_Status, or the per-event field documented in HMS_BLE_TraceEventId
+} HMS_BLE_TraceRecord;                                                                                                                      // 16 bytes, little-endian in dumpTrace() output
+
+typedef struct {
+  char magic[8];                                                                                                                            // "HMSTRACE"
+  uint16_t version;                                                                                                                         // HMS_BLE_TRACE_FORMAT_VERSION
+  uint16_t recordSize;                                                                                                                      // sizeof(HMS_BLE_TraceRecord)
+  uint32_t count;                                                                                                                           // Records following the header, oldest first
+  uint32_t dropped;                                                                                                                         // Records overwritten before this dump
+  uint32_t reserved;                                                                                                                        // Zero
+} HMS_BLE_TraceDumpHeader;                                                                                                                  // Starts a dumpTrace() buffer, read by tools/HMS_BLE_TRACE_DECODE.cpp
+#define HMS_BLE_TRACE_FORMAT_VERSION 1                                                                                                      // Bumped when the record layout changes
+
+typedef struct {
+  uint32_t id;                                                                                                                              // HMS_BLE_LogFormatId(format), what a deferred record stores instead of the string
+  uint8_t level;                                                                                                                            // HMS_BLE_LOG_debug .. HMS_BLE_LOG_error
+  const char* format;                                                                                                                       // The printf format, stays in flash
+} HMS_BLE_LogSite;                                                                                                                          // One per deferred BLE_LOGGER call site, static constexpr
+
+typedef struct {
+  uint32_t timestamp;                                                                                                                       // Microseconds, same clock as the trace
+  uint32_t sequence;                                                                                                                        // Record number since start, 1-based; gaps mean lost records
+  uint32_t id;                                                                                                                              // HMS_BLE_LogSite::id, resolved to the format by tools/HMS_BLE_LOG_DECODE.cpp
+  uint8_t level;                                                                                                                            // HMS_BLE_LOG_debug .. HMS_BLE_LOG_error
+  uint8_t length;                                                                                                                           // Payload bytes used
+  uint8_t reserved[2];                                                                                                                      // Zero
+  uint8_t payload[HMS_BLE_LOG_PAYLOAD];                                                                                                     // Arguments: one tag byte (i u I U d s p) then the value, strings as length byte + bytes
+} HMS_BLE_LogRecord;                                                                                                                        // dumpLog() record, little-endian; decoders take the payload size from recordSize
+
+typedef struct {
+  char magic[8];                                                                                                                            // "HMSLOG" padded with zeros
+  uint16_t version;                                                                                                                         // HMS_BLE_LOG_FORMAT_VERSION
+  uint16_t recordSize;                                                                                                                      // sizeof(HMS_BLE_LogRecord) on the device
+  uint32_t count;                                                                                                                           // Records following the header, oldest first
+  uint32_t lost;                                                                                                                            // Records overwritten before they were flushed or dumped, since start
+  uint32_t reserved;                                                                                                                        // Zero
+} HMS_BLE_LogDumpHeader;                                                                                                                    // Starts a dumpLog() buffer
+#define HMS_BLE_LOG_FORMAT_VERSION 1                                                                                                        // Bumped when the record or payload encoding changes
+
+typedef std::function<void(uint8_t level, uint32_t timestamp, const char* line)> HMS_BLE_LogHandler;                                        // Receives deferred log lines from flushLog()
+
+// FNV-1a of the format string: the compiler turns each deferred call site into a 32-bit id, the decoder hashes the same
+// literals out of the sources to map ids back
+constexpr uint32_t HMS_BLE_LogFormatId(const char* format) {
+  uint32_t hash = 2166136261u;
+  while(*format) hash = (hash ^ (uint8_t)*format++) * 16777619u;
+  return hash;
+}
+
+#if HMS_BLE_LOG_DEFERRED || defined(HMS_BLE_PLATFORM_DESKTOP)
+size_t HMS_BLE_LogFormat(const char* format, const uint8_t* payload, size_t length, char* out, size_t size);                                // printf the format with a record's arguments, returns the line length
+#endif
+
+#if HMS_BLE_LOG_DEFERRED
+/*
+  Deferred BLE_LOGGER: the call site copies its arguments into a small buffer with one tag byte each and hands that to the
+  log ring, no formatting on the calling thread. Integers keep their width (32 or 64 bit), enums go as their underlying
+  type and strings are copied, cut to what is left of HMS_BLE_LOG_PAYLOAD. Arguments that no longer fit are dropped and
+  print as <?> when the record is formatted.
+*/
+void HMS_BLE_LogCommit(const HMS_BLE_LogSite* site, const uint8_t* payload, size_t length);                                                 // Any context, lock-free; payload spans HMS_BLE_LOG_PAYLOAD bytes
+
+typedef struct {
+  uint8_t data[HMS_BLE_LOG_PAYLOAD];
+  size_t length;
+  bool full;
+} HMS_BLE_LogArguments;                                                                                                                     // Encoder state of one deferred call
+
+inline void HMS_BLE_LogPut(HMS_BLE_LogArguments& args, char tag, const void* value, size_t size) {
+  if(args.full || args.length + 1 + size > HMS_BLE_LOG_PAYLOAD) {
+    args.full = true;
+    return;
+  }
+  args.data[args.length] = (uint8_t)tag;
+  memcpy(&args.data[args.length + 1], value, size);
+  args.length += 1 + size;
+}
+
+inline void HMS_BLE_LogPutString(HMS_BLE_LogArguments& args, const char* value) {
+  if(!value) value = "(null)";
+  if(args.full || args.length + 2 > HMS_BLE_LOG_PAYLOAD) {
+    args.full = true;
+    return;
+  }
+  size_t length = 0, room = HMS_BLE_LOG_PAYLOAD - args.length - 2;
+  while(length < room && value[length]) length++;
+  args.data[args.length] = 's';
+  args.data[args.length + 1] = (uint8_t)length;
+  memcpy(&args.data[args.length + 2], value, length);
+  args.length += 2 + length;
+}
+
+template <typename T>
+inline void HMS_BLE_LogEncode(HMS_BLE_LogArguments& args, T value) {
+  if constexpr (std::is_enum<T>::value) {
+    HMS_BLE_LogEncode(args, (typename std::underlying_type<T>::type)value);
+  } else if constexpr (std::is_integral<T>::value && sizeof(T) <= 4) {
+    if constexpr (std::is_signed<T>::value) { int32_t v = value; HMS_BLE_LogPut(args, 'i', &v, sizeof(v)); }
+    else                                    { uint32_t v = value; HMS_BLE_LogPut(args, 'u', &v, sizeof(v)); }
+  } else if constexpr (std::is_integral<T>::value) {
+    if constexpr (std::is_signed<T>::value) { int64_t v = value; HMS_BLE_LogPut(args, 'I', &v, sizeof(v)); }
+    else                                    { uint64_t v = value; HMS_BLE_LogPut(args, 'U', &v, sizeof(v)); }
+  } else if constexpr (std::is_floating_point<T>::value) {
+    double v = value;
+    HMS_BLE_LogPut(args, 'd', &v, sizeof(v));
+  } else if constexpr (std::is_convertible<T, const char*>::value) {
+    HMS_BLE_LogPutString(args, value);
+  } else {
+    static_assert(std::is_pointer<T>::value, "BLE_LOGGER argument the deferred log cannot record");
+    uint64_t v = (uint64_t)(uintptr_t)value;
+    HMS_BLE_LogPut(args, 'p', &v, sizeof(v));
+  }
+}
+
+template <typename... Args>
+inline void HMS_BLE_LogWrite(const HMS_BLE_LogSite* site, const Args&... values) {
+  HMS_BLE_LogArguments args;
+  args.length = 0;
+  args.full = false;
+  (HMS_BLE_LogEncode(args, values), ...);
+  HMS_BLE_LogCommit(site, args.data, args.length);
+}
+#endif
+
 typedef struct {
   std::array<uint8_t, 2> manufacturer_id;                                                                                                   // Company Identifier Code (0xFFFF for testing)
   std::array<uint8_t, 6> data;                                                                                                              // Manufacturer specific data (up to 6 bytes)
 } HMS_BLE_ManufacturerData;
 
+#define HMS_BLE_ADV_PACKET_LENGTH                   31                                                                                      // Legacy advertising / scan response payload
+
+typedef enum {
+  HMS_BLE_ADV_UUIDS_INCOMPLETE              = 0x01,                                                                                         // Not every advertised service UUID fit, the cut list is marked incomplete
+  HMS_BLE_ADV_NAME_SHORTENED                = 0x02,                                                                                         // Only the start of the device name fit (Shortened Local Name)
+  HMS_BLE_ADV_NAME_DROPPED                  = 0x04,
+  HMS_BLE_ADV_MANUFACTURER_DROPPED          = 0x08,
+  HMS_BLE_ADV_SERVICE_DATA_DROPPED          = 0x10,
+} HMS_BLE_AdvFit;                                                                                                                           // What packing had to give up, bits of HMS_BLE_AdvPayload::fit
+
+typedef struct {
+  uint8_t offset;                                                                                                                           // Index of the value in its packet, 0 = not placed
+  uint8_t length;
+  bool scanResponse;
+} HMS_BLE_AdvField;                                                                                                                         // Where an updatable value sits
+
+typedef struct {
+  uint8_t advertising[HMS_BLE_ADV_PACKET_LENGTH];
+  uint8_t scanResponse[HMS_BLE_ADV_PACKET_LENGTH];
+  uint8_t advertisingLength;
+  uint8_t scanResponseLength;
+  HMS_BLE_AdvField manufacturer;                                                                                                            // Value after the company identifier
+  HMS_BLE_AdvField serviceData;                                                                                                             // Value after the service UUID
+  uint8_t fit;                                                                                                                              // HMS_BLE_AdvFit bits
+} HMS_BLE_AdvPayload;                                                                                                                       // Packed AD structures, handed to the stack as they are
+
 typedef std::function<void(bool connected, const uint8_t* deviceMac)> HMS_BLE_ConnectionCallback;
 typedef std::function<void(const char* serviceUUID, const char* charUUID, bool enabled, const uint8_t* deviceMac)> HMS_BLE_NotifyCallback;
 typedef std::function<void(const char* serviceUUID, const char* charUUID, uint8_t* data, size_t* length, const uint8_t* deviceMac)> HMS_BLE_ReadCallback;
 typedef std::function<void(const char* serviceUUID, const char* charUUID, const uint8_t* data, size_t length, const uint8_t* deviceMac)> HMS_BLE_WriteCallback;
 
+typedef struct {
+  const uint8_t* data;                                                                                                                      // Points into the stack's own buffer, valid only during the callback
+  size_t length;                                                                                                                            // Full written length, not capped at HMS_BLE_MAX_DATA_LENGTH
+} HMS_BLE_ValueView;                                                                                                                        // Written value handed to HMS_BLE_WriteViewCallback
+
+typedef struct {
+  uint8_t* data;                                                                                                                            // Outgoing read response buffer
+  size_t capacity;                                                                                                                          // Bytes the response can carry (negotiated ATT MTU - 1)
+} HMS_BLE_ValueBuffer;                                                                                                                      // Read response handed to HMS_BLE_ReadIntoCallback
+
+typedef std::function<void(HMS_BLE_CharHandle handle, HMS_BLE_ValueView value, const uint8_t* deviceMac)> HMS_BLE_WriteViewCallback;
+
+#if HMS_BLE_INGEST_BYTES
+typedef std::function<void(HMS_BLE_CharHandle handle, HMS_BLE_ValueView value, int slot)> HMS_BLE_IngestCallback;                           // value points into the ingest ring, slot is the writer's connection slot
+
+typedef struct {
+  uint32_t received;                                                                                                                        // Writes handed to the application
+  uint32_t bytes;                                                                                                                           // Their payload bytes
+  uint32_t dropped;                                                                                                                         // Writes discarded because the ring was full
+  uint32_t droppedBytes;                                                                                                                    // Their payload bytes
+  size_t maxFill;                                                                                                                           // Most ring bytes in use at once since the last reset
+} HMS_BLE_IngestStats;                                                                                                                      // Write Without Response ingest counters (HMS_BLE_INGEST_BYTES)
+#endif
+typedef std::function<void(HMS_BLE_CharHandle handle, HMS_BLE_Status status)> HMS_BLE_SendCallback;                                      // Per-send completion (see sendData() with onSent)
+typedef std::function<size_t(HMS_BLE_CharHandle handle, HMS_BLE_ValueBuffer response, const uint8_t* deviceMac)> HMS_BLE_ReadIntoCallback;   // Returns bytes written
+
+#if HMS_BLE_MAX_STREAMS
+typedef std::function<void(HMS_BLE_CharHandle handle, HMS_BLE_Status status, size_t length)> HMS_BLE_StreamCallback;
+
+/*
+  Stream segment: 1 header byte, then payload. The first segment also carries the total length (uint32, little-endian) right
+  after the header. Sequence numbers count segments modulo 64 so a lost write is detected instead of silently reassembled.
+*/
+#define HMS_BLE_STREAM_FIRST                        0x80                                                                                            // Segment header: first segment, total length follows
+#define HMS_BLE_STREAM_LAST                         0x40                                                                                            // Segment header: last segment
+#define HMS_BLE_STREAM_SEQUENCE_MASK                0x3F                                                                                            // Segment header: sequence number
+
+typedef struct {
+  uint16_t handle;                                                                                                                          // Bound characteristic (HMS_BLE_CharHandle id), 0xFFFF while free
+  std::atomic<bool> txActive;                                                                                                               // Outgoing stream in progress (armed by the app, cleared by the pump)
+  const uint8_t* txData;                                                                                                                    // Caller's blob, must stay valid until txDone
+  size_t txLength;                                                                                                                          // Blob length
+  size_t txOffset;                                                                                                                          // Bytes handed to the stack so far
+  uint32_t txSegments;                                                                                                                      // Segments sent so far
+  HMS_BLE_StreamCallback txDone;                                                                                                            // Completion, called from loop()
+  std::atomic<bool> rxActive;                                                                                                               // Reassembly armed (set by the app, cleared on completion)
+  uint8_t* rxBuffer;                                                                                                                        // Caller's reassembly buffer
+  size_t rxCapacity;                                                                                                                        // Reassembly buffer size
+  size_t rxLength;                                                                                                                          // Bytes reassembled so far
+  size_t rxExpected;                                                                                                                        // Total length announced by the first segment
+  uint8_t rxSequence;                                                                                                                       // Sequence number of the last accepted segment
+  bool rxStarted;                                                                                                                           // First segment seen
+  HMS_BLE_StreamCallback rxDone;                                                                                                            // Completion, called from the BLE host context
+} HMS_BLE_Stream;                                                                                                                           // Fragmentation/reassembly state of one characteristic
+#endif
+
+#if HMS_BLE_TX_CREDITS
+typedef struct {
+  HMS_BLE_SendCallback done;                                                                                                                // Completion, called once every PDU of the send completed
+  uint16_t handle;                                                                                                                          // Characteristic (HMS_BLE_CharHandle id)
+  uint16_t generation;                                                                                                                      // Bumped on release, a stale completion token no longer matches
+  uint32_t links[HMS_BLE_CLIENT_WORDS];                                                                                                     // Connection slots whose PDU is still in flight
+  bool used;                                                                                                                                // Credit taken
+  HMS_BLE_Status status;                                                                                                                    // First failure among the PDUs, SUCCESS otherwise
+} HMS_BLE_TxSlot;                                                                                                                           // One TX credit: a send handed to the stack and not yet completed
+
+typedef struct {
+  size_t inFlight;                                                                                                                          // Credits currently taken
+  size_t maxInFlight;                                                                                                                       // Most credits taken at once since the last reset
+  uint32_t submitted;                                                                                                                       // Sends handed to the stack
+  uint32_t completed;                                                                                                                       // Sends whose PDUs all went out
+  uint32_t failed;                                                                                                                          // Sends completed with an error (link lost)
+  uint32_t busy;                                                                                                                            // Sends refused because every credit was in flight
+} HMS_BLE_TxStats;                                                                                                                          // TX flow control counters (HMS_BLE_TX_CREDITS)
+#endif
+
+#if HMS_BLE_INDICATE_DEPTH
+typedef enum {
+  HMS_BLE_INDICATE_IN_ORDER                 = 0,                                                                                            // One indication in flight per link, in submission order across characteristics (default)
+  HMS_BLE_INDICATE_PER_CHARACTERISTIC       = 1,                                                                                            // In order per characteristic only: characteristics take turns, up to HMS_BLE_INDICATE_BEARERS in flight per link
+} HMS_BLE_IndicateOrder;                                                                                                                    // See HMS_BLE::setIndicationOrder()
+
+typedef enum {
+  HMS_BLE_INDICATION_FREE                   = 0,
+  HMS_BLE_INDICATION_QUEUED                 = 1,                                                                                            // Waiting for its turn
+  HMS_BLE_INDICATION_IN_FLIGHT              = 2,                                                                                            // With the stack, waiting for the confirmation
+} HMS_BLE_IndicationState;
+
+typedef std::function<void(HMS_BLE_CharHandle handle, int slot, HMS_BLE_Status status, uint32_t roundTripUs)> HMS_BLE_IndicateCallback;     // Once per link; roundTripUs is hand-off to confirmation (0 unless SUCCESS)
+typedef std::function<void(HMS_BLE_CharHandle handle, int slot)> HMS_BLE_IndicateTimeoutCallback;                                           // A link missed the confirmation deadline for handle
+
+typedef struct {
+  HMS_BLE_IndicateCallback done;                                                                                                            // Completion for this link
+  uint32_t sequence;                                                                                                                        // Submission order on the link
+  uint32_t sentAt;                                                                                                                          // eventClockMicros() at the hand-off to the stack
+  uint16_t handle;                                                                                                                          // Characteristic (HMS_BLE_CharHandle id)
+  uint16_t length;                                                                                                                          // Value bytes
+  uint16_t generation;                                                                                                                      // Bumped on release, a stale confirmation token no longer matches
+  uint8_t state;                                                                                                                            // HMS_BLE_IndicationState
+  uint8_t value[HMS_BLE_MAX_DATA_LENGTH];                                                                                                   // Copy of the value, read by the stack at hand-off
+} HMS_BLE_Indication;                                                                                                                       // One queued or in-flight indication on one link
+
+typedef struct {
+  uint32_t queued;                                                                                                                          // Indications accepted, one per target link
+  uint32_t sent;                                                                                                                            // Handed to the stack
+  uint32_t confirmed;                                                                                                                       // Confirmed by the central
+  uint32_t timedOut;                                                                                                                        // Not confirmed within the timeout, or queued behind one that was not
+  uint32_t failed;                                                                                                                          // Ended with another error (link lost, indications disabled, refused by the stack)
+  uint32_t busy;                                                                                                                            // indicate() calls refused because a target link's queue was full
+  size_t pending;                                                                                                                           // Entries queued or in flight now
+  size_t maxPending;                                                                                                                        // Most entries held at once since the last reset
+  size_t inFlight;                                                                                                                          // Entries with the stack now
+  uint32_t lastRoundTripUs;                                                                                                                 // Hand-off to confirmation of the last confirmed indication
+  uint32_t maxRoundTripUs;                                                                                                                  // Worst round trip since the last reset
+  uint64_t totalRoundTripUs;                                                                                                                // Sum over confirmed (divide by confirmed for the mean)
+} HMS_BLE_IndicationStats;                                                                                                                  // Indication pipeline counters (HMS_BLE_INDICATE_DEPTH)
+#endif
+
+typedef enum {
+  HMS_BLE_LINK_CHANGE_PARAMS                = 0x01,                                                                                         // Connection interval, peripheral latency or supervision timeout
+  HMS_BLE_LINK_CHANGE_PHY                   = 0x02,
+  HMS_BLE_LINK_CHANGE_DATA_LENGTH           = 0x04,                                                                                         // LL payload octets (Data Length Extension)
+  HMS_BLE_LINK_CHANGE_MTU                   = 0x08,
+} HMS_BLE_LinkChange;                                                                                                                       // What a link report changed, bits of HMS_BLE_LinkInfo::changed and of the HMS_BLE_TRACE_LINK status
+
+typedef enum {
+  HMS_BLE_PHY_1M                            = 0x01,                                                                                         // Bit values, as Zephyr's BT_GAP_LE_PHY_* and NimBLE's BLE_GAP_LE_PHY_*_MASK
+  HMS_BLE_PHY_2M                            = 0x02,
+  HMS_BLE_PHY_CODED                         = 0x04,                                                                                         // Long range (S8 coding assumed for the air time)
+} HMS_BLE_Phy;                                                                                                                              // Link profiles and broadcast sets
+
+#if HMS_BLE_LINK_PROFILES
+typedef enum {
+  HMS_BLE_LINK_PROFILE_DEFAULT              = 0,                                                                                            // Request nothing, keep what the central picked
+  HMS_BLE_LINK_PROFILE_LOW_LATENCY          = 1,                                                                                            // Shortest intervals on the 2M PHY: an update waits the least for the next connection event
+  HMS_BLE_LINK_PROFILE_HIGH_THROUGHPUT      = 2,                                                                                            // 2M PHY and 251-byte LL packets, intervals long enough to carry many of them per event
+  HMS_BLE_LINK_PROFILE_LOW_POWER            = 3,                                                                                            // Long intervals with peripheral latency on the 1M PHY, the radio sleeps between events
+  HMS_BLE_LINK_PROFILE_COUNT
+} HMS_BLE_LinkProfile;                                                                                                                      // See HMS_BLE::requestLinkProfile()
+
+typedef struct {
+  uint16_t minInterval;                                                                                                                     // Connection interval range, 1.25 ms units, 6 (7.5 ms) .. 3200 (4 s)
+  uint16_t maxInterval;
+  uint16_t latency;                                                                                                                         // Connection events the peripheral may skip, <= 499
+  uint16_t supervisionTimeout;                                                                                                              // 10 ms units, 10 .. 3200, longer than (1 + latency) * maxInterval * 2
+  uint8_t phy;                                                                                                                              // HMS_BLE_Phy bits preferred in both directions, 0 = leave the PHY alone
+  uint16_t dataLength;                                                                                                                      // LL payload octets to ask for, 27 .. 251, 0 = leave it alone
+} HMS_BLE_LinkProfileParams;                                                                                                                // What a profile requests (see HMS_BLE::setLinkProfileParams())
+
+typedef struct {
+  HMS_BLE_LinkProfile profile;                                                                                                              // Last profile requested on this link
+  uint16_t interval;                                                                                                                        // Connection interval, 1.25 ms units
+  uint16_t latency;                                                                                                                         // Peripheral latency, connection events
+  uint16_t supervisionTimeout;                                                                                                              // Supervision timeout, 10 ms units
+  uint8_t txPhy;                                                                                                                            // HMS_BLE_Phy of each direction, 1M until the stack reports otherwise
+  uint8_t rxPhy;
+  uint16_t txOctets;                                                                                                                        // LL payload octets of each direction, 27 until the data length is updated
+  uint16_t rxOctets;
+  uint16_t mtu;                                                                                                                             // Negotiated ATT MTU
+  uint8_t notificationsPerEvent;                                                                                                            // Full-MTU notifications one connection event carries, estimated from the values above
+  uint8_t changed;                                                                                                                          // HMS_BLE_LinkChange bits of this report, 0 when a request was refused
+  bool matched;                                                                                                                             // The values satisfy the requested profile (interval in range, preferred TX PHY, data length reached)
+} HMS_BLE_LinkInfo;                                                                                                                         // Negotiated state of one connection (see HMS_BLE::getLinkInfo())
+
+typedef std::function<void(int slot, const HMS_BLE_LinkInfo& link, HMS_BLE_Status status)> HMS_BLE_LinkCallback;                            // Stack context; SUCCESS for a report, else the error of a refused request
+typedef std::function<HMS_BLE_LinkProfile(int slot, const uint8_t* address)> HMS_BLE_LinkProfileSelector;                                   // Picks the profile requested when a central connects
+#endif
+#if HMS_BLE_BROADCAST_SETS
+typedef enum {
+  HMS_BLE_BROADCAST_LEGACY                  = 0,                                                                                            // ADV_NONCONN_IND on the three primary channels, 27 data bytes a frame, seen by every scanner
+  HMS_BLE_BROADCAST_EXTENDED                = 1,                                                                                            // ADV_EXT_IND pointing to an AUX_ADV_IND on a secondary channel, HMS_BLE_BROADCAST_DATA_LENGTH - 4 bytes (Bluetooth 5 scanners)
+  HMS_BLE_BROADCAST_PERIODIC                = 2,                                                                                            // Periodic train at a fixed interval without random delay, found once through the set's extended advertising
+} HMS_BLE_BroadcastMode;                                                                                                                    // See HMS_BLE::createBroadcast()
+
+typedef struct {
+  HMS_BLE_BroadcastMode mode;
+  uint16_t companyId;                                                                                                                       // Manufacturer data company identifier every frame carries
+  uint16_t interval;                                                                                                                        // Advertising interval, 0.625 ms units, 32 (20 ms) .. 16384 (10.24 s); PERIODIC: of the announcing extended advertising
+  uint16_t periodicInterval;                                                                                                                // PERIODIC: train interval, 1.25 ms units, 6 (7.5 ms) .. 65535
+  uint8_t phy;                                                                                                                              // EXTENDED/PERIODIC: HMS_BLE_Phy of the secondary channel packets, 0 = 1M; CODED puts the primary ones on coded too
+  uint16_t eventsPerFrame;                                                                                                                  // Advertising (PERIODIC: periodic) events a frame stays on air before the next one, >= 1
+} HMS_BLE_BroadcastParams;                                                                                                                  // One broadcast set (see HMS_BLE::createBroadcast())
+
+typedef struct {
+  uint32_t updates;                                                                                                                         // Frames handed to the stack, by rotation or because the frame on air changed
+  uint32_t rotations;                                                                                                                       // Frame switches made by the scheduler
+  uint32_t failed;                                                                                                                          // Hand-offs the stack refused
+  uint32_t bytes;                                                                                                                           // Advertising data bytes handed to the stack
+  uint8_t frame;                                                                                                                            // Frame on air now
+  uint8_t frames;                                                                                                                           // Frames in the rotation
+  bool running;
+} HMS_BLE_BroadcastStats;                                                                                                                   // Per-set broadcaster counters (HMS_BLE_BROADCAST_SETS)
+#endif
+#if defined(HMS_BLE_DESKTOP_SIM)
+  class HMS_BLE_VirtualCentral;
+  class HMS_BLE_VirtualScanner;
+  typedef std::function<void(const char* serviceUUID, const char* charUUID, const uint8_t* data, size_t length)> HMS_BLE_CentralNotificationCallback;
+  #if HMS_BLE_BROADCAST_SETS
+  typedef std::function<void(int set, HMS_BLE_BroadcastMode mode, const uint8_t* data, size_t length)> HMS_BLE_ScanReportCallback;          // data: the AD structures of one advertising event
+  #endif
+#endif
+
+typedef struct {
+  const HMS_BLE_ServiceEntry* services;                                                                                                     // Service entries in declaration order
+  const HMS_BLE_CharacteristicEntry* characteristics;                                                                                       // All characteristics, grouped by service
+  const uint8_t* characteristicCounts;                                                                                                      // Characteristics per service
+  size_t serviceCount;                                                                                                                      // Number of services
+  size_t attributeCount;                                                                                                                    // GATT attributes the schema needs (service/decl/value/CCC/CUD)
+} HMS_BLE_SchemaView;                                                                                                                       // Type-erased schema handed to HMS_BLE::beginSchema()
+
+template <size_t N>
+struct HMS_BLE_SchemaService {
+  HMS_BLE_ServiceEntry service;                                                                                                             // Service definition
+  HMS_BLE_CharacteristicEntry characteristics[N];                                                                                           // Characteristics for this service
+};                                                                                                                                          // Built by HMS_BLE_MakeService()
+
+template <size_t NS, size_t NC>
+struct HMS_BLE_Schema {
+  HMS_BLE_ServiceEntry services[NS];                                                                                                        // Service entries in declaration order
+  HMS_BLE_CharacteristicEntry characteristics[NC];                                                                                          // All characteristics, grouped by service
+  uint8_t characteristicCounts[NS];                                                                                                         // Characteristics per service
+  size_t attributeCount;                                                                                                                    // GATT attributes the schema needs
+
+  constexpr HMS_BLE_SchemaView view() const                        { return { services, characteristics, characteristicCounts, NS, attributeCount }; }
+};                                                                                                                                          // Built by HMS_BLE_MakeSchema(), lives in flash when declared constexpr
+
 
 /* BLE Module *//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class HMS_BLE {
@@ -214,12 +1152,45 @@ class HMS_BLE {
     HMS_BLE(const char* deviceName);
     ~HMS_BLE();
 
-    void loop();
+    void loop();                                                                                                                            // Handle pending events; the background task calls it when woken
+    HMS_BLE_TaskStats getTaskStats() const;                                                                                                 // Wakeups and event-to-handler latency
+    void resetTaskStats();                                                                                                                  // Zero the task counters
+    HMS_BLE_Stats getStats() const;                                                                                                         // Snapshot of the always-on counters, relaxed loads
+    HMS_BLE_CharStats getCharacteristicStats(HMS_BLE_CharHandle handle) const;                                                              // Zeroes for an invalid handle
+    void resetStats();                                                                                                                      // Zero these counters, the per-characteristic ones and the task counters
+    #if HMS_BLE_TRACE_DEPTH
+    size_t readTrace(HMS_BLE_TraceRecord* records, size_t capacity) const;                                                                  // Latest records, oldest first; records being written are skipped
+    size_t dumpTrace(uint8_t* buffer, size_t size) const;                                                                                   // HMS_BLE_TraceDumpHeader + readTrace(), bytes written (0 when size < header)
+    void clearTrace();                                                                                                                      // Start a new trace, sequence numbers restart at 1
+    #endif
+    #if HMS_BLE_LOG_DEFERRED
+    static void setLogHandler(HMS_BLE_LogHandler handler);                                                                                  // loop() formats pending records into it; without one they wait for flushLog()/dumpLog()
+    static size_t flushLog();                                                                                                               // Format pending records to the handler now, returns how many (0 without a handler)
+    static size_t dumpLog(uint8_t* buffer, size_t size);                                                                                    // HMS_BLE_LogDumpHeader + pending records, which are consumed; bytes written
+    #endif
     
+    // ========== Compile-time Schema API ==========
+    /*
+      Start from a constexpr HMS_BLE_Schema (see HMS_BLE_MakeSchema()). UUIDs were parsed and limits checked by the compiler,
+      the descriptors point straight into the schema and the attribute table is static, so begin() neither allocates nor parses.
+    */
+    template <const auto& Schema>
+    HMS_BLE_Status begin(bool backThread = true) {
+      #if defined(HMS_BLE_ZEPHYR_nRF)
+        constexpr ZephyrGattLayout layout = zephyrGattLayout(Schema.view());
+        alignas(void*) static uint8_t schemaArena[layout.size()];                                                                          // One GATT arena per schema, sized by the compiler
+        zephyrArena = schemaArena;
+        zephyrArenaSize = sizeof(schemaArena);
+      #endif
+      return beginSchema(Schema.view(), backThread);
+    }
+
+    #if HMS_BLE_RUNTIME_REGISTRATION
     // ========== Multi-Service API (New) ==========
     HMS_BLE_Status addService(const HMS_BLE_Service* service);                                                                              // Add a new service
     HMS_BLE_Status addCharacteristicToService(const char* serviceUUID, const HMS_BLE_Characteristic* characteristic);                      // Add characteristic to specific service
     HMS_BLE_Status begin(bool backThread = true);                                                                                           // Initialize all registered services
+    #endif
     HMS_BLE_Status setAdvertisedServices(const char** serviceUUIDs, size_t count);                                                          // Set which services to advertise (max ~31 bytes in adv packet)
     HMS_BLE_Status sendDataToService(const char* serviceUUID, const char* characteristicUUID, const uint8_t* data, size_t length);          // Send data to specific service/characteristic
     
@@ -230,100 +1201,639 @@ class HMS_BLE {
     void clearReceivedDataFromService(const char* serviceUUID);                                                                             // Clear received data flag for specific service
     size_t getServiceCount() const                                   { return serviceCount;                                    }
     size_t getCharacteristicCountForService(const char* serviceUUID) const;                                                                 // Get characteristic count for a specific service
+
+    // ========== Handle API (hot path, no UUID compares) ==========
+    /*
+      Resolve a service/characteristic pair once and reuse the handle for every send/check.
+      Handles are plain indices: they stay valid from begin() on, but removeCharacteristic() before begin() invalidates them.
+    */
+    HMS_BLE_CharHandle getCharacteristicHandle(const char* serviceUUID, const char* characteristicUUID) const;                              // Resolve a characteristic within a service
+    #if HMS_BLE_LEGACY_API
+    HMS_BLE_CharHandle getCharacteristicHandle(const char* characteristicUUID) const;                                                      // Legacy: first service with matching char
+    #endif
+    HMS_BLE_CharHandle getCharacteristicHandle(const HMS_BLE_UUID& serviceUUID, const HMS_BLE_UUID& characteristicUUID) const;            // Resolve from pre-parsed UUIDs
+    HMS_BLE_Status sendData(HMS_BLE_CharHandle handle, const uint8_t* data, size_t length);                                                 // Send data to a pre-resolved characteristic
+    HMS_BLE_Status sendData(HMS_BLE_CharHandle handle, const uint8_t* data, size_t length, HMS_BLE_SendCallback onSent);                    // Same, onSent runs once the stack sent it (only when SUCCESS is returned)
+    bool isSubscribed(HMS_BLE_CharHandle handle) const;                                                                                     // Any client has notifications/indications enabled
+    bool hasReceivedData(HMS_BLE_CharHandle handle) const;                                                                                  // Received flag of the handle's service
+    const uint8_t* getReceivedData(HMS_BLE_CharHandle handle) const;                                                                        // Received data of the handle's service
+    size_t getReceivedDataLength(HMS_BLE_CharHandle handle) const;                                                                          // Received data length of the handle's service
+    void clearReceivedData(HMS_BLE_CharHandle handle);                                                                                      // Clear received flag of the handle's service
+
+    #if HMS_BLE_RX_RING_DEPTH
+    // ========== Receive Rings ==========
+    /*
+      Every write from a central is pushed into the characteristic's ring by the BLE host context and popped here by the
+      application, lock-free, so bursts of commands are not lost and a value is never read half-written. The shared and
+      per-service buffers behind getReceivedData()/getReceivedDataFromService() are still filled for compatibility.
+    */
+    HMS_BLE_Status setReceiveMode(HMS_BLE_CharHandle handle, HMS_BLE_RxMode mode);                                                         // Queue or mailbox; clears the ring, call while no central is connected
+    bool receive(HMS_BLE_CharHandle handle, uint8_t* data, size_t* length);                                                                 // Oldest (queue) / newest (mailbox) write, *length is buffer size in / value size out
+    size_t getReceiveDepth(HMS_BLE_CharHandle handle) const;                                                                                // Writes waiting to be received
+    uint32_t getReceiveOverflows(HMS_BLE_CharHandle handle) const;                                                                          // Writes dropped (queue) or replaced unread (mailbox)
+    uint32_t getReceiveTruncations(HMS_BLE_CharHandle handle) const;                                                                        // Writes longer than HMS_BLE_MAX_DATA_LENGTH, received cut to it
+    #endif
+
+    #if HMS_BLE_INGEST_BYTES
+    // ========== Write Command Ingest ==========
+    /*
+      Writes to a WRITE_NR characteristic skip the write callbacks and the receive buffers: the BLE host context appends them to
+      one byte ring (length, handle, slot, payload) and returns, so the stack can deliver the next write command in the same
+      connection event. No lock and no allocation; when the ring is full the write is dropped and counted. The ring is read
+      in place: loop() (the background task when enabled) passes every record to the ingest callback, or processIngest()
+      does it on the caller's thread. Stream segments (receiveStream()) are still taken first.
+    */
+    void setIngestCallback(HMS_BLE_IngestCallback callback)          { ingestCallback = callback;                             }             // Set before begin(); the value is only valid during the call
+    size_t processIngest(size_t maxRecords = SIZE_MAX);                                                                                     // Hand pending writes to the ingest callback now, returns how many
+    size_t getIngestFill() const;                                                                                                           // Ring bytes in use
+    HMS_BLE_IngestStats getIngestStats() const;                                                                                             // Snapshot of the ingest counters
+    void resetIngestStats();                                                                                                                // Zero them
+    #endif
+
+    #if HMS_BLE_VALUE_CACHE
+    // ========== Value Cache ==========
+    /*
+      Every characteristic keeps its last value, updated by sendData() (all variants), setValue() and classic-path writes from a
+      central. Reads are answered from it without calling back into the application, unless the characteristic's policy is
+      HMS_BLE_READ_REFRESH. A long read (read + read blob) is served from one snapshot taken at offset 0, so a value updated in
+      between never comes back half old, half new. With setNotifyOnChange() a send identical to the cached value is skipped.
+    */
+    HMS_BLE_Status setValue(HMS_BLE_CharHandle handle, const uint8_t* data, size_t length);                                                 // Update the readable value without notifying
+    bool getValue(HMS_BLE_CharHandle handle, uint8_t* data, size_t* length) const;                                                          // Copy of the cached value, *length is buffer size in / value size out
+    HMS_BLE_Status setReadPolicy(HMS_BLE_CharHandle handle, HMS_BLE_ReadPolicy policy);                                                     // Cached (default) or refresh through the read callback
+    HMS_BLE_Status setNotifyOnChange(HMS_BLE_CharHandle handle, bool enabled);                                                              // Skip sends identical to the cached value
+    HMS_BLE_ValueCacheStats getValueCacheStats() const;                                                                                     // Snapshot of the cache counters
+    #endif
+
+    #if HMS_BLE_MAX_STREAMS
+    // ========== Streams ==========
+    /*
+      Blobs larger than one attribute value, cut into getMTU() - 3 byte notifications (see HMS_BLE_STREAM_FIRST for the segment
+      format). sendStream() only arms the transfer: loop() (the background task when enabled) sends segments back-to-back
+      until the stack runs out of TX buffers and resumes on the next pass. receiveStream() reassembles the next stream a central
+      writes to the characteristic into the caller's buffer; those writes do not reach the write callbacks.
+    */
+    HMS_BLE_Status sendStream(HMS_BLE_CharHandle handle, const uint8_t* data, size_t length, HMS_BLE_StreamCallback onComplete);         // data must stay valid until onComplete
+    HMS_BLE_Status receiveStream(HMS_BLE_CharHandle handle, uint8_t* buffer, size_t capacity, HMS_BLE_StreamCallback onComplete);         // One stream per call, re-arm from onComplete
+    bool isStreaming(HMS_BLE_CharHandle handle) const;                                                                                      // An outgoing stream is still in progress
+    #endif
+    uint16_t getMTU() const;                                                                                                                // Smallest negotiated ATT MTU among connected centrals (23 when none)
+
+    #if HMS_BLE_TX_CREDITS
+    // ========== TX Flow Control ==========
+    /*
+      At most HMS_BLE_TX_CREDITS notifications are in the stack at once, one per ACL TX buffer. A credit returns when the
+      controller reports the PDU sent (the onSent callback runs then, in the stack's TX context). With every credit in flight,
+      sendData() waits up to the send timeout for one to return and then fails with HMS_BLE_STATUS_ERROR_BUSY instead of
+      dropping the value. The notification queue and streams never wait: they resume as soon as a credit returns.
+    */
+    void setSendTimeout(uint32_t timeoutMs)                          { sendTimeoutMs = timeoutMs;                             }              // 0 (default): fail with ERROR_BUSY right away
+    HMS_BLE_TxStats getTxStats() const;                                                                                                     // Snapshot of the flow control counters
+    void resetTxStats();                                                                                                                    // Zero the counters (in-flight count is kept)
+    #endif
+
+    #if HMS_BLE_INDICATE_DEPTH
+    // ========== Indications ==========
+    /*
+      indicate() copies the value into a per-connection queue for every central that enabled indications on the characteristic
+      and returns. A link gets the next indication once the central confirmed the previous one, since ATT allows one outstanding
+      indication per bearer; the order (strict, or per characteristic) is set with setIndicationOrder(). onDone runs once per
+      link with SUCCESS and the round trip when the confirmation arrives, or with the error that ended the indication, from the
+      stack context. A link that misses the deadline gets ERROR_TIMEOUT for that indication and for everything queued behind it,
+      takes no further indications until it reconnects (ATT allows no more transactions after a timeout), and the timeout
+      callback runs so the application can drop it. Deadlines are checked by loop() (the background task when enabled).
+      sendData() on a characteristic that indicates but does not notify goes through the same queue.
+    */
+    HMS_BLE_Status indicate(HMS_BLE_CharHandle handle, const uint8_t* data, size_t length, HMS_BLE_IndicateCallback onDone = nullptr);      // ERROR_BUSY when a target queue is full (nothing queued), ERROR_NOT_CONNECTED without indicating centrals
+    void setIndicationOrder(HMS_BLE_IndicateOrder order)             { indicationOrder = order;                               }              // Applies from the next hand-off
+    void setIndicationTimeout(uint32_t timeoutMs)                    { indicationTimeoutMs = timeoutMs;                       }              // 0: wait for the stack to report the outcome
+    void setIndicationTimeoutCallback(HMS_BLE_IndicateTimeoutCallback callback) { indicationTimeoutCallback = callback;       }
+    size_t getPendingIndications(int slot) const;                                                                                           // Entries queued or in flight on a link
+    HMS_BLE_IndicationStats getIndicationStats() const;                                                                                     // Snapshot of the indication counters
+    void resetIndicationStats();                                                                                                            // Zero the counters (pending and in-flight counts are kept)
+    #endif
+
+    #if HMS_BLE_LINK_PROFILES
+    // ========== Link Profiles ==========
+    /*
+      A profile bundles a connection interval range, peripheral latency, supervision timeout, preferred PHY and LL data length.
+      It is requested when a central connects (the selector's choice, else the default profile) or later with
+      requestLinkProfile(). The central decides: every value the stack reports back is stored per connection and passed to the
+      link callback, from the stack context, one call per report. Send passes of the notification queue and of streams top
+      the stack up to two connection events' worth of notifications for the slowest link (less what HMS_BLE_TX_CREDITS says
+      is still in flight) and come back one interval later, so updates wait (and coalesce) in the library instead of in the
+      stack's buffers.
+    */
+    HMS_BLE_Status requestLinkProfile(int slot, HMS_BLE_LinkProfile profile);                                                               // ERROR_NOT_CONNECTED for a free slot, ERROR_PROTOCOL when the stack refused the request
+    HMS_BLE_Status setLinkProfileParams(HMS_BLE_LinkProfile profile, const HMS_BLE_LinkProfileParams& params);                              // Replace a profile's values, ERROR_PROTOCOL for DEFAULT or values the Core spec does not allow
+    HMS_BLE_LinkProfileParams getLinkProfileParams(HMS_BLE_LinkProfile profile) const;                                                      // Zeroes for DEFAULT or an unknown profile
+    void setDefaultLinkProfile(HMS_BLE_LinkProfile profile)          { defaultLinkProfile = profile;                          }              // Requested on every connect (default: DEFAULT, nothing)
+    void setLinkProfileSelector(HMS_BLE_LinkProfileSelector selector){ linkProfileSelector = selector;                        }              // Per central choice on connect, replaces the default
+    void setLinkCallback(HMS_BLE_LinkCallback callback)              { linkCallback = callback;                               }              // Connect-time values, every reported change and refused request
+    bool getLinkInfo(int slot, HMS_BLE_LinkInfo* info) const;                                                                               // Snapshot of a link, false when the slot is free
+    size_t getSendBatch() const;                                                                                                            // Notifications one send pass hands the stack, 0 = no connected link (no limit)
+    #endif
+    #if HMS_BLE_BROADCAST_SETS
+    // ========== Broadcaster ==========
+    /*
+      Connectionless telemetry: every set is a non-connectable, non-scannable advertiser of its own, running next to the
+      connectable one, so a reading reaches any number of scanners without a connection. A frame is application data sent
+      as manufacturer specific data under the set's company identifier, packed into its AD structure once when it is set.
+      A set rotates through its frames, each on air for eventsPerFrame events; loop() (the background task when enabled)
+      makes the switch. Setting the frame that is on air hands it to the stack at once, the set keeps advertising. The
+      application and loop() never talk to the stack for the same set at the same time: the one that finds the set busy
+      leaves the newest frame to the other.
+    */
+    HMS_BLE_Status createBroadcast(const HMS_BLE_BroadcastParams& params, int* set);                                                        // After begin(); ERROR_PROTOCOL for values the Core spec does not allow, ERROR_BUSY when every set is taken
+    HMS_BLE_Status setBroadcastFrame(int set, int frame, const uint8_t* data, size_t length);                                               // Length 0 takes the frame out of the rotation, ERROR_OVERFLOW past getBroadcastCapacity()
+    HMS_BLE_Status startBroadcast(int set);                                                                                                 // Puts the first frame on air, rotation starts
+    HMS_BLE_Status stopBroadcast(int set);                                                                                                  // Frames are kept for the next start
+    HMS_BLE_Status removeBroadcast(int set);                                                                                                // Stops the set and frees it with its frames
+    size_t getBroadcastCapacity(int set) const;                                                                                             // Data bytes a frame takes: 27 legacy, HMS_BLE_BROADCAST_DATA_LENGTH - 4 otherwise, 0 for a free set
+    HMS_BLE_BroadcastStats getBroadcastStats(int set) const;                                                                                // Zeroes for a free set
+    void resetBroadcastStats(int set);                                                                                                      // Zero the counters
+    #endif
+    #if HMS_BLE_NOTIFY_QUEUE
+    // ========== Notification Queue ==========
+    /*
+      With HMS_BLE_NOTIFY_QUEUE every send to a subscribed characteristic is stored as that characteristic's pending value and
+      sendData() returns immediately. loop() (the background task when enabled) drains the queue oldest-first; a characteristic
+      updated again before it went out keeps its place and only the newest value is sent. When the stack is out of TX buffers the
+      drain stops and resumes on the next loop(), so a burst degrades to "freshest value" instead of failed sends.
+    */
+    size_t getNotifyQueueDepth() const;                                                                                                     // Characteristics with a pending update
+    HMS_BLE_NotifyQueueStats getNotifyQueueStats() const;                                                                                   // Snapshot of the queue counters
+    void resetNotifyQueueStats();                                                                                                           // Zero the counters (depth is kept)
+    void flushNotifyQueue();                                                                                                                // Drain now instead of waiting for loop()
+    #endif
     
+
     // ========== Legacy Single-Service API (Backward Compatible) ==========
+    /*
+      One service whose characteristics are found by UUID alone, and one received-data buffer shared by every service.
+      HMS_BLE_LEGACY_API 0 removes these calls together with the flat characteristic array and the shared buffer; the
+      multi-service, handle and schema APIs cover all of them.
+    */
+    #if HMS_BLE_LEGACY_API
+    #if HMS_BLE_RUNTIME_REGISTRATION
     HMS_BLE_Status removeCharacteristic(const char* characteristicUUID);                                                                    // Remove from default service
     HMS_BLE_Status begin(const char* serviceUUID, bool backThread = true);                                                                  // Creates default service and initializes
     HMS_BLE_Status addCharacteristic(const HMS_BLE_Characteristic* characteristic);                                                         // Add to default service (auto-creates if needed)
+    #endif
     HMS_BLE_Status sendData(const char* characteristicUUID, const uint8_t* data, size_t length);                                            // Send data (uses first service with matching char)
-
-
-    bool isConnected() const                                         { return bleConnected;                                   }
     bool hasReceivedData() const                                     { return received;                                       }              // Legacy: checks shared buffer
     const uint8_t* getReceivedData() const                           { return data;                                           }              // Legacy: returns shared buffer
     size_t getReceivedDataLength() const                             { return dataLength;                                     }              // Legacy: returns shared buffer length
     size_t getCharacteristicCount() const                            { return getTotalCharacteristicCount();                  }              // Legacy: total across all services
+    #endif
+
+    bool isConnected() const                                         { return connectedCount.load() > 0;                      }
     uint8_t getMaxClients() const                                    { return HMS_BLE_MAX_CLIENTS;                            }
 
+    static constexpr bool parseUUID(const char* str, HMS_BLE_UUID* uuid);                                                                   // "181A", "0000181A", 128-bit with/without dashes; SIG base UUIDs are shortened
+    static size_t uuidToString(const HMS_BLE_UUID& uuid, char* buffer, size_t size);                                                       // Canonical upper-case form ("181A" or 8-4-4-4-12)
+
     void setReadCallback(HMS_BLE_ReadCallback callback)              { readCallback = callback;                               }
     void setWriteCallback(HMS_BLE_WriteCallback callback)            { writeCallback = callback;                              }
     void setNotifyCallback(HMS_BLE_NotifyCallback callback)          { notifyCallback = callback;                             }
-    void setManufacturerData(HMS_BLE_ManufacturerData data)          { manufacturerData = data; manufacturerDataSet = true;   }
+    void setManufacturerData(HMS_BLE_ManufacturerData data);                                                                                // Company identifier + 6 bytes, see Advertising
     void setConnectionCallback(HMS_BLE_ConnectionCallback callback)  { connectionCallback = callback;                         }
 
-    #if defined(HMS_BLE_ARDUINO_ESP32)
-      uint8_t getConnectedClients() const                            { return (bleServer != nullptr) ? bleServer->getConnectedCount() : 0; }
+    // ========== Advertising ==========
+    /*
+      Both legacy packets are packed into fixed 31-byte buffers at begin() and again only when an input changes. Packing
+      order: flags, then the advertised service UUIDs (setAdvertisedServices(), else the first service) as 16-, 32- and
+      128-bit lists, then manufacturer data and service data, and the device name last. Each goes into the advertising packet
+      while it has room and into the scan response after that. A list that fits in neither is cut and marked incomplete,
+      and a name that fits in neither is shortened. The update functions overwrite a value of the same length in place and
+      hand both packets to the running advertiser without stopping it. A value of another length re-packs first.
+    */
+    HMS_BLE_Status setManufacturerData(uint16_t companyId, const uint8_t* data, size_t length);                                             // ERROR_OVERFLOW when it fits in neither packet (nothing changes)
+    HMS_BLE_Status setServiceData(const char* serviceUUID, const uint8_t* data, size_t length);                                             // Service Data AD for any UUID width, same rules
+    HMS_BLE_Status updateManufacturerData(const uint8_t* data, size_t length);                                                              // Live value change, keeps the company identifier
+    HMS_BLE_Status updateServiceData(const uint8_t* data, size_t length);                                                                   // Live value change, keeps the UUID
+    HMS_BLE_AdvPayload getAdvertisingPayload() const;                                                                                       // Snapshot of both packets and where the values went
+
+    // ========== Zero-copy Callbacks ==========
+    /*
+      Setting one of these replaces the copying path for that direction. A write view points into the stack's buffer (no copy
+      into the per-service/legacy buffers, which stay untouched, so hasReceivedData() does not see these writes; the receive ring
+      is still filled when enabled). A read-into callback fills the response buffer itself, up to the negotiated MTU - 1 bytes,
+      instead of a HMS_BLE_MAX_DATA_LENGTH scratch array. Values longer than one read response are not continued by read blob.
+    */
+    void setWriteViewCallback(HMS_BLE_WriteViewCallback callback)    { writeViewCallback = callback;                          }
+    void setReadIntoCallback(HMS_BLE_ReadIntoCallback callback)      { readIntoCallback = callback;                           }
+
+    // ========== Connections ==========
+    /*
+      One slot per connected central, taken on connect and freed on disconnect. Stack callbacks find their slot through a
+      hash index on the connection handle, so the lookup cost does not grow with HMS_BLE_MAX_CLIENTS. A slot number stays the
+      same for the life of its connection.
+    */
+    uint8_t getConnectedClients() const                              { return connectedCount.load();                          }
+    int findConnection(uint16_t connHandle) const;                                                                                          // Slot of a connection handle, -1 when not connected
+    bool getConnection(uint8_t slot, HMS_BLE_Connection* connection) const;                                                                // Snapshot of a slot, false when it is free
+
+    #if defined(HMS_BLE_DESKTOP_SIM)
+      bool isAdvertising() const                                     { return desktopAdvertising.load();                      }
+      uint32_t getAdvertisingStarts() const                          { return desktopAdvertisingStarts.load();                }              // Advertiser (re)starts since begin(), live updates do not count
+      #if HMS_BLE_BROADCAST_SETS
+      uint32_t getBroadcastEvents(int set) const;                                                                                           // Advertising events the virtual controller ran for a set
+      #endif
     #endif
 
   private:
+    struct ConnectionSlot {
+      uint16_t                  connHandle                                        = HMS_BLE_CONN_HANDLE_NONE;
+      uint8_t                   address[6];
+      uint16_t                  mtu;
+      uint16_t                  interval;
+      uint16_t                  latency;
+      uint16_t                  supervisionTimeout;
+      uint32_t                  subscriptions[HMS_BLE_SUBSCRIPTION_WORDS];
+      std::atomic<uint32_t>     notificationsSent{0};                                                                                       // Counters are bumped from the stack and the senders
+      std::atomic<uint32_t>     bytesSent{0};
+      std::atomic<uint32_t>     writesReceived{0};
+      std::atomic<uint32_t>     bytesReceived{0};
+      std::atomic<uint32_t>     readsServed{0};
+      #if HMS_BLE_LINK_PROFILES
+      HMS_BLE_LinkProfile       profile;                                                                                                    // See HMS_BLE_LinkInfo
+      uint8_t                   txPhy;
+      uint8_t                   rxPhy;
+      uint16_t                  txOctets;
+      uint16_t                  rxOctets;
+      std::atomic<uint8_t>      notificationsPerEvent{1};                                                                                   // Read by the senders (and the simulated link) without the stack lock
+      #endif
+    };                                                                                                                                      // Connection table entry, see HMS_BLE_Connection
+
+    // Connection table
+    ConnectionSlot              connections[HMS_BLE_MAX_CLIENTS];                                                                           // Indexed by slot
+    uint8_t                     connectionIndex[HMS_BLE_ConnectionIndexSize()];                                                             // Open addressing on connHandle -> slot, 0xFF empty
+    std::atomic<uint8_t>        connectedCount{0};                                                                                          // Slots in use
+
+    int openConnection(uint16_t connHandle, const uint8_t* address);                                                                        // Take a slot on connect, -1 when the table is full
+    void closeConnection(int slot, uint8_t reason);                                                                                         // Free a slot and drop its subscriptions, reason is the HCI code
+    void setSubscribed(int slot, int serviceIndex, int charIndex, bool enabled, bool indicate = false);                                     // Keeps both bitsets (per characteristic, per connection) in step, indicate: CCC indication bit
+    bool isSubscribed(int slot, int serviceIndex, int charIndex) const { return services[serviceIndex].subscribers[charIndex][slot / 32] & (1u << (slot % 32)); }
+    #if HMS_BLE_INDICATE_DEPTH
+    bool isIndicating(int slot, int serviceIndex, int charIndex) const { return services[serviceIndex].indicators[charIndex][slot / 32] & (1u << (slot % 32)); }
+    #else
+    bool isIndicating(int, int, int) const                           { return false;                                          }
+    #endif
+    bool hasSubscribers(int serviceIndex, int charIndex) const;
+    static int takeLowestSlot(uint32_t* links);                                                                                             // Clear and return the lowest set slot of a bitset, -1 when empty
+    void updateConnectionParams(int slot, uint16_t interval, uint16_t latency, uint16_t supervisionTimeout);
+    void updateConnectionMTU(int slot, uint16_t mtu);
+    void countLinkSend(int slot, size_t length);
+    void countLinkWrite(int slot, int serviceIndex, int charIndex, size_t length);                                                          // Also feeds the characteristic counters
+    void countLinkRead(int slot, int serviceIndex, int charIndex);
+
+    #if HMS_BLE_LINK_PROFILES
+    HMS_BLE_LinkProfileParams   linkProfiles[HMS_BLE_LINK_PROFILE_COUNT];                                                                   // Indexed by HMS_BLE_LinkProfile, DEFAULT stays zero
+    HMS_BLE_LinkProfile         defaultLinkProfile                                = HMS_BLE_LINK_PROFILE_DEFAULT;                           // See setDefaultLinkProfile()
+    HMS_BLE_LinkProfileSelector linkProfileSelector;
+    HMS_BLE_LinkCallback        linkCallback;
+    std::atomic<uint16_t>       sendBatch{0};                                                                                               // Two connection events of the slowest link, 0 without links
+    std::atomic<uint16_t>       sendPaceMs{0};                                                                                              // Shortest connection interval among the links, ms (at least 1)
+
+    void applyLinkProfile(int slot);                                                                                                        // Backend connect path: request the selector's (or the default) profile
+    void updateLinkPhy(int slot, uint8_t txPhy, uint8_t rxPhy);                                                                             // HMS_BLE_Phy bits
+    void updateLinkDataLength(int slot, uint16_t txOctets, uint16_t rxOctets);
+    void reportLink(int slot, uint8_t changed, HMS_BLE_Status status);                                                                      // Re-estimate the link, refresh the send batch, trace and call the link callback
+    void refreshSendBatch();                                                                                                                // Minimum over the connected links
+    bool linkMatches(const ConnectionSlot& link) const;                                                                                     // Negotiated values satisfy the link's requested profile
+    static uint8_t linkNotificationsPerEvent(uint16_t interval, uint8_t txPhy, uint8_t rxPhy, uint16_t txOctets, uint16_t mtu);             // Air time model, see reportLink()
+    size_t sendBudget() const;                                                                                                              // Sends allowed in one pass, SIZE_MAX without links
+    uint32_t sendRetryMs() const;                                                                                                           // Background task re-check while sends wait: one connection interval
+    HMS_BLE_Status requestLinkInternal(int slot, const HMS_BLE_LinkProfileParams& params);                                                  // Backend: ask the stack, the outcome comes back through the update functions
+    #else
+    size_t sendBudget() const                                        { return SIZE_MAX;                                       }
+    uint32_t sendRetryMs() const                                     { return HMS_BLE_NOTIFY_RETRY_MS;                        }
+    #endif
+    #if HMS_BLE_BROADCAST_SETS
+    struct BroadcastSet {
+      HMS_BLE_BroadcastParams   params;
+      uint8_t                   frames[HMS_BLE_BROADCAST_FRAMES][HMS_BLE_BROADCAST_DATA_LENGTH];                                            // Packed manufacturer data AD structure per frame
+      uint8_t                   frameLengths[HMS_BLE_BROADCAST_FRAMES];                                                                     // 0 = not in the rotation
+      uint8_t                   frame;                                                                                                      // On air, or next to go on air while stopped
+      uint32_t                  nextRotation;                                                                                               // eventClockMicros() of the next switch
+      bool                      used;
+      std::atomic<bool>         running{false};
+      std::atomic<bool>         handing{false};                                                                                             // A thread is talking to the stack for this set
+      std::atomic<bool>         stale{false};                                                                                               // The frame on air changed since the last hand-off
+      std::atomic<uint32_t>     updates{0};                                                                                                 // See HMS_BLE_BroadcastStats
+      std::atomic<uint32_t>     rotations{0};
+      std::atomic<uint32_t>     failed{0};
+      std::atomic<uint32_t>     bytes{0};
+    };                                                                                                                                      // Frames and rotation state are guarded by lockAdvertising()
+    BroadcastSet                broadcastSets[HMS_BLE_BROADCAST_SETS];
+
+    void rotateBroadcasts();                                                                                                                // loop(): switch the sets whose frame time ran out
+    uint32_t broadcastWaitMs() const;                                                                                                       // Background task: ms to the next switch, 0 when nothing rotates
+    void publishBroadcast(int set);                                                                                                         // Hand the set's current frame to the stack, or leave it to the thread already doing so
+    HMS_BLE_Status handBroadcast(int set);                                                                                                  // Snapshot the frame on air and hand it to the stack, with the counters and trace
+    void claimBroadcast(int set);                                                                                                           // Wait until no hand-off runs for the set and keep others out, releaseBroadcast() undoes it
+    void releaseBroadcast(int set);
+    static uint32_t broadcastFrameUs(const HMS_BLE_BroadcastParams& params);                                                                // How long a frame stays on air, with the 5 ms mean advDelay of non-periodic events
+    HMS_BLE_Status createBroadcastInternal(int set, const HMS_BLE_BroadcastParams& params);                                                 // Backend: create a non-connectable set, ERROR_PROTOCOL for a mode the controller lacks
+    HMS_BLE_Status setBroadcastDataInternal(int set, const uint8_t* data, size_t length);                                                   // Backend: advertising (PERIODIC: periodic) data, also while the set runs
+    HMS_BLE_Status startBroadcastInternal(int set);
+    HMS_BLE_Status stopBroadcastInternal(int set);
+    void removeBroadcastInternal(int set);
+    #endif
     // Service management
     HMS_BLE_ServiceDescriptor   services[HMS_BLE_MAX_SERVICES];                                                                             // Array of service descriptors
     size_t                      serviceCount;                                                                                               // Number of registered services
-    const char*                 advertisedServices[HMS_BLE_MAX_SERVICES];                                                                   // Services to advertise
+    uint8_t                     advertisedServices[HMS_BLE_MAX_SERVICES];                                                                   // Indices of services to advertise
     size_t                      advertisedServiceCount;                                                                                     // Number of services to advertise
-    bool                        defaultServiceCreated;                                                                                      // Flag for backward compatibility
+    #if HMS_BLE_RUNTIME_REGISTRATION
+    HMS_BLE_ServiceEntry        runtimeServices[HMS_BLE_MAX_SERVICES];                                                                      // Backing store for addService()
+    HMS_BLE_CharacteristicEntry runtimeCharacteristics[HMS_BLE_MAX_SERVICES][HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                      // Backing store for addCharacteristicToService()
+    #endif
     
+    #if HMS_BLE_LEGACY_API
     // Legacy shared buffer (for backward compatibility)
     char                        serviceUUID[40];                                                                                            // Legacy: single service UUID
     bool                        received;                                                                                                   // Legacy: shared received flag
     size_t                      dataLength;                                                                                                 // Legacy: shared data length
     uint8_t                     data[HMS_BLE_MAX_DATA_LENGTH];                                                                              // Legacy: shared data buffer
+    #if HMS_BLE_RUNTIME_REGISTRATION
+    bool                        defaultServiceCreated;                                                                                      // Flag for backward compatibility
     size_t                      characteristicCount;                                                                                        // Legacy: kept for compatibility
     HMS_BLE_Characteristic      characteristics[HMS_BLE_MAX_CHARACTERISTICS];                                                               // Legacy: flat array (kept for compatibility)
+    #endif
+    #endif
     
     // Common state
-    bool                        bleConnected;
     bool                        oldConnected;
-    bool                        manufacturerDataSet;
     bool                        backgroundProcess;
     bool                        bleInitialized;
     uint8_t                     deviceAddress[6];
     const char*                 deviceName;
     static HMS_BLE              *instance;
-    HMS_BLE_ManufacturerData    manufacturerData;
 
     HMS_BLE_ReadCallback        readCallback;
     HMS_BLE_WriteCallback       writeCallback;
     HMS_BLE_NotifyCallback      notifyCallback;
     HMS_BLE_ConnectionCallback  connectionCallback;
+    HMS_BLE_WriteViewCallback   writeViewCallback;
+    HMS_BLE_ReadIntoCallback    readIntoCallback;
+
+    // Advertising payload
+    uint8_t                     advManufacturerValue[HMS_BLE_ADV_PACKET_LENGTH - 4];                                                        // Value after the company identifier, AD header included in the 31 bytes
+    uint8_t                     advServiceDataValue[HMS_BLE_ADV_PACKET_LENGTH - 4];
+    uint8_t                     advManufacturerLength;                                                                                      // 0 = no manufacturer data
+    uint8_t                     advServiceDataLength;                                                                                       // 0 = no service data
+    uint16_t                    advCompanyId;
+    HMS_BLE_UUID                advServiceDataUUID;
+    HMS_BLE_AdvPayload          advPayload;                                                                                                 // What the stack advertises, read under lockAdvertising()
+    #if defined(HMS_BLE_ARDUINO_ESP32)
+      mutable portMUX_TYPE      advertisingMux                                    = portMUX_INITIALIZER_UNLOCKED;
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+      mutable struct k_spinlock advertisingSpinlock;
+      mutable k_spinlock_key_t  advertisingKey;
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+      mutable std::mutex        advertisingMutex;
+    #endif
+
+    void lockAdvertising() const;
+    void unlockAdvertising() const;
+    void buildAdvertising(HMS_BLE_AdvPayload* payload) const;                                                                               // Pack the current inputs
+    HMS_BLE_Status packAdvertising(uint8_t required);                                                                                       // Build, and publish unless a required HMS_BLE_AdvFit bit came up; pushes it live after begin()
+    HMS_BLE_Status writeAdvertisingValue(bool manufacturer, const uint8_t* data, size_t length, bool repack);                               // Shared by the set/update functions: in place when it can, else re-pack
+    HMS_BLE_Status updateAdvertisingInternal();                                                                                             // Backend: hand advPayload to the running advertiser, keep it for the next start otherwise
 
     void stop();
     HMS_BLE_Status init();
+    HMS_BLE_Status beginSchema(const HMS_BLE_SchemaView& schema, bool backThread);
     void restartAdvertising();
     void bleDelay(uint32_t ms);
+
+    // Background task events
+    std::atomic<uint32_t>       pendingEvents{0};                                                                                           // HMS_BLE_Event bits raised since the last loop()
+    std::atomic<uint32_t>       pendingEventTime{0};                                                                                        // eventClockMicros() of the oldest pending event
+    std::atomic<uint32_t>       taskWakeups{0};                                                                                             // See HMS_BLE_TaskStats
+    std::atomic<uint32_t>       taskHandled{0};
+    std::atomic<uint32_t>       taskLastLatencyUs{0};
+    std::atomic<uint32_t>       taskMaxLatencyUs{0};
+    std::atomic<uint32_t>       taskTotalLatencyUs{0};
+
+    // Always-on statistics
+    struct CharCounters {
+      std::atomic<uint32_t>     notifications{0};                                                                                           // See HMS_BLE_CharStats
+      std::atomic<uint32_t>     indications{0};
+      std::atomic<uint32_t>     bytesSent{0};
+      std::atomic<uint32_t>     reads{0};
+      std::atomic<uint32_t>     writes{0};
+      std::atomic<uint32_t>     bytesWritten{0};
+    };
+    CharCounters                charCounters[HMS_BLE_MAX_SERVICES][HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];
+    std::atomic<uint32_t>       statConnections{0};                                                                                         // See HMS_BLE_Stats
+    std::atomic<uint32_t>       statRefusedConnections{0};
+    std::atomic<uint32_t>       statDisconnections{0};
+    std::atomic<uint32_t>       statDisconnectReasons[HMS_BLE_DISCONNECT_REASON_COUNT] = {};
+    std::atomic<uint8_t>        statLastDisconnectReason{0};
+    std::atomic<uint32_t>       statSendErrors[HMS_BLE_STATUS_COUNT] = {};
+    std::atomic<uint32_t>       statCoalesced{0};
+    std::atomic<uint32_t>       statDropped{0};
+
+    // Binary trace
+    #if HMS_BLE_TRACE_DEPTH
+    struct TraceSlot {
+      std::atomic<uint32_t>     sequence{0};                                                                                                // Absolute record number, 0 while the slot is being written
+      std::atomic<uint32_t>     timestamp{0};
+      std::atomic<uint32_t>     where{0};                                                                                                   // handle | length << 16
+      std::atomic<uint32_t>     what{0};                                                                                                    // event | slot << 8 | status << 16
+    };
+    TraceSlot                   traceRing[HMS_BLE_TRACE_DEPTH];
+    std::atomic<uint32_t>       traceHead{0};                                                                                               // Records claimed since start, a writer owns slot (n - 1) % depth
+    std::atomic<uint32_t>       traceBase{0};                                                                                               // traceHead at the last clearTrace()
+
+    void trace(HMS_BLE_TraceEventId event, int slot, uint16_t handle, uint32_t length, int32_t status);                                     // Any context, lock-free
+    bool copyTraceRecord(uint32_t sequence, HMS_BLE_TraceRecord* record) const;                                                             // False when that record is being written or was overwritten
+    uint32_t firstTraceSequence(uint32_t head, size_t capacity) const;                                                                      // Oldest record number a read of capacity records starts at
+    #else
+    void trace(HMS_BLE_TraceEventId, int, uint16_t, uint32_t, int32_t) {}                                                                   // Compiled out
+    #endif
+
+    HMS_BLE_Status stackSend(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_SendCallback* done = nullptr);// sendDataInternal() plus counters, every core send goes through it
+    uint32_t taskStackFree() const;                                                                                                         // Backend: unused bytes of the background task stack, 0 when unknown
+
+    void signalEvent(uint32_t events);                                                                                                      // Any context: record events and wake the background task
+    void waitForEvents(uint32_t timeoutMs);                                                                                                 // Background task: block until an event (0 = no timeout)
+    void backgroundStep();                                                                                                                  // One wait + loop() iteration of the background task
+    static uint32_t eventClockMicros();
+    #if HMS_BLE_LOG_DEFERRED
+    friend void HMS_BLE_LogCommit(const HMS_BLE_LogSite* site, const uint8_t* payload, size_t length);                                      // Timestamps with eventClockMicros()
+    #endif
     
     // Service lookup helpers
     int findServiceIndex(const char* serviceUUID) const;
+    int findServiceIndex(const HMS_BLE_UUID& serviceUUID) const;
     int findCharacteristicInService(int serviceIndex, const char* charUUID) const;
+    int findCharacteristicInService(int serviceIndex, const HMS_BLE_UUID& charUUID) const;
+    #if HMS_BLE_LEGACY_API
     int findCharacteristicIndex(const char* uuid) const;                                                                                    // Legacy: finds across all services
+    #endif
     size_t getTotalCharacteristicCount() const;                                                                                             // Get total characteristics across all services
-    HMS_BLE_Status sendDataInternal(int serviceIndex, int charIndex, const uint8_t* data, size_t length);
+    static inline HMS_BLE_CharHandle encodeHandle(int serviceIndex, int charIndex) {
+      return HMS_BLE_CharHandle{(uint16_t)((serviceIndex << 8) | charIndex)};
+    }
+    inline bool decodeHandle(HMS_BLE_CharHandle handle, int* serviceIndex, int* charIndex) const {
+      int s = handle.id >> 8, c = handle.id & 0xFF;
+      if(s >= (int)serviceCount || c >= (int)services[s].characteristicCount) return false;
+      *serviceIndex = s;
+      *charIndex = c;
+      return true;
+    }
+    HMS_BLE_Status sendDataInternal(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_SendCallback* done = nullptr);  // Backend, never blocks: ERROR_BUSY when out of TX buffers
+    HMS_BLE_Status submitData(int serviceIndex, int charIndex, const uint8_t* data, size_t length);                                         // Queue or send, depending on HMS_BLE_NOTIFY_QUEUE
+    HMS_BLE_Status sendWithBackpressure(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_SendCallback* done); // Application sends: wait up to the send timeout for a credit
+    void storeReceivedData(int serviceIndex, int charIndex, const uint8_t* data, size_t length);                                            // Host context: receive ring + compatibility buffers
+    void deliverWriteView(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const uint8_t* deviceMac);                   // Host context: receive ring + writeViewCallback, no copies
+    size_t deliverReadInto(int serviceIndex, int charIndex, uint8_t* buffer, size_t capacity, const uint8_t* deviceMac);                    // Host context: readIntoCallback fills the response
 
-    #if defined(HMS_BLE_ZEPHYR_nRF)
-      size_t                        zephyrAttrCount;                                                                                        // Number of attributes
-      struct bt_gatt_attr           *zephyrGattAttrs;                                                                                       // GATT attributes array
-      struct bt_gatt_service        *zephyrGattService;                                                                                     // GATT service structure
-      
-      bool                          zephyrServiceUUID16;                                                                                    // true if service UUID is 16-bit
-      uint16_t                      zephyrServiceUUID16Val;                                                                                 // 16-bit service UUID value
-      struct bt_uuid_16             zephyrServiceUUID16Struct;                                                                              // 16-bit service UUID structure 
-      struct bt_uuid_128            zephyrServiceUUID;                                                                                      // Full 128-bit service UUID structure
-      
-      bool                          zephyrCharUUID16[HMS_BLE_MAX_CHARACTERISTICS];                                                          // true if char UUID is 16-bit
-      struct bt_uuid_128            zephyrCharUUIDs[HMS_BLE_MAX_CHARACTERISTICS];                                                           // Full 128-bit char UUID structures
-      struct bt_uuid_16             zephyrCharUUID16Structs[HMS_BLE_MAX_CHARACTERISTICS];                                                   // 16-bit char UUID structures
-      
-      struct bt_gatt_chrc           zephyrCharDeclarations[HMS_BLE_MAX_CHARACTERISTICS];                                                    // Characteristic Declarations (needed for bt_gatt_attr_read_chrc)
+    #if HMS_BLE_VALUE_CACHE
+      std::atomic<uint32_t>     cacheCachedReads{0};                                                                                        // See HMS_BLE_ValueCacheStats
+      std::atomic<uint32_t>     cacheRefreshedReads{0};
+      std::atomic<uint32_t>     cacheUnchangedSkipped{0};
+      #if defined(HMS_BLE_ARDUINO_ESP32)
+        mutable portMUX_TYPE    valueCacheMux                                     = portMUX_INITIALIZER_UNLOCKED;
+      #elif defined(HMS_BLE_ZEPHYR_nRF)
+        mutable struct k_spinlock valueCacheSpinlock;
+        mutable k_spinlock_key_t valueCacheKey;
+        uint8_t                 zephyrReadSnapshot[HMS_BLE_MAX_DATA_LENGTH];                                                                // Value served across the offsets of one long read
+        uint16_t                zephyrReadSnapshotLength;
+        uint16_t                zephyrReadSnapshotHandle                          = 0xFFFF;                                                 // Characteristic the snapshot belongs to
+      #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        mutable std::mutex      valueCacheMutex;
+      #endif
 
-      char                          zephyrCharUserDesc[HMS_BLE_MAX_CHARACTERISTICS][64];                                                    // User Description string storage
-      struct bt_gatt_cpf            zephyrCharCpf[HMS_BLE_MAX_CHARACTERISTICS];                                                             // User Description Descriptors (CUD) Optional: Presentation Format
-      
-      struct bt_conn                *zephyrConnection;                                                                                      // Connection tracking
+      void lockValueCache() const;
+      void unlockValueCache() const;
+      bool updateCachedValue(int serviceIndex, int charIndex, const uint8_t* data, size_t length);                                         // true when the value changed
+      size_t readCachedValue(int serviceIndex, int charIndex, uint8_t* data, size_t capacity) const;                                       // Consistent copy, returns the length
+      void storeValue(int serviceIndex, int charIndex, const uint8_t* data, size_t length);                                                // Cache + the stack's attribute value
+      void refreshCachedValue(int serviceIndex, int charIndex, const uint8_t* deviceMac);                                                  // HMS_BLE_READ_REFRESH: ask the read callback
+      void beginCachedRead(int serviceIndex, int charIndex, const uint8_t* deviceMac);                                                     // Host context, offset 0 of a read: refresh per policy, count
+    #endif
 
-      k_tid_t                       zephyrBleThreadId;
-      struct k_thread               zephyrBleThread;
-      k_thread_stack_t              *zephyrBleThreadStack;
-      
+    #if HMS_BLE_MAX_STREAMS
+      HMS_BLE_Stream            streams[HMS_BLE_MAX_STREAMS];                                                                               // Stream slots, bound to a characteristic on first use
+      uint8_t                   streamSegment[HMS_BLE_ATT_MAX_VALUE_LENGTH];                                                                // Segment being built by pumpStreams()
+
+      HMS_BLE_Stream* findStream(HMS_BLE_CharHandle handle, bool bind);
+      bool consumeStreamSegment(int serviceIndex, int charIndex, const uint8_t* data, size_t length);                                      // Host context: true when the write belonged to a stream
+      void pumpStreams();                                                                                                                   // loop(): send segments until done or out of TX buffers
+    #else
+      bool consumeStreamSegment(int, int, const uint8_t*, size_t)    { return false;                                          }
+    #endif
+
+    #if HMS_BLE_INGEST_BYTES
+      alignas(4) uint8_t        ingestRing[HMS_BLE_INGEST_BYTES];                                                                           // Records of 8 header bytes + payload, padded to 8
+      std::atomic<uint32_t>     ingestHead{0};                                                                                              // Bytes written since start (host context)
+      std::atomic<uint32_t>     ingestTail{0};                                                                                              // Bytes consumed since start (whoever holds ingestDraining)
+      std::atomic<uint32_t>     ingestReceived{0};
+      std::atomic<uint32_t>     ingestBytes{0};
+      std::atomic<uint32_t>     ingestDropped{0};
+      std::atomic<uint32_t>     ingestDroppedBytes{0};
+      std::atomic<uint32_t>     ingestMaxFill{0};
+      std::atomic_flag          ingestDraining = ATOMIC_FLAG_INIT;                                                                          // One consumer at a time: loop() or processIngest()
+      HMS_BLE_IngestCallback    ingestCallback;
+
+      bool consumeIngestWrite(int slot, int serviceIndex, int charIndex, const uint8_t* data, size_t length);                               // Host context: true when the write went to (or was dropped by) the ingest ring
+    #else
+      bool consumeIngestWrite(int, int, int, const uint8_t*, size_t) { return false;                                          }
+    #endif
+
+    #if HMS_BLE_TX_CREDITS
+      HMS_BLE_TxSlot            txSlots[HMS_BLE_TX_CREDITS];                                                                                // One per credit, guarded by the TX lock
+      size_t                    txFree;                                                                                                     // Credits not in flight
+      HMS_BLE_TxStats           txStats;                                                                                                    // Counters, guarded by the TX lock
+      uint32_t                  sendTimeoutMs                                     = 0;                                                      // See setSendTimeout()
+      std::atomic<bool>         txWaiting{false};                                                                                           // A send was refused, the next completion wakes the background task
+      #if defined(HMS_BLE_ZEPHYR_nRF)
+        mutable struct k_spinlock txSpinlock;
+        mutable k_spinlock_key_t txKey;
+        struct k_sem            zephyrTxDoneSem;                                                                                            // Given on every returned credit, taken by waitForTxCredit()
+        std::atomic<int32_t>    zephyrRetryToken{-1};                                                                                       // Partly refused send still owed to some links, -1 none, -2 claimed; set under the TX lock
+        uint32_t                zephyrRetryLinks[HMS_BLE_CLIENT_WORDS];                                                                     // Links that refused it for want of an ACL buffer
+        uint16_t                zephyrRetryHandle;
+        uint16_t                zephyrRetryLength;
+        uint8_t                 zephyrRetryValue[HMS_BLE_ATT_MAX_VALUE_LENGTH];                                                             // Copy of the value, the links that took it have theirs in an ACL buffer
+      #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        mutable std::mutex      txMutex;
+        std::condition_variable txCondition;                                                                                                // Notified on every returned credit
+      #endif
+
+      void lockTx() const;
+      void unlockTx() const;
+      int32_t acquireTxCredit(HMS_BLE_CharHandle handle, const HMS_BLE_SendCallback* done, const uint32_t* links);                         // Backend: token, or -1 with every credit in flight
+      void completeTx(int32_t token, HMS_BLE_Status status, int link);                                                                      // Stack TX context: the PDU on one link finished
+      void cancelTxCredit(int32_t token);                                                                                                   // The stack refused the PDU, return the credit silently
+      void abortTx(HMS_BLE_Status status, int link = -1);                                                                                   // Link lost (-1: all links): fail its PDUs in flight
+      bool waitForTxCredit(uint32_t timeoutMs);                                                                                             // Block until a credit returns, false on timeout
+    #endif
+
+    #if HMS_BLE_NOTIFY_QUEUE
+      uint16_t                  notifyQueue[HMS_BLE_MAX_CHARACTERISTICS];                                                                   // FIFO of handle ids, each characteristic at most once
+      size_t                    notifyQueueHead;                                                                                            // Index of the oldest entry
+      size_t                    notifyQueueCount;                                                                                           // Entries in the FIFO
+      bool                      notifyQueueDraining;                                                                                        // A drain pass is in progress
+      HMS_BLE_NotifyQueueStats  notifyQueueStats;                                                                                           // Counters, guarded by the queue lock
+      #if defined(HMS_BLE_ARDUINO_ESP32)
+        mutable portMUX_TYPE    notifyQueueMux                                    = portMUX_INITIALIZER_UNLOCKED;
+      #elif defined(HMS_BLE_ZEPHYR_nRF)
+        mutable struct k_spinlock notifyQueueSpinlock;
+        mutable k_spinlock_key_t notifyQueueKey;
+      #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        mutable std::mutex      notifyQueueMutex;
+      #endif
+
+      void lockNotifyQueue() const;
+      void unlockNotifyQueue() const;
+      void drainNotifyQueue();
+    #endif
+
+    #if HMS_BLE_INDICATE_DEPTH
+      struct IndicationLink {
+        HMS_BLE_Indication      entries[HMS_BLE_INDICATE_DEPTH];
+        uint32_t                nextSequence;                                                                                               // Sequence of the next entry queued on this link
+        uint16_t                lastHandle;                                                                                                 // Characteristic handed off last (per-characteristic turns)
+        uint8_t                 queued;                                                                                                     // Entries waiting for their turn
+        uint8_t                 inFlight;                                                                                                   // Entries with the stack
+        bool                    stalled;                                                                                                    // Missed a deadline: nothing more goes out until the link reconnects
+        bool                    retry;                                                                                                      // The stack had no buffer, loop() tries again
+        bool                    pumping;                                                                                                    // pumpIndications() is handing off entries of this link, other callers leave it the work
+      };                                                                                                                                    // Indication queue of one connection slot
+      IndicationLink            indicationLinks[HMS_BLE_MAX_CLIENTS];                                                                       // Guarded by the indication lock
+      HMS_BLE_IndicationStats   indicationStats;                                                                                            // Counters, guarded by the indication lock
+      HMS_BLE_IndicateOrder     indicationOrder                                   = HMS_BLE_INDICATE_IN_ORDER;                              // See setIndicationOrder()
+      uint32_t                  indicationTimeoutMs                               = HMS_BLE_INDICATE_TIMEOUT_MS;                            // See setIndicationTimeout()
+      HMS_BLE_IndicateTimeoutCallback indicationTimeoutCallback;
+      #if defined(HMS_BLE_ARDUINO_ESP32)
+        mutable portMUX_TYPE    indicationMux                                     = portMUX_INITIALIZER_UNLOCKED;
+      #elif defined(HMS_BLE_ZEPHYR_nRF)
+        mutable struct k_spinlock indicationSpinlock;
+        mutable k_spinlock_key_t indicationKey;
+      #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        mutable std::mutex      indicationMutex;
+      #endif
+
+      void lockIndications() const;
+      void unlockIndications() const;
+      HMS_BLE_Status queueIndication(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_IndicateCallback* done);   // Copy into every indicating link's queue and start them
+      int nextIndication(const IndicationLink& link) const;                                                                                 // Entry allowed to go out next under the current order, -1 when none (lock held)
+      void pumpIndications(int slot);                                                                                                       // Hand off entries of a link until the order or the stack stops it
+      void completeIndication(int slot, int32_t token, HMS_BLE_Status status);                                                              // Stack context: confirmation (or failure) of the entry behind token
+      void completeOldestIndication(int serviceIndex, int charIndex, HMS_BLE_Status status);                                                // Same, for the oldest entry in flight on the characteristic (stacks that report no connection)
+      void abortIndications(int slot, HMS_BLE_Status status);                                                                               // Fail every entry of a link, oldest first
+      void serviceIndications();                                                                                                            // loop(): deadlines and retries
+      uint32_t indicationWaitMs() const;                                                                                                    // Background task timeout: next deadline or retry, 0 when nothing waits
+      HMS_BLE_Status indicateInternal(int slot, int serviceIndex, int charIndex, const uint8_t* data, size_t length, int32_t token);        // Backend: one indication to one link, completeIndication() with token on the confirmation
+    #endif
+
+    #if defined(HMS_BLE_ZEPHYR_nRF)
       /*
         CCC (Client Characteristic Configuration) for notifications
         Note: Zephyr's CCC implementation uses an internal struct _bt_gatt_ccc
@@ -338,35 +1848,143 @@ class HMS_BLE {
         bool (*cfg_match)(struct bt_conn *conn, const struct bt_gatt_attr *attr);
       };
 
-      struct ZephyrCCC              zephyrCccObjects[HMS_BLE_MAX_CHARACTERISTICS];
+      /*
+        The whole GATT database lives in one arena, carved in this order (each section aligned for its type):
+        bt_gatt_service[services] | bt_gatt_attr[attributes] | ZephyrCCC[cccs] | bt_gatt_chrc[characteristics] | UUIDs
+        UUIDs are packed at their real width (bt_uuid_16/32/128) in registration order. CUDs point at the entry names,
+        which already outlive the database (schema in flash or the runtime pools).
+      */
+      struct ZephyrGattLayout {
+        size_t services                                                             = 0;
+        size_t attributes                                                           = 0;
+        size_t characteristics                                                      = 0;
+        size_t cccs                                                                 = 0;
+        size_t uuidBytes                                                            = 0;
+
+        static constexpr size_t alignUp(size_t n, size_t a)            { return (n + a - 1) & ~(a - 1);                         }
+        static constexpr size_t uuidAlign(uint8_t type) {
+          return type == HMS_BLE_UUID_TYPE_16 ? alignof(struct bt_uuid_16) : type == HMS_BLE_UUID_TYPE_32 ? alignof(struct bt_uuid_32) : alignof(struct bt_uuid_128);
+        }
+        static constexpr size_t uuidSize(uint8_t type) {
+          return type == HMS_BLE_UUID_TYPE_16 ? sizeof(struct bt_uuid_16) : type == HMS_BLE_UUID_TYPE_32 ? sizeof(struct bt_uuid_32) : sizeof(struct bt_uuid_128);
+        }
+        constexpr size_t addUUID(const HMS_BLE_UUID& uuid) {                                                                                // Returns the UUID's offset within the UUID section
+          size_t offset = alignUp(uuidBytes, uuidAlign(uuid.type));
+          uuidBytes = offset + uuidSize(uuid.type);
+          return offset;
+        }
+        constexpr void addService(const HMS_BLE_ServiceEntry& service) {
+          services++;
+          attributes++;                                                                                                                     // Primary service declaration
+          addUUID(service.uuid);
+        }
+        constexpr void addCharacteristic(const HMS_BLE_CharacteristicEntry& chr) {
+          characteristics++;
+          attributes += 2;                                                                                                                  // Declaration + value
+          if(chr.properties & (HMS_BLE_PROPERTY_NOTIFY | HMS_BLE_PROPERTY_INDICATE)) { attributes++; cccs++; }
+          if(chr.name[0] != '\0') attributes++;                                                                                             // CUD
+          addUUID(chr.uuid);
+        }
+        constexpr size_t attributeOffset() const                       { return alignUp(services * sizeof(struct bt_gatt_service), alignof(struct bt_gatt_attr)); }
+        constexpr size_t cccOffset() const                             { return alignUp(attributeOffset() + attributes * sizeof(struct bt_gatt_attr), alignof(ZephyrCCC)); }
+        constexpr size_t declarationOffset() const                     { return alignUp(cccOffset() + cccs * sizeof(ZephyrCCC), alignof(struct bt_gatt_chrc)); }
+        constexpr size_t uuidOffset() const                            { return alignUp(declarationOffset() + characteristics * sizeof(struct bt_gatt_chrc), alignof(struct bt_uuid_32)); }
+        constexpr size_t size() const                                  { return uuidOffset() + uuidBytes;                       }
+      };
+
+      static constexpr ZephyrGattLayout zephyrGattLayout(const HMS_BLE_SchemaView& schema) {
+        ZephyrGattLayout layout;
+        const HMS_BLE_CharacteristicEntry* chr = schema.characteristics;
+        for(size_t s = 0; s < schema.serviceCount; s++) {
+          layout.addService(schema.services[s]);
+          for(size_t c = 0; c < schema.characteristicCounts[s]; c++) layout.addCharacteristic(*chr++);
+        }
+        return layout;
+      }
+      ZephyrGattLayout zephyrGattLayout() const;                                                                                            // Same, from the registered services[]
+
+      static constexpr ZephyrGattLayout zephyrGattLayoutLimit() {                                                                           // Largest database the limits allow: 128-bit UUIDs, CCC and CUD everywhere
+        HMS_BLE_ServiceEntry service = {};
+        HMS_BLE_CharacteristicEntry chr = {};
+        service.uuid.type = HMS_BLE_UUID_TYPE_128;
+        chr.uuid.type = HMS_BLE_UUID_TYPE_128;
+        chr.properties = HMS_BLE_PROPERTY_NOTIFY;
+        chr.name[0] = 'N';
+        ZephyrGattLayout layout;
+        for(size_t s = 0; s < HMS_BLE_MAX_SERVICES; s++) {
+          layout.addService(service);
+          for(size_t c = 0; c < HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE; c++) layout.addCharacteristic(chr);
+        }
+        return layout;
+      }
+
+      uint16_t                      zephyrValueAttrIndex[HMS_BLE_MAX_SERVICES][HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                  // Value attribute of each characteristic within its service's table
+      uint8_t                       *zephyrArena                                      = nullptr;                                            // GATT database arena (static when started from a schema)
+      size_t                        zephyrArenaSize                                   = 0;                                                  // Arena bytes, 0 while no database is built
+      bool                          zephyrArenaOwned                                  = false;                                              // Arena came from k_malloc() and is freed by stop()
+      #if HMS_BLE_STATIC_ALLOCATION && HMS_BLE_RUNTIME_REGISTRATION
+      static uint8_t                zephyrStaticArena[];                                                                                    // Runtime registration arena, sized by zephyrGattLayoutLimit()
+      #endif
+      size_t                        zephyrRegisteredServices                          = 0;                                                  // Services handed to bt_gatt_service_register()
+      uint16_t                      zephyrReadIntoHandle                              = 0xFFFF;                                             // Characteristic of the last read-into response
+      uint16_t                      zephyrReadIntoLength                              = 0;                                                  // Bytes that response carried, the end of its value
+
+      struct bt_conn                *zephyrConnections[HMS_BLE_MAX_CLIENTS]           = {nullptr};                                          // Referenced connection per slot
+      #if HMS_BLE_BROADCAST_SETS
+      struct bt_le_ext_adv          *zephyrBroadcastSets[HMS_BLE_BROADCAST_SETS]      = {nullptr};                                          // Advertising set behind each broadcast set
+      #endif
+
+      struct k_sem                  zephyrEventSem;                                                                                         // Given by signalEvent(), taken by the background task
+      k_tid_t                       zephyrBleThreadId;
+      struct k_thread               zephyrBleThread;
+      k_thread_stack_t              *zephyrBleThreadStack;
       
       int buildGattAttributes();
+      void releaseGattAttributes();
       static void zephyrBleTask(void* p1, void* p2, void* p3);
       static void zephyrConnectedCallback(struct bt_conn *conn, uint8_t err);
       static void zephyrDisconnectedCallback(struct bt_conn *conn, uint8_t reason);
-      void convertUUIDStringToZephyr(const char* uuidStr, struct bt_uuid_128* zephyrUUID);
+      static void zephyrParamsUpdatedCallback(struct bt_conn *conn, uint16_t interval, uint16_t latency, uint16_t timeout);
+      static void zephyrMtuUpdatedCallback(struct bt_conn *conn, uint16_t tx, uint16_t rx);
+      #if HMS_BLE_LINK_PROFILES && defined(CONFIG_BT_USER_PHY_UPDATE)
+      static void zephyrPhyUpdatedCallback(struct bt_conn *conn, struct bt_conn_le_phy_info *param);
+      #endif
+      #if HMS_BLE_LINK_PROFILES && defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+      static void zephyrDataLenUpdatedCallback(struct bt_conn *conn, struct bt_conn_le_data_len_info *info);
+      #endif
+      static ssize_t zephyrCccWriteCallback(struct bt_conn *conn, const struct bt_gatt_attr *attr, uint16_t value);
       static void zephyrCccChangedCallback(const struct bt_gatt_attr *attr, uint16_t value);
       static ssize_t zephyrReadCallback(struct bt_conn *conn, const struct bt_gatt_attr *attr,void *buf, uint16_t len, uint16_t offset);
       static ssize_t zephyrWriteCallback(struct bt_conn *conn, const struct bt_gatt_attr *attr,const void *buf, uint16_t len, uint16_t offset, uint8_t flags);
+      static void zephyrNotifyComplete(struct bt_conn *conn, void *user_data);
+      bool zephyrRetryNotifications();                                                                                                     // Hand a partly refused send to the links that still owe it, true once none do
+      #if HMS_BLE_INDICATE_DEPTH
+      struct bt_gatt_indicate_params zephyrIndicateParams[HMS_BLE_MAX_CLIENTS][HMS_BLE_INDICATE_DEPTH];                                     // One per indication entry, must stay valid until the confirmation
+      int32_t                       zephyrIndicateTokens[HMS_BLE_MAX_CLIENTS][HMS_BLE_INDICATE_DEPTH];                                      // Token of the entry each params block carries
+      static void zephyrIndicateComplete(struct bt_conn *conn, struct bt_gatt_indicate_params *params, uint8_t err);
+      #endif
 
     #elif defined(HMS_BLE_ARDUINO_ESP32)
       NimBLEServer              *bleServer                                        = nullptr;
       TaskHandle_t              bleTaskHandle                                     = nullptr;
+      uint8_t                   readIntoBuffer[HMS_BLE_ATT_MAX_VALUE_LENGTH];                                                               // Read-into target, NimBLE copies it into the response
+      NimBLEAdvertisementData   espAdvertisingData;                                                                                         // Raw AD structures from advPayload, capacity kept between updates
+      NimBLEAdvertisementData   espScanResponseData;
       // Note: Per-service NimBLEService* and NimBLECharacteristic* are now stored in HMS_BLE_ServiceDescriptor
 
       class BLEData : public NimBLECharacteristicCallbacks {
         public:
-          BLEData(HMS_BLE* instance, const char* serviceUUID = nullptr, const char* charUUID = nullptr, int svcIdx = -1, int charIdx = -1) 
-            : hms_ble(instance), serviceIndex(svcIdx), charIndex(charIdx) {
-            if(serviceUUID) strncpy(this->serviceUUID, serviceUUID, sizeof(this->serviceUUID) - 1);
-            if(charUUID) strncpy(this->charUUID, charUUID, sizeof(this->charUUID) - 1);
-          }
+          BLEData(HMS_BLE* instance = nullptr, const char* serviceUUID = nullptr, const char* charUUID = nullptr, int svcIdx = -1, int charIdx = -1) 
+            : serviceUUID(serviceUUID), charUUID(charUUID), serviceIndex(svcIdx), charIndex(charIdx), hms_ble(instance) {}
           void onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) override;
           void onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) override;
           void onSubscribe(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo, uint16_t subValue) override;
+          #if HMS_BLE_INDICATE_DEPTH
+          void onStatus(NimBLECharacteristic* pCharacteristic, int code) override;                                                          // Indication outcome (BLE_HS_EDONE when confirmed)
+          #endif
         private:
-          char      serviceUUID[40] = {0};                                                                                                    // Service UUID for this characteristic
-          char      charUUID[40] = {0};                                                                                                       // Characteristic UUID
+          const char *serviceUUID;                                                                                                            // Service UUID text, points at the registered service entry
+          const char *charUUID;                                                                                                               // Characteristic UUID text, points at the registered entry
           int       serviceIndex;                                                                                                             // Index into services array
           int       charIndex;                                                                                                                // Index into service's characteristics array
           HMS_BLE   *hms_ble;
@@ -374,13 +1992,23 @@ class HMS_BLE {
       
       class BLEConnectionStatus : public NimBLEServerCallbacks {
         public:
-          BLEConnectionStatus(HMS_BLE* instance) : hms_ble(instance) {}
+          BLEConnectionStatus(HMS_BLE* instance = nullptr) : hms_ble(instance) {}
           void onConnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo) override;
           void onDisconnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo, int reason) override;
+          void onMTUChange(uint16_t MTU, NimBLEConnInfo& connInfo) override;
+          void onConnParamsUpdate(NimBLEConnInfo& connInfo) override;
+          #if HMS_BLE_LINK_PROFILES
+          void onPhyUpdate(NimBLEConnInfo& connInfo, uint8_t txPhy, uint8_t rxPhy) override;
+          #endif
         private:
           HMS_BLE * hms_ble;
       };
 
+      #if HMS_BLE_STATIC_ALLOCATION
+      BLEConnectionStatus       espServerCallbacks;                                                                                         // Server callbacks, lent to NimBLE (not deleted with the server)
+      BLEData                   espCharacteristicCallbacks[HMS_BLE_MAX_SERVICES][HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE];                  // One per characteristic slot, rebound by every init()
+      #endif
+
       static void bleTask(void* pvParameters);
       static const uint8_t* getMacAddressBytes(const NimBLEAddress& address);
 
@@ -392,10 +2020,314 @@ class HMS_BLE {
       // Add Zephyr specific members
     #elif defined(HMS_BLE_PLATFORM_STM32_HAL)
       // Add STM32 HAL specific members
-    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
-      // Add Desktop specific members
+    #elif defined(HMS_BLE_DESKTOP_SIM)
+      friend class HMS_BLE_VirtualCentral;
+      #if HMS_BLE_BROADCAST_SETS
+      friend class HMS_BLE_VirtualScanner;
+      #endif
+
+      mutable std::recursive_mutex  desktopMutex;                                                                                           // Virtual controller lock (plays the role of the host stack lock)
+      std::thread                   desktopThread;                                                                                          // Background task thread
+      std::atomic<bool>             desktopThreadRunning{false};                                                                            // Background task run flag
+      std::mutex                    desktopEventMutex;                                                                                      // Guards the wait on desktopEventCondition
+      std::condition_variable       desktopEventCondition;                                                                                  // Signalled by signalEvent()
+      std::atomic<bool>             desktopAdvertising{false};                                                                              // Virtual controller advertising state
+      std::atomic<uint32_t>         desktopAdvertisingStarts{0};                                                                            // See getAdvertisingStarts()
+      uint16_t                      desktopNextConnHandle                             = 0;                                                  // Next connection handle to hand out
+      HMS_BLE_VirtualCentral        *desktopCentrals[HMS_BLE_MAX_CLIENTS]             = {nullptr};                                          // Connected centrals indexed by slot
+      #if HMS_BLE_BROADCAST_SETS
+      struct DesktopBroadcast {
+        HMS_BLE_BroadcastParams     params;
+        uint8_t                     data[HMS_BLE_BROADCAST_DATA_LENGTH];                                                                    // What the virtual controller advertises
+        size_t                      length;
+        std::thread                 thread;                                                                                                 // Advertising event scheduler
+        std::atomic<bool>           running{false};
+        std::atomic<uint32_t>       events{0};                                                                                              // See getBroadcastEvents()
+      };
+      DesktopBroadcast              desktopBroadcasts[HMS_BLE_BROADCAST_SETS];
+      HMS_BLE_VirtualScanner        *desktopScanners[4]                               = {nullptr};                                          // Scanners listening to this broadcaster
+
+      void runBroadcastEvents(int set);
+      HMS_BLE_Status desktopScan(HMS_BLE_VirtualScanner* scanner, bool enable);
+      #endif
+
+      static void desktopTask(HMS_BLE* pThis);
+      HMS_BLE_Status desktopConnect(HMS_BLE_VirtualCentral* central);
+      void desktopDisconnect(HMS_BLE_VirtualCentral* central, uint8_t reason);
+      HMS_BLE_Status desktopSubscribe(HMS_BLE_VirtualCentral* central, int serviceIndex, int charIndex, uint16_t cccValue);
+      HMS_BLE_Status desktopRead(HMS_BLE_VirtualCentral* central, int serviceIndex, int charIndex, uint8_t* data, size_t* length);
+      HMS_BLE_Status desktopWrite(HMS_BLE_VirtualCentral* central, int serviceIndex, int charIndex, const uint8_t* data, size_t length, bool command);// command: ATT Write Command (WRITE_NR), else Write Request
+      #if HMS_BLE_INDICATE_DEPTH
+      void desktopConfirm(HMS_BLE_VirtualCentral* central, int32_t token);                                                                  // ATT Handle Value Confirmation from a central
+      #endif
     #endif
 
 };
 
+/* UUID Parser *////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/*
+  Defined in the header so the same code runs at registration time and inside HMS_BLE_MakeSchema() at compile time.
+*/
+constexpr bool HMS_BLE::parseUUID(const char* str, HMS_BLE_UUID* uuid) {
+  if(!str || !uuid) return false;
+  uuid->type = HMS_BLE_UUID_TYPE_INVALID;
+
+  size_t len = __builtin_strlen(str);                                                                                                      // Usable in constant expressions (GCC/Clang), plain strlen() at runtime
+
+  if(len == 4 || len == 8) {                                                                                                                // "181A" / "0000181A"
+    uint32_t value = 0;
+    for(size_t i = 0; i < len; i++) {
+      uint8_t n = HMS_BLE_HEX_TABLE.nibble[(uint8_t)str[i]];
+      if(n == 0xFF) return false;
+      value = (value << 4) | n;
+    }
+    for(size_t i = 0; i < 12; i++) uuid->val[i] = HMS_BLE_BASE_UUID[i];
+    uuid->val[12] = value & 0xFF;
+    uuid->val[13] = (value >> 8) & 0xFF;
+    uuid->val[14] = (value >> 16) & 0xFF;
+    uuid->val[15] = (value >> 24) & 0xFF;
+  } else if(len == 36 || len == 32) {                                                                                                       // 8-4-4-4-12 or 32 plain hex digits
+    if(len == 36 && (str[8] != '-' || str[13] != '-' || str[18] != '-' || str[23] != '-')) return false;
+    constexpr uint8_t dashed[16] = { 0, 2, 4, 6, 9, 11, 14, 16, 19, 21, 24, 26, 28, 30, 32, 34 };
+    for(size_t i = 0; i < 16; i++) {
+      const char* p = &str[(len == 36) ? dashed[i] : i * 2];
+      uint8_t hi = HMS_BLE_HEX_TABLE.nibble[(uint8_t)p[0]], lo = HMS_BLE_HEX_TABLE.nibble[(uint8_t)p[1]];
+      if((hi | lo) & 0xF0) return false;
+      uuid->val[15 - i] = (uint8_t)((hi << 4) | lo);                                                                                        // Text is big-endian, val is little-endian
+    }
+  } else {
+    return false;
+  }
+
+  // Shorten anything that sits on the SIG base UUID
+  size_t same = 0;
+  while(same < 12 && uuid->val[same] == HMS_BLE_BASE_UUID[same]) same++;
+  if(same == 12) {
+    uuid->type = (uuid->val[14] == 0 && uuid->val[15] == 0) ? HMS_BLE_UUID_TYPE_16 : HMS_BLE_UUID_TYPE_32;
+  } else {
+    uuid->type = HMS_BLE_UUID_TYPE_128;
+  }
+  return true;
+}
+
+/* Compile-time Schema *////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/*
+  Declare the whole GATT database as a constexpr object and start with ble.begin<schema>():
+
+    static constexpr auto schema = HMS_BLE_MakeSchema(
+      HMS_BLE_MakeService("181A", "Environmental Sensing",
+        HMS_BLE_MakeCharacteristic("2A6E", "Temperature", HMS_BLE_PROPERTY_READ_NOTIFY),
+        HMS_BLE_MakeCharacteristic("2A6F", "Humidity",    HMS_BLE_PROPERTY_READ_NOTIFY)
+      )
+    );
+
+  Exceeding a HMS_BLE_MAX_* limit fails a static_assert. An unparsable or duplicate UUID is reported by the compiler as a call
+  to one of the HMS_BLE_SCHEMA_ERROR_* functions below, which are deliberately not constexpr.
+*/
+inline void HMS_BLE_SCHEMA_ERROR_invalid_uuid() {}
+inline void HMS_BLE_SCHEMA_ERROR_duplicate_uuid() {}
+
+constexpr bool HMS_BLE_SchemaSameUUID(const HMS_BLE_UUID& a, const HMS_BLE_UUID& b) {
+  for(size_t i = 0; i < sizeof(a.val); i++) {
+    if(a.val[i] != b.val[i]) return false;
+  }
+  return true;
+}
+
+template <size_t U, size_t L>
+constexpr HMS_BLE_CharacteristicEntry HMS_BLE_MakeCharacteristic(const char (&uuid)[U], const char (&name)[L], HMS_BLE_CharacteristicProperty properties) {
+  static_assert(U <= HMS_BLE_UUID_STR_LENGTH, "Characteristic UUID string is too long");
+  static_assert(L <= HMS_BLE_MAX_NAME_LENGTH, "Characteristic name exceeds HMS_BLE_MAX_NAME_LENGTH");
+  HMS_BLE_CharacteristicEntry entry{};
+  if(!HMS_BLE::parseUUID(uuid, &entry.uuid)) HMS_BLE_SCHEMA_ERROR_invalid_uuid();
+  for(size_t i = 0; i < U; i++) entry.uuidStr[i] = uuid[i];
+  for(size_t i = 0; i < L; i++) entry.name[i] = name[i];
+  entry.properties = properties;
+  return entry;
+}
+
+template <size_t U, size_t L, typename... Chars>
+constexpr HMS_BLE_SchemaService<sizeof...(Chars)> HMS_BLE_MakeService(const char (&uuid)[U], const char (&name)[L], const Chars&... characteristics) {
+  static_assert(U <= HMS_BLE_UUID_STR_LENGTH, "Service UUID string is too long");
+  static_assert(L <= HMS_BLE_MAX_NAME_LENGTH, "Service name exceeds HMS_BLE_MAX_NAME_LENGTH");
+  static_assert(sizeof...(Chars) > 0, "Service needs at least one characteristic");
+  static_assert(sizeof...(Chars) <= HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE, "Service exceeds HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE");
+  HMS_BLE_SchemaService<sizeof...(Chars)> svc{ {}, { characteristics... } };
+  if(!HMS_BLE::parseUUID(uuid, &svc.service.uuid)) HMS_BLE_SCHEMA_ERROR_invalid_uuid();
+  for(size_t i = 0; i < U; i++) svc.service.uuidStr[i] = uuid[i];
+  for(size_t i = 0; i < L; i++) svc.service.name[i] = name[i];
+  for(size_t i = 0; i < sizeof...(Chars); i++) {
+    for(size_t j = i + 1; j < sizeof...(Chars); j++) {
+      if(HMS_BLE_SchemaSameUUID(svc.characteristics[i].uuid, svc.characteristics[j].uuid)) HMS_BLE_SCHEMA_ERROR_duplicate_uuid();
+    }
+  }
+  return svc;
+}
+
+template <size_t... Ns>
+constexpr HMS_BLE_Schema<sizeof...(Ns), (Ns + ...)> HMS_BLE_MakeSchema(const HMS_BLE_SchemaService<Ns>&... services) {
+  static_assert(sizeof...(Ns) > 0, "Schema needs at least one service");
+  static_assert(sizeof...(Ns) <= HMS_BLE_MAX_SERVICES, "Schema exceeds HMS_BLE_MAX_SERVICES");
+  HMS_BLE_Schema<sizeof...(Ns), (Ns + ...)> schema{};
+  size_t s = 0, c = 0;
+  auto append = [&](const auto& svc, size_t count) {
+    for(size_t i = 0; i < s; i++) {
+      if(HMS_BLE_SchemaSameUUID(schema.services[i].uuid, svc.service.uuid)) HMS_BLE_SCHEMA_ERROR_duplicate_uuid();
+    }
+    schema.services[s] = svc.service;
+    schema.characteristicCounts[s++] = (uint8_t)count;
+    schema.attributeCount += 1;                                                                                                             // Service declaration
+    for(size_t i = 0; i < count; i++) {
+      const HMS_BLE_CharacteristicEntry& chr = svc.characteristics[i];
+      schema.characteristics[c++] = chr;
+      schema.attributeCount += 2;                                                                                                           // Declaration + value
+      if(chr.properties & (HMS_BLE_PROPERTY_NOTIFY | HMS_BLE_PROPERTY_INDICATE)) schema.attributeCount += 1;                               // CCC
+      if(chr.name[0] != '\0') schema.attributeCount += 1;                                                                                   // CUD
+    }
+  };
+  (append(services, Ns), ...);
+  return schema;
+}
+
+#if defined(HMS_BLE_DESKTOP_SIM)
+/* Virtual Central */////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/*
+  Scriptable stand-in for a phone/gateway that talks to an HMS_BLE peripheral through the in-process virtual controller.
+  All calls are synchronous: a write() returns after the peripheral's write callback has run, a sendData() on the peripheral
+  returns after every subscribed central's notification callback has run.
+
+  With HMS_BLE_TX_CREDITS > 0 notifications go over a modelled link instead: each central runs connection events every
+  connection interval from its own thread, delivers up to maxPdusPerEvent queued notifications per event and then returns
+  their TX credits, like a controller reporting Number Of Completed Packets.
+*/
+class HMS_BLE_VirtualCentral {
+  public:
+    HMS_BLE_VirtualCentral(const uint8_t* address = nullptr);
+    ~HMS_BLE_VirtualCentral();
+
+    HMS_BLE_Status connect(HMS_BLE* peripheral);                                                                                            // Connect to an advertising peripheral
+    HMS_BLE_Status disconnect(uint8_t reason = 0x13);                                                                                       // 0x13: Remote User Terminated Connection
+    HMS_BLE_Status subscribe(const char* serviceUUID, const char* charUUID, bool enable = true, bool indicate = false);                     // Write the characteristic's CCC descriptor
+    HMS_BLE_Status read(const char* serviceUUID, const char* charUUID, uint8_t* data, size_t* length);                                     // ATT Read Request, *length is buffer size in / value size out
+    HMS_BLE_Status write(const char* serviceUUID, const char* charUUID, const uint8_t* data, size_t length);                               // ATT Write Request, at most getMTU() - 3 bytes
+    HMS_BLE_Status writeCommand(const char* serviceUUID, const char* charUUID, const uint8_t* data, size_t length);                         // ATT Write Command (WRITE_NR), no response; returns once the peripheral took it
+    uint16_t exchangeMTU(uint16_t clientMTU);                                                                                               // ATT Exchange MTU, returns the negotiated MTU
+    uint16_t getMTU() const                                          { return mtu;                                            }
+
+    bool isConnected() const                                         { return peripheral != nullptr;                          }
+    uint16_t getConnHandle() const                                   { return connHandle;                                     }
+    const uint8_t* getAddress() const                                { return address;                                        }
+    size_t getNotificationCount() const                              { return notificationCount.load();                       }
+    void setNotificationCallback(HMS_BLE_CentralNotificationCallback callback) { notificationCallback = callback;             }
+
+    void setConnectionInterval(uint16_t interval)                    { connectionInterval = interval ? interval : 1;          }      // 1.25 ms units (6 = 7.5 ms, the minimum), before connect()
+    #if HMS_BLE_LINK_PROFILES
+    void setLinkSupport(uint8_t phys, uint16_t maxOctets)            { supportedPhys = phys; maxDataLength = maxOctets;       }      // HMS_BLE_Phy bits and LL payload the central's controller takes (default all, 251)
+    void setIntervalRange(uint16_t low, uint16_t high)               { minInterval = low; maxInterval = high;                 }      // Intervals the central accepts (default 6..3200), a request outside is rejected
+    #endif
+    #if HMS_BLE_INDICATE_DEPTH
+    void setAutoConfirm(bool enable)                                 { autoConfirm = enable;                                  }      // Confirm indications on receipt (default), else confirm() does
+    HMS_BLE_Status confirm();                                                                                                               // Confirm the oldest unconfirmed indication, ERROR_PROTOCOL when there is none
+    size_t getUnconfirmed() const;                                                                                                          // Indications received and not confirmed yet
+    size_t getIndicationCount() const                                { return indicationCount.load();                         }      // Indications received (also counted as notifications)
+    #endif
+    #if HMS_BLE_TX_CREDITS
+    void setMaxPdusPerEvent(uint8_t pdus)                            { maxPdusPerEvent = pdus ? pdus : 1;                     }      // Notifications the link carries per connection event (with link profiles: at most, the negotiated link decides)
+    uint32_t getConnectionEvents() const                             { return connectionEvents.load();                        }      // Connection events since connect()
+    #endif
+
+  private:
+    friend class HMS_BLE;
+
+    HMS_BLE                             *peripheral;                                                                                        // Peripheral this central is connected to
+    uint16_t                            connHandle;                                                                                         // Connection handle assigned by the virtual controller
+    int                                 slot;                                                                                               // Slot in the peripheral's central table
+    uint8_t                             address[6];                                                                                         // Central device address
+    std::atomic<size_t>                 notificationCount;                                                                                  // Notifications/indications received
+    HMS_BLE_CentralNotificationCallback notificationCallback;
+
+    uint16_t                            mtu;                                                                                                // ATT MTU of this link
+    std::atomic<uint16_t>               connectionInterval;                                                                                 // 1.25 ms units, reported to the peripheral on connect
+
+    HMS_BLE_Status resolve(const char* serviceUUID, const char* charUUID, int* serviceIndex, int* charIndex) const;
+    void onNotification(int serviceIndex, int charIndex, const uint8_t* data, size_t length);
+
+    #if HMS_BLE_LINK_PROFILES
+    uint8_t                             supportedPhys;                                                                                      // HMS_BLE_Phy bits
+    uint16_t                            maxDataLength;                                                                                      // LL payload octets
+    uint16_t                            minInterval;                                                                                        // Accepted connection intervals, 1.25 ms units
+    uint16_t                            maxInterval;
+
+    void negotiateLink(const HMS_BLE_LinkProfileParams& params);                                                                            // Answer the peripheral's link requests
+    #endif
+
+    #if HMS_BLE_INDICATE_DEPTH
+    int32_t                             confirmTokens[HMS_BLE_INDICATE_BEARERS];                                                            // Received, unconfirmed indications, oldest first
+    size_t                              confirmHead;
+    size_t                              confirmCount;
+    mutable std::mutex                  confirmMutex;                                                                                       // Guards confirmTokens
+    std::atomic<size_t>                 indicationCount;
+    bool                                autoConfirm;
+
+    void onIndication(int serviceIndex, int charIndex, const uint8_t* data, size_t length, int32_t token);
+    #endif
+
+    #if HMS_BLE_TX_CREDITS
+    typedef struct {
+      int32_t                           token;                                                                                              // TX credit token returned on delivery
+      uint8_t                           serviceIndex;
+      uint8_t                           charIndex;
+      uint16_t                          length;
+      uint8_t                           data[HMS_BLE_ATT_MAX_VALUE_LENGTH];
+    } LinkPdu;                                                                                                                              // Notification waiting for a connection event
+
+    LinkPdu                             linkQueue[HMS_BLE_TX_CREDITS];                                                                      // Each entry holds a distinct credit, so it never overflows
+    size_t                              linkHead;
+    size_t                              linkCount;
+    std::mutex                          linkMutex;                                                                                          // Guards linkQueue
+    std::thread                         linkThread;                                                                                         // Connection event scheduler
+    std::atomic<bool>                   linkRunning;
+    std::atomic<uint32_t>               connectionEvents;
+    uint8_t                             maxPdusPerEvent;
+
+    void queueNotification(int serviceIndex, int charIndex, const uint8_t* data, size_t length, int32_t token);
+    void startLink();
+    void stopLink();                                                                                                                        // Joins the scheduler, fails what is still queued
+    void runConnectionEvents();
+    #endif
+};
+
+#if HMS_BLE_BROADCAST_SETS
+/*
+  Virtual scanner for the desktop simulator: hears the advertising events of every broadcast set the peripheral runs, as
+  the virtual controller sends them. setLoss() drops a share of the events at random, the way a real scanner misses the
+  ones sent while its radio listens on another channel or the air is busy. Reports arrive on the set's event thread.
+*/
+class HMS_BLE_VirtualScanner {
+  public:
+    HMS_BLE_VirtualScanner();
+    ~HMS_BLE_VirtualScanner();
+
+    HMS_BLE_Status start(HMS_BLE* broadcaster);                                                                                             // Start listening, ERROR_BUSY when four scanners already do
+    void stop();
+    void setReportCallback(HMS_BLE_ScanReportCallback callback)      { reportCallback = callback;                             }      // Before start()
+    void setLoss(uint8_t percent)                                    { loss = percent > 100 ? 100 : percent;                  }      // Share of events missed, 0..100
+    uint32_t getReports() const                                      { return reports.load();                                 }      // Events heard
+    uint32_t getMissed() const                                       { return missed.load();                                  }      // Events lost to setLoss()
+
+  private:
+    friend class HMS_BLE;
+
+    HMS_BLE                             *broadcaster;                                                                                       // Peripheral listened to
+    HMS_BLE_ScanReportCallback          reportCallback;
+    std::atomic<uint8_t>                loss;                                                                                               // Percent
+    uint32_t                            random;                                                                                             // Loss model state, advanced under the peripheral's desktopMutex
+    std::atomic<uint32_t>               reports;
+    std::atomic<uint32_t>               missed;
+
+    void onAdvertisingEvent(int set, HMS_BLE_BroadcastMode mode, const uint8_t* data, size_t length);
+};
+#endif
+#endif // HMS_BLE_DESKTOP_SIM
+
 #endif // HMS_BLE_H
\ No newline at end of file
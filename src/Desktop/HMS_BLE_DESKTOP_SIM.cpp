@@ -0,0 +1,760 @@
+#include "HMS_BLE.h"
+
+#if defined(HMS_BLE_DESKTOP_SIM)
+
+/*
+  In-process virtual controller for desktop builds.
+  The peripheral side implements the same backend hooks as the ESP32 and nRF ports (init/stop/restartAdvertising/sendDataInternal),
+  while HMS_BLE_VirtualCentral drives the "air" side: connect, CCC writes, ATT reads/writes and notification reception.
+  desktopMutex stands in for the host stack lock, so every event is delivered to the application exactly like a stack callback would be.
+*/
+
+void HMS_BLE::stop() {
+    if(desktopThreadRunning.exchange(false)) {
+        signalEvent(HMS_BLE_EVENT_STOP);
+        if(desktopThread.joinable() && desktopThread.get_id() != std::this_thread::get_id()) {
+            desktopThread.join();
+        }
+    }
+    #if HMS_BLE_BROADCAST_SETS
+        for(int i = 0; i < HMS_BLE_BROADCAST_SETS; i++) {
+            if(broadcastSets[i].used) removeBroadcast(i);                                                                   // Joins the set's event thread
+        }
+    #endif
+
+    // Disconnect outside the lock: a central's link thread may be inside a callback that sends
+    HMS_BLE_VirtualCentral* connected[HMS_BLE_MAX_CLIENTS];
+    {
+        std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+        desktopAdvertising = false;
+        memcpy(connected, desktopCentrals, sizeof(connected));
+    }
+    for(int i = 0; i < HMS_BLE_MAX_CLIENTS; i++) {
+        if(connected[i]) {
+            desktopDisconnect(connected[i], 0x16);                                                                          // 0x16: Connection Terminated By Local Host
+        }
+    }
+}
+
+HMS_BLE_Status HMS_BLE::init() {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+
+    // Static random address derived from the device name so runs are reproducible
+    uint32_t hash = 2166136261u;
+    for(const char* p = deviceName; p && *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    deviceAddress[0] = 0xC0 | ((hash >> 24) & 0x3F);
+    deviceAddress[1] = (hash >> 16) & 0xFF;
+    deviceAddress[2] = (hash >> 8) & 0xFF;
+    deviceAddress[3] = hash & 0xFF;
+    deviceAddress[4] = 0x48;
+    deviceAddress[5] = 0x4D;
+
+    for(size_t s = 0; s < serviceCount; s++) {
+        BLE_LOGGER(debug, "Created service: %s (%s)",
+            services[s].service->uuidStr, services[s].service->name
+        );
+        memset(services[s].subscribers, 0, sizeof(services[s].subscribers));
+        for(size_t c = 0; c < services[s].characteristicCount; c++) {
+            services[s].valueLengths[c] = 0;
+            BLE_LOGGER(debug, "  Created characteristic: %s (%s)",
+                services[s].characteristics[c].uuidStr, services[s].characteristics[c].name
+            );
+        }
+    }
+
+    restartAdvertising();
+
+    if(backgroundProcess) {
+        desktopThreadRunning = true;
+        desktopThread = std::thread(desktopTask, this);
+        BLE_LOGGER(debug, "Background BLE task created");
+    }
+
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+void HMS_BLE::restartAdvertising() {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    if(connectedCount >= HMS_BLE_MAX_CLIENTS) {
+        BLE_LOGGER(debug, "All central slots in use, not advertising");
+        return;
+    }
+    desktopAdvertising = true;
+    desktopAdvertisingStarts++;
+    BLE_LOGGER(info, "Advertising started");
+}
+
+HMS_BLE_Status HMS_BLE::updateAdvertisingInternal() {
+    return HMS_BLE_STATUS_SUCCESS;                                                                                          // The virtual controller advertises advPayload as it is
+}
+
+uint32_t HMS_BLE::taskStackFree() const {
+    return 0;                                                                                                               // Host threads grow their stack on demand
+}
+
+void HMS_BLE::desktopTask(HMS_BLE* pThis) {
+    if(!pThis) return;
+    while(pThis->desktopThreadRunning) {
+        pThis->backgroundStep();
+    }
+}
+
+HMS_BLE_Status HMS_BLE::sendDataInternal(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_SendCallback* done) {
+    if(serviceIndex < 0 || serviceIndex >= (int)serviceCount) {
+        BLE_LOGGER(error, "Invalid service index: %d", serviceIndex);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    if(charIndex < 0 || charIndex >= (int)services[serviceIndex].characteristicCount) {
+        BLE_LOGGER(error, "Invalid characteristic index: %d for service %d", charIndex, serviceIndex);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    HMS_BLE_ServiceDescriptor& svc = services[serviceIndex];
+    svc.valueLengths[charIndex] = std::min(length, (size_t)HMS_BLE_MAX_DATA_LENGTH);                                      // Stream segments can be longer than the stored value
+    memcpy(svc.values[charIndex], data, svc.valueLengths[charIndex]);
+
+    if(connectedCount == 0) {
+        BLE_LOGGER(warn, "No connected clients to notify for %s", svc.characteristics[charIndex].uuidStr);
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+
+    // Subscribed slots are always connected: closeConnection() drops their bits before the central is unlinked
+    int subscribedCount = 0;
+    uint32_t links[HMS_BLE_CLIENT_WORDS];
+    memcpy(links, svc.subscribers[charIndex], sizeof(links));
+    #if HMS_BLE_TX_CREDITS
+        // One credit covers the PDU queued on every subscribed link, the link threads return it once all went out
+        if(hasSubscribers(serviceIndex, charIndex)) {
+            int32_t token = acquireTxCredit(encodeHandle(serviceIndex, charIndex), done, links);
+            if(token < 0) return HMS_BLE_STATUS_ERROR_BUSY;
+            for(int i = takeLowestSlot(links); i >= 0; i = takeLowestSlot(links)) {
+                size_t pduLength = std::min(length, (size_t)desktopCentrals[i]->mtu - 3);
+                desktopCentrals[i]->queueNotification(serviceIndex, charIndex, data, pduLength, token);
+                countLinkSend(i, pduLength);
+                subscribedCount++;
+            }
+            done = nullptr;
+        }
+    #else
+        for(int i = takeLowestSlot(links); i >= 0; i = takeLowestSlot(links)) {
+            size_t pduLength = std::min(length, (size_t)desktopCentrals[i]->mtu - 3);
+            desktopCentrals[i]->onNotification(serviceIndex, charIndex, data, pduLength);
+            countLinkSend(i, pduLength);
+            subscribedCount++;
+        }
+    #endif
+
+    if(subscribedCount > 0) {
+        BLE_LOGGER(debug, "Notification sent on %s: %d bytes to %d client(s)",
+            svc.characteristics[charIndex].uuidStr, length, subscribedCount
+        );
+    } else {
+        BLE_LOGGER(debug, "No clients subscribed to %s, skipping notification", svc.characteristics[charIndex].uuidStr);
+    }
+    if(done && *done) (*done)(encodeHandle(serviceIndex, charIndex), HMS_BLE_STATUS_SUCCESS);                             // Nothing left in flight
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+#if HMS_BLE_INDICATE_DEPTH
+/*
+  The indication reaches the central synchronously; it confirms right away (auto-confirm) or keeps the token until its
+  confirm() call, from any thread, which completes the entry like a Handle Value Confirmation would.
+*/
+HMS_BLE_Status HMS_BLE::indicateInternal(int slot, int serviceIndex, int charIndex, const uint8_t* data, size_t length, int32_t token) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    HMS_BLE_ServiceDescriptor& svc = services[serviceIndex];
+    svc.valueLengths[charIndex] = length;
+    memcpy(svc.values[charIndex], data, length);
+
+    HMS_BLE_VirtualCentral* central = desktopCentrals[slot];
+    if(!central) {
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+    size_t pduLength = std::min(length, (size_t)central->mtu - 3);
+    countLinkSend(slot, pduLength);
+    central->onIndication(serviceIndex, charIndex, data, pduLength, token);
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+void HMS_BLE::desktopConfirm(HMS_BLE_VirtualCentral* central, int32_t token) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    if(central->slot < 0 || central->slot >= HMS_BLE_MAX_CLIENTS || desktopCentrals[central->slot] != central) return;
+    completeIndication(central->slot, token, HMS_BLE_STATUS_SUCCESS);
+}
+#endif
+
+#if HMS_BLE_LINK_PROFILES
+/*
+  The central answers like a real one, one report per procedure, all before requestLinkProfile() returns: see
+  HMS_BLE_VirtualCentral::negotiateLink().
+*/
+HMS_BLE_Status HMS_BLE::requestLinkInternal(int slot, const HMS_BLE_LinkProfileParams& params) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    HMS_BLE_VirtualCentral* central = desktopCentrals[slot];
+    if(!central) {
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+    central->negotiateLink(params);
+    return HMS_BLE_STATUS_SUCCESS;
+}
+#endif
+
+// ========== Virtual Controller Events (central -> peripheral) ==========
+
+HMS_BLE_Status HMS_BLE::desktopConnect(HMS_BLE_VirtualCentral* central) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    if(!desktopAdvertising) {
+        BLE_LOGGER(warn, "Connection attempt while not advertising");
+        return HMS_BLE_STATUS_ERROR_START;
+    }
+
+    if(connectedCount >= HMS_BLE_MAX_CLIENTS) {
+        return HMS_BLE_STATUS_ERROR_BUSY;                                                                                  // Every connection slot taken
+    }
+    uint16_t connHandle = desktopNextConnHandle;
+    while(findConnection(connHandle) >= 0) connHandle = (connHandle + 1) % 0x0F00;                                        // Skip handles still live after a wrap
+    desktopNextConnHandle = (connHandle + 1) % 0x0F00;                                                                     // HCI handles are 12-bit, 0x0F00+ reserved
+    int slot = openConnection(connHandle, central->address);
+    updateConnectionParams(slot, central->connectionInterval, 0, 400);                                                     // 4 s supervision timeout
+
+    desktopCentrals[slot] = central;
+    central->peripheral = this;
+    central->slot = slot;
+    central->connHandle = connHandle;
+
+    // Like NimBLE, advertising stops on connect and is resumed by the library if slots remain
+    desktopAdvertising = false;
+    if(connectedCount < HMS_BLE_MAX_CLIENTS) {
+        desktopAdvertising = true;
+        desktopAdvertisingStarts++;
+    }
+
+    oldConnected = true;
+    signalEvent(HMS_BLE_EVENT_CONNECT);
+    BLE_LOGGER(debug, "BLE Client Connected (handle %d, slot %d)", central->connHandle, slot);
+    if(connectionCallback) {
+        connectionCallback(true, central->address);
+    }
+    #if HMS_BLE_LINK_PROFILES
+        applyLinkProfile(slot);
+    #endif
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+void HMS_BLE::desktopDisconnect(HMS_BLE_VirtualCentral* central, uint8_t reason) {
+    #if HMS_BLE_TX_CREDITS
+        central->stopLink();                                                                                                // Before the lock, the link thread may be sending from a callback
+    #endif
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    int slot = central->slot;
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS || desktopCentrals[slot] != central) return;
+
+    closeConnection(slot, reason);
+    desktopCentrals[slot] = nullptr;
+    central->peripheral = nullptr;
+    central->slot = -1;
+    signalEvent(HMS_BLE_EVENT_DISCONNECT);
+
+    BLE_LOGGER(debug, "BLE Client Disconnected - Reason: %d", reason);
+    if(connectionCallback) {
+        connectionCallback(false, central->address);
+    }
+
+    if(bleInitialized) {
+        restartAdvertising();
+    }
+}
+
+HMS_BLE_Status HMS_BLE::desktopSubscribe(HMS_BLE_VirtualCentral* central, int serviceIndex, int charIndex, uint16_t cccValue) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    HMS_BLE_ServiceDescriptor& svc = services[serviceIndex];
+    HMS_BLE_CharacteristicProperty props = svc.characteristics[charIndex].properties;
+    if(!(props & (HMS_BLE_PROPERTY_NOTIFY | HMS_BLE_PROPERTY_INDICATE))) {
+        BLE_LOGGER(warn, "Characteristic %s has no CCC descriptor", svc.characteristics[charIndex].uuidStr);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    bool enabled = (cccValue & 0x0003) != 0;
+    setSubscribed(central->slot, serviceIndex, charIndex, enabled, (cccValue & 0x0002) != 0);
+    signalEvent(HMS_BLE_EVENT_SUBSCRIBE);
+
+    BLE_LOGGER(debug, "Subscription changed on service %s, char %s (client %d): %s",
+        svc.service->uuidStr, svc.characteristics[charIndex].uuidStr, central->slot, enabled ? "ENABLED" : "DISABLED"
+    );
+
+    if(notifyCallback) {
+        notifyCallback(svc.service->uuidStr, svc.characteristics[charIndex].uuidStr, enabled, central->address);
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::desktopRead(HMS_BLE_VirtualCentral* central, int serviceIndex, int charIndex, uint8_t* data, size_t* length) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    HMS_BLE_ServiceDescriptor& svc = services[serviceIndex];
+    if(!(svc.characteristics[charIndex].properties & HMS_BLE_PROPERTY_READ)) {
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    BLE_LOGGER(debug, "Read on service %s, characteristic: %s", svc.service->uuidStr, svc.characteristics[charIndex].uuidStr);
+    countLinkRead(central->slot, serviceIndex, charIndex);
+
+    if(readIntoCallback) {                                                                                                  // Zero-copy: the application fills the central's buffer
+        *length = deliverReadInto(serviceIndex, charIndex, data, std::min(*length, (size_t)central->mtu - 1), central->address);
+        return HMS_BLE_STATUS_SUCCESS;
+    }
+
+    #if HMS_BLE_VALUE_CACHE
+        beginCachedRead(serviceIndex, charIndex, central->address);                                                        // Whole value in one response, the copy is the snapshot
+        *length = readCachedValue(serviceIndex, charIndex, data, std::min(*length, (size_t)central->mtu - 1));
+        return HMS_BLE_STATUS_SUCCESS;
+    #endif
+
+    if(readCallback) {
+        uint8_t readData[HMS_BLE_MAX_DATA_LENGTH] = {0};
+        size_t readLength = 0;
+        readCallback(svc.service->uuidStr, svc.characteristics[charIndex].uuidStr, readData, &readLength, central->address);
+        if(readLength > 0 && readLength <= HMS_BLE_MAX_DATA_LENGTH) {
+            memcpy(svc.values[charIndex], readData, readLength);
+            svc.valueLengths[charIndex] = readLength;
+        }
+    }
+
+    size_t copyLen = std::min(*length, svc.valueLengths[charIndex]);
+    memcpy(data, svc.values[charIndex], copyLen);
+    *length = copyLen;
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::desktopWrite(HMS_BLE_VirtualCentral* central, int serviceIndex, int charIndex, const uint8_t* data, size_t length, bool command) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    HMS_BLE_ServiceDescriptor& svc = services[serviceIndex];
+    if(!(svc.characteristics[charIndex].properties & (command ? HMS_BLE_PROPERTY_WRITE_NR : HMS_BLE_PROPERTY_WRITE))) {
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;                                                                           // A real stack answers with Write Not Permitted, or ignores the command
+    }
+
+    countLinkWrite(central->slot, serviceIndex, charIndex, length);
+    if(consumeStreamSegment(serviceIndex, charIndex, data, length)) {
+        return HMS_BLE_STATUS_SUCCESS;
+    }
+    if(command && consumeIngestWrite(central->slot, serviceIndex, charIndex, data, length)) {
+        return HMS_BLE_STATUS_SUCCESS;                                                                                      // Also when the ring was full: a command has no response to fail
+    }
+
+    memcpy(svc.values[charIndex], data, std::min(length, (size_t)HMS_BLE_MAX_DATA_LENGTH));
+    svc.valueLengths[charIndex] = std::min(length, (size_t)HMS_BLE_MAX_DATA_LENGTH);
+
+    if(writeViewCallback) {                                                                                                 // Zero-copy: the application sees the central's buffer
+        deliverWriteView(serviceIndex, charIndex, data, length, central->address);
+        return HMS_BLE_STATUS_SUCCESS;
+    }
+
+    storeReceivedData(serviceIndex, charIndex, data, length);
+
+    BLE_LOGGER(debug, "Write on service %s, characteristic: %s (%d bytes)",
+        svc.service->uuidStr, svc.characteristics[charIndex].uuidStr, svc.dataLength
+    );
+
+    if(writeCallback) {
+        writeCallback(svc.service->uuidStr, svc.characteristics[charIndex].uuidStr, svc.data, svc.dataLength, central->address);
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+// ========== Virtual Central ==========
+
+HMS_BLE_VirtualCentral::HMS_BLE_VirtualCentral(const uint8_t* address):
+    peripheral(nullptr), connHandle(HMS_BLE_CONN_HANDLE_NONE), slot(-1), notificationCount(0), mtu(23), connectionInterval(6)
+    #if HMS_BLE_INDICATE_DEPTH
+        , confirmHead(0), confirmCount(0), indicationCount(0), autoConfirm(true)
+    #endif
+    #if HMS_BLE_LINK_PROFILES
+        , supportedPhys(HMS_BLE_PHY_1M | HMS_BLE_PHY_2M | HMS_BLE_PHY_CODED), maxDataLength(251), minInterval(6), maxInterval(3200)
+    #endif
+    #if HMS_BLE_TX_CREDITS
+        , linkHead(0), linkCount(0), linkRunning(false), connectionEvents(0), maxPdusPerEvent(HMS_BLE_LINK_PROFILES ? 255 : 4)
+    #endif
+    {
+    static const uint8_t defaultAddress[6] = {0x00, 0x00, 0x00, 0x5E, 0xC0, 0xC0};
+    memcpy(this->address, address ? address : defaultAddress, sizeof(this->address));
+}
+
+HMS_BLE_VirtualCentral::~HMS_BLE_VirtualCentral() {
+    disconnect();
+    #if HMS_BLE_TX_CREDITS
+        if(linkThread.joinable()) {
+            if(linkThread.get_id() == std::this_thread::get_id()) linkThread.detach();
+            else linkThread.join();
+        }
+    #endif
+}
+
+HMS_BLE_Status HMS_BLE_VirtualCentral::connect(HMS_BLE* peripheral) {
+    if(!peripheral) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(this->peripheral) return HMS_BLE_STATUS_ERROR_START;
+    HMS_BLE_Status status = peripheral->desktopConnect(this);
+    if(status == HMS_BLE_STATUS_SUCCESS) {
+        exchangeMTU(HMS_BLE_PREFERRED_MTU);                                                                                 // Like most phones, exchange right after connecting
+        #if HMS_BLE_TX_CREDITS
+            startLink();
+        #endif
+    }
+    return status;
+}
+
+uint16_t HMS_BLE_VirtualCentral::exchangeMTU(uint16_t clientMTU) {
+    if(!peripheral) return mtu;
+    mtu = std::max<uint16_t>(23, std::min<uint16_t>(clientMTU, HMS_BLE_PREFERRED_MTU));                                   // 23 is the ATT minimum
+    peripheral->updateConnectionMTU(slot, mtu);
+    return mtu;
+}
+
+HMS_BLE_Status HMS_BLE_VirtualCentral::disconnect(uint8_t reason) {
+    if(!peripheral) return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    peripheral->desktopDisconnect(this, reason);
+    mtu = 23;
+    #if HMS_BLE_INDICATE_DEPTH
+        std::lock_guard<std::mutex> lock(confirmMutex);
+        confirmHead = 0;
+        confirmCount = 0;                                                                                                   // The link is gone, so are the confirmations it owed
+    #endif
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE_VirtualCentral::resolve(const char* serviceUUID, const char* charUUID, int* serviceIndex, int* charIndex) const {
+    if(!peripheral) return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    *serviceIndex = peripheral->findServiceIndex(serviceUUID);
+    *charIndex = peripheral->findCharacteristicInService(*serviceIndex, charUUID);
+    return (*charIndex < 0) ? HMS_BLE_STATUS_ERROR_INVALID_CHAR : HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE_VirtualCentral::subscribe(const char* serviceUUID, const char* charUUID, bool enable, bool indicate) {
+    int s, c;
+    HMS_BLE_Status status = resolve(serviceUUID, charUUID, &s, &c);
+    if(status != HMS_BLE_STATUS_SUCCESS) return status;
+    uint16_t cccValue = enable ? (indicate ? 0x0002 : 0x0001) : 0x0000;
+    return peripheral->desktopSubscribe(this, s, c, cccValue);
+}
+
+HMS_BLE_Status HMS_BLE_VirtualCentral::read(const char* serviceUUID, const char* charUUID, uint8_t* data, size_t* length) {
+    if(!data || !length) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    int s, c;
+    HMS_BLE_Status status = resolve(serviceUUID, charUUID, &s, &c);
+    if(status != HMS_BLE_STATUS_SUCCESS) return status;
+    return peripheral->desktopRead(this, s, c, data, length);
+}
+
+HMS_BLE_Status HMS_BLE_VirtualCentral::write(const char* serviceUUID, const char* charUUID, const uint8_t* data, size_t length) {
+    if(!data || length == 0) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(length > (size_t)mtu - 3) return HMS_BLE_STATUS_ERROR_SEND;                                                          // Does not fit one ATT Write Request
+    int s, c;
+    HMS_BLE_Status status = resolve(serviceUUID, charUUID, &s, &c);
+    if(status != HMS_BLE_STATUS_SUCCESS) return status;
+    return peripheral->desktopWrite(this, s, c, data, length, false);
+}
+
+HMS_BLE_Status HMS_BLE_VirtualCentral::writeCommand(const char* serviceUUID, const char* charUUID, const uint8_t* data, size_t length) {
+    if(!data || length == 0) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(length > (size_t)mtu - 3) return HMS_BLE_STATUS_ERROR_SEND;                                                          // Does not fit one ATT Write Command
+    int s, c;
+    HMS_BLE_Status status = resolve(serviceUUID, charUUID, &s, &c);
+    if(status != HMS_BLE_STATUS_SUCCESS) return status;
+    return peripheral->desktopWrite(this, s, c, data, length, true);
+}
+
+void HMS_BLE_VirtualCentral::onNotification(int serviceIndex, int charIndex, const uint8_t* data, size_t length) {
+    notificationCount++;
+    if(notificationCallback) {
+        const HMS_BLE_ServiceDescriptor& svc = peripheral->services[serviceIndex];
+        notificationCallback(svc.service->uuidStr, svc.characteristics[charIndex].uuidStr, data, length);
+    }
+}
+
+#if HMS_BLE_LINK_PROFILES
+// ========== Virtual Central Link Negotiation ==========
+/*
+  Runs inside the peripheral's request. The connection parameter update is accepted when the requested interval range
+  overlaps the central's and settles on the shortest interval both allow, else it is rejected (ERROR_PROTOCOL report). The
+  PHY update picks the fastest PHY both sides prefer and is left alone when they share none. The data length settles at the
+  smaller of the two maximums.
+*/
+void HMS_BLE_VirtualCentral::negotiateLink(const HMS_BLE_LinkProfileParams& params) {
+    uint16_t low = std::max(params.minInterval, minInterval), high = std::min(params.maxInterval, maxInterval);
+    if(low <= high) {
+        connectionInterval = low;                                                                                          // The link thread picks it up on its next event
+        peripheral->updateConnectionParams(slot, low, params.latency, params.supervisionTimeout);
+    } else {
+        peripheral->reportLink(slot, 0, HMS_BLE_STATUS_ERROR_PROTOCOL);
+    }
+
+    uint8_t common = params.phy & supportedPhys;
+    if(common) {
+        uint8_t phy = (common & HMS_BLE_PHY_2M) ? HMS_BLE_PHY_2M : (common & HMS_BLE_PHY_1M) ? HMS_BLE_PHY_1M : HMS_BLE_PHY_CODED;
+        peripheral->updateLinkPhy(slot, phy, phy);
+    }
+
+    if(params.dataLength) {
+        uint16_t octets = std::max<uint16_t>(27, std::min(params.dataLength, maxDataLength));
+        peripheral->updateLinkDataLength(slot, octets, octets);
+    }
+}
+#endif
+
+#if HMS_BLE_INDICATE_DEPTH
+// ========== Virtual Central Indications ==========
+
+void HMS_BLE_VirtualCentral::onIndication(int serviceIndex, int charIndex, const uint8_t* data, size_t length, int32_t token) {
+    indicationCount++;
+    onNotification(serviceIndex, charIndex, data, length);
+    if(autoConfirm) {
+        peripheral->desktopConfirm(this, token);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(confirmMutex);
+    if(confirmCount == HMS_BLE_INDICATE_BEARERS) {                                                                          // Cannot happen with one per bearer, drop the oldest if it does
+        confirmHead = (confirmHead + 1) % HMS_BLE_INDICATE_BEARERS;
+        confirmCount--;
+    }
+    confirmTokens[(confirmHead + confirmCount) % HMS_BLE_INDICATE_BEARERS] = token;
+    confirmCount++;
+}
+
+HMS_BLE_Status HMS_BLE_VirtualCentral::confirm() {
+    int32_t token;
+    {
+        std::lock_guard<std::mutex> lock(confirmMutex);
+        if(confirmCount == 0) return HMS_BLE_STATUS_ERROR_PROTOCOL;                                                         // No indication to confirm
+        token = confirmTokens[confirmHead];
+        confirmHead = (confirmHead + 1) % HMS_BLE_INDICATE_BEARERS;
+        confirmCount--;
+    }
+    HMS_BLE* host = peripheral;
+    if(!host) return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    host->desktopConfirm(this, token);                                                                                      // Outside confirmMutex: the next indication may arrive from inside
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+size_t HMS_BLE_VirtualCentral::getUnconfirmed() const {
+    std::lock_guard<std::mutex> lock(confirmMutex);
+    return confirmCount;
+}
+#endif
+
+#if HMS_BLE_TX_CREDITS
+// ========== Virtual Link (TX credits) ==========
+
+void HMS_BLE_VirtualCentral::queueNotification(int serviceIndex, int charIndex, const uint8_t* data, size_t length, int32_t token) {
+    std::lock_guard<std::mutex> lock(linkMutex);
+    LinkPdu& pdu = linkQueue[(linkHead + linkCount) % HMS_BLE_TX_CREDITS];
+    pdu.token = token;
+    pdu.serviceIndex = (uint8_t)serviceIndex;
+    pdu.charIndex = (uint8_t)charIndex;
+    pdu.length = (uint16_t)length;
+    memcpy(pdu.data, data, length);
+    linkCount++;
+}
+
+void HMS_BLE_VirtualCentral::startLink() {
+    if(linkThread.joinable()) linkThread.join();                                                                            // Left over from a disconnect issued by the link thread itself
+    linkHead = 0;
+    linkCount = 0;
+    connectionEvents = 0;
+    linkRunning = true;
+    linkThread = std::thread(&HMS_BLE_VirtualCentral::runConnectionEvents, this);
+}
+
+void HMS_BLE_VirtualCentral::stopLink() {
+    if(!linkRunning.exchange(false)) return;
+    if(linkThread.joinable() && linkThread.get_id() != std::this_thread::get_id()) {
+        linkThread.join();
+    }
+
+    // The link is gone: what the controller still held fails
+    while(true) {
+        int32_t token;
+        {
+            std::lock_guard<std::mutex> lock(linkMutex);
+            if(linkCount == 0) break;
+            token = linkQueue[linkHead].token;
+            linkHead = (linkHead + 1) % HMS_BLE_TX_CREDITS;
+            linkCount--;
+        }
+        peripheral->completeTx(token, HMS_BLE_STATUS_ERROR_NOT_CONNECTED, slot);
+    }
+}
+
+/*
+  One iteration per connection event. The PDUs go out first and their credits come back together at the end of the event,
+  so a send started from a completion callback rides on the next event, as with a real controller's Number Of Completed
+  Packets. Delivery per event is capped by maxPdusPerEvent and by what the host had in flight (HMS_BLE_TX_CREDITS).
+*/
+void HMS_BLE_VirtualCentral::runConnectionEvents() {
+    HMS_BLE* host = peripheral;                                                                                             // Stays valid: disconnect() joins before unlinking
+    int link = slot;
+    auto next = std::chrono::steady_clock::now();
+    LinkPdu pdu;
+    int32_t sent[HMS_BLE_TX_CREDITS];
+
+    while(linkRunning) {
+        next += std::chrono::microseconds(connectionInterval * 1250);                                                       // Follows connection parameter updates
+        std::this_thread::sleep_until(next);
+        if(!linkRunning) break;
+        connectionEvents++;
+
+        size_t perEvent = maxPdusPerEvent;
+        #if HMS_BLE_LINK_PROFILES
+            perEvent = std::min<size_t>(perEvent, host->connections[link].notificationsPerEvent.load(std::memory_order_relaxed));
+        #endif
+        size_t count = 0;
+        while(count < perEvent && count < HMS_BLE_TX_CREDITS && linkRunning) {
+            {
+                std::lock_guard<std::mutex> lock(linkMutex);
+                if(linkCount == 0) break;
+                pdu = linkQueue[linkHead];
+                linkHead = (linkHead + 1) % HMS_BLE_TX_CREDITS;
+                linkCount--;
+            }
+            onNotification(pdu.serviceIndex, pdu.charIndex, pdu.data, pdu.length);
+            sent[count++] = pdu.token;
+        }
+        for(size_t i = 0; i < count; i++) {
+            host->completeTx(sent[i], HMS_BLE_STATUS_SUCCESS, link);
+        }
+    }
+}
+#endif
+
+#if HMS_BLE_BROADCAST_SETS
+// ========== Virtual Broadcaster ==========
+/*
+  Every started set runs its advertising events from its own thread: one per periodic interval for a periodic set, one per
+  advertising interval plus the 0..10 ms advDelay a controller adds for the others. An event carries the set's data as it is
+  at that moment to every scanner, under desktopMutex like a stack callback.
+*/
+HMS_BLE_Status HMS_BLE::createBroadcastInternal(int set, const HMS_BLE_BroadcastParams& params) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    DesktopBroadcast& b = desktopBroadcasts[set];
+    b.params = params;
+    b.length = 0;
+    b.events = 0;
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::setBroadcastDataInternal(int set, const uint8_t* data, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    DesktopBroadcast& b = desktopBroadcasts[set];
+    memcpy(b.data, data, length);
+    b.length = length;
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::startBroadcastInternal(int set) {
+    DesktopBroadcast& b = desktopBroadcasts[set];
+    if(b.thread.joinable()) b.thread.join();
+    b.running = true;
+    b.thread = std::thread(&HMS_BLE::runBroadcastEvents, this, set);
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::stopBroadcastInternal(int set) {
+    DesktopBroadcast& b = desktopBroadcasts[set];
+    if(!b.running.exchange(false)) return HMS_BLE_STATUS_SUCCESS;
+    if(b.thread.joinable() && b.thread.get_id() != std::this_thread::get_id()) {
+        b.thread.join();                                                                                                    // Outside desktopMutex, the thread takes it per event
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+void HMS_BLE::removeBroadcastInternal(int set) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    desktopBroadcasts[set].length = 0;
+}
+
+uint32_t HMS_BLE::getBroadcastEvents(int set) const {
+    if(set < 0 || set >= HMS_BLE_BROADCAST_SETS) return 0;
+    return desktopBroadcasts[set].events.load();
+}
+
+void HMS_BLE::runBroadcastEvents(int set) {
+    DesktopBroadcast& b = desktopBroadcasts[set];
+    bool periodic = b.params.mode == HMS_BLE_BROADCAST_PERIODIC;
+    uint32_t random = 2463534242u + (uint32_t)set;
+    auto next = std::chrono::steady_clock::now();
+
+    while(b.running) {
+        // Short naps, so stopping a set with a long interval does not wait out the interval
+        for(auto now = std::chrono::steady_clock::now(); b.running && now < next; now = std::chrono::steady_clock::now()) {
+            std::this_thread::sleep_until(std::min(next, now + std::chrono::milliseconds(10)));
+        }
+        if(!b.running) break;
+        {
+            std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+            b.events++;
+            for(HMS_BLE_VirtualScanner* scanner : desktopScanners) {
+                if(scanner) scanner->onAdvertisingEvent(set, b.params.mode, b.data, b.length);
+            }
+        }
+
+        uint32_t spacingUs = b.params.periodicInterval * 1250u;
+        if(!periodic) {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            spacingUs = b.params.interval * 625u + random % 10001;                                                          // advDelay, 0..10 ms
+        }
+        next += std::chrono::microseconds(spacingUs);
+    }
+}
+
+HMS_BLE_Status HMS_BLE::desktopScan(HMS_BLE_VirtualScanner* scanner, bool enable) {
+    std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+    for(HMS_BLE_VirtualScanner*& entry : desktopScanners) {
+        if(enable ? entry == nullptr : entry == scanner) {
+            entry = enable ? scanner : nullptr;
+            return HMS_BLE_STATUS_SUCCESS;
+        }
+    }
+    return enable ? HMS_BLE_STATUS_ERROR_BUSY : HMS_BLE_STATUS_SUCCESS;
+}
+
+// ========== Virtual Scanner ==========
+
+HMS_BLE_VirtualScanner::HMS_BLE_VirtualScanner():
+    broadcaster(nullptr), loss(0), random(88172645u), reports(0), missed(0) {
+}
+
+HMS_BLE_VirtualScanner::~HMS_BLE_VirtualScanner() {
+    stop();
+}
+
+HMS_BLE_Status HMS_BLE_VirtualScanner::start(HMS_BLE* broadcaster) {
+    if(!broadcaster) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(this->broadcaster) return HMS_BLE_STATUS_ERROR_START;
+    HMS_BLE_Status status = broadcaster->desktopScan(this, true);
+    if(status == HMS_BLE_STATUS_SUCCESS) this->broadcaster = broadcaster;
+    return status;
+}
+
+void HMS_BLE_VirtualScanner::stop() {
+    if(!broadcaster) return;
+    broadcaster->desktopScan(this, false);                                                                                  // Returns between events, none is delivered after it
+    broadcaster = nullptr;
+}
+
+void HMS_BLE_VirtualScanner::onAdvertisingEvent(int set, HMS_BLE_BroadcastMode mode, const uint8_t* data, size_t length) {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    if(random % 100 < loss.load(std::memory_order_relaxed)) {
+        missed++;
+        return;
+    }
+    reports++;
+    if(reportCallback) reportCallback(set, mode, data, length);
+}
+#endif
+
+#endif // HMS_BLE_DESKTOP_SIM
@@ -2,64 +2,106 @@
 
 #if defined(HMS_BLE_ARDUINO_ESP32)
 
+#if HMS_BLE_STATIC_ALLOCATION
+    static StackType_t  bleTaskStack[HMS_BLE_BACKGROUND_PROCESS_STACK_SIZE / sizeof(StackType_t)];      // ESP-IDF counts task stacks in bytes
+    static StaticTask_t bleTaskBuffer;                                                                  // Task control block, vTaskDelete() leaves both in place
+#endif
+
+// Build a NimBLE UUID straight from the binary UUID (16/32-bit stay short on air and in the attribute table)
+static NimBLEUUID toNimBLEUUID(const HMS_BLE_UUID& uuid) {
+    if(uuid.type == HMS_BLE_UUID_TYPE_16) return NimBLEUUID(uuid.value16());
+    if(uuid.type == HMS_BLE_UUID_TYPE_32) return NimBLEUUID(uuid.value32());
+    ble_uuid128_t uuid128;
+    uuid128.u.type = BLE_UUID_TYPE_128;
+    memcpy(uuid128.value, uuid.val, sizeof(uuid128.value));
+    return NimBLEUUID(&uuid128);
+}
+
+// The stored value by reference where NimBLE has getAttVal() (2.x), otherwise the heap copy getValue() returns
+template<typename C> static auto storedValue(C* characteristic, int) -> decltype(characteristic->getAttVal()) {
+    return characteristic->getAttVal();
+}
+template<typename C> static NimBLEAttValue storedValue(C* characteristic, long) {
+    return characteristic->getValue();
+}
+
 void HMS_BLE::stop() {
     if (bleTaskHandle != nullptr) {
         vTaskDelete(bleTaskHandle);
         bleTaskHandle = nullptr;
     }
-    NimBLEDevice::deinit();
+    #if HMS_BLE_STATIC_ALLOCATION
+        NimBLEDevice::deinit(true);                                                                         // Frees NimBLE's server, services and characteristics, the next init() builds them again
+        bleServer = nullptr;
+    #else
+        NimBLEDevice::deinit();
+    #endif
 }
 
 HMS_BLE_Status HMS_BLE::init() {
     NimBLEDevice::init(deviceName);
+    NimBLEDevice::setMTU(HMS_BLE_PREFERRED_MTU);
     bleServer = NimBLEDevice::createServer();
     if(!bleServer) {
         BLE_LOGGER(error, "Failed to create NimBLE server");
         return HMS_BLE_STATUS_ERROR_INIT;
     }
 
-    bleServer->setCallbacks(new BLEConnectionStatus(instance));
+    #if HMS_BLE_STATIC_ALLOCATION
+        espServerCallbacks = BLEConnectionStatus(instance);
+        bleServer->setCallbacks(&espServerCallbacks, false);                                                // Member storage, the server must not delete it
+    #else
+        bleServer->setCallbacks(new BLEConnectionStatus(instance));
+    #endif
     
     // Create all registered services
     for(size_t s = 0; s < serviceCount; s++) {
-        NimBLEService* pService = bleServer->createService(NimBLEUUID(services[s].service.uuid.c_str()));
+        NimBLEService* pService = bleServer->createService(toNimBLEUUID(services[s].service->uuid));
         if(!pService) {
-            BLE_LOGGER(error, "Failed to create BLE service: %s", services[s].service.uuid.c_str());
+            BLE_LOGGER(error, "Failed to create BLE service: %s", services[s].service->uuidStr);
             return HMS_BLE_STATUS_ERROR_INIT;
         }
         services[s].bleService = pService;
         
         BLE_LOGGER(debug, "Created service: %s (%s)", 
-            services[s].service.uuid.c_str(), services[s].service.name.c_str()
+            services[s].service->uuidStr, services[s].service->name
         );
         
         // Create characteristics for this service
         for(size_t c = 0; c < services[s].characteristicCount; c++) {
             NimBLECharacteristic* pChar = pService->createCharacteristic(
-                BLEUUID(services[s].characteristics[c].uuid.c_str()),
+                toNimBLEUUID(services[s].characteristics[c].uuid),
                 static_cast<uint32_t>(services[s].characteristics[c].properties)
             );
 
             if(!pChar) {
-                BLE_LOGGER(error, "Failed to create characteristic: %s", services[s].characteristics[c].uuid.c_str());
+                BLE_LOGGER(error, "Failed to create characteristic: %s", services[s].characteristics[c].uuidStr);
                 return HMS_BLE_STATUS_ERROR_INIT;
             }
 
             // Pass service UUID, char UUID, and indices to callback
-            pChar->setCallbacks(new BLEData(instance, 
-                services[s].service.uuid.c_str(),
-                services[s].characteristics[c].uuid.c_str(),
-                s, c));
+            #if HMS_BLE_STATIC_ALLOCATION
+                espCharacteristicCallbacks[s][c] = BLEData(instance,
+                    services[s].service->uuidStr,
+                    services[s].characteristics[c].uuidStr,
+                    s, c);
+                pChar->setCallbacks(&espCharacteristicCallbacks[s][c]);
+            #else
+                pChar->setCallbacks(new BLEData(instance, 
+                    services[s].service->uuidStr,
+                    services[s].characteristics[c].uuidStr,
+                    s, c));
+            #endif
             services[s].bleCharacteristics[c] = pChar;
 
             BLE_LOGGER(debug, "  Created characteristic: %s (%s)", 
-                services[s].characteristics[c].uuid.c_str(), services[s].characteristics[c].name.c_str()
+                services[s].characteristics[c].uuidStr, services[s].characteristics[c].name
             );
         }
         
         pService->start();
         BLE_LOGGER(debug, "Started service: %s with %d characteristics", 
-            services[s].service.uuid.c_str(), services[s].characteristicCount
+            services[s].service->uuidStr, services[s].characteristicCount
         );
     }
 
@@ -69,33 +111,8 @@ HMS_BLE_Status HMS_BLE::init() {
         return HMS_BLE_STATUS_ERROR_INIT;
     }
 
-    pAdvertising->setName(deviceName);
-    
-    // Add service UUIDs to advertising
-    if(advertisedServiceCount > 0) {
-        // User specified which services to advertise
-        for(size_t i = 0; i < advertisedServiceCount; i++) {
-            int svcIdx = findServiceIndex(advertisedServices[i]);
-            if(svcIdx >= 0) {
-                pAdvertising->addServiceUUID(NimBLEUUID(services[svcIdx].service.uuid.c_str()));
-                BLE_LOGGER(debug, "Advertising service: %s", services[svcIdx].service.uuid.c_str());
-            }
-        }
-    } else {
-        // Advertise first service by default (BLE advertising has limited space)
-        if(serviceCount > 0) {
-            pAdvertising->addServiceUUID(NimBLEUUID(services[0].service.uuid.c_str()));
-            BLE_LOGGER(debug, "Advertising primary service: %s", services[0].service.uuid.c_str());
-        }
-    }
-
-    if(manufacturerDataSet) {
-        std::string mfgDataStr;
-        mfgDataStr += (char)(manufacturerData.manufacturer_id[0] & 0xFF);
-        mfgDataStr += (char)(manufacturerData.manufacturer_id[1] & 0xFF);
-        mfgDataStr.append(reinterpret_cast<const char*>(manufacturerData.data.data()), manufacturerData.data.size());
-        pAdvertising->setManufacturerData(mfgDataStr);
-        BLE_LOGGER(debug, "Manufacturer data set in advertising packet");
+    if(updateAdvertisingInternal() != HMS_BLE_STATUS_SUCCESS) {                                             // The packed payload replaces NimBLE's own
+        return HMS_BLE_STATUS_ERROR_INIT;
     }
 
     pAdvertising->start();
@@ -103,15 +120,28 @@ HMS_BLE_Status HMS_BLE::init() {
     BLE_LOGGER(debug, "NimBLE advertising started");
 
     if(backgroundProcess) {
-        xTaskCreatePinnedToCore(
-            bleTask,
-            "HMS_BLE_Task",
-            HMS_BLE_BACKGROUND_PROCESS_STACK_SIZE,
-            nullptr,
-            HMS_BLE_BACKGROUND_PROCESS_PRIORITY,
-            &bleTaskHandle,
-            1
-        );
+        #if HMS_BLE_STATIC_ALLOCATION
+            bleTaskHandle = xTaskCreateStaticPinnedToCore(
+                bleTask,
+                "HMS_BLE_Task",
+                HMS_BLE_BACKGROUND_PROCESS_STACK_SIZE,
+                nullptr,
+                HMS_BLE_BACKGROUND_PROCESS_PRIORITY,
+                bleTaskStack,
+                &bleTaskBuffer,
+                1
+            );
+        #else
+            xTaskCreatePinnedToCore(
+                bleTask,
+                "HMS_BLE_Task",
+                HMS_BLE_BACKGROUND_PROCESS_STACK_SIZE,
+                nullptr,
+                HMS_BLE_BACKGROUND_PROCESS_PRIORITY,
+                &bleTaskHandle,
+                1
+            );
+        #endif
         BLE_LOGGER(debug, "Background BLE task created");
     }
 
@@ -127,12 +157,34 @@ void HMS_BLE::restartAdvertising() {
     }
 }
 
+/*
+  The packets are handed over as raw AD structures. The two NimBLEAdvertisementData members keep their vector capacity, so
+  an update copies 62 bytes at most and does not allocate. NimBLE passes new data to a running advertiser without a restart.
+*/
+HMS_BLE_Status HMS_BLE::updateAdvertisingInternal() {
+    NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+    if(!pAdvertising) {
+        BLE_LOGGER(error, "Failed to get NimBLE advertising instance");
+        return HMS_BLE_STATUS_ERROR_INIT;
+    }
+    HMS_BLE_AdvPayload payload = getAdvertisingPayload();
+    espAdvertisingData.clearData();
+    espAdvertisingData.addData(payload.advertising, payload.advertisingLength);
+    espScanResponseData.clearData();
+    espScanResponseData.addData(payload.scanResponse, payload.scanResponseLength);
+    pAdvertising->enableScanResponse(payload.scanResponseLength > 0);
+    if(!pAdvertising->setAdvertisementData(espAdvertisingData) || !pAdvertising->setScanResponseData(espScanResponseData)) {
+        BLE_LOGGER(warn, "NimBLE refused the advertising payload");
+        return HMS_BLE_STATUS_ERROR_SEND;
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
 void HMS_BLE::bleTask(void* pvParameters) {
     HMS_BLE* pThis = HMS_BLE::instance;
     if(!pThis) return;
     while(true) {
-        pThis->loop();
-        vTaskDelay(pdMS_TO_TICKS(50));
+        pThis->backgroundStep();                                                                        // Blocks in ulTaskNotifyTake() until signalEvent()
     }
 }
 
@@ -141,7 +193,12 @@ const uint8_t* HMS_BLE::getMacAddressBytes(const NimBLEAddress& address) {
     return addrBase->val;
 }
 
-HMS_BLE_Status HMS_BLE::sendDataInternal(int serviceIndex, int charIndex, const uint8_t* data, size_t length) {
+uint32_t HMS_BLE::taskStackFree() const {
+    if(!bleTaskHandle) return 0;
+    return uxTaskGetStackHighWaterMark(bleTaskHandle);                                                      // ESP-IDF counts the stack in bytes
+}
+
+HMS_BLE_Status HMS_BLE::sendDataInternal(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_SendCallback* done) {
     if(serviceIndex < 0 || serviceIndex >= (int)serviceCount) {
         BLE_LOGGER(error, "Invalid service index: %d", serviceIndex);
         return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
@@ -162,44 +219,143 @@ HMS_BLE_Status HMS_BLE::sendDataInternal(int serviceIndex, int charIndex, const
     
     if(bleServer && bleServer->getConnectedCount() > 0) {
         // Check if any client has subscribed to notifications for this characteristic
-        int subscribedCount = 0;
-        for(int i = 0; i < HMS_BLE_MAX_CLIENTS; i++) {
-            if(services[serviceIndex].notificationEnabled[charIndex][i]) {
+        if(hasSubscribers(serviceIndex, charIndex)) {
+            bool result = pChar->notify();
+            if(!result) return HMS_BLE_STATUS_ERROR_SEND;
+            int subscribedCount = 0;
+            uint32_t links[HMS_BLE_CLIENT_WORDS];
+            memcpy(links, services[serviceIndex].subscribers[charIndex], sizeof(links));
+            for(int i = takeLowestSlot(links); i >= 0; i = takeLowestSlot(links)) {
+                countLinkSend(i, std::min(length, (size_t)connections[i].mtu - 3));                                       // NimBLE truncates to each peer's MTU
                 subscribedCount++;
             }
-        }
-        
-        if(subscribedCount > 0) {
-            bool result = pChar->notify();
             BLE_LOGGER(debug, "Notification sent on %s: %d bytes to %d client(s)", 
-                pChar->getUUID().toString().c_str(), length, subscribedCount
+                services[serviceIndex].characteristics[charIndex].uuidStr, length, subscribedCount
             );
-            return result ? HMS_BLE_STATUS_SUCCESS : HMS_BLE_STATUS_ERROR_SEND;
+            if(done && *done) (*done)(encodeHandle(serviceIndex, charIndex), HMS_BLE_STATUS_SUCCESS);                     // NimBLE copied the value into an mbuf
+            return HMS_BLE_STATUS_SUCCESS;
         } else {
             BLE_LOGGER(debug, "No clients subscribed to %s, skipping notification", 
-                pChar->getUUID().toString().c_str());
+                services[serviceIndex].characteristics[charIndex].uuidStr);
+            if(done && *done) (*done)(encodeHandle(serviceIndex, charIndex), HMS_BLE_STATUS_SUCCESS);
             return HMS_BLE_STATUS_SUCCESS;
         }
     } else {
-        BLE_LOGGER(warn, "No connected clients to notify for %s", pChar->getUUID().toString().c_str());
+        BLE_LOGGER(warn, "No connected clients to notify for %s", services[serviceIndex].characteristics[charIndex].uuidStr);
         return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
     }
 }                                             
 
+#if HMS_BLE_INDICATE_DEPTH
+/*
+  NimBLE sends one indication per connection and reports its outcome through onStatus() without saying which connection it
+  was for, so the confirmation completes the oldest indication in flight on that characteristic; the token is not needed.
+*/
+HMS_BLE_Status HMS_BLE::indicateInternal(int slot, int serviceIndex, int charIndex, const uint8_t* data, size_t length, int32_t token) {
+    (void)token;
+    NimBLECharacteristic* pChar = services[serviceIndex].bleCharacteristics[charIndex];
+    if(!pChar) {
+        BLE_LOGGER(error, "BLE characteristic pointer is null");
+        return HMS_BLE_STATUS_ERROR_SEND;
+    }
+    uint16_t connHandle = connections[slot].connHandle;
+    if(connHandle == HMS_BLE_CONN_HANDLE_NONE) {
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+
+    pChar->setValue((uint8_t*)data, length);
+    size_t pduLength = std::min(length, (size_t)connections[slot].mtu - 3);
+    if(!pChar->indicate(data, pduLength, connHandle)) {
+        BLE_LOGGER(warn, "Indication on %s failed", services[serviceIndex].characteristics[charIndex].uuidStr);
+        return HMS_BLE_STATUS_ERROR_SEND;
+    }
+    countLinkSend(slot, pduLength);
+    return HMS_BLE_STATUS_SUCCESS;
+}
+#endif
+
 void HMS_BLE::BLEConnectionStatus::onConnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo) {
     if(!hms_ble) return;
-    hms_ble->bleConnected = true;
+    int slot = hms_ble->openConnection(connInfo.getConnHandle(), getMacAddressBytes(connInfo.getAddress()));
+    if(slot < 0) {
+        pServer->disconnect(connInfo.getConnHandle());                                                      // More links than HMS_BLE_MAX_CLIENTS (CONFIG_BT_NIMBLE_MAX_CONNECTIONS too high)
+        return;
+    }
+    hms_ble->updateConnectionParams(slot, connInfo.getConnInterval(), connInfo.getConnLatency(), connInfo.getConnTimeout());
+    hms_ble->updateConnectionMTU(slot, connInfo.getMTU());
     hms_ble->oldConnected = true;
-    BLE_LOGGER(debug, "BLE Client Connected");
+    hms_ble->signalEvent(HMS_BLE_EVENT_CONNECT);
+    BLE_LOGGER(debug, "BLE Client Connected (handle %d, slot %d)", connInfo.getConnHandle(), slot);
     if(hms_ble->connectionCallback) {
         const uint8_t* macBytes = getMacAddressBytes(connInfo.getAddress());
         hms_ble->connectionCallback(true, macBytes);
     }
+    #if HMS_BLE_LINK_PROFILES
+        hms_ble->applyLinkProfile(slot);
+    #endif
 }    
 
+void HMS_BLE::BLEConnectionStatus::onMTUChange(uint16_t MTU, NimBLEConnInfo& connInfo) {
+    if(!hms_ble) return;
+    hms_ble->updateConnectionMTU(hms_ble->findConnection(connInfo.getConnHandle()), MTU);
+}
+
+void HMS_BLE::BLEConnectionStatus::onConnParamsUpdate(NimBLEConnInfo& connInfo) {
+    if(!hms_ble) return;
+    hms_ble->updateConnectionParams(hms_ble->findConnection(connInfo.getConnHandle()),
+        connInfo.getConnInterval(), connInfo.getConnLatency(), connInfo.getConnTimeout()
+    );
+}
+
+#if HMS_BLE_LINK_PROFILES
+void HMS_BLE::BLEConnectionStatus::onPhyUpdate(NimBLEConnInfo& connInfo, uint8_t txPhy, uint8_t rxPhy) {
+    if(!hms_ble) return;
+    auto toPhy = [](uint8_t phy) -> uint8_t { return phy == BLE_GAP_LE_PHY_CODED ? HMS_BLE_PHY_CODED : phy; };      // NimBLE numbers the PHYs 1, 2, 3
+    hms_ble->updateLinkPhy(hms_ble->findConnection(connInfo.getConnHandle()), toPhy(txPhy), toPhy(rxPhy));
+}
+
+/*
+  The parameter and PHY updates come back through onConnParamsUpdate() and onPhyUpdate(). NimBLE has no callback for the
+  data length change, so the requested length is reported as soon as the controller took the request. A central that
+  settles lower is not seen: the notifications-per-event estimate comes out high and the stack's buffers absorb the rest.
+*/
+HMS_BLE_Status HMS_BLE::requestLinkInternal(int slot, const HMS_BLE_LinkProfileParams& params) {
+    uint16_t connHandle = connections[slot].connHandle;
+    if(connHandle == HMS_BLE_CONN_HANDLE_NONE || !bleServer) {
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+    bleServer->updateConnParams(connHandle, params.minInterval, params.maxInterval, params.latency, params.supervisionTimeout);
+    if(params.phy && !bleServer->updatePhy(connHandle, params.phy, params.phy, 0)) {                       // BLE_GAP_LE_PHY_*_MASK are the HMS_BLE_Phy bits
+        BLE_LOGGER(warn, "PHY update failed (handle %d)", connHandle);
+        return HMS_BLE_STATUS_ERROR_PROTOCOL;
+    }
+    if(params.dataLength) {
+        bleServer->setDataLen(connHandle, params.dataLength);
+        updateLinkDataLength(slot, params.dataLength, params.dataLength);
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+#endif
+
 void HMS_BLE::BLEData::onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {
     if(!hms_ble) return;
     BLE_LOGGER(debug, "Read on service %s, characteristic: %s", serviceUUID, charUUID);
+    hms_ble->countLinkRead(hms_ble->findConnection(connInfo.getConnHandle()), serviceIndex, charIndex);
+
+    if(hms_ble->readIntoCallback) {
+        // NimBLE serves the response from the attribute value, so the application fills a buffer sized to the negotiated MTU
+        size_t capacity = std::min((size_t)(connInfo.getMTU() - 1), sizeof(hms_ble->readIntoBuffer));
+        const uint8_t* macBytes = getMacAddressBytes(connInfo.getAddress());
+        size_t length = hms_ble->deliverReadInto(serviceIndex, charIndex, hms_ble->readIntoBuffer, capacity, macBytes);
+        pCharacteristic->setValue(hms_ble->readIntoBuffer, length);
+        return;
+    }
+
+    #if HMS_BLE_VALUE_CACHE
+        // NimBLE answers from the attribute value, which storeValue()/sendData() keep equal to the cache
+        hms_ble->beginCachedRead(serviceIndex, charIndex, getMacAddressBytes(connInfo.getAddress()));
+        return;
+    #endif
     
     if(hms_ble->readCallback) {
         uint8_t readData[HMS_BLE_MAX_DATA_LENGTH] = {0};
@@ -214,45 +370,41 @@ void HMS_BLE::BLEData::onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnI
 
 void HMS_BLE::BLEData::onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {
     if(!hms_ble) return;
-    std::string rxValue = pCharacteristic->getValue();
-    
-    // Store in per-service buffer
-    if(serviceIndex >= 0 && serviceIndex < HMS_BLE_MAX_SERVICES) {
-        memcpy(hms_ble->services[serviceIndex].data, rxValue.data(), 
-            std::min(rxValue.length(), (size_t)HMS_BLE_MAX_DATA_LENGTH - 1));
-        hms_ble->services[serviceIndex].dataLength = std::min(rxValue.length(), (size_t)HMS_BLE_MAX_DATA_LENGTH - 1);
-        hms_ble->services[serviceIndex].data[hms_ble->services[serviceIndex].dataLength] = 0;
-        hms_ble->services[serviceIndex].received = true;
+    const NimBLEAttValue& rxValue = storedValue(pCharacteristic, 0);                                        // Written by this host task just before the call, no copy
+    int slot = hms_ble->findConnection(connInfo.getConnHandle());
+    hms_ble->countLinkWrite(slot, serviceIndex, charIndex, rxValue.length());
+
+    if(hms_ble->consumeStreamSegment(serviceIndex, charIndex, rxValue.data(), rxValue.length())) return;
+
+    // onWrite() does not say which opcode arrived, so every write to a WRITE_NR characteristic takes the ingest ring
+    if(hms_ble->consumeIngestWrite(slot, serviceIndex, charIndex, rxValue.data(), rxValue.length())) return;
+
+    if(hms_ble->writeViewCallback) {
+        const uint8_t* macBytes = getMacAddressBytes(connInfo.getAddress());
+        hms_ble->deliverWriteView(serviceIndex, charIndex, rxValue.data(), rxValue.length(), macBytes);
+        return;
     }
     
-    // Also store in legacy shared buffer for backward compatibility
-    memcpy(hms_ble->data, rxValue.data(), std::min(rxValue.length(), (size_t)HMS_BLE_MAX_DATA_LENGTH - 1));
-    hms_ble->dataLength = std::min(rxValue.length(), (size_t)HMS_BLE_MAX_DATA_LENGTH - 1);
-    hms_ble->data[hms_ble->dataLength] = 0;
-    hms_ble->received = true;
+    // Receive ring + per-service and legacy shared buffers (NimBLE host task is the single producer)
+    hms_ble->storeReceivedData(serviceIndex, charIndex, rxValue.data(), rxValue.length());
+    const HMS_BLE_ServiceDescriptor& svc = hms_ble->services[serviceIndex];
 
-    BLE_LOGGER(debug, "Write on service %s, characteristic: %s (%d bytes)", serviceUUID, charUUID, hms_ble->dataLength);
+    BLE_LOGGER(debug, "Write on service %s, characteristic: %s (%d bytes)", serviceUUID, charUUID, svc.dataLength);
 
     if(hms_ble->writeCallback) {
         const uint8_t* macBytes = getMacAddressBytes(connInfo.getAddress());
-        hms_ble->writeCallback(serviceUUID, charUUID, hms_ble->data, hms_ble->dataLength, macBytes);
+        hms_ble->writeCallback(serviceUUID, charUUID, svc.data, svc.dataLength, macBytes);
     }
 }
 
 void HMS_BLE::BLEConnectionStatus::onDisconnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo, int reason) {
     if(!hms_ble) return;
     
-    // Clear subscription data for this client across all services
-    uint16_t connHandle = connInfo.getConnHandle();
-    uint8_t clientIndex = connHandle % HMS_BLE_MAX_CLIENTS;
-    
-    for(size_t s = 0; s < hms_ble->serviceCount; s++) {
-        for(size_t c = 0; c < hms_ble->services[s].characteristicCount; c++) {
-            hms_ble->services[s].notificationEnabled[c][clientIndex] = false;
-        }
-    }
-    
-    hms_ble->bleConnected = false;
+    // Frees the slot and drops this client's subscriptions across all services. NimBLE reports HCI reasons as
+    // BLE_HS_ERR_HCI_BASE + code, anything else is a host error and counts as 0x1F (Unspecified Error)
+    uint8_t hciReason = (reason >= BLE_HS_ERR_HCI_BASE && reason < BLE_HS_ERR_HCI_BASE + 0x100) ? (uint8_t)(reason - BLE_HS_ERR_HCI_BASE) : 0x1F;
+    hms_ble->closeConnection(hms_ble->findConnection(connInfo.getConnHandle()), hciReason);
+    hms_ble->signalEvent(HMS_BLE_EVENT_DISCONNECT);
     BLE_LOGGER(debug, "BLE Client Disconnected - Reason: %d", reason);
     if(hms_ble->connectionCallback) {
         const uint8_t* macBytes = getMacAddressBytes(connInfo.getAddress());
@@ -273,12 +425,13 @@ void HMS_BLE::BLEData::onSubscribe(NimBLECharacteristic* pCharacteristic, NimBLE
         return;
     }
 
-    uint16_t connHandle = connInfo.getConnHandle();
-    uint8_t clientIndex = connHandle % HMS_BLE_MAX_CLIENTS;
+    int clientIndex = hms_ble->findConnection(connInfo.getConnHandle());
+    if(clientIndex < 0) return;
     
-    bool notificationsEnabled = (subValue & 0x0001) != 0;
+    bool notificationsEnabled = (subValue & 0x0003) != 0;                                                  // Notifications or indications
     
-    hms_ble->services[serviceIndex].notificationEnabled[charIndex][clientIndex] = notificationsEnabled;
+    hms_ble->setSubscribed(clientIndex, serviceIndex, charIndex, notificationsEnabled, (subValue & 0x0002) != 0);
+    hms_ble->signalEvent(HMS_BLE_EVENT_SUBSCRIBE);
     
     BLE_LOGGER(debug, "Subscription changed on service %s, char %s (client %d): %s", 
         serviceUUID, charUUID, clientIndex, notificationsEnabled ? "ENABLED" : "DISABLED"
@@ -289,4 +442,17 @@ void HMS_BLE::BLEData::onSubscribe(NimBLECharacteristic* pCharacteristic, NimBLE
         hms_ble->notifyCallback(serviceUUID, charUUID, notificationsEnabled, macBytes);
     }
 }
+
+#if HMS_BLE_INDICATE_DEPTH
+void HMS_BLE::BLEData::onStatus(NimBLECharacteristic* pCharacteristic, int code) {
+    if(!hms_ble || code == 0) return;                                                                       // 0: a notification left
+    HMS_BLE_Status status = HMS_BLE_STATUS_ERROR_SEND;
+    if(code == BLE_HS_EDONE)         status = HMS_BLE_STATUS_SUCCESS;                                       // Confirmation received
+    else if(code == BLE_HS_ETIMEOUT) status = HMS_BLE_STATUS_ERROR_TIMEOUT;
+    else if(hms_ble->services[serviceIndex].characteristics[charIndex].properties & HMS_BLE_PROPERTY_NOTIFY) {
+        return;                                                                                             // A failed notification reports here too, it says nothing about the indication
+    }
+    hms_ble->completeOldestIndication(serviceIndex, charIndex, status);                                     // No-op when no indication is in flight
+}
+#endif
 #endif
\ No newline at end of file
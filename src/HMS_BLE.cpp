@@ -1,56 +1,177 @@
 #include "HMS_BLE.h"
 
-#if HMS_BLE_DEBUG_ENABLED
+#if HMS_BLE_TRACE_DEPTH && defined(HMS_BLE_PLATFORM_ZEPHYR) && defined(CONFIG_TRACING)
+    #include <zephyr/tracing/tracing.h>
+    #define HMS_BLE_TRACE_ZEPHYR
+#elif HMS_BLE_TRACE_DEPTH && defined(HMS_BLE_PLATFORM_DESKTOP) && defined(__linux__) && __has_include(<sys/sdt.h>)
+    #include <sys/sdt.h>
+    #define HMS_BLE_TRACE_USDT
+#endif
+
+#if HMS_BLE_LOG_DEFERRED
+    static bool logPending();                                                                           // Records waiting for the log handler, see Deferred Log
+#elif HMS_BLE_DEBUG_ENABLED && HMS_BLE_STATIC_ALLOCATION
+    static ChronoLogger bleLoggerStorage("HMS_BLE", HMS_BLE_LOG_LEVEL);                                 // Static storage, outlives every instance
+    ChronoLogger    *bleLogger             = &bleLoggerStorage;
+#elif HMS_BLE_DEBUG_ENABLED
     ChronoLogger    *bleLogger             = new ChronoLogger("HMS_BLE", HMS_BLE_LOG_LEVEL);
 #endif
 
 HMS_BLE*            HMS_BLE::instance   = nullptr;
 
 HMS_BLE::HMS_BLE(const char* deviceName): 
-    bleConnected(false), oldConnected(false), received(false), 
-    manufacturerDataSet(false), backgroundProcess(false), bleInitialized(false), 
-    dataLength(0), characteristicCount(0), serviceCount(0), advertisedServiceCount(0),
-    defaultServiceCreated(false), deviceName(deviceName) {
+    serviceCount(0), advertisedServiceCount(0),
+    #if HMS_BLE_LEGACY_API
+        received(false), dataLength(0),
+    #endif
+    #if HMS_BLE_LEGACY_API && HMS_BLE_RUNTIME_REGISTRATION
+        defaultServiceCreated(false), characteristicCount(0),
+    #endif
+    oldConnected(false), 
+    backgroundProcess(false), bleInitialized(false), 
+    deviceName(deviceName) {
 
 
     BLE_LOGGER(debug, "HMS_BLE instance created");
 
     instance = this;
-    memset(data, 0, sizeof(data));
-    memset(serviceUUID, 0, sizeof(serviceUUID));
+    #if HMS_BLE_LEGACY_API
+        memset(data, 0, sizeof(data));
+        memset(serviceUUID, 0, sizeof(serviceUUID));
+    #endif
     memset(advertisedServices, 0, sizeof(advertisedServices));
+    memset(&advPayload, 0, sizeof(advPayload));
+    memset(&advServiceDataUUID, 0, sizeof(advServiceDataUUID));
+    advManufacturerLength = 0;
+    advServiceDataLength = 0;
+    advCompanyId = 0;
+    memset(connectionIndex, 0xFF, sizeof(connectionIndex));
     
     // Initialize services array
     for(int s = 0; s < HMS_BLE_MAX_SERVICES; s++) {
-        services[s].service.uuid.clear();
-        services[s].service.name.clear();
+        #if HMS_BLE_RUNTIME_REGISTRATION
+            memset(&runtimeServices[s], 0, sizeof(runtimeServices[s]));
+            memset(runtimeCharacteristics[s], 0, sizeof(runtimeCharacteristics[s]));
+            services[s].service = &runtimeServices[s];
+            services[s].characteristics = runtimeCharacteristics[s];
+        #else
+            services[s].service = nullptr;
+            services[s].characteristics = nullptr;
+        #endif
         services[s].characteristicCount = 0;
         services[s].dataLength = 0;
         services[s].received = false;
         memset(services[s].data, 0, sizeof(services[s].data));
         
+        memset(services[s].subscribers, 0, sizeof(services[s].subscribers));
+        
         for(int c = 0; c < HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE; c++) {
-            services[s].characteristics[c].uuid.clear();
-            services[s].characteristics[c].name.clear();
-            services[s].characteristics[c].properties = (HMS_BLE_CharacteristicProperty)0;
             #if defined(HMS_BLE_ARDUINO_ESP32)
                 services[s].bleCharacteristics[c] = nullptr;
-                for(int k = 0; k < HMS_BLE_MAX_CLIENTS; k++) {
-                    services[s].notificationEnabled[c][k] = false;
-                }
+            #elif defined(HMS_BLE_DESKTOP_SIM)
+                services[s].valueLengths[c] = 0;
+                memset(services[s].values[c], 0, sizeof(services[s].values[c]));
             #endif
         }
         #if defined(HMS_BLE_ARDUINO_ESP32)
             services[s].bleService = nullptr;
         #endif
+        #if HMS_BLE_NOTIFY_QUEUE
+            memset(services[s].pendingLengths, 0, sizeof(services[s].pendingLengths));
+            memset(services[s].pendingQueued, 0, sizeof(services[s].pendingQueued));
+            memset(services[s].pendingDirty, 0, sizeof(services[s].pendingDirty));
+        #endif
     }
+
+    #if HMS_BLE_VALUE_CACHE
+        for(int s = 0; s < HMS_BLE_MAX_SERVICES; s++) {
+            memset(services[s].cachedLengths, 0, sizeof(services[s].cachedLengths));
+            memset(services[s].readPolicies, HMS_BLE_READ_CACHED, sizeof(services[s].readPolicies));
+            memset(services[s].notifyOnChange, 0, sizeof(services[s].notifyOnChange));
+        }
+        #if defined(HMS_BLE_ZEPHYR_nRF)
+            memset(&valueCacheSpinlock, 0, sizeof(valueCacheSpinlock));
+        #endif
+    #endif
+
+    #if HMS_BLE_MAX_STREAMS
+        for(int i = 0; i < HMS_BLE_MAX_STREAMS; i++) {
+            streams[i].handle = HMS_BLE_INVALID_CHAR_HANDLE.id;
+            streams[i].txActive = false;
+            streams[i].rxActive = false;
+        }
+    #endif
+
+    #if HMS_BLE_TX_CREDITS
+        for(int i = 0; i < HMS_BLE_TX_CREDITS; i++) {
+            txSlots[i].used = false;
+            txSlots[i].generation = 0;
+            memset(txSlots[i].links, 0, sizeof(txSlots[i].links));
+        }
+        txFree = HMS_BLE_TX_CREDITS;
+        memset(&txStats, 0, sizeof(txStats));
+        #if defined(HMS_BLE_ZEPHYR_nRF)
+            memset(&txSpinlock, 0, sizeof(txSpinlock));
+        #endif
+    #endif
+
+    #if HMS_BLE_INDICATE_DEPTH
+        for(int s = 0; s < HMS_BLE_MAX_SERVICES; s++) {
+            memset(services[s].indicators, 0, sizeof(services[s].indicators));
+        }
+        for(int l = 0; l < HMS_BLE_MAX_CLIENTS; l++) {
+            IndicationLink& link = indicationLinks[l];
+            for(int i = 0; i < HMS_BLE_INDICATE_DEPTH; i++) {
+                link.entries[i].state = HMS_BLE_INDICATION_FREE;
+                link.entries[i].generation = 0;
+            }
+            link.nextSequence = 0;
+            link.lastHandle = 0;
+            link.queued = 0;
+            link.inFlight = 0;
+            link.stalled = false;
+            link.retry = false;
+            link.pumping = false;
+        }
+        memset(&indicationStats, 0, sizeof(indicationStats));
+        #if defined(HMS_BLE_ZEPHYR_nRF)
+            memset(&indicationSpinlock, 0, sizeof(indicationSpinlock));
+        #endif
+    #endif
+
+    #if HMS_BLE_LINK_PROFILES
+        memset(linkProfiles, 0, sizeof(linkProfiles));
+        linkProfiles[HMS_BLE_LINK_PROFILE_LOW_LATENCY]     = {   6,  12, 0, 200, HMS_BLE_PHY_2M, 251 };            // 7.5-15 ms, 2 s timeout
+        linkProfiles[HMS_BLE_LINK_PROFILE_HIGH_THROUGHPUT] = {  12,  24, 0, 400, HMS_BLE_PHY_2M, 251 };            // 15-30 ms, 4 s timeout
+        linkProfiles[HMS_BLE_LINK_PROFILE_LOW_POWER]       = {  80, 160, 4, 600, HMS_BLE_PHY_1M,   0 };            // 100-200 ms, skips 4 events, 6 s timeout
+    #endif
+
+    #if HMS_BLE_BROADCAST_SETS
+        for(int i = 0; i < HMS_BLE_BROADCAST_SETS; i++) {
+            broadcastSets[i].used = false;
+            broadcastSets[i].frame = 0;
+            memset(broadcastSets[i].frameLengths, 0, sizeof(broadcastSets[i].frameLengths));
+        }
+    #endif
+
+    #if HMS_BLE_NOTIFY_QUEUE
+        notifyQueueHead = 0;
+        notifyQueueCount = 0;
+        notifyQueueDraining = false;
+        memset(&notifyQueueStats, 0, sizeof(notifyQueueStats));
+        #if defined(HMS_BLE_ZEPHYR_nRF)
+            memset(&notifyQueueSpinlock, 0, sizeof(notifyQueueSpinlock));
+        #endif
+    #endif
     
-    // Legacy: initialize flat characteristics array
-    for(int i = 0; i < HMS_BLE_MAX_CHARACTERISTICS; i++) {
-        characteristics[i].uuid.clear();
-        characteristics[i].name.clear();
-        characteristics[i].properties = (HMS_BLE_CharacteristicProperty)0;
-    }
+    #if HMS_BLE_LEGACY_API && HMS_BLE_RUNTIME_REGISTRATION
+        // Legacy: initialize flat characteristics array
+        for(int i = 0; i < HMS_BLE_MAX_CHARACTERISTICS; i++) {
+            characteristics[i].uuid.clear();
+            characteristics[i].name.clear();
+            characteristics[i].properties = (HMS_BLE_CharacteristicProperty)0;
+        }
+    #endif
 }
 
 HMS_BLE::~HMS_BLE() {
@@ -58,30 +179,32 @@ HMS_BLE::~HMS_BLE() {
 
     if (instance) instance = nullptr;
 
-    memset(data, 0, sizeof(data));
-    memset(serviceUUID, 0, sizeof(serviceUUID));
+    #if HMS_BLE_LEGACY_API
+        memset(data, 0, sizeof(data));
+        memset(serviceUUID, 0, sizeof(serviceUUID));
+    #endif
     
     // Clear services array
     for(int s = 0; s < HMS_BLE_MAX_SERVICES; s++) {
-        services[s].service.uuid.clear();
-        services[s].service.name.clear();
         services[s].characteristicCount = 0;
-        for(int c = 0; c < HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE; c++) {
-            services[s].characteristics[c].uuid.clear();
-            services[s].characteristics[c].name.clear();
-            services[s].characteristics[c].properties = (HMS_BLE_CharacteristicProperty)0;
-        }
     }
+    serviceCount = 0;
     
-    // Legacy: clear flat array
-    for(int i = 0; i < HMS_BLE_MAX_CHARACTERISTICS; i++) {
-        characteristics[i].uuid.clear();
-        characteristics[i].name.clear();
-        characteristics[i].properties = (HMS_BLE_CharacteristicProperty)0;
-    }
+    #if HMS_BLE_RUNTIME_REGISTRATION
+        memset(runtimeServices, 0, sizeof(runtimeServices));
+        memset(runtimeCharacteristics, 0, sizeof(runtimeCharacteristics));
+    #endif
+    #if HMS_BLE_LEGACY_API && HMS_BLE_RUNTIME_REGISTRATION
+        // Legacy: clear flat array
+        for(int i = 0; i < HMS_BLE_MAX_CHARACTERISTICS; i++) {
+            characteristics[i].uuid.clear();
+            characteristics[i].name.clear();
+            characteristics[i].properties = (HMS_BLE_CharacteristicProperty)0;
+        }
+    #endif
     
     BLE_LOGGER(debug, "HMS_BLE instance destroyed");
-    #if HMS_BLE_DEBUG_ENABLED
+    #if HMS_BLE_DEBUG_ENABLED && !HMS_BLE_STATIC_ALLOCATION && !HMS_BLE_LOG_DEFERRED
         if(bleLogger) {
             delete bleLogger;
             bleLogger = nullptr;
@@ -91,18 +214,53 @@ HMS_BLE::~HMS_BLE() {
 }
 
 void HMS_BLE::loop() {
-    if(backgroundProcess) {
-        if (!bleConnected && oldConnected) {
-            BLE_LOGGER(info, "Client disconnected, restarting advertising");
-            bleDelay(500);                                                                              // Small delay to ensure proper disconnection handling
-            oldConnected = bleConnected;
+    uint32_t events = pendingEvents.exchange(0, std::memory_order_acquire);
+    if(events) {
+        uint32_t latency = eventClockMicros() - pendingEventTime.load(std::memory_order_relaxed);
+        taskHandled.fetch_add(1, std::memory_order_relaxed);
+        taskLastLatencyUs.store(latency, std::memory_order_relaxed);
+        taskTotalLatencyUs.fetch_add(latency, std::memory_order_relaxed);
+        if(latency > taskMaxLatencyUs.load(std::memory_order_relaxed)) {
+            taskMaxLatencyUs.store(latency, std::memory_order_relaxed);                                 // Single writer (the loop() caller)
         }
+        trace(HMS_BLE_TRACE_TASK, -1, 0xFFFF, events, (int32_t)std::min(latency, (uint32_t)INT16_MAX));
+    }
 
-        if(received) {
-            BLE_LOGGER(debug, "Data received, invoking callback");
-            received = false;
+    if(backgroundProcess) {
+        if (!isConnected() && oldConnected) {
+            BLE_LOGGER(info, "Client disconnected, restarting advertising");                            // Backends restart advertising from their disconnect callback
+            oldConnected = false;
         }
+
+        #if HMS_BLE_LEGACY_API
+            if(received) {
+                BLE_LOGGER(debug, "Data received, invoking callback");
+                received = false;
+            }
+        #endif
     }
+
+    #if HMS_BLE_INGEST_BYTES
+        processIngest();
+    #endif
+    #if defined(HMS_BLE_ZEPHYR_nRF)
+        zephyrRetryNotifications();                                                                     // Links that refused a notification for want of a buffer
+    #endif
+    #if HMS_BLE_NOTIFY_QUEUE
+        drainNotifyQueue();
+    #endif
+    #if HMS_BLE_MAX_STREAMS
+        pumpStreams();
+    #endif
+    #if HMS_BLE_INDICATE_DEPTH
+        serviceIndications();
+    #endif
+    #if HMS_BLE_BROADCAST_SETS
+        rotateBroadcasts();
+    #endif
+    #if HMS_BLE_LOG_DEFERRED
+        flushLog();                                                                                     // Formats on this thread, never on the caller of BLE_LOGGER
+    #endif
 }
 
 void HMS_BLE::bleDelay(uint32_t ms) {
@@ -117,36 +275,612 @@ void HMS_BLE::bleDelay(uint32_t ms) {
     #endif
 }
 
+// ========== Background Task Events ==========
+/*
+  Backends call signalEvent() from their connect/disconnect/write/subscribe callbacks and submitData() calls it when a
+  notification is queued. The background task sleeps in waitForEvents() until then instead of polling, so an idle link costs
+  no wakeups and an event is handled as soon as the scheduler runs the task.
+*/
+
+void HMS_BLE::signalEvent(uint32_t events) {
+    if(pendingEvents.load(std::memory_order_relaxed) == 0) {
+        pendingEventTime.store(eventClockMicros(), std::memory_order_relaxed);                          // Oldest unhandled event starts the latency clock
+    }
+    pendingEvents.fetch_or(events, std::memory_order_release);
+    if(!backgroundProcess) return;                                                                      // Nobody waits, the application's loop() picks the bits up
+
+    #if defined(HMS_BLE_PLATFORM_DESKTOP)
+        { std::lock_guard<std::mutex> lock(desktopEventMutex); }                                        // Orders the flag update against the waiter's predicate check
+        desktopEventCondition.notify_one();
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+        k_sem_give(&zephyrEventSem);
+    #elif defined(HMS_BLE_ARDUINO_ESP32)
+        if(bleTaskHandle) xTaskNotifyGive(bleTaskHandle);
+    #endif
+}
+
+void HMS_BLE::waitForEvents(uint32_t timeoutMs) {
+    #if defined(HMS_BLE_PLATFORM_DESKTOP)
+        std::unique_lock<std::mutex> lock(desktopEventMutex);
+        auto pending = [this] { return pendingEvents.load(std::memory_order_acquire) != 0; };
+        if(timeoutMs) desktopEventCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), pending);
+        else          desktopEventCondition.wait(lock, pending);
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+        k_sem_take(&zephyrEventSem, timeoutMs ? K_MSEC(timeoutMs) : K_FOREVER);
+    #elif defined(HMS_BLE_ARDUINO_ESP32)
+        ulTaskNotifyTake(pdTRUE, timeoutMs ? pdMS_TO_TICKS(timeoutMs) : portMAX_DELAY);
+    #else
+        bleDelay(timeoutMs ? timeoutMs : 10);                                                           // No wait primitive wired up for this platform yet
+    #endif
+    taskWakeups.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HMS_BLE::backgroundStep() {
+    uint32_t timeoutMs = 0;
+    #if HMS_BLE_NOTIFY_QUEUE
+        if(getNotifyQueueDepth() > 0) timeoutMs = sendRetryMs();                                       // Drain was deferred (no TX buffer, or the link batch was sent)
+    #endif
+    #if HMS_BLE_MAX_STREAMS
+        for(int i = 0; i < HMS_BLE_MAX_STREAMS; i++) {
+            if(streams[i].txActive.load(std::memory_order_acquire)) timeoutMs = sendRetryMs();
+        }
+    #endif
+    #if defined(HMS_BLE_ZEPHYR_nRF)
+        if(zephyrRetryToken.load(std::memory_order_relaxed) != -1) timeoutMs = sendRetryMs();           // A notification still owed to some links
+    #endif
+    #if HMS_BLE_INDICATE_DEPTH
+        uint32_t indicationMs = indicationWaitMs();                                                     // Next confirmation deadline, or a deferred hand-off
+        if(indicationMs && (!timeoutMs || timeoutMs > indicationMs)) timeoutMs = indicationMs;
+    #endif
+    #if HMS_BLE_BROADCAST_SETS
+        uint32_t broadcastMs = broadcastWaitMs();                                                       // Next frame switch
+        if(broadcastMs && (!timeoutMs || timeoutMs > broadcastMs)) timeoutMs = broadcastMs;
+    #endif
+    #if HMS_BLE_LOG_DEFERRED
+        if(logPending() && (!timeoutMs || timeoutMs > HMS_BLE_LOG_FLUSH_MS)) timeoutMs = HMS_BLE_LOG_FLUSH_MS;
+    #endif
+    if(pendingEvents.load(std::memory_order_acquire) == 0) {                                            // Events raised before the task existed are handled right away
+        waitForEvents(timeoutMs);
+    }
+    loop();
+}
+
+uint32_t HMS_BLE::eventClockMicros() {
+    #if defined(HMS_BLE_PLATFORM_DESKTOP)
+        return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    #elif defined(HMS_BLE_PLATFORM_ZEPHYR)
+        return k_cyc_to_us_floor32(k_cycle_get_32());
+    #elif defined(HMS_BLE_PLATFORM_ARDUINO)
+        return micros();
+    #elif defined(HMS_BLE_PLATFORM_STM32_HAL)
+        return HAL_GetTick() * 1000;
+    #else
+        return 0;
+    #endif
+}
+
+HMS_BLE_TaskStats HMS_BLE::getTaskStats() const {
+    HMS_BLE_TaskStats stats;
+    stats.wakeups        = taskWakeups.load(std::memory_order_relaxed);
+    stats.handled        = taskHandled.load(std::memory_order_relaxed);
+    stats.lastLatencyUs  = taskLastLatencyUs.load(std::memory_order_relaxed);
+    stats.maxLatencyUs   = taskMaxLatencyUs.load(std::memory_order_relaxed);
+    stats.totalLatencyUs = taskTotalLatencyUs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void HMS_BLE::resetTaskStats() {
+    taskWakeups.store(0, std::memory_order_relaxed);
+    taskHandled.store(0, std::memory_order_relaxed);
+    taskLastLatencyUs.store(0, std::memory_order_relaxed);
+    taskMaxLatencyUs.store(0, std::memory_order_relaxed);
+    taskTotalLatencyUs.store(0, std::memory_order_relaxed);
+}
+
+// ========== Statistics ==========
+
+/*
+  Always compiled in: each counter is a relaxed atomic bumped where the event already happens (send result, connection table,
+  read/write dispatch), so the cost is one uncontended add and nothing is formatted. Counters wrap at 2^32; a collector
+  should report deltas between snapshots.
+*/
+static HMS_BLE_DisconnectReason classifyDisconnect(uint8_t reason) {
+    switch(reason) {
+        case 0x08: return HMS_BLE_DISCONNECT_TIMEOUT;
+        case 0x13: return HMS_BLE_DISCONNECT_REMOTE_USER;
+        case 0x14:
+        case 0x15: return HMS_BLE_DISCONNECT_REMOTE_POWER;
+        case 0x16: return HMS_BLE_DISCONNECT_LOCAL_HOST;
+        case 0x3D: return HMS_BLE_DISCONNECT_MIC_FAILURE;
+        case 0x3E: return HMS_BLE_DISCONNECT_FAILED_TO_ESTABLISH;
+        default:   return HMS_BLE_DISCONNECT_OTHER;
+    }
+}
+
+HMS_BLE_Stats HMS_BLE::getStats() const {
+    HMS_BLE_Stats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.connections        = statConnections.load(std::memory_order_relaxed);
+    stats.refusedConnections = statRefusedConnections.load(std::memory_order_relaxed);
+    stats.disconnections     = statDisconnections.load(std::memory_order_relaxed);
+    for(int i = 0; i < HMS_BLE_DISCONNECT_REASON_COUNT; i++) stats.disconnectReasons[i] = statDisconnectReasons[i].load(std::memory_order_relaxed);
+    stats.lastDisconnectReason = statLastDisconnectReason.load(std::memory_order_relaxed);
+    for(int i = 0; i < HMS_BLE_STATUS_COUNT; i++) stats.sendErrors[i] = statSendErrors[i].load(std::memory_order_relaxed);
+    for(int s = 0; s < HMS_BLE_MAX_SERVICES; s++) {
+        for(int c = 0; c < HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE; c++) {
+            const CharCounters& counters = charCounters[s][c];
+            stats.notifications += counters.notifications.load(std::memory_order_relaxed);
+            stats.indications   += counters.indications.load(std::memory_order_relaxed);
+            stats.bytesSent     += counters.bytesSent.load(std::memory_order_relaxed);
+            stats.reads         += counters.reads.load(std::memory_order_relaxed);
+            stats.writes        += counters.writes.load(std::memory_order_relaxed);
+            stats.bytesWritten  += counters.bytesWritten.load(std::memory_order_relaxed);
+        }
+    }
+    stats.coalesced = statCoalesced.load(std::memory_order_relaxed);
+    stats.dropped   = statDropped.load(std::memory_order_relaxed);
+    stats.wakeups   = taskWakeups.load(std::memory_order_relaxed);
+    stats.stackFree = taskStackFree();
+    return stats;
+}
+
+HMS_BLE_CharStats HMS_BLE::getCharacteristicStats(HMS_BLE_CharHandle handle) const {
+    HMS_BLE_CharStats stats;
+    memset(&stats, 0, sizeof(stats));
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return stats;
+    const CharCounters& counters = charCounters[svcIdx][charIdx];
+    stats.notifications = counters.notifications.load(std::memory_order_relaxed);
+    stats.indications   = counters.indications.load(std::memory_order_relaxed);
+    stats.bytesSent     = counters.bytesSent.load(std::memory_order_relaxed);
+    stats.reads         = counters.reads.load(std::memory_order_relaxed);
+    stats.writes        = counters.writes.load(std::memory_order_relaxed);
+    stats.bytesWritten  = counters.bytesWritten.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void HMS_BLE::resetStats() {
+    statConnections.store(0, std::memory_order_relaxed);
+    statRefusedConnections.store(0, std::memory_order_relaxed);
+    statDisconnections.store(0, std::memory_order_relaxed);
+    for(int i = 0; i < HMS_BLE_DISCONNECT_REASON_COUNT; i++) statDisconnectReasons[i].store(0, std::memory_order_relaxed);
+    statLastDisconnectReason.store(0, std::memory_order_relaxed);
+    for(int i = 0; i < HMS_BLE_STATUS_COUNT; i++) statSendErrors[i].store(0, std::memory_order_relaxed);
+    for(int s = 0; s < HMS_BLE_MAX_SERVICES; s++) {
+        for(int c = 0; c < HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE; c++) {
+            CharCounters& counters = charCounters[s][c];
+            counters.notifications.store(0, std::memory_order_relaxed);
+            counters.indications.store(0, std::memory_order_relaxed);
+            counters.bytesSent.store(0, std::memory_order_relaxed);
+            counters.reads.store(0, std::memory_order_relaxed);
+            counters.writes.store(0, std::memory_order_relaxed);
+            counters.bytesWritten.store(0, std::memory_order_relaxed);
+        }
+    }
+    statCoalesced.store(0, std::memory_order_relaxed);
+    statDropped.store(0, std::memory_order_relaxed);
+    resetTaskStats();
+}
+
+HMS_BLE_Status HMS_BLE::stackSend(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_SendCallback* done) {
+    HMS_BLE_Status status = sendDataInternal(serviceIndex, charIndex, data, length, done);
+    trace(HMS_BLE_TRACE_NOTIFY, -1, encodeHandle(serviceIndex, charIndex).id, length, status);
+    if(status == HMS_BLE_STATUS_SUCCESS) {
+        if(hasSubscribers(serviceIndex, charIndex)) {                                                    // Otherwise only the stored value changed
+            CharCounters& counters = charCounters[serviceIndex][charIndex];
+            counters.notifications.fetch_add(1, std::memory_order_relaxed);
+            counters.bytesSent.fetch_add((uint32_t)length, std::memory_order_relaxed);
+        }
+    } else if(-status < HMS_BLE_STATUS_COUNT) {
+        statSendErrors[-status].fetch_add(1, std::memory_order_relaxed);
+    }
+    return status;
+}
+
+// ========== Trace ==========
+
+#if HMS_BLE_TRACE_DEPTH
+/*
+  Flight recorder for the hot paths: 16-byte binary records, no formatting, so enabling it does not move the timing the way
+  HMS_BLE_DEBUG does. Writers claim a record number with one atomic add and fill the slot it maps to; the slot's sequence is 0
+  while it is written and the record number once complete, so readTrace() can copy without a lock and drop a slot that changed
+  under it. The oldest records are overwritten when the ring is full. Each record is also forwarded to the OS tracer when one
+  is there: sys_trace_named_event() with CONFIG_TRACING on Zephyr, a USDT probe (hms_ble:trace) on Linux when <sys/sdt.h> exists.
+*/
+#if defined(HMS_BLE_TRACE_ZEPHYR)
+static const char* const traceEventNames[] = {
+    "hms_ble", "hms_ble_connect", "hms_ble_disconnect", "hms_ble_subscribe", "hms_ble_write", "hms_ble_read",
+    "hms_ble_notify", "hms_ble_tx_done", "hms_ble_queue", "hms_ble_task", "hms_ble_mtu", "hms_ble_indicate", "hms_ble_confirm",
+    "hms_ble_link", "hms_ble_broadcast"
+};
+#endif
+
+void HMS_BLE::trace(HMS_BLE_TraceEventId event, int slot, uint16_t handle, uint32_t length, int32_t status) {
+    uint32_t timestamp = eventClockMicros();
+    uint32_t where = handle | (std::min(length, (uint32_t)0xFFFF) << 16);
+    int32_t clamped = std::max(std::min(status, (int32_t)INT16_MAX), (int32_t)INT16_MIN);
+    uint32_t what = (uint32_t)event | ((uint32_t)(uint8_t)slot << 8) | ((uint32_t)(uint16_t)clamped << 16);
+
+    uint32_t sequence = traceHead.fetch_add(1, std::memory_order_relaxed) + 1;
+    TraceSlot& record = traceRing[(sequence - 1) & (HMS_BLE_TRACE_DEPTH - 1)];
+    record.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);                                                // Readers see 0 before any new field
+    record.timestamp.store(timestamp, std::memory_order_relaxed);
+    record.where.store(where, std::memory_order_relaxed);
+    record.what.store(what, std::memory_order_relaxed);
+    record.sequence.store(sequence, std::memory_order_release);
+
+    #if defined(HMS_BLE_TRACE_ZEPHYR)
+        sys_trace_named_event(traceEventNames[event < sizeof(traceEventNames) / sizeof(traceEventNames[0]) ? event : 0], ((uint32_t)(uint8_t)slot << 16) | handle,
+            ((uint32_t)(uint16_t)clamped << 16) | (where >> 16));
+    #elif defined(HMS_BLE_TRACE_USDT)
+        DTRACE_PROBE5(hms_ble, trace, (int)event, slot, (int)handle, (int)length, (int)status);
+    #endif
+}
+
+bool HMS_BLE::copyTraceRecord(uint32_t sequence, HMS_BLE_TraceRecord* record) const {
+    const TraceSlot& slot = traceRing[(sequence - 1) & (HMS_BLE_TRACE_DEPTH - 1)];
+    if(slot.sequence.load(std::memory_order_acquire) != sequence) return false;                         // Still being written, or already reused
+    uint32_t timestamp = slot.timestamp.load(std::memory_order_relaxed);
+    uint32_t where = slot.where.load(std::memory_order_relaxed);
+    uint32_t what = slot.what.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(slot.sequence.load(std::memory_order_relaxed) != sequence) return false;                         // Overwritten while copying
+
+    record->timestamp = timestamp;
+    record->sequence  = sequence - traceBase.load(std::memory_order_relaxed);
+    record->handle    = where & 0xFFFF;
+    record->length    = where >> 16;
+    record->event     = what & 0xFF;
+    record->slot      = (what >> 8) & 0xFF;
+    record->status    = (int16_t)(what >> 16);
+    return true;
+}
+
+uint32_t HMS_BLE::firstTraceSequence(uint32_t head, size_t capacity) const {
+    uint32_t available = std::min(head - traceBase.load(std::memory_order_relaxed), (uint32_t)HMS_BLE_TRACE_DEPTH);
+    return head - (uint32_t)std::min((size_t)available, capacity) + 1;
+}
+
+size_t HMS_BLE::readTrace(HMS_BLE_TraceRecord* records, size_t capacity) const {
+    if(!records) return 0;
+    uint32_t head = traceHead.load(std::memory_order_acquire);
+    size_t count = 0;
+    for(uint32_t sequence = firstTraceSequence(head, capacity); sequence != head + 1; sequence++) {
+        if(copyTraceRecord(sequence, &records[count])) count++;
+    }
+    return count;
+}
+
+/*
+  The records are copied one at a time, so the buffer needs no alignment (a UART or flash buffer will do). Layout is the
+  in-memory one, little-endian on every supported target.
+*/
+size_t HMS_BLE::dumpTrace(uint8_t* buffer, size_t size) const {
+    if(!buffer || size < sizeof(HMS_BLE_TraceDumpHeader)) return 0;
+    size_t capacity = (size - sizeof(HMS_BLE_TraceDumpHeader)) / sizeof(HMS_BLE_TraceRecord);
+    uint32_t head = traceHead.load(std::memory_order_acquire);
+    uint32_t claimed = head - traceBase.load(std::memory_order_relaxed);
+
+    uint8_t* out = buffer + sizeof(HMS_BLE_TraceDumpHeader);
+    HMS_BLE_TraceRecord record;
+    size_t count = 0;
+    uint32_t last = 0;
+    for(uint32_t sequence = firstTraceSequence(head, capacity); sequence != head + 1 && count < capacity; sequence++) {
+        if(!copyTraceRecord(sequence, &record)) continue;
+        memcpy(out + count * sizeof(record), &record, sizeof(record));
+        last = record.sequence;
+        count++;
+    }
+
+    HMS_BLE_TraceDumpHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "HMSTRACE", sizeof(header.magic));
+    header.version    = HMS_BLE_TRACE_FORMAT_VERSION;
+    header.recordSize = sizeof(HMS_BLE_TraceRecord);
+    header.count      = (uint32_t)count;
+    header.dropped    = count ? last - (uint32_t)count : claimed;                                     // Overwritten before the first record kept, or skipped
+    memcpy(buffer, &header, sizeof(header));
+    return sizeof(header) + count * sizeof(HMS_BLE_TraceRecord);
+}
+
+void HMS_BLE::clearTrace() {
+    traceBase.store(traceHead.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+#endif
+
+// ========== Deferred Log ==========
+
+#if HMS_BLE_LOG_DEFERRED
+/*
+  BLE_LOGGER records land here as format id + raw arguments (see HMS_BLE_LogWrite()), written the way the trace ring is: one
+  atomic add claims a record number, the slot's sequence is 0 while it is filled. One consumer at a time (flushLog(),
+  dumpLog(), or loop() when a handler is set) walks the records from its tail; a record still being written stops it until
+  the next pass, records overwritten before it got there are counted as lost. The ring is shared by every HMS_BLE instance
+  because BLE_LOGGER is.
+*/
+struct HMS_BLE_LogSlot {
+    std::atomic<uint32_t>               sequence{0};                                                    // Absolute record number, 0 while the slot is being written
+    std::atomic<uint32_t>               timestamp{0};
+    std::atomic<const HMS_BLE_LogSite*> site{nullptr};
+    std::atomic<uint32_t>               length{0};
+    std::atomic<uint32_t>               words[HMS_BLE_LOG_PAYLOAD / 4];
+};
+
+static HMS_BLE_LogSlot      logRing[HMS_BLE_LOG_DEPTH];
+static std::atomic<uint32_t> logHead{0};                                                                // Records claimed since start
+static uint32_t             logTail = 0;                                                                // Records consumed, owned by whoever holds logDraining
+static std::atomic<uint32_t> logLost{0};
+static std::atomic_flag     logDraining = ATOMIC_FLAG_INIT;
+static HMS_BLE_LogHandler   logHandler;
+
+void HMS_BLE_LogCommit(const HMS_BLE_LogSite* site, const uint8_t* payload, size_t length) {
+    uint32_t timestamp = HMS_BLE::eventClockMicros();
+    uint32_t sequence = logHead.fetch_add(1, std::memory_order_relaxed) + 1;
+    HMS_BLE_LogSlot& slot = logRing[(sequence - 1) & (HMS_BLE_LOG_DEPTH - 1)];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);                                                // Readers see 0 before any new field
+    slot.timestamp.store(timestamp, std::memory_order_relaxed);
+    slot.site.store(site, std::memory_order_relaxed);
+    slot.length.store((uint32_t)length, std::memory_order_relaxed);
+    for(size_t i = 0; i * 4 < length; i++) {
+        uint32_t word;
+        memcpy(&word, payload + i * 4, 4);                                                              // payload is a whole HMS_BLE_LogArguments buffer
+        slot.words[i].store(word, std::memory_order_relaxed);
+    }
+    slot.sequence.store(sequence, std::memory_order_release);
+}
+
+// Next record after logTail, false when there is none or the next one is still being written. Caller holds logDraining.
+static bool takeLogRecord(HMS_BLE_LogRecord* record, const HMS_BLE_LogSite** site) {
+    uint32_t head = logHead.load(std::memory_order_acquire);
+    if(head - logTail > HMS_BLE_LOG_DEPTH) {
+        logLost.fetch_add(head - logTail - HMS_BLE_LOG_DEPTH, std::memory_order_relaxed);
+        logTail = head - HMS_BLE_LOG_DEPTH;
+    }
+    while(logTail != head) {
+        uint32_t sequence = logTail + 1;
+        const HMS_BLE_LogSlot& slot = logRing[(sequence - 1) & (HMS_BLE_LOG_DEPTH - 1)];
+        uint32_t seen = slot.sequence.load(std::memory_order_acquire);
+        if(seen == 0 || (int32_t)(seen - sequence) < 0) return false;                                   // Writer has not finished, retry on the next pass
+
+        if(seen == sequence) {
+            record->timestamp = slot.timestamp.load(std::memory_order_relaxed);
+            *site = slot.site.load(std::memory_order_relaxed);
+            uint32_t length = std::min(slot.length.load(std::memory_order_relaxed), (uint32_t)HMS_BLE_LOG_PAYLOAD);
+            for(uint32_t i = 0; i * 4 < length; i++) {
+                uint32_t word = slot.words[i].load(std::memory_order_relaxed);
+                memcpy(record->payload + i * 4, &word, 4);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(slot.sequence.load(std::memory_order_relaxed) == sequence) {
+                logTail = sequence;
+                record->sequence = sequence;
+                record->id       = (*site)->id;
+                record->level    = (*site)->level;
+                record->length   = (uint8_t)length;
+                record->reserved[0] = record->reserved[1] = 0;
+                return true;
+            }
+        }
+        logLost.fetch_add(1, std::memory_order_relaxed);                                                // Overwritten before or while it was copied
+        logTail = sequence;
+    }
+    return false;
+}
+
+void HMS_BLE::setLogHandler(HMS_BLE_LogHandler handler) {
+    logHandler = handler;                                                                               // Set it before begin() or from the thread that runs loop()
+}
+
+size_t HMS_BLE::flushLog() {
+    if(!logHandler || logDraining.test_and_set(std::memory_order_acquire)) return 0;
+    HMS_BLE_LogRecord record;
+    const HMS_BLE_LogSite* site;
+    char line[160];
+    size_t count = 0;
+    while(takeLogRecord(&record, &site)) {
+        HMS_BLE_LogFormat(site->format, record.payload, record.length, line, sizeof(line));
+        logHandler(record.level, record.timestamp, line);
+        count++;
+    }
+    logDraining.clear(std::memory_order_release);
+    return count;
+}
+
+/*
+  Like dumpTrace(), records are copied one at a time so the buffer needs no alignment. What is dumped is consumed: a later
+  flushLog() or dumpLog() starts after it.
+*/
+size_t HMS_BLE::dumpLog(uint8_t* buffer, size_t size) {
+    if(!buffer || size < sizeof(HMS_BLE_LogDumpHeader) || logDraining.test_and_set(std::memory_order_acquire)) return 0;
+    size_t capacity = (size - sizeof(HMS_BLE_LogDumpHeader)) / sizeof(HMS_BLE_LogRecord);
+    uint8_t* out = buffer + sizeof(HMS_BLE_LogDumpHeader);
+    HMS_BLE_LogRecord record;
+    const HMS_BLE_LogSite* site;
+    size_t count = 0;
+    while(count < capacity && takeLogRecord(&record, &site)) {
+        memset(record.payload + record.length, 0, sizeof(record.payload) - record.length);
+        memcpy(out + count * sizeof(record), &record, sizeof(record));
+        count++;
+    }
+    logDraining.clear(std::memory_order_release);
+
+    HMS_BLE_LogDumpHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "HMSLOG", 6);
+    header.version    = HMS_BLE_LOG_FORMAT_VERSION;
+    header.recordSize = sizeof(HMS_BLE_LogRecord);
+    header.count      = (uint32_t)count;
+    header.lost       = logLost.load(std::memory_order_relaxed);
+    memcpy(buffer, &header, sizeof(header));
+    return sizeof(header) + count * sizeof(HMS_BLE_LogRecord);
+}
+
+static bool logPending() {
+    return logHandler && logHead.load(std::memory_order_relaxed) != logTail;                            // Racy read, only decides whether to wake up for a flush
+}
+#endif
+
+#if HMS_BLE_LOG_DEFERRED || defined(HMS_BLE_PLATFORM_DESKTOP)
+/*
+  printf with the arguments of a deferred record. Each conversion takes the next tagged argument; length modifiers in the
+  format are ignored and rebuilt from the recorded width, so "%d" of an int and "%zu" of a size_t come out as printf would
+  have printed them at the call site. A missing or mismatched argument prints <?>. Also used by the host decoder.
+*/
+size_t HMS_BLE_LogFormat(const char* format, const uint8_t* payload, size_t length, char* out, size_t size) {
+    if(!out || !size) return 0;
+    size_t used = 0, offset = 0;
+    auto append = [&](int written) {
+        if(written > 0) used = std::min(used + (size_t)written, size - 1);
+    };
+    auto room = [&]() { return size - used; };
+
+    for(const char* p = format; *p; p++) {
+        if(*p != '%') {
+            if(used < size - 1) out[used++] = *p;
+            continue;
+        }
+        if(p[1] == '%') {
+            if(used < size - 1) out[used++] = '%';
+            p++;
+            continue;
+        }
+
+        char spec[24] = "%";
+        size_t specLength = 1;
+        p++;
+        while(*p && strchr("-+ #0123456789.", *p) && specLength < sizeof(spec) - 5) spec[specLength++] = *p++;
+        while(*p && strchr("hljztLq", *p)) p++;
+        char conversion = *p;
+        if(!conversion) break;
+
+        char tag = offset < length ? (char)payload[offset] : 0;
+        uint64_t bits = 0;
+        size_t argument = tag == 'I' || tag == 'U' || tag == 'd' || tag == 'p' ? 8 : tag == 'i' || tag == 'u' ? 4 : 0;
+        if(tag == 's' && offset + 2 <= length) argument = 1 + payload[offset + 1];
+        if(!argument || offset + 1 + argument > length) {
+            append(snprintf(out + used, room(), "<?>"));
+            offset = length;
+            continue;
+        }
+        if(tag != 's') memcpy(&bits, payload + offset + 1, argument);
+        const uint8_t* value = payload + offset + 1;
+        offset += 1 + argument;
+
+        bool integer = tag == 'i' || tag == 'u' || tag == 'I' || tag == 'U';
+        if(strchr("di", conversion) && integer) {
+            long long signedValue = tag == 'i' ? (int32_t)bits : tag == 'u' ? (int32_t)(uint32_t)bits : (int64_t)bits;
+            memcpy(spec + specLength, "lld", 4);
+            append(snprintf(out + used, room(), spec, signedValue));
+        } else if(strchr("uxXo", conversion) && integer) {
+            unsigned long long unsignedValue = (tag == 'i' || tag == 'u') ? (uint32_t)bits : bits;
+            spec[specLength] = 'l';
+            spec[specLength + 1] = 'l';
+            spec[specLength + 2] = conversion;
+            spec[specLength + 3] = 0;
+            append(snprintf(out + used, room(), spec, unsignedValue));
+        } else if(conversion == 'c' && integer) {
+            memcpy(spec + specLength, "c", 2);
+            append(snprintf(out + used, room(), spec, (int)(uint8_t)bits));
+        } else if(strchr("fFeEgGaA", conversion) && tag == 'd') {
+            double number;
+            memcpy(&number, &bits, sizeof(number));
+            spec[specLength] = conversion;
+            spec[specLength + 1] = 0;
+            append(snprintf(out + used, room(), spec, number));
+        } else if(conversion == 's' && tag == 's') {
+            char text[256];
+            memcpy(text, value + 1, value[0]);
+            text[value[0]] = 0;
+            memcpy(spec + specLength, "s", 2);
+            append(snprintf(out + used, room(), spec, text));
+        } else if(conversion == 'p' && (tag == 'p' || integer)) {
+            memcpy(spec + specLength, "llx", 4);
+            append(snprintf(out + used, room(), "0x"));
+            append(snprintf(out + used, room(), spec, (unsigned long long)bits));
+        } else {
+            append(snprintf(out + used, room(), "<?>"));
+        }
+    }
+    out[used] = 0;
+    return used;
+}
+#endif
+
+// ========== UUID Parsing ==========
+
+#if HMS_BLE_RUNTIME_REGISTRATION
+static void copyString(char* dst, size_t size, const char* src) {
+    size_t len = src ? strnlen(src, size - 1) : 0;
+    if(len) memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+#endif
+
+size_t HMS_BLE::uuidToString(const HMS_BLE_UUID& uuid, char* buffer, size_t size) {
+    if(!buffer || size == 0) return 0;
+    int written;
+    if(uuid.type == HMS_BLE_UUID_TYPE_16) {
+        written = snprintf(buffer, size, "%04X", uuid.value16());
+    } else if(uuid.type == HMS_BLE_UUID_TYPE_32) {
+        written = snprintf(buffer, size, "%08X", (unsigned)uuid.value32());
+    } else if(uuid.type == HMS_BLE_UUID_TYPE_128) {
+        const uint8_t* v = uuid.val;
+        written = snprintf(buffer, size, "%02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+            v[15], v[14], v[13], v[12], v[11], v[10], v[9], v[8], v[7], v[6], v[5], v[4], v[3], v[2], v[1], v[0]);
+    } else {
+        buffer[0] = '\0';
+        return 0;
+    }
+    return (written > 0) ? (size_t)written : 0;
+}
+
 // ========== Service Lookup Helpers ==========
 
-int HMS_BLE::findServiceIndex(const char* svcUUID) const {
-    if(!svcUUID) return -1;
+int HMS_BLE::findServiceIndex(const HMS_BLE_UUID& svcUUID) const {
     for(size_t i = 0; i < serviceCount; i++) {
-        if(strcmp(services[i].service.uuid.c_str(), svcUUID) == 0) {
+        if(services[i].service->uuid == svcUUID) {
             return i;
         }
     }
     return -1;
 }
 
-int HMS_BLE::findCharacteristicInService(int serviceIndex, const char* charUUID) const {
-    if(serviceIndex < 0 || serviceIndex >= (int)serviceCount || !charUUID) return -1;
+int HMS_BLE::findServiceIndex(const char* svcUUID) const {
+    HMS_BLE_UUID uuid;
+    if(!parseUUID(svcUUID, &uuid)) return -1;
+    return findServiceIndex(uuid);
+}
+
+int HMS_BLE::findCharacteristicInService(int serviceIndex, const HMS_BLE_UUID& charUUID) const {
+    if(serviceIndex < 0 || serviceIndex >= (int)serviceCount) return -1;
     for(size_t i = 0; i < services[serviceIndex].characteristicCount; i++) {
-        if(strcmp(services[serviceIndex].characteristics[i].uuid.c_str(), charUUID) == 0) {
+        if(services[serviceIndex].characteristics[i].uuid == charUUID) {
             return i;
         }
     }
     return -1;
 }
 
+int HMS_BLE::findCharacteristicInService(int serviceIndex, const char* charUUID) const {
+    if(serviceIndex < 0 || serviceIndex >= (int)serviceCount) return -1;
+    HMS_BLE_UUID uuid;
+    if(!parseUUID(charUUID, &uuid)) return -1;
+    return findCharacteristicInService(serviceIndex, uuid);
+}
+
+#if HMS_BLE_LEGACY_API
 // Legacy: find characteristic across all services (returns flat index for backward compatibility)
 int HMS_BLE::findCharacteristicIndex(const char* uuid) const {
-    if(!uuid) return -1;
+    HMS_BLE_UUID charUUID;
+    if(!parseUUID(uuid, &charUUID)) return -1;
     
     int flatIndex = 0;
     for(size_t s = 0; s < serviceCount; s++) {
         for(size_t c = 0; c < services[s].characteristicCount; c++) {
-            if(strcmp(services[s].characteristics[c].uuid.c_str(), uuid) == 0) {
+            if(services[s].characteristics[c].uuid == charUUID) {
                 return flatIndex;
             }
             flatIndex++;
@@ -154,6 +888,7 @@ int HMS_BLE::findCharacteristicIndex(const char* uuid) const {
     }
     return -1;
 }
+#endif
 
 size_t HMS_BLE::getTotalCharacteristicCount() const {
     size_t total = 0;
@@ -169,8 +904,51 @@ size_t HMS_BLE::getCharacteristicCountForService(const char* svcUUID) const {
     return services[idx].characteristicCount;
 }
 
+// ========== Compile-time Schema API ==========
+
+HMS_BLE_Status HMS_BLE::beginSchema(const HMS_BLE_SchemaView& schema, bool backThread) {
+    if(bleInitialized) {
+        BLE_LOGGER(warn, "BLE already initialized. Call begin() only once");
+        return HMS_BLE_STATUS_ERROR_INIT;
+    }
+
+    if(serviceCount > 0) {
+        BLE_LOGGER(error, "begin<Schema>() cannot be combined with addService()/addCharacteristic()");
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    // Point the descriptors into the schema, nothing is copied or parsed
+    const HMS_BLE_CharacteristicEntry* chars = schema.characteristics;
+    for(size_t s = 0; s < schema.serviceCount; s++) {
+        services[s].service = &schema.services[s];
+        services[s].characteristics = chars;
+        services[s].characteristicCount = schema.characteristicCounts[s];
+        chars += schema.characteristicCounts[s];
+    }
+    serviceCount = schema.serviceCount;
+
+    backgroundProcess = backThread;
+    #if HMS_BLE_LEGACY_API
+        strncpy(serviceUUID, services[0].service->uuidStr, sizeof(serviceUUID) - 1);
+    #endif
+
+    BLE_LOGGER(debug, "Starting BLE from schema with %d services, %d attributes",
+        serviceCount, schema.attributeCount
+    );
+
+    packAdvertising(0);
+    HMS_BLE_Status status = init();
+    if(status != HMS_BLE_STATUS_SUCCESS) {
+        return status;
+    }
+
+    bleInitialized = true;
+    return status;
+}
+
 // ========== Multi-Service API ==========
 
+#if HMS_BLE_RUNTIME_REGISTRATION
 HMS_BLE_Status HMS_BLE::addService(const HMS_BLE_Service* service) {
     if(!service) {
         BLE_LOGGER(error, "Null service pointer provided");
@@ -187,16 +965,22 @@ HMS_BLE_Status HMS_BLE::addService(const HMS_BLE_Service* service) {
         return HMS_BLE_STATUS_ERROR_MAX_CHARS;
     }
     
+    HMS_BLE_UUID uuid;
+    if(!parseUUID(service->uuid.c_str(), &uuid)) {
+        BLE_LOGGER(error, "Invalid service UUID %s", service->uuid.c_str());
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+    
     // Check for duplicate service UUID
-    for(size_t i = 0; i < serviceCount; i++) {
-        if(strcmp(services[i].service.uuid.c_str(), service->uuid.c_str()) == 0) {
-            BLE_LOGGER(error, "Service with UUID %s already exists", service->uuid.c_str());
-            return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
-        }
+    if(findServiceIndex(uuid) >= 0) {
+        BLE_LOGGER(error, "Service with UUID %s already exists", service->uuid.c_str());
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
     }
     
-    services[serviceCount].service.uuid = service->uuid;
-    services[serviceCount].service.name = service->name;
+    HMS_BLE_ServiceEntry& entry = runtimeServices[serviceCount];
+    entry.uuid = uuid;
+    copyString(entry.uuidStr, sizeof(entry.uuidStr), service->uuid.c_str());
+    copyString(entry.name, sizeof(entry.name), service->name.c_str());
     services[serviceCount].characteristicCount = 0;
     services[serviceCount].dataLength = 0;
     services[serviceCount].received = false;
@@ -233,19 +1017,25 @@ HMS_BLE_Status HMS_BLE::addCharacteristicToService(const char* svcUUID, const HM
         return HMS_BLE_STATUS_ERROR_MAX_CHARS;
     }
     
+    HMS_BLE_UUID uuid;
+    if(!parseUUID(characteristic->uuid.c_str(), &uuid)) {
+        BLE_LOGGER(error, "Invalid characteristic UUID %s", characteristic->uuid.c_str());
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+    
     // Check for duplicate characteristic UUID within this service
-    for(size_t i = 0; i < services[svcIdx].characteristicCount; i++) {
-        if(strcmp(services[svcIdx].characteristics[i].uuid.c_str(), characteristic->uuid.c_str()) == 0) {
-            BLE_LOGGER(error, "Characteristic with UUID %s already exists in service %s",
-                characteristic->uuid.c_str(), svcUUID);
-            return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
-        }
+    if(findCharacteristicInService(svcIdx, uuid) >= 0) {
+        BLE_LOGGER(error, "Characteristic with UUID %s already exists in service %s",
+            characteristic->uuid.c_str(), svcUUID);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
     }
     
     size_t charIdx = services[svcIdx].characteristicCount;
-    services[svcIdx].characteristics[charIdx].uuid = characteristic->uuid;
-    services[svcIdx].characteristics[charIdx].name = characteristic->name;
-    services[svcIdx].characteristics[charIdx].properties = characteristic->properties;
+    HMS_BLE_CharacteristicEntry& entry = runtimeCharacteristics[svcIdx][charIdx];
+    entry.uuid = uuid;
+    copyString(entry.uuidStr, sizeof(entry.uuidStr), characteristic->uuid.c_str());
+    copyString(entry.name, sizeof(entry.name), characteristic->name.c_str());
+    entry.properties = characteristic->properties;
     services[svcIdx].characteristicCount++;
     
     BLE_LOGGER(debug, "Characteristic added to service %s: UUID=%s, Name=%s, Count=%d",
@@ -255,13 +1045,14 @@ HMS_BLE_Status HMS_BLE::addCharacteristicToService(const char* svcUUID, const HM
     
     return HMS_BLE_STATUS_SUCCESS;
 }
+#endif
 
 HMS_BLE_Status HMS_BLE::setAdvertisedServices(const char** serviceUUIDs, size_t count) {
     if(!serviceUUIDs || count == 0) {
         // Clear advertised services list - will advertise all
         advertisedServiceCount = 0;
-        BLE_LOGGER(debug, "Advertised services cleared, will advertise all services");
-        return HMS_BLE_STATUS_SUCCESS;
+        BLE_LOGGER(debug, "Advertised services cleared, will advertise the primary service");
+        return bleInitialized ? packAdvertising(0) : HMS_BLE_STATUS_SUCCESS;
     }
     
     if(count > HMS_BLE_MAX_SERVICES) {
@@ -272,17 +1063,19 @@ HMS_BLE_Status HMS_BLE::setAdvertisedServices(const char** serviceUUIDs, size_t
     advertisedServiceCount = 0;
     for(size_t i = 0; i < count; i++) {
         // Verify service exists
-        if(findServiceIndex(serviceUUIDs[i]) >= 0) {
-            advertisedServices[advertisedServiceCount++] = serviceUUIDs[i];
+        int svcIdx = findServiceIndex(serviceUUIDs[i]);
+        if(svcIdx >= 0) {
+            advertisedServices[advertisedServiceCount++] = (uint8_t)svcIdx;
         } else {
             BLE_LOGGER(warn, "Service UUID %s not found, skipping from advertisement", serviceUUIDs[i]);
         }
     }
     
     BLE_LOGGER(debug, "Set %d services for advertising", advertisedServiceCount);
-    return HMS_BLE_STATUS_SUCCESS;
+    return bleInitialized ? packAdvertising(0) : HMS_BLE_STATUS_SUCCESS;
 }
 
+#if HMS_BLE_RUNTIME_REGISTRATION
 // New begin() for multi-service - initializes all registered services
 HMS_BLE_Status HMS_BLE::begin(bool backThread) {
     if(bleInitialized) {
@@ -311,15 +1104,18 @@ HMS_BLE_Status HMS_BLE::begin(bool backThread) {
     
     backgroundProcess = backThread;
     
-    // For legacy compatibility, store first service UUID
-    if(serviceCount > 0) {
-        strncpy(serviceUUID, services[0].service.uuid.c_str(), sizeof(serviceUUID) - 1);
-    }
+    #if HMS_BLE_LEGACY_API
+        // For legacy compatibility, store first service UUID
+        if(serviceCount > 0) {
+            strncpy(serviceUUID, services[0].service->uuidStr, sizeof(serviceUUID) - 1);
+        }
+    #endif
     
     BLE_LOGGER(debug, "Starting BLE with %d services, Total characteristics: %d",
         serviceCount, getTotalCharacteristicCount()
     );
     
+    packAdvertising(0);
     HMS_BLE_Status status = init();
     if(status != HMS_BLE_STATUS_SUCCESS) {
         return status;
@@ -328,6 +1124,7 @@ HMS_BLE_Status HMS_BLE::begin(bool backThread) {
     bleInitialized = true;
     return status;
 }
+#endif
 
 // Per-service data access methods
 bool HMS_BLE::hasReceivedDataFromService(const char* svcUUID) const {
@@ -356,7 +1153,7 @@ void HMS_BLE::clearReceivedDataFromService(const char* svcUUID) {
 }
 
 HMS_BLE_Status HMS_BLE::sendDataToService(const char* svcUUID, const char* charUUID, const uint8_t* data, size_t length) {
-    if(!bleConnected) {
+    if(!isConnected()) {
         BLE_LOGGER(warn, "Cannot send data, no BLE connection");
         return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
     }
@@ -383,23 +1180,2186 @@ HMS_BLE_Status HMS_BLE::sendDataToService(const char* svcUUID, const char* charU
         return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
     }
     
-    return sendDataInternal(svcIdx, charIdx, data, length);
+    return submitData(svcIdx, charIdx, data, length);
 }
 
-// ========== Legacy Single-Service API (Backward Compatible) ==========
+// ========== Advertising ==========
 
-HMS_BLE_Status HMS_BLE::begin(const char* service_uuid, bool backThread) {
-    if(!service_uuid) {
-        BLE_LOGGER(error, "Service UUID cannot be null");
-        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+// One AD structure (length, type, data) at the end of a packet; returns the index of its data
+static uint8_t advPut(uint8_t* packet, uint8_t* length, uint8_t type, const uint8_t* data, size_t size) {
+    uint8_t at = *length;
+    packet[at] = (uint8_t)(size + 1);
+    packet[at + 1] = type;
+    memcpy(packet + at + 2, data, size);
+    *length = (uint8_t)(at + 2 + size);
+    return (uint8_t)(at + 2);
+}
+
+void HMS_BLE::buildAdvertising(HMS_BLE_AdvPayload* payload) const {
+    memset(payload, 0, sizeof(*payload));
+    uint8_t* packets[2] = { payload->advertising, payload->scanResponse };
+    uint8_t* lengths[2] = { &payload->advertisingLength, &payload->scanResponseLength };
+    auto room = [&](int p) { return (size_t)(HMS_BLE_ADV_PACKET_LENGTH - *lengths[p]); };
+    auto pick = [&](size_t size) { return room(0) >= size ? 0 : room(1) >= size ? 1 : -1; };          // Advertising packet first
+    auto roomier = [&]() { return room(0) >= room(1) ? 0 : 1; };
+
+    static const uint8_t flags = 0x06;                                                                  // LE General Discoverable, BR/EDR not supported
+    advPut(packets[0], lengths[0], 0x01, &flags, 1);
+
+    // One list per UUID width: Complete List 0x03/0x05/0x07, the Incomplete List type is one less
+    uint8_t primary = 0;
+    const uint8_t* indices = advertisedServiceCount ? advertisedServices : &primary;
+    size_t count = advertisedServiceCount ? advertisedServiceCount : (serviceCount ? 1 : 0);
+    static const uint8_t widths[3] = { HMS_BLE_UUID_TYPE_16, HMS_BLE_UUID_TYPE_32, HMS_BLE_UUID_TYPE_128 };
+    for(int w = 0; w < 3; w++) {
+        uint8_t list[HMS_BLE_ADV_PACKET_LENGTH - 2];
+        size_t n = 0, wanted = 0;
+        for(size_t i = 0; i < count; i++) {
+            const HMS_BLE_UUID& uuid = services[indices[i]].service->uuid;
+            if(uuid.type != widths[w]) continue;
+            if((n + 1) * widths[w] <= sizeof(list)) memcpy(list + (n++) * widths[w], uuid.encoded(), widths[w]);
+            wanted++;
+        }
+        if(wanted == 0) continue;
+        uint8_t type = (uint8_t)(0x03 + 2 * w);
+        int p = pick(2 + n * widths[w]);
+        if(p < 0) {
+            p = roomier();
+            n = room(p) > 2 ? (room(p) - 2) / widths[w] : 0;
+        }
+        if(n < wanted) {
+            payload->fit |= HMS_BLE_ADV_UUIDS_INCOMPLETE;
+            type--;
+        }
+        if(n > 0) advPut(packets[p], lengths[p], type, list, n * widths[w]);
     }
 
-    if(bleInitialized) {
-        BLE_LOGGER(warn, "BLE already initialized. Call begin() only once");
-        return HMS_BLE_STATUS_ERROR_INIT;
+    if(advManufacturerLength) {
+        uint8_t value[HMS_BLE_ADV_PACKET_LENGTH];
+        value[0] = advCompanyId & 0xFF;                                                                 // Company identifier, little-endian
+        value[1] = advCompanyId >> 8;
+        memcpy(value + 2, advManufacturerValue, advManufacturerLength);
+        int p = pick(4 + advManufacturerLength);
+        if(p < 0) {
+            payload->fit |= HMS_BLE_ADV_MANUFACTURER_DROPPED;
+        } else {
+            payload->manufacturer.offset = advPut(packets[p], lengths[p], 0xFF, value, 2 + advManufacturerLength) + 2;
+            payload->manufacturer.length = advManufacturerLength;
+            payload->manufacturer.scanResponse = p == 1;
+        }
     }
 
-    // Legacy mode: if characteristics were added via addCharacteristic() without addService(),
+    if(advServiceDataLength) {
+        uint8_t value[HMS_BLE_ADV_PACKET_LENGTH + 16];
+        size_t uuidSize = advServiceDataUUID.size();
+        memcpy(value, advServiceDataUUID.encoded(), uuidSize);
+        memcpy(value + uuidSize, advServiceDataValue, advServiceDataLength);
+        uint8_t type = uuidSize == 2 ? 0x16 : uuidSize == 4 ? 0x20 : 0x21;                              // Service Data - 16/32/128-bit UUID
+        int p = pick(2 + uuidSize + advServiceDataLength);
+        if(p < 0) {
+            payload->fit |= HMS_BLE_ADV_SERVICE_DATA_DROPPED;
+        } else {
+            payload->serviceData.offset = (uint8_t)(advPut(packets[p], lengths[p], type, value, uuidSize + advServiceDataLength) + uuidSize);
+            payload->serviceData.length = advServiceDataLength;
+            payload->serviceData.scanResponse = p == 1;
+        }
+    }
+
+    size_t nameLength = deviceName ? strlen(deviceName) : 0;
+    if(nameLength) {
+        int p = pick(2 + nameLength);
+        if(p >= 0) {
+            advPut(packets[p], lengths[p], 0x09, (const uint8_t*)deviceName, nameLength);              // Complete Local Name
+        } else if(room(roomier()) > 2) {
+            p = roomier();
+            advPut(packets[p], lengths[p], 0x08, (const uint8_t*)deviceName, room(p) - 2);              // Shortened Local Name
+            payload->fit |= HMS_BLE_ADV_NAME_SHORTENED;
+        } else {
+            payload->fit |= HMS_BLE_ADV_NAME_DROPPED;
+        }
+    }
+}
+
+HMS_BLE_Status HMS_BLE::packAdvertising(uint8_t required) {
+    HMS_BLE_AdvPayload payload;
+    buildAdvertising(&payload);
+    if(payload.fit & required) {
+        return HMS_BLE_STATUS_ERROR_OVERFLOW;
+    }
+    if(payload.fit) {
+        BLE_LOGGER(warn, "Advertising payload is cut to fit (0x%02X), see HMS_BLE_AdvFit", payload.fit);
+    }
+    lockAdvertising();
+    advPayload = payload;
+    unlockAdvertising();
+    return bleInitialized ? updateAdvertisingInternal() : HMS_BLE_STATUS_SUCCESS;
+}
+
+/*
+  Same length and already placed: overwrite the bytes in the packed payload and push it. Anything else re-packs, and a
+  value that no longer fits is refused with the previous one restored.
+*/
+HMS_BLE_Status HMS_BLE::writeAdvertisingValue(bool manufacturer, const uint8_t* data, size_t length, bool repack) {
+    uint8_t* value = manufacturer ? advManufacturerValue : advServiceDataValue;
+    uint8_t& valueLength = manufacturer ? advManufacturerLength : advServiceDataLength;
+    if(length > sizeof(advManufacturerValue) || (length && !data)) {
+        return HMS_BLE_STATUS_ERROR_OVERFLOW;
+    }
+
+    HMS_BLE_AdvField field = manufacturer ? advPayload.manufacturer : advPayload.serviceData;      // Only written by the setters, on this thread
+    if(!repack && length == valueLength && field.offset) {
+        memcpy(value, data, length);
+        lockAdvertising();
+        memcpy((field.scanResponse ? advPayload.scanResponse : advPayload.advertising) + field.offset, data, length);
+        unlockAdvertising();
+        return bleInitialized ? updateAdvertisingInternal() : HMS_BLE_STATUS_SUCCESS;
+    }
+
+    uint8_t previous[sizeof(advManufacturerValue)];
+    uint8_t previousLength = valueLength;
+    memcpy(previous, value, previousLength);
+    if(length) memcpy(value, data, length);
+    valueLength = (uint8_t)length;
+    HMS_BLE_Status status = packAdvertising(manufacturer ? HMS_BLE_ADV_MANUFACTURER_DROPPED : HMS_BLE_ADV_SERVICE_DATA_DROPPED);
+    if(status == HMS_BLE_STATUS_ERROR_OVERFLOW) {
+        memcpy(value, previous, previousLength);
+        valueLength = previousLength;
+    }
+    return status;
+}
+
+HMS_BLE_Status HMS_BLE::setManufacturerData(uint16_t companyId, const uint8_t* data, size_t length) {
+    uint16_t previous = advCompanyId;
+    advCompanyId = companyId;
+    HMS_BLE_Status status = writeAdvertisingValue(true, data, length, true);
+    if(status == HMS_BLE_STATUS_ERROR_OVERFLOW) {
+        advCompanyId = previous;
+        BLE_LOGGER(warn, "Manufacturer data (%d bytes) does not fit the advertising packets", (int)length);
+    }
+    return status;
+}
+
+void HMS_BLE::setManufacturerData(HMS_BLE_ManufacturerData data) {
+    setManufacturerData((uint16_t)(data.manufacturer_id[0] | data.manufacturer_id[1] << 8), data.data.data(), data.data.size());
+}
+
+HMS_BLE_Status HMS_BLE::setServiceData(const char* serviceUUID, const uint8_t* data, size_t length) {
+    HMS_BLE_UUID uuid;
+    if(!serviceUUID || !parseUUID(serviceUUID, &uuid)) {
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+    HMS_BLE_UUID previous = advServiceDataUUID;
+    advServiceDataUUID = uuid;
+    HMS_BLE_Status status = writeAdvertisingValue(false, data, length, true);
+    if(status == HMS_BLE_STATUS_ERROR_OVERFLOW) {
+        advServiceDataUUID = previous;
+        BLE_LOGGER(warn, "Service data for %s (%d bytes) does not fit the advertising packets", serviceUUID, (int)length);
+    }
+    return status;
+}
+
+HMS_BLE_Status HMS_BLE::updateManufacturerData(const uint8_t* data, size_t length) {
+    if(advManufacturerLength == 0) {
+        return HMS_BLE_STATUS_ERROR_PROTOCOL;                                                           // setManufacturerData() first, it has the company identifier
+    }
+    return writeAdvertisingValue(true, data, length, false);
+}
+
+HMS_BLE_Status HMS_BLE::updateServiceData(const uint8_t* data, size_t length) {
+    if(advServiceDataLength == 0) {
+        return HMS_BLE_STATUS_ERROR_PROTOCOL;                                                           // setServiceData() first, it has the UUID
+    }
+    return writeAdvertisingValue(false, data, length, false);
+}
+
+HMS_BLE_AdvPayload HMS_BLE::getAdvertisingPayload() const {
+    lockAdvertising();
+    HMS_BLE_AdvPayload payload = advPayload;
+    unlockAdvertising();
+    return payload;
+}
+
+void HMS_BLE::lockAdvertising() const {
+    #if defined(HMS_BLE_ARDUINO_ESP32)
+        taskENTER_CRITICAL(&advertisingMux);
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+        advertisingKey = k_spin_lock(&advertisingSpinlock);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        advertisingMutex.lock();
+    #endif
+}
+
+void HMS_BLE::unlockAdvertising() const {
+    #if defined(HMS_BLE_ARDUINO_ESP32)
+        taskEXIT_CRITICAL(&advertisingMux);
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+        k_spin_unlock(&advertisingSpinlock, advertisingKey);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        advertisingMutex.unlock();
+    #endif
+}
+
+// ========== Handle API ==========
+
+HMS_BLE_CharHandle HMS_BLE::getCharacteristicHandle(const char* svcUUID, const char* charUUID) const {
+    int svcIdx = findServiceIndex(svcUUID);
+    int charIdx = findCharacteristicInService(svcIdx, charUUID);
+    if(charIdx < 0) {
+        BLE_LOGGER(warn, "Cannot resolve handle for %s/%s", svcUUID ? svcUUID : "null", charUUID ? charUUID : "null");
+        return HMS_BLE_INVALID_CHAR_HANDLE;
+    }
+    return encodeHandle(svcIdx, charIdx);
+}
+
+HMS_BLE_CharHandle HMS_BLE::getCharacteristicHandle(const HMS_BLE_UUID& svcUUID, const HMS_BLE_UUID& charUUID) const {
+    int svcIdx = findServiceIndex(svcUUID);
+    int charIdx = findCharacteristicInService(svcIdx, charUUID);
+    if(charIdx < 0) return HMS_BLE_INVALID_CHAR_HANDLE;
+    return encodeHandle(svcIdx, charIdx);
+}
+
+#if HMS_BLE_LEGACY_API
+HMS_BLE_CharHandle HMS_BLE::getCharacteristicHandle(const char* charUUID) const {
+    HMS_BLE_UUID uuid;
+    if(!parseUUID(charUUID, &uuid)) return HMS_BLE_INVALID_CHAR_HANDLE;
+    for(size_t s = 0; s < serviceCount; s++) {
+        int charIdx = findCharacteristicInService(s, uuid);
+        if(charIdx >= 0) {
+            return encodeHandle(s, charIdx);
+        }
+    }
+    BLE_LOGGER(warn, "Cannot resolve handle for %s", charUUID);
+    return HMS_BLE_INVALID_CHAR_HANDLE;
+}
+#endif
+
+HMS_BLE_Status HMS_BLE::sendData(HMS_BLE_CharHandle handle, const uint8_t* data, size_t length) {
+    if(!isConnected()) {
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+
+    if(!data || length == 0 || length > HMS_BLE_MAX_DATA_LENGTH) {
+        return length > HMS_BLE_MAX_DATA_LENGTH ? HMS_BLE_STATUS_ERROR_SEND : HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) {
+        BLE_LOGGER(error, "Invalid characteristic handle 0x%04X", handle.id);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    return submitData(svcIdx, charIdx, data, length);
+}
+
+/*
+  Bypasses the notification queue (and notify-on-change, the caller asked to hear about this value): the value goes to the
+  stack right away and onSent runs once it left, or failed to leave, on every subscribed link.
+*/
+HMS_BLE_Status HMS_BLE::sendData(HMS_BLE_CharHandle handle, const uint8_t* data, size_t length, HMS_BLE_SendCallback onSent) {
+    if(!isConnected()) {
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+
+    if(!data || length == 0 || length > HMS_BLE_MAX_DATA_LENGTH) {
+        return length > HMS_BLE_MAX_DATA_LENGTH ? HMS_BLE_STATUS_ERROR_SEND : HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) {
+        BLE_LOGGER(error, "Invalid characteristic handle 0x%04X", handle.id);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    #if HMS_BLE_VALUE_CACHE
+        updateCachedValue(svcIdx, charIdx, data, length);
+    #endif
+    return sendWithBackpressure(svcIdx, charIdx, data, length, onSent ? &onSent : nullptr);
+}
+
+bool HMS_BLE::isSubscribed(HMS_BLE_CharHandle handle) const {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return false;
+    return hasSubscribers(svcIdx, charIdx);
+}
+
+bool HMS_BLE::hasReceivedData(HMS_BLE_CharHandle handle) const {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return false;
+    return services[svcIdx].received;
+}
+
+const uint8_t* HMS_BLE::getReceivedData(HMS_BLE_CharHandle handle) const {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return nullptr;
+    return services[svcIdx].data;
+}
+
+size_t HMS_BLE::getReceivedDataLength(HMS_BLE_CharHandle handle) const {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return 0;
+    return services[svcIdx].dataLength;
+}
+
+void HMS_BLE::clearReceivedData(HMS_BLE_CharHandle handle) {
+    int svcIdx, charIdx;
+    if(decodeHandle(handle, &svcIdx, &charIdx)) {
+        services[svcIdx].received = false;
+    }
+}
+
+// ========== Connections ==========
+/*
+  connectionIndex is open addressing with linear probing on the connection handle (stacks hand out small, mostly
+  consecutive handles, so the low bits spread well). At most half full, a lookup touches one or two entries. Removal shifts
+  the following entries back instead of leaving tombstones, so the index never degrades under connect/disconnect churn.
+*/
+
+int HMS_BLE::findConnection(uint16_t connHandle) const {
+    if(connHandle == HMS_BLE_CONN_HANDLE_NONE) return -1;
+    const size_t mask = HMS_BLE_ConnectionIndexSize() - 1;
+    for(size_t i = connHandle & mask; connectionIndex[i] != 0xFF; i = (i + 1) & mask) {
+        if(connections[connectionIndex[i]].connHandle == connHandle) return connectionIndex[i];
+    }
+    return -1;
+}
+
+int HMS_BLE::openConnection(uint16_t connHandle, const uint8_t* address) {
+    int slot = findConnection(connHandle);
+    if(slot >= 0) return slot;                                                                          // Connected callback seen twice
+
+    for(int i = 0; i < HMS_BLE_MAX_CLIENTS; i++) {
+        if(connections[i].connHandle == HMS_BLE_CONN_HANDLE_NONE) {
+            slot = i;
+            break;
+        }
+    }
+    if(slot < 0) {
+        BLE_LOGGER(warn, "Connection table full, handle %d not tracked", connHandle);
+        statRefusedConnections.fetch_add(1, std::memory_order_relaxed);
+        trace(HMS_BLE_TRACE_CONNECT, -1, 0xFFFF, connHandle, -1);
+        return -1;
+    }
+
+    ConnectionSlot& link = connections[slot];
+    link.connHandle = connHandle;
+    if(address) memcpy(link.address, address, sizeof(link.address));
+    else        memset(link.address, 0, sizeof(link.address));
+    link.mtu = 23;
+    link.interval = 0;
+    link.latency = 0;
+    link.supervisionTimeout = 0;
+    memset(link.subscriptions, 0, sizeof(link.subscriptions));
+    link.notificationsSent.store(0, std::memory_order_relaxed);
+    link.bytesSent.store(0, std::memory_order_relaxed);
+    link.writesReceived.store(0, std::memory_order_relaxed);
+    link.bytesReceived.store(0, std::memory_order_relaxed);
+    link.readsServed.store(0, std::memory_order_relaxed);
+    #if HMS_BLE_LINK_PROFILES
+        link.profile = HMS_BLE_LINK_PROFILE_DEFAULT;
+        link.txPhy = HMS_BLE_PHY_1M;                                                                    // Every link starts on 1M with 27-byte LL payloads
+        link.rxPhy = HMS_BLE_PHY_1M;
+        link.txOctets = 27;
+        link.rxOctets = 27;
+        link.notificationsPerEvent.store(1, std::memory_order_relaxed);
+    #endif
+    #if HMS_BLE_INDICATE_DEPTH
+        lockIndications();
+        indicationLinks[slot].stalled = false;
+        indicationLinks[slot].retry = false;
+        unlockIndications();
+    #endif
+
+    const size_t mask = HMS_BLE_ConnectionIndexSize() - 1;
+    size_t i = connHandle & mask;
+    while(connectionIndex[i] != 0xFF) i = (i + 1) & mask;
+    connectionIndex[i] = (uint8_t)slot;
+    connectedCount++;
+    statConnections.fetch_add(1, std::memory_order_relaxed);
+    trace(HMS_BLE_TRACE_CONNECT, slot, 0xFFFF, connHandle, slot);
+    return slot;
+}
+
+void HMS_BLE::closeConnection(int slot, uint8_t reason) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS || connections[slot].connHandle == HMS_BLE_CONN_HANDLE_NONE) return;
+    statDisconnections.fetch_add(1, std::memory_order_relaxed);
+    statDisconnectReasons[classifyDisconnect(reason)].fetch_add(1, std::memory_order_relaxed);
+    statLastDisconnectReason.store(reason, std::memory_order_relaxed);
+    trace(HMS_BLE_TRACE_DISCONNECT, slot, 0xFFFF, connections[slot].connHandle, reason);
+
+    const size_t mask = HMS_BLE_ConnectionIndexSize() - 1;
+    size_t hole = connections[slot].connHandle & mask;
+    while(connectionIndex[hole] != slot) hole = (hole + 1) & mask;
+    connectionIndex[hole] = 0xFF;
+    for(size_t i = (hole + 1) & mask; connectionIndex[i] != 0xFF; i = (i + 1) & mask) {
+        size_t home = connections[connectionIndex[i]].connHandle & mask;
+        if(((i - home) & mask) >= ((i - hole) & mask)) {                                                // Its probe sequence passes the hole: move it up
+            connectionIndex[hole] = connectionIndex[i];
+            connectionIndex[i] = 0xFF;
+            hole = i;
+        }
+    }
+
+    // Only the characteristics this client subscribed to are touched, found from its own bitset
+    uint32_t* subscriptions = connections[slot].subscriptions;
+    for(int w = 0; w < HMS_BLE_SUBSCRIPTION_WORDS; w++) {
+        for(uint32_t bits = subscriptions[w]; bits; bits &= bits - 1) {
+            int bit = w * 32 + __builtin_ctz(bits);
+            services[bit / HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE].subscribers[bit % HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE][slot / 32] &= ~(1u << (slot % 32));
+            #if HMS_BLE_INDICATE_DEPTH
+                services[bit / HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE].indicators[bit % HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE][slot / 32] &= ~(1u << (slot % 32));
+            #endif
+        }
+        subscriptions[w] = 0;
+    }
+    connections[slot].connHandle = HMS_BLE_CONN_HANDLE_NONE;
+    connectedCount--;
+    #if HMS_BLE_LINK_PROFILES
+        refreshSendBatch();                                                                             // The slowest link may be gone
+    #endif
+    #if HMS_BLE_INDICATE_DEPTH
+        abortIndications(slot, HMS_BLE_STATUS_ERROR_NOT_CONNECTED);                                    // Queued and unconfirmed ones never arrive
+        lockIndications();
+        indicationLinks[slot].stalled = false;
+        indicationLinks[slot].retry = false;
+        unlockIndications();
+    #endif
+}
+
+bool HMS_BLE::getConnection(uint8_t slot, HMS_BLE_Connection* connection) const {
+    if(!connection || slot >= HMS_BLE_MAX_CLIENTS || connections[slot].connHandle == HMS_BLE_CONN_HANDLE_NONE) return false;
+    const ConnectionSlot& link = connections[slot];
+    connection->connHandle = link.connHandle;
+    memcpy(connection->address, link.address, sizeof(connection->address));
+    connection->mtu = link.mtu;
+    connection->interval = link.interval;
+    connection->latency = link.latency;
+    connection->supervisionTimeout = link.supervisionTimeout;
+    memcpy(connection->subscriptions, link.subscriptions, sizeof(connection->subscriptions));
+    connection->stats.notificationsSent = link.notificationsSent.load(std::memory_order_relaxed);
+    connection->stats.bytesSent         = link.bytesSent.load(std::memory_order_relaxed);
+    connection->stats.writesReceived    = link.writesReceived.load(std::memory_order_relaxed);
+    connection->stats.bytesReceived     = link.bytesReceived.load(std::memory_order_relaxed);
+    connection->stats.readsServed       = link.readsServed.load(std::memory_order_relaxed);
+    return true;
+}
+
+uint16_t HMS_BLE::getMTU() const {
+    uint16_t mtu = 0;
+    for(int i = 0; i < HMS_BLE_MAX_CLIENTS; i++) {
+        if(connections[i].connHandle != HMS_BLE_CONN_HANDLE_NONE && (mtu == 0 || connections[i].mtu < mtu)) mtu = connections[i].mtu;
+    }
+    return mtu ? mtu : 23;
+}
+
+/*
+  Subscriptions are kept twice as bitsets: per characteristic over connection slots (who gets a notification) and per
+  connection over characteristics (what a disconnect has to drop). Both are written only from the stack context, senders
+  read the per-characteristic words.
+*/
+void HMS_BLE::setSubscribed(int slot, int serviceIndex, int charIndex, bool enabled, bool indicate) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    size_t bit = serviceIndex * HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE + charIndex;
+    uint32_t* clients = services[serviceIndex].subscribers[charIndex];
+    if(enabled) {
+        connections[slot].subscriptions[bit / 32] |= (1u << (bit % 32));
+        clients[slot / 32] |= (1u << (slot % 32));
+    } else {
+        connections[slot].subscriptions[bit / 32] &= ~(1u << (bit % 32));
+        clients[slot / 32] &= ~(1u << (slot % 32));
+    }
+    #if HMS_BLE_INDICATE_DEPTH
+        uint32_t* indicating = services[serviceIndex].indicators[charIndex];
+        if(enabled && indicate) indicating[slot / 32] |= (1u << (slot % 32));
+        else                    indicating[slot / 32] &= ~(1u << (slot % 32));                          // Queued entries fail with NOT_CONNECTED at their turn
+    #else
+        (void)indicate;
+    #endif
+    trace(HMS_BLE_TRACE_SUBSCRIBE, slot, encodeHandle(serviceIndex, charIndex).id, enabled ? (indicate ? 2 : 1) : 0, 0);
+}
+
+bool HMS_BLE::hasSubscribers(int serviceIndex, int charIndex) const {
+    const uint32_t* clients = services[serviceIndex].subscribers[charIndex];
+    uint32_t any = clients[0];
+    for(int w = 1; w < HMS_BLE_CLIENT_WORDS; w++) any |= clients[w];                                    // Folds away for HMS_BLE_MAX_CLIENTS <= 32
+    return any != 0;
+}
+
+int HMS_BLE::takeLowestSlot(uint32_t* links) {
+    for(int w = 0; w < HMS_BLE_CLIENT_WORDS; w++) {
+        if(links[w]) {
+            int bit = __builtin_ctz(links[w]);
+            links[w] &= links[w] - 1;
+            return w * 32 + bit;
+        }
+    }
+    return -1;
+}
+
+void HMS_BLE::updateConnectionParams(int slot, uint16_t interval, uint16_t latency, uint16_t supervisionTimeout) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    connections[slot].interval = interval;
+    connections[slot].latency = latency;
+    connections[slot].supervisionTimeout = supervisionTimeout;
+    #if HMS_BLE_LINK_PROFILES
+        reportLink(slot, HMS_BLE_LINK_CHANGE_PARAMS, HMS_BLE_STATUS_SUCCESS);
+    #endif
+}
+
+void HMS_BLE::updateConnectionMTU(int slot, uint16_t mtu) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    connections[slot].mtu = mtu;
+    trace(HMS_BLE_TRACE_MTU, slot, 0xFFFF, mtu, 0);
+    #if HMS_BLE_LINK_PROFILES
+        reportLink(slot, HMS_BLE_LINK_CHANGE_MTU, HMS_BLE_STATUS_SUCCESS);
+    #endif
+}
+
+void HMS_BLE::countLinkSend(int slot, size_t length) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    connections[slot].notificationsSent.fetch_add(1, std::memory_order_relaxed);
+    connections[slot].bytesSent.fetch_add((uint32_t)length, std::memory_order_relaxed);
+}
+
+void HMS_BLE::countLinkWrite(int slot, int serviceIndex, int charIndex, size_t length) {
+    if(serviceIndex >= 0 && serviceIndex < HMS_BLE_MAX_SERVICES && charIndex >= 0 && charIndex < HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE) {
+        charCounters[serviceIndex][charIndex].writes.fetch_add(1, std::memory_order_relaxed);
+        charCounters[serviceIndex][charIndex].bytesWritten.fetch_add((uint32_t)length, std::memory_order_relaxed);
+    }
+    trace(HMS_BLE_TRACE_WRITE, slot, encodeHandle(serviceIndex, charIndex).id, length, 0);
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    connections[slot].writesReceived.fetch_add(1, std::memory_order_relaxed);
+    connections[slot].bytesReceived.fetch_add((uint32_t)length, std::memory_order_relaxed);
+}
+
+void HMS_BLE::countLinkRead(int slot, int serviceIndex, int charIndex) {
+    if(serviceIndex >= 0 && serviceIndex < HMS_BLE_MAX_SERVICES && charIndex >= 0 && charIndex < HMS_BLE_MAX_CHARACTERISTICS_PER_SERVICE) {
+        charCounters[serviceIndex][charIndex].reads.fetch_add(1, std::memory_order_relaxed);
+    }
+    trace(HMS_BLE_TRACE_READ, slot, encodeHandle(serviceIndex, charIndex).id, 0, 0);
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    connections[slot].readsServed.fetch_add(1, std::memory_order_relaxed);
+}
+
+#if HMS_BLE_LINK_PROFILES
+// ========== Link Profiles ==========
+/*
+  A profile is only a request: the central (and its controller) pick the values, and each stack report is stored in the
+  connection slot. From those the link's capacity is estimated as the full-MTU notifications that fit one connection event:
+  the notification plus its 4-byte L2CAP header is cut into LL packets of txOctets, and each packet costs its air time on the
+  TX PHY, the central's empty reply on the RX PHY and two 150 us inter-frame spaces. The event lasts the interval, or
+  HMS_BLE_LINK_EVENT_US when the controller caps it. Unencrypted packets and no retransmissions, so it is an upper bound
+  that is good to a few packets, which is all the send passes need.
+*/
+
+static uint32_t linkPacketAirUs(uint32_t octets, uint8_t phy) {
+    if(phy & HMS_BLE_PHY_2M)    return (11 + octets) * 4;                                              // 2-byte preamble, access address, header, CRC at 2 Mbit/s
+    if(phy & HMS_BLE_PHY_CODED) return 400 + (5 + octets) * 64;                                        // S8: 376 us preamble/access address/CI/TERM1, then 64 us per byte
+    return (10 + octets) * 8;                                                                           // 1 Mbit/s
+}
+
+uint8_t HMS_BLE::linkNotificationsPerEvent(uint16_t interval, uint8_t txPhy, uint8_t rxPhy, uint16_t txOctets, uint16_t mtu) {
+    if(interval == 0) return 1;                                                                         // Not reported yet
+    uint32_t eventUs = interval * 1250u;
+    if(HMS_BLE_LINK_EVENT_US > 0 && eventUs > (uint32_t)HMS_BLE_LINK_EVENT_US) eventUs = HMS_BLE_LINK_EVENT_US;
+
+    uint32_t pdu = (uint32_t)mtu + 4;                                                                   // MTU - 3 value bytes, 3-byte ATT header, 4-byte L2CAP header
+    uint32_t octets = std::max<uint32_t>(txOctets, 27);
+    uint32_t reply = 150 + linkPacketAirUs(0, rxPhy) + 150;
+    uint32_t perNotification = (pdu / octets) * (linkPacketAirUs(octets, txPhy) + reply);
+    if(pdu % octets) perNotification += linkPacketAirUs(pdu % octets, txPhy) + reply;
+    return (uint8_t)std::max<uint32_t>(1, std::min<uint32_t>(255, eventUs / perNotification));
+}
+
+HMS_BLE_Status HMS_BLE::setLinkProfileParams(HMS_BLE_LinkProfile profile, const HMS_BLE_LinkProfileParams& params) {
+    if(profile <= HMS_BLE_LINK_PROFILE_DEFAULT || profile >= HMS_BLE_LINK_PROFILE_COUNT) return HMS_BLE_STATUS_ERROR_PROTOCOL;
+    if(params.minInterval < 6 || params.maxInterval > 3200 || params.minInterval > params.maxInterval ||
+       params.latency > 499 || params.supervisionTimeout < 10 || params.supervisionTimeout > 3200 ||
+       params.supervisionTimeout * 4u <= (1u + params.latency) * params.maxInterval ||              // timeout * 10 ms > (1 + latency) * interval * 1.25 ms * 2
+       (params.phy & ~(HMS_BLE_PHY_1M | HMS_BLE_PHY_2M | HMS_BLE_PHY_CODED)) ||
+       (params.dataLength != 0 && (params.dataLength < 27 || params.dataLength > 251))) {
+        return HMS_BLE_STATUS_ERROR_PROTOCOL;
+    }
+    linkProfiles[profile] = params;
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_LinkProfileParams HMS_BLE::getLinkProfileParams(HMS_BLE_LinkProfile profile) const {
+    if(profile < 0 || profile >= HMS_BLE_LINK_PROFILE_COUNT) return HMS_BLE_LinkProfileParams{};
+    return linkProfiles[profile];
+}
+
+HMS_BLE_Status HMS_BLE::requestLinkProfile(int slot, HMS_BLE_LinkProfile profile) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS || connections[slot].connHandle == HMS_BLE_CONN_HANDLE_NONE) return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    if(profile < 0 || profile >= HMS_BLE_LINK_PROFILE_COUNT) return HMS_BLE_STATUS_ERROR_PROTOCOL;
+    connections[slot].profile = profile;
+    if(profile == HMS_BLE_LINK_PROFILE_DEFAULT) return HMS_BLE_STATUS_SUCCESS;                         // Nothing to ask for, the current values stay
+
+    HMS_BLE_Status status = requestLinkInternal(slot, linkProfiles[profile]);
+    if(status != HMS_BLE_STATUS_SUCCESS) {
+        BLE_LOGGER(warn, "Link profile %d refused on slot %d: %d", (int)profile, slot, (int)status);
+        reportLink(slot, 0, status);
+    }
+    return status;
+}
+
+void HMS_BLE::applyLinkProfile(int slot) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    HMS_BLE_LinkProfile profile = linkProfileSelector ? linkProfileSelector(slot, connections[slot].address) : defaultLinkProfile;
+    if(profile != HMS_BLE_LINK_PROFILE_DEFAULT) requestLinkProfile(slot, profile);
+}
+
+void HMS_BLE::updateLinkPhy(int slot, uint8_t txPhy, uint8_t rxPhy) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    connections[slot].txPhy = txPhy;
+    connections[slot].rxPhy = rxPhy;
+    reportLink(slot, HMS_BLE_LINK_CHANGE_PHY, HMS_BLE_STATUS_SUCCESS);
+}
+
+void HMS_BLE::updateLinkDataLength(int slot, uint16_t txOctets, uint16_t rxOctets) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    connections[slot].txOctets = txOctets;
+    connections[slot].rxOctets = rxOctets;
+    reportLink(slot, HMS_BLE_LINK_CHANGE_DATA_LENGTH, HMS_BLE_STATUS_SUCCESS);
+}
+
+void HMS_BLE::reportLink(int slot, uint8_t changed, HMS_BLE_Status status) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS || connections[slot].connHandle == HMS_BLE_CONN_HANDLE_NONE) return;
+    ConnectionSlot& link = connections[slot];
+    link.notificationsPerEvent.store(linkNotificationsPerEvent(link.interval, link.txPhy, link.rxPhy, link.txOctets, link.mtu), std::memory_order_relaxed);
+    refreshSendBatch();
+    trace(HMS_BLE_TRACE_LINK, slot, 0xFFFF, link.interval, status == HMS_BLE_STATUS_SUCCESS ? (int32_t)changed : (int32_t)status);
+
+    if(linkCallback) {
+        HMS_BLE_LinkInfo info;
+        getLinkInfo(slot, &info);
+        info.changed = changed;
+        linkCallback(slot, info, status);
+    }
+}
+
+void HMS_BLE::refreshSendBatch() {
+    uint32_t perEvent = 0, intervalMs = 0;
+    for(int i = 0; i < HMS_BLE_MAX_CLIENTS; i++) {
+        const ConnectionSlot& link = connections[i];
+        if(link.connHandle == HMS_BLE_CONN_HANDLE_NONE || link.interval == 0) continue;
+        uint32_t carried = link.notificationsPerEvent.load(std::memory_order_relaxed);
+        uint32_t ms = std::max<uint32_t>(1, link.interval * 5u / 4);
+        if(perEvent == 0 || carried < perEvent) perEvent = carried;
+        if(intervalMs == 0 || ms < intervalMs) intervalMs = ms;
+    }
+    sendBatch.store((uint16_t)(perEvent * 2), std::memory_order_relaxed);                               // One event on the air, the next one ready in the stack
+    sendPaceMs.store((uint16_t)intervalMs, std::memory_order_relaxed);
+}
+
+bool HMS_BLE::linkMatches(const ConnectionSlot& link) const {
+    if(link.profile == HMS_BLE_LINK_PROFILE_DEFAULT) return true;
+    const HMS_BLE_LinkProfileParams& wanted = linkProfiles[link.profile];
+    return link.interval >= wanted.minInterval && link.interval <= wanted.maxInterval &&
+           (wanted.phy == 0 || (link.txPhy & wanted.phy)) &&
+           (wanted.dataLength == 0 || link.txOctets >= wanted.dataLength);
+}
+
+bool HMS_BLE::getLinkInfo(int slot, HMS_BLE_LinkInfo* info) const {
+    if(!info || slot < 0 || slot >= HMS_BLE_MAX_CLIENTS || connections[slot].connHandle == HMS_BLE_CONN_HANDLE_NONE) return false;
+    const ConnectionSlot& link = connections[slot];
+    info->profile               = link.profile;
+    info->interval              = link.interval;
+    info->latency               = link.latency;
+    info->supervisionTimeout    = link.supervisionTimeout;
+    info->txPhy                 = link.txPhy;
+    info->rxPhy                 = link.rxPhy;
+    info->txOctets              = link.txOctets;
+    info->rxOctets              = link.rxOctets;
+    info->mtu                   = link.mtu;
+    info->notificationsPerEvent = link.notificationsPerEvent.load(std::memory_order_relaxed);
+    info->changed               = 0;
+    info->matched               = linkMatches(link);
+    return true;
+}
+
+size_t HMS_BLE::getSendBatch() const {
+    return sendBatch.load(std::memory_order_relaxed);
+}
+
+size_t HMS_BLE::sendBudget() const {
+    size_t batch = sendBatch.load(std::memory_order_relaxed);
+    if(batch == 0) return SIZE_MAX;
+    #if HMS_BLE_TX_CREDITS
+        size_t inFlight = getTxStats().inFlight;                                                        // Still with the stack from earlier passes
+        return batch > inFlight ? batch - inFlight : 0;
+    #else
+        return batch;
+    #endif
+}
+
+uint32_t HMS_BLE::sendRetryMs() const {
+    uint32_t pace = sendPaceMs.load(std::memory_order_relaxed);
+    return pace ? pace : HMS_BLE_NOTIFY_RETRY_MS;
+}
+#endif
+
+#if HMS_BLE_BROADCAST_SETS
+// ========== Broadcaster ==========
+/*
+  The stack sees one frame per set at a time. Switching frames is a data update on the running set, never a restart, so
+  scanners that follow the set (and periodic sync) keep following it. A hand-off needs the stack for a while, so it runs
+  outside lockAdvertising() on a snapshot of the frame; the handing flag makes sure only one thread talks to the stack
+  for a set, and the stale flag makes the one that holds it repeat the hand-off when the frame changed meanwhile.
+*/
+
+// First frame in the rotation at or after from (cyclic), from itself when the rotation is empty
+static uint8_t firstBroadcastFrame(const uint8_t* lengths, int from) {
+    for(int k = 0; k < HMS_BLE_BROADCAST_FRAMES; k++) {
+        int frame = (from + k) % HMS_BLE_BROADCAST_FRAMES;
+        if(lengths[frame]) return (uint8_t)frame;
+    }
+    return (uint8_t)(from % HMS_BLE_BROADCAST_FRAMES);
+}
+
+uint32_t HMS_BLE::broadcastFrameUs(const HMS_BLE_BroadcastParams& params) {
+    if(params.mode == HMS_BLE_BROADCAST_PERIODIC) return params.eventsPerFrame * params.periodicInterval * 1250u;
+    return params.eventsPerFrame * (params.interval * 625u + 5000);                                     // advDelay is 0..10 ms per event
+}
+
+HMS_BLE_Status HMS_BLE::createBroadcast(const HMS_BLE_BroadcastParams& params, int* set) {
+    if(!set) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(!bleInitialized) return HMS_BLE_STATUS_ERROR_INIT;
+    bool periodic = params.mode == HMS_BLE_BROADCAST_PERIODIC;
+    if(params.mode < HMS_BLE_BROADCAST_LEGACY || params.mode > HMS_BLE_BROADCAST_PERIODIC ||
+       params.interval < 32 || params.interval > 16384 || params.eventsPerFrame == 0 || (periodic && params.periodicInterval < 6) ||
+       (params.phy & ~(HMS_BLE_PHY_1M | HMS_BLE_PHY_2M | HMS_BLE_PHY_CODED)) || (params.phy & (params.phy - 1)) ||    // One PHY
+       (params.mode == HMS_BLE_BROADCAST_LEGACY && params.phy & ~HMS_BLE_PHY_1M)) {                    // Legacy PDUs are 1M only
+        return HMS_BLE_STATUS_ERROR_PROTOCOL;
+    }
+
+    int free = -1;
+    for(int i = 0; i < HMS_BLE_BROADCAST_SETS && free < 0; i++) {
+        if(!broadcastSets[i].used) free = i;
+    }
+    if(free < 0) return HMS_BLE_STATUS_ERROR_BUSY;
+
+    BroadcastSet& b = broadcastSets[free];
+    lockAdvertising();
+    b.params = params;
+    b.frame = 0;
+    memset(b.frameLengths, 0, sizeof(b.frameLengths));
+    unlockAdvertising();
+    HMS_BLE_Status status = createBroadcastInternal(free, params);
+    if(status != HMS_BLE_STATUS_SUCCESS) {
+        BLE_LOGGER(warn, "Broadcast set (mode %d) refused by the stack: %d", (int)params.mode, (int)status);
+        return status;
+    }
+    resetBroadcastStats(free);
+    b.used = true;
+    *set = free;
+    BLE_LOGGER(debug, "Broadcast set %d created, mode %d, %d data bytes a frame", free, (int)params.mode, (int)getBroadcastCapacity(free));
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::setBroadcastFrame(int set, int frame, const uint8_t* data, size_t length) {
+    if(set < 0 || set >= HMS_BLE_BROADCAST_SETS || !broadcastSets[set].used || frame < 0 || frame >= HMS_BLE_BROADCAST_FRAMES ||
+       (length && !data)) {
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+    if(length > getBroadcastCapacity(set)) return HMS_BLE_STATUS_ERROR_OVERFLOW;
+
+    BroadcastSet& b = broadcastSets[set];
+    lockAdvertising();
+    if(length) {
+        uint8_t* packet = b.frames[frame];
+        packet[0] = (uint8_t)(length + 3);                                                              // Type and company identifier
+        packet[1] = 0xFF;                                                                               // Manufacturer Specific Data
+        packet[2] = b.params.companyId & 0xFF;
+        packet[3] = b.params.companyId >> 8;
+        memcpy(packet + 4, data, length);
+    }
+    b.frameLengths[frame] = length ? (uint8_t)(length + 4) : 0;
+    bool onAir = frame == b.frame || b.frameLengths[b.frame] == 0;
+    b.frame = firstBroadcastFrame(b.frameLengths, b.frame);                                             // Moves on when the frame on air left the rotation
+    unlockAdvertising();
+
+    if(onAir) {
+        b.stale = true;
+        if(b.running) publishBroadcast(set);
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::startBroadcast(int set) {
+    if(set < 0 || set >= HMS_BLE_BROADCAST_SETS || !broadcastSets[set].used) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    BroadcastSet& b = broadcastSets[set];
+    if(b.running) return HMS_BLE_STATUS_SUCCESS;
+
+    claimBroadcast(set);
+    b.stale = false;
+    HMS_BLE_Status status = handBroadcast(set);
+    if(status == HMS_BLE_STATUS_SUCCESS) status = startBroadcastInternal(set);
+    if(status == HMS_BLE_STATUS_SUCCESS) {
+        lockAdvertising();
+        b.nextRotation = eventClockMicros() + broadcastFrameUs(b.params);
+        unlockAdvertising();
+        b.running = true;
+    }
+    releaseBroadcast(set);
+
+    if(status != HMS_BLE_STATUS_SUCCESS) {
+        BLE_LOGGER(warn, "Broadcast set %d failed to start: %d", set, (int)status);
+        return status;
+    }
+    signalEvent(HMS_BLE_EVENT_BROADCAST);                                                               // The background task picks up the rotation
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::stopBroadcast(int set) {
+    if(set < 0 || set >= HMS_BLE_BROADCAST_SETS || !broadcastSets[set].used) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    BroadcastSet& b = broadcastSets[set];
+    if(!b.running) return HMS_BLE_STATUS_SUCCESS;
+
+    claimBroadcast(set);
+    b.running = false;
+    HMS_BLE_Status status = stopBroadcastInternal(set);
+    releaseBroadcast(set);
+    return status;
+}
+
+HMS_BLE_Status HMS_BLE::removeBroadcast(int set) {
+    if(set < 0 || set >= HMS_BLE_BROADCAST_SETS || !broadcastSets[set].used) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    BroadcastSet& b = broadcastSets[set];
+    stopBroadcast(set);
+    claimBroadcast(set);
+    removeBroadcastInternal(set);
+    lockAdvertising();
+    memset(b.frameLengths, 0, sizeof(b.frameLengths));
+    unlockAdvertising();
+    b.used = false;
+    releaseBroadcast(set);
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+size_t HMS_BLE::getBroadcastCapacity(int set) const {
+    if(set < 0 || set >= HMS_BLE_BROADCAST_SETS || !broadcastSets[set].used) return 0;
+    if(broadcastSets[set].params.mode == HMS_BLE_BROADCAST_LEGACY) return HMS_BLE_ADV_PACKET_LENGTH - 4;
+    return HMS_BLE_BROADCAST_DATA_LENGTH - 4;                                                           // AD length, type and company identifier
+}
+
+HMS_BLE_BroadcastStats HMS_BLE::getBroadcastStats(int set) const {
+    HMS_BLE_BroadcastStats stats = {};
+    if(set < 0 || set >= HMS_BLE_BROADCAST_SETS || !broadcastSets[set].used) return stats;
+    const BroadcastSet& b = broadcastSets[set];
+    stats.updates = b.updates.load(std::memory_order_relaxed);
+    stats.rotations = b.rotations.load(std::memory_order_relaxed);
+    stats.failed = b.failed.load(std::memory_order_relaxed);
+    stats.bytes = b.bytes.load(std::memory_order_relaxed);
+    stats.running = b.running.load();
+    lockAdvertising();
+    stats.frame = b.frame;
+    for(int i = 0; i < HMS_BLE_BROADCAST_FRAMES; i++) {
+        if(b.frameLengths[i]) stats.frames++;
+    }
+    unlockAdvertising();
+    return stats;
+}
+
+void HMS_BLE::resetBroadcastStats(int set) {
+    if(set < 0 || set >= HMS_BLE_BROADCAST_SETS) return;
+    BroadcastSet& b = broadcastSets[set];
+    b.updates.store(0, std::memory_order_relaxed);
+    b.rotations.store(0, std::memory_order_relaxed);
+    b.failed.store(0, std::memory_order_relaxed);
+    b.bytes.store(0, std::memory_order_relaxed);
+}
+
+void HMS_BLE::rotateBroadcasts() {
+    uint32_t now = eventClockMicros();
+    for(int set = 0; set < HMS_BLE_BROADCAST_SETS; set++) {
+        BroadcastSet& b = broadcastSets[set];
+        if(!b.running) continue;
+        bool switched = false;
+        lockAdvertising();
+        if((int32_t)(now - b.nextRotation) >= 0) {
+            uint8_t next = firstBroadcastFrame(b.frameLengths, b.frame + 1);
+            switched = next != b.frame;
+            b.frame = next;
+            uint32_t frameUs = broadcastFrameUs(b.params);
+            b.nextRotation += frameUs;                                                                  // Keeps the cadence when loop() ran late
+            if((int32_t)(now - b.nextRotation) >= 0) b.nextRotation = now + frameUs;                    // Unless it fell a whole frame behind
+        }
+        unlockAdvertising();
+        if(switched) {
+            b.rotations.fetch_add(1, std::memory_order_relaxed);
+            publishBroadcast(set);
+        }
+    }
+}
+
+uint32_t HMS_BLE::broadcastWaitMs() const {
+    uint32_t now = eventClockMicros();
+    uint32_t wait = 0;
+    for(int set = 0; set < HMS_BLE_BROADCAST_SETS; set++) {
+        const BroadcastSet& b = broadcastSets[set];
+        if(!b.running) continue;
+        lockAdvertising();
+        int32_t left = (int32_t)(b.nextRotation - now);
+        unlockAdvertising();
+        uint32_t ms = left <= 0 ? 1 : ((uint32_t)left + 999) / 1000;
+        if(!wait || ms < wait) wait = ms;
+    }
+    return wait;
+}
+
+HMS_BLE_Status HMS_BLE::handBroadcast(int set) {
+    BroadcastSet& b = broadcastSets[set];
+    uint8_t packet[HMS_BLE_BROADCAST_DATA_LENGTH];
+    lockAdvertising();
+    uint8_t frame = b.frame;
+    size_t length = b.frameLengths[frame];
+    memcpy(packet, b.frames[frame], length);
+    unlockAdvertising();
+
+    HMS_BLE_Status status = setBroadcastDataInternal(set, packet, length);
+    if(status == HMS_BLE_STATUS_SUCCESS) {
+        b.updates.fetch_add(1, std::memory_order_relaxed);
+        b.bytes.fetch_add((uint32_t)length, std::memory_order_relaxed);
+    } else {
+        b.failed.fetch_add(1, std::memory_order_relaxed);
+    }
+    trace(HMS_BLE_TRACE_BROADCAST, -1, (uint16_t)(set << 8 | frame), (uint32_t)length, status);
+    return status;
+}
+
+void HMS_BLE::publishBroadcast(int set) {
+    BroadcastSet& b = broadcastSets[set];
+    b.stale = true;
+    while(!b.handing.exchange(true)) {
+        while(b.stale.exchange(false)) {
+            handBroadcast(set);
+        }
+        b.handing = false;
+        if(!b.stale) break;                                                                             // Else a frame changed after the last check and its publisher found us busy
+    }
+}
+
+void HMS_BLE::claimBroadcast(int set) {
+    while(broadcastSets[set].handing.exchange(true)) {
+        bleDelay(1);                                                                                    // A hand-off takes one stack call
+    }
+}
+
+void HMS_BLE::releaseBroadcast(int set) {
+    BroadcastSet& b = broadcastSets[set];
+    b.handing = false;
+    if(b.running && b.stale) publishBroadcast(set);                                                     // Left by a publisher while the set was claimed
+}
+#endif
+
+// ========== Receive Path ==========
+
+void HMS_BLE::storeReceivedData(int serviceIndex, int charIndex, const uint8_t* value, size_t length) {
+    if(serviceIndex < 0 || serviceIndex >= (int)serviceCount) return;
+    HMS_BLE_ServiceDescriptor& svc = services[serviceIndex];
+
+    #if HMS_BLE_RX_RING_DEPTH
+        if(charIndex >= 0 && charIndex < (int)svc.characteristicCount) {
+            svc.rxRings[charIndex].push(value, length);
+        }
+    #endif
+
+    // Compatibility buffers: per-service and legacy shared, NUL-terminated
+    size_t storeLen = (length < HMS_BLE_MAX_DATA_LENGTH - 1) ? length : HMS_BLE_MAX_DATA_LENGTH - 1;
+    memcpy(svc.data, value, storeLen);
+    svc.dataLength = storeLen;
+    svc.data[storeLen] = 0;
+    svc.received = true;
+
+    #if HMS_BLE_LEGACY_API
+        memcpy(data, value, storeLen);
+        dataLength = storeLen;
+        data[storeLen] = 0;
+        received = true;
+    #endif
+
+    #if HMS_BLE_VALUE_CACHE
+        if(charIndex >= 0 && charIndex < (int)svc.characteristicCount && (svc.characteristics[charIndex].properties & HMS_BLE_PROPERTY_READ)) {
+            updateCachedValue(serviceIndex, charIndex, value, length);                                  // Written value reads back, like a stack-held attribute
+        }
+    #endif
+
+    #if !HMS_BLE_RX_RING_DEPTH && !HMS_BLE_VALUE_CACHE
+        (void)charIndex;
+    #endif
+    signalEvent(HMS_BLE_EVENT_WRITE);
+}
+
+void HMS_BLE::deliverWriteView(int serviceIndex, int charIndex, const uint8_t* value, size_t length, const uint8_t* deviceMac) {
+    if(serviceIndex < 0 || serviceIndex >= (int)serviceCount) return;
+    if(charIndex < 0 || charIndex >= (int)services[serviceIndex].characteristicCount) return;
+
+    #if HMS_BLE_RX_RING_DEPTH
+        services[serviceIndex].rxRings[charIndex].push(value, length);
+    #endif
+    signalEvent(HMS_BLE_EVENT_WRITE);
+    writeViewCallback(encodeHandle(serviceIndex, charIndex), HMS_BLE_ValueView{value, length}, deviceMac);
+}
+
+size_t HMS_BLE::deliverReadInto(int serviceIndex, int charIndex, uint8_t* buffer, size_t capacity, const uint8_t* deviceMac) {
+    if(serviceIndex < 0 || serviceIndex >= (int)serviceCount) return 0;
+    if(charIndex < 0 || charIndex >= (int)services[serviceIndex].characteristicCount) return 0;
+
+    size_t length = readIntoCallback(encodeHandle(serviceIndex, charIndex), HMS_BLE_ValueBuffer{buffer, capacity}, deviceMac);
+    return (length < capacity) ? length : capacity;
+}
+
+#if HMS_BLE_RX_RING_DEPTH
+HMS_BLE_Status HMS_BLE::setReceiveMode(HMS_BLE_CharHandle handle, HMS_BLE_RxMode mode) {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(isConnected()) {
+        BLE_LOGGER(warn, "Receive mode can only change while no central is connected");
+        return HMS_BLE_STATUS_ERROR_START;
+    }
+    services[svcIdx].rxRings[charIdx].reset(mode);
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+bool HMS_BLE::receive(HMS_BLE_CharHandle handle, uint8_t* value, size_t* length) {
+    int svcIdx, charIdx;
+    if(!value || !length || !decodeHandle(handle, &svcIdx, &charIdx)) return false;
+    return services[svcIdx].rxRings[charIdx].pop(value, length);
+}
+
+size_t HMS_BLE::getReceiveDepth(HMS_BLE_CharHandle handle) const {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return 0;
+    return services[svcIdx].rxRings[charIdx].available();
+}
+
+uint32_t HMS_BLE::getReceiveOverflows(HMS_BLE_CharHandle handle) const {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return 0;
+    return services[svcIdx].rxRings[charIdx].overflows.load(std::memory_order_relaxed);
+}
+
+uint32_t HMS_BLE::getReceiveTruncations(HMS_BLE_CharHandle handle) const {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return 0;
+    return services[svcIdx].rxRings[charIdx].truncations.load(std::memory_order_relaxed);
+}
+#endif
+
+// ========== Write Command Ingest ==========
+
+#if HMS_BLE_INGEST_BYTES
+/*
+  Single producer (the BLE host context runs the write handlers one at a time), single consumer (whoever holds
+  ingestDraining). Head and tail count bytes since start and records are multiples of 8 bytes, so a record never wraps:
+  when one does not fit before the end of the buffer, a pad record fills the rest and it starts again at offset 0.
+*/
+typedef struct {
+    uint16_t length;                                                                                    // Payload bytes, INGEST_PAD for a pad record
+    uint16_t handle;                                                                                    // HMS_BLE_CharHandle id
+    uint8_t  slot;                                                                                      // Connection slot, 0xFF when unknown
+    uint8_t  reserved[3];
+} HMS_BLE_IngestHeader;
+
+static const uint16_t INGEST_PAD = 0xFFFF;
+
+static inline uint32_t ingestRecordSize(size_t length) {
+    return (uint32_t)(sizeof(HMS_BLE_IngestHeader) + ((length + 7) & ~(size_t)7));
+}
+
+bool HMS_BLE::consumeIngestWrite(int slot, int serviceIndex, int charIndex, const uint8_t* data, size_t length) {
+    if(!ingestCallback) return false;                                                                   // Nobody drains the ring, the write callbacks get it
+    if(serviceIndex < 0 || serviceIndex >= (int)serviceCount) return false;
+    if(charIndex < 0 || charIndex >= (int)services[serviceIndex].characteristicCount) return false;
+    if(!(services[serviceIndex].characteristics[charIndex].properties & HMS_BLE_PROPERTY_WRITE_NR)) return false;
+    if(length > HMS_BLE_ATT_MAX_VALUE_LENGTH) length = HMS_BLE_ATT_MAX_VALUE_LENGTH;
+
+    uint32_t need = ingestRecordSize(length);
+    uint32_t head = ingestHead.load(std::memory_order_relaxed);
+    uint32_t used = head - ingestTail.load(std::memory_order_acquire);
+    uint32_t offset = head & (HMS_BLE_INGEST_BYTES - 1);
+    uint32_t pad = (HMS_BLE_INGEST_BYTES - offset < need) ? HMS_BLE_INGEST_BYTES - offset : 0;
+    if(HMS_BLE_INGEST_BYTES - used < need + pad) {
+        ingestDropped.fetch_add(1, std::memory_order_relaxed);
+        ingestDroppedBytes.fetch_add((uint32_t)length, std::memory_order_relaxed);
+        return true;
+    }
+
+    HMS_BLE_IngestHeader header = { INGEST_PAD, 0, 0, {0, 0, 0} };
+    if(pad) {
+        memcpy(ingestRing + offset, &header, sizeof(header));
+        offset = 0;
+    }
+    header.length = (uint16_t)length;
+    header.handle = encodeHandle(serviceIndex, charIndex).id;
+    header.slot   = (slot >= 0 && slot < HMS_BLE_MAX_CLIENTS) ? (uint8_t)slot : 0xFF;
+    memcpy(ingestRing + offset, &header, sizeof(header));
+    memcpy(ingestRing + offset + sizeof(header), data, length);
+    ingestHead.store(head + pad + need, std::memory_order_release);
+
+    if(used + pad + need > ingestMaxFill.load(std::memory_order_relaxed)) {
+        ingestMaxFill.store(used + pad + need, std::memory_order_relaxed);                             // Single writer
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);                                                // Pairs with processIngest(): it sees this record or the event is raised again
+    if(!(pendingEvents.load(std::memory_order_relaxed) & HMS_BLE_EVENT_WRITE)) {
+        signalEvent(HMS_BLE_EVENT_WRITE);                                                               // Wake the consumer once per batch, not per write
+    }
+    return true;
+}
+
+size_t HMS_BLE::processIngest(size_t maxRecords) {
+    if(!ingestCallback || ingestDraining.test_and_set(std::memory_order_acquire)) return 0;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t tail = ingestTail.load(std::memory_order_relaxed);
+    uint32_t head = ingestHead.load(std::memory_order_acquire);
+    size_t count = 0;
+    while(tail != head && count < maxRecords) {
+        uint32_t offset = tail & (HMS_BLE_INGEST_BYTES - 1);
+        HMS_BLE_IngestHeader header;
+        memcpy(&header, ingestRing + offset, sizeof(header));
+        if(header.length == INGEST_PAD) {
+            tail += HMS_BLE_INGEST_BYTES - offset;
+        } else {
+            ingestCallback(HMS_BLE_CharHandle{header.handle}, HMS_BLE_ValueView{ingestRing + offset + sizeof(header), header.length},
+                header.slot == 0xFF ? -1 : header.slot);
+            ingestReceived.fetch_add(1, std::memory_order_relaxed);
+            ingestBytes.fetch_add(header.length, std::memory_order_relaxed);
+            tail += ingestRecordSize(header.length);
+            count++;
+        }
+        ingestTail.store(tail, std::memory_order_release);                                              // Hand each record back as soon as it is handled
+        if(tail == head) head = ingestHead.load(std::memory_order_acquire);
+    }
+    ingestDraining.clear(std::memory_order_release);
+    return count;
+}
+
+size_t HMS_BLE::getIngestFill() const {
+    return ingestHead.load(std::memory_order_acquire) - ingestTail.load(std::memory_order_acquire);
+}
+
+HMS_BLE_IngestStats HMS_BLE::getIngestStats() const {
+    HMS_BLE_IngestStats stats;
+    stats.received     = ingestReceived.load(std::memory_order_relaxed);
+    stats.bytes        = ingestBytes.load(std::memory_order_relaxed);
+    stats.dropped      = ingestDropped.load(std::memory_order_relaxed);
+    stats.droppedBytes = ingestDroppedBytes.load(std::memory_order_relaxed);
+    stats.maxFill      = ingestMaxFill.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void HMS_BLE::resetIngestStats() {
+    ingestReceived.store(0, std::memory_order_relaxed);
+    ingestBytes.store(0, std::memory_order_relaxed);
+    ingestDropped.store(0, std::memory_order_relaxed);
+    ingestDroppedBytes.store(0, std::memory_order_relaxed);
+    ingestMaxFill.store((uint32_t)getIngestFill(), std::memory_order_relaxed);
+}
+#endif
+
+// ========== Value Cache ==========
+
+#if HMS_BLE_VALUE_CACHE
+void HMS_BLE::lockValueCache() const {
+    #if defined(HMS_BLE_ARDUINO_ESP32)
+        taskENTER_CRITICAL(&valueCacheMux);
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+        valueCacheKey = k_spin_lock(&valueCacheSpinlock);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        valueCacheMutex.lock();
+    #endif
+}
+
+void HMS_BLE::unlockValueCache() const {
+    #if defined(HMS_BLE_ARDUINO_ESP32)
+        taskEXIT_CRITICAL(&valueCacheMux);
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+        k_spin_unlock(&valueCacheSpinlock, valueCacheKey);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        valueCacheMutex.unlock();
+    #endif
+}
+
+bool HMS_BLE::updateCachedValue(int serviceIndex, int charIndex, const uint8_t* value, size_t length) {
+    HMS_BLE_ServiceDescriptor& svc = services[serviceIndex];
+    if(length > HMS_BLE_MAX_DATA_LENGTH) length = HMS_BLE_MAX_DATA_LENGTH;
+
+    lockValueCache();
+    bool changed = svc.cachedLengths[charIndex] != length || memcmp(svc.cachedValues[charIndex], value, length) != 0;
+    if(changed) {
+        memcpy(svc.cachedValues[charIndex], value, length);
+        svc.cachedLengths[charIndex] = (uint16_t)length;
+    }
+    unlockValueCache();
+    return changed;
+}
+
+size_t HMS_BLE::readCachedValue(int serviceIndex, int charIndex, uint8_t* value, size_t capacity) const {
+    const HMS_BLE_ServiceDescriptor& svc = services[serviceIndex];
+    lockValueCache();
+    size_t length = std::min((size_t)svc.cachedLengths[charIndex], capacity);
+    memcpy(value, svc.cachedValues[charIndex], length);
+    unlockValueCache();
+    return length;
+}
+
+void HMS_BLE::storeValue(int serviceIndex, int charIndex, const uint8_t* value, size_t length) {
+    updateCachedValue(serviceIndex, charIndex, value, length);
+
+    // Stacks that serve reads from their own attribute value get it too (Zephyr reads the cache directly)
+    #if defined(HMS_BLE_ARDUINO_ESP32)
+        NimBLECharacteristic* pChar = services[serviceIndex].bleCharacteristics[charIndex];
+        if(pChar) pChar->setValue(value, length);
+    #elif defined(HMS_BLE_DESKTOP_SIM)
+        std::lock_guard<std::recursive_mutex> lock(desktopMutex);
+        services[serviceIndex].valueLengths[charIndex] = std::min(length, (size_t)HMS_BLE_MAX_DATA_LENGTH);
+        memcpy(services[serviceIndex].values[charIndex], value, services[serviceIndex].valueLengths[charIndex]);
+    #endif
+}
+
+void HMS_BLE::refreshCachedValue(int serviceIndex, int charIndex, const uint8_t* deviceMac) {
+    if(!readCallback) return;
+    const HMS_BLE_ServiceDescriptor& svc = services[serviceIndex];
+    uint8_t value[HMS_BLE_MAX_DATA_LENGTH] = {0};
+    size_t length = 0;
+    readCallback(svc.service->uuidStr, svc.characteristics[charIndex].uuidStr, value, &length, deviceMac);
+    if(length > 0 && length <= HMS_BLE_MAX_DATA_LENGTH) {
+        storeValue(serviceIndex, charIndex, value, length);
+    }
+}
+
+void HMS_BLE::beginCachedRead(int serviceIndex, int charIndex, const uint8_t* deviceMac) {
+    if(services[serviceIndex].readPolicies[charIndex] == HMS_BLE_READ_REFRESH) {
+        cacheRefreshedReads.fetch_add(1, std::memory_order_relaxed);
+        refreshCachedValue(serviceIndex, charIndex, deviceMac);
+    } else {
+        cacheCachedReads.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+HMS_BLE_Status HMS_BLE::setValue(HMS_BLE_CharHandle handle, const uint8_t* data, size_t length) {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(!data || length == 0) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(length > HMS_BLE_MAX_DATA_LENGTH) return HMS_BLE_STATUS_ERROR_OVERFLOW;
+    storeValue(svcIdx, charIdx, data, length);
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+bool HMS_BLE::getValue(HMS_BLE_CharHandle handle, uint8_t* data, size_t* length) const {
+    int svcIdx, charIdx;
+    if(!data || !length || !decodeHandle(handle, &svcIdx, &charIdx)) return false;
+    *length = readCachedValue(svcIdx, charIdx, data, *length);
+    return true;
+}
+
+HMS_BLE_Status HMS_BLE::setReadPolicy(HMS_BLE_CharHandle handle, HMS_BLE_ReadPolicy policy) {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    services[svcIdx].readPolicies[charIdx] = (uint8_t)policy;
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::setNotifyOnChange(HMS_BLE_CharHandle handle, bool enabled) {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    services[svcIdx].notifyOnChange[charIdx] = enabled;
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_ValueCacheStats HMS_BLE::getValueCacheStats() const {
+    HMS_BLE_ValueCacheStats stats;
+    stats.cachedReads      = cacheCachedReads.load(std::memory_order_relaxed);
+    stats.refreshedReads   = cacheRefreshedReads.load(std::memory_order_relaxed);
+    stats.unchangedSkipped = cacheUnchangedSkipped.load(std::memory_order_relaxed);
+    return stats;
+}
+#endif
+
+// ========== Notification Queue ==========
+
+HMS_BLE_Status HMS_BLE::submitData(int serviceIndex, int charIndex, const uint8_t* data, size_t length) {
+    #if HMS_BLE_VALUE_CACHE
+        if(!updateCachedValue(serviceIndex, charIndex, data, length) && services[serviceIndex].notifyOnChange[charIndex]) {
+            cacheUnchangedSkipped.fetch_add(1, std::memory_order_relaxed);
+            statCoalesced.fetch_add(1, std::memory_order_relaxed);
+            return HMS_BLE_STATUS_SUCCESS;                                                              // Same value as last time, nothing to notify
+        }
+    #endif
+
+    #if HMS_BLE_INDICATE_DEPTH
+        uint32_t properties = services[serviceIndex].characteristics[charIndex].properties;
+        if((properties & HMS_BLE_PROPERTY_INDICATE) && !(properties & HMS_BLE_PROPERTY_NOTIFY)) {
+            HMS_BLE_Status status = queueIndication(serviceIndex, charIndex, data, length, nullptr);
+            if(status != HMS_BLE_STATUS_ERROR_NOT_CONNECTED) return status;                             // Nobody indicating: only the stored value changes below
+        }
+    #endif
+
+    #if HMS_BLE_NOTIFY_QUEUE
+        // Nobody to notify: store the value right away, there is nothing to coalesce
+        if(!isSubscribed(encodeHandle(serviceIndex, charIndex))) {
+            return stackSend(serviceIndex, charIndex, data, length);
+        }
+
+        HMS_BLE_ServiceDescriptor& svc = services[serviceIndex];
+        bool wake = false;
+        lockNotifyQueue();
+        memcpy(svc.pendingValues[charIndex], data, length);
+        svc.pendingLengths[charIndex] = (uint16_t)length;
+        svc.pendingDirty[charIndex] = true;
+        if(svc.pendingQueued[charIndex]) {
+            notifyQueueStats.coalesced++;
+            statCoalesced.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            wake = true;
+            notifyQueue[(notifyQueueHead + notifyQueueCount) % HMS_BLE_MAX_CHARACTERISTICS] = encodeHandle(serviceIndex, charIndex).id;
+            notifyQueueCount++;
+            svc.pendingQueued[charIndex] = true;
+            if(notifyQueueCount > notifyQueueStats.highWater) notifyQueueStats.highWater = notifyQueueCount;
+        }
+        notifyQueueStats.queued++;
+        unlockNotifyQueue();
+        trace(HMS_BLE_TRACE_QUEUE, -1, encodeHandle(serviceIndex, charIndex).id, length, !wake);
+        if(wake) signalEvent(HMS_BLE_EVENT_SEND);                                                       // A coalesced update rides on the wakeup already pending
+        return HMS_BLE_STATUS_SUCCESS;
+    #else
+        return sendWithBackpressure(serviceIndex, charIndex, data, length, nullptr);
+    #endif
+}
+
+HMS_BLE_Status HMS_BLE::sendWithBackpressure(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_SendCallback* done) {
+    HMS_BLE_Status status = stackSend(serviceIndex, charIndex, data, length, done);
+    #if HMS_BLE_TX_CREDITS
+        if(status != HMS_BLE_STATUS_ERROR_BUSY || sendTimeoutMs == 0) return status;
+
+        // Every credit in flight: wait for one to come back, another sender may take it first so retry until the deadline
+        uint32_t start = eventClockMicros();
+        uint64_t budgetUs = (uint64_t)sendTimeoutMs * 1000;
+        while(status == HMS_BLE_STATUS_ERROR_BUSY) {
+            uint32_t elapsed = eventClockMicros() - start;
+            if(elapsed >= budgetUs || !waitForTxCredit((uint32_t)((budgetUs - elapsed + 999) / 1000))) break;
+            status = stackSend(serviceIndex, charIndex, data, length, done);
+        }
+    #endif
+    return status;
+}
+
+#if HMS_BLE_NOTIFY_QUEUE
+void HMS_BLE::lockNotifyQueue() const {
+    #if defined(HMS_BLE_ARDUINO_ESP32)
+        taskENTER_CRITICAL(&notifyQueueMux);
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+        notifyQueueKey = k_spin_lock(&notifyQueueSpinlock);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        notifyQueueMutex.lock();
+    #endif
+}
+
+void HMS_BLE::unlockNotifyQueue() const {
+    #if defined(HMS_BLE_ARDUINO_ESP32)
+        taskEXIT_CRITICAL(&notifyQueueMux);
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+        k_spin_unlock(&notifyQueueSpinlock, notifyQueueKey);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        notifyQueueMutex.unlock();
+    #endif
+}
+
+/*
+  One pass over the entries queued when the drain starts. The value is copied out under the lock and sent without it, so the
+  application can keep updating while the stack blocks. An entry whose value changed during the send moves to the tail
+  (round-robin, a hot characteristic cannot starve the others); a send the stack could not take (ERROR_SEND, or ERROR_BUSY with
+  every TX credit in flight) stays at the head and ends the pass. Only one drain runs at a time (background task vs flushNotifyQueue()).
+*/
+void HMS_BLE::drainNotifyQueue() {
+    uint8_t value[HMS_BLE_MAX_DATA_LENGTH];
+
+    lockNotifyQueue();
+    if(notifyQueueDraining) {
+        unlockNotifyQueue();
+        return;
+    }
+    notifyQueueDraining = true;
+    size_t budget = std::min(notifyQueueCount, sendBudget());                                          // What the links carry until the next pass
+    unlockNotifyQueue();
+
+    while(budget--) {
+        lockNotifyQueue();
+        if(notifyQueueCount == 0) {
+            unlockNotifyQueue();
+            break;
+        }
+        uint16_t id = notifyQueue[notifyQueueHead];
+        int s = id >> 8, c = id & 0xFF;
+        HMS_BLE_ServiceDescriptor& svc = services[s];
+        size_t length = svc.pendingLengths[c];
+        memcpy(value, svc.pendingValues[c], length);
+        svc.pendingDirty[c] = false;
+        unlockNotifyQueue();
+
+        HMS_BLE_Status status = stackSend(s, c, value, length);
+
+        lockNotifyQueue();
+        if(status == HMS_BLE_STATUS_ERROR_SEND || status == HMS_BLE_STATUS_ERROR_BUSY) {
+            notifyQueueStats.deferred++;
+            unlockNotifyQueue();
+            break;
+        }
+
+        if(status == HMS_BLE_STATUS_SUCCESS) {
+            notifyQueueStats.sent++;
+        } else {
+            notifyQueueStats.dropped++;
+            statDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        notifyQueueHead = (notifyQueueHead + 1) % HMS_BLE_MAX_CHARACTERISTICS;
+        notifyQueueCount--;
+        if(svc.pendingDirty[c] && status == HMS_BLE_STATUS_SUCCESS) {
+            notifyQueue[(notifyQueueHead + notifyQueueCount) % HMS_BLE_MAX_CHARACTERISTICS] = id;
+            notifyQueueCount++;
+        } else {
+            svc.pendingQueued[c] = false;
+            svc.pendingDirty[c] = false;
+        }
+        unlockNotifyQueue();
+    }
+
+    lockNotifyQueue();
+    notifyQueueDraining = false;
+    unlockNotifyQueue();
+}
+
+size_t HMS_BLE::getNotifyQueueDepth() const {
+    lockNotifyQueue();
+    size_t depth = notifyQueueCount;
+    unlockNotifyQueue();
+    return depth;
+}
+
+HMS_BLE_NotifyQueueStats HMS_BLE::getNotifyQueueStats() const {
+    lockNotifyQueue();
+    HMS_BLE_NotifyQueueStats stats = notifyQueueStats;
+    stats.depth = notifyQueueCount;
+    unlockNotifyQueue();
+    return stats;
+}
+
+void HMS_BLE::resetNotifyQueueStats() {
+    lockNotifyQueue();
+    memset(&notifyQueueStats, 0, sizeof(notifyQueueStats));
+    notifyQueueStats.highWater = notifyQueueCount;
+    unlockNotifyQueue();
+}
+
+void HMS_BLE::flushNotifyQueue() {
+    drainNotifyQueue();
+}
+#endif
+
+// ========== TX Flow Control ==========
+/*
+  A credit stands for one send handed to the stack: the backend takes it before queueing the PDU(s) and the stack's TX-complete
+  callback returns it through completeTx() with the token. The token carries the slot's generation, so a completion arriving
+  after abortTx() reclaimed the slot (or after it was reused) is ignored. A send to several links holds one credit until the
+  PDU on every link completed (or its link dropped), onSent sees the first failure if any.
+*/
+
+#if HMS_BLE_TX_CREDITS
+void HMS_BLE::lockTx() const {
+    #if defined(HMS_BLE_ZEPHYR_nRF)
+        txKey = k_spin_lock(&txSpinlock);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        txMutex.lock();
+    #endif
+}
+
+void HMS_BLE::unlockTx() const {
+    #if defined(HMS_BLE_ZEPHYR_nRF)
+        k_spin_unlock(&txSpinlock, txKey);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        txMutex.unlock();
+    #endif
+}
+
+int32_t HMS_BLE::acquireTxCredit(HMS_BLE_CharHandle handle, const HMS_BLE_SendCallback* done, const uint32_t* links) {
+    lockTx();
+    if(txFree == 0) {
+        txStats.busy++;
+        txWaiting.store(true, std::memory_order_relaxed);                                               // Set under the lock: the completion that frees a credit sees it
+        unlockTx();
+        return -1;
+    }
+
+    int slot = 0;
+    while(txSlots[slot].used) slot++;
+    HMS_BLE_TxSlot& tx = txSlots[slot];
+    tx.used = true;
+    tx.handle = handle.id;
+    memcpy(tx.links, links, sizeof(tx.links));
+    tx.status = HMS_BLE_STATUS_SUCCESS;
+    tx.done = done ? *done : nullptr;
+    txFree--;
+    txStats.submitted++;
+    txStats.inFlight = HMS_BLE_TX_CREDITS - txFree;
+    if(txStats.inFlight > txStats.maxInFlight) txStats.maxInFlight = txStats.inFlight;
+    int32_t token = ((int32_t)tx.generation << 8) | slot;
+    unlockTx();
+    return token;
+}
+
+void HMS_BLE::completeTx(int32_t token, HMS_BLE_Status status, int link) {
+    int slot = token & 0xFF;
+    if(token < 0 || slot >= HMS_BLE_TX_CREDITS || link < 0 || link >= HMS_BLE_MAX_CLIENTS) return;
+
+    lockTx();
+    HMS_BLE_TxSlot& tx = txSlots[slot];
+    uint32_t bit = 1u << (link % 32);
+    if(!tx.used || tx.generation != (uint16_t)(token >> 8) || !(tx.links[link / 32] & bit)) {         // Reclaimed by abortTx() already
+        unlockTx();
+        return;
+    }
+    if(status != HMS_BLE_STATUS_SUCCESS && tx.status == HMS_BLE_STATUS_SUCCESS) tx.status = status;
+    tx.links[link / 32] &= ~bit;
+    for(int w = 0; w < HMS_BLE_CLIENT_WORDS; w++) {
+        if(tx.links[w]) {                                                                               // Other links still sending
+            unlockTx();
+            return;
+        }
+    }
+
+    HMS_BLE_SendCallback done = std::move(tx.done);
+    HMS_BLE_CharHandle handle = { tx.handle };
+    status = tx.status;
+    tx.done = nullptr;
+    tx.used = false;
+    tx.generation++;
+    txFree++;
+    txStats.inFlight = HMS_BLE_TX_CREDITS - txFree;
+    if(status == HMS_BLE_STATUS_SUCCESS) txStats.completed++;
+    else                                 txStats.failed++;
+    unlockTx();
+    trace(HMS_BLE_TRACE_TX_DONE, -1, handle.id, 0, status);
+
+    #if defined(HMS_BLE_ZEPHYR_nRF)
+        k_sem_give(&zephyrTxDoneSem);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        txCondition.notify_all();
+    #endif
+    if(done) done(handle, status);
+    if(txWaiting.exchange(false, std::memory_order_relaxed)) signalEvent(HMS_BLE_EVENT_SEND);          // Resume a deferred queue drain or stream
+}
+
+void HMS_BLE::cancelTxCredit(int32_t token) {
+    int slot = token & 0xFF;
+    if(token < 0 || slot >= HMS_BLE_TX_CREDITS) return;
+
+    lockTx();
+    HMS_BLE_TxSlot& tx = txSlots[slot];
+    if(tx.used && tx.generation == (uint16_t)(token >> 8)) {
+        tx.done = nullptr;
+        tx.used = false;
+        tx.generation++;
+        txFree++;
+        txStats.submitted--;
+        txStats.inFlight = HMS_BLE_TX_CREDITS - txFree;
+    }
+    unlockTx();
+}
+
+void HMS_BLE::abortTx(HMS_BLE_Status status, int link) {
+    for(int slot = 0; slot < HMS_BLE_TX_CREDITS; slot++) {
+        for(int l = (link < 0 ? 0 : link); l < (link < 0 ? HMS_BLE_MAX_CLIENTS : link + 1); l++) {
+            lockTx();
+            HMS_BLE_TxSlot& tx = txSlots[slot];
+            int32_t token = tx.used ? (((int32_t)tx.generation << 8) | slot) : -1;
+            unlockTx();
+            if(token >= 0) completeTx(token, status, l);                                                // No-op unless this link still holds the PDU
+        }
+    }
+}
+
+bool HMS_BLE::waitForTxCredit(uint32_t timeoutMs) {
+    #if defined(HMS_BLE_ZEPHYR_nRF)
+        if(k_is_in_isr() || k_current_get() == &k_sys_work_q.thread) return false;                     // Completions run there, waiting would deadlock
+        lockTx();
+        bool available = txFree > 0 && zephyrRetryToken.load(std::memory_order_relaxed) == -1;          // An owed notification holds every send back
+        unlockTx();
+        return available || k_sem_take(&zephyrTxDoneSem, K_MSEC(timeoutMs)) == 0;
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        std::unique_lock<std::mutex> lock(txMutex);
+        return txCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return txFree > 0; });
+    #else
+        (void)timeoutMs;
+        return false;
+    #endif
+}
+
+HMS_BLE_TxStats HMS_BLE::getTxStats() const {
+    lockTx();
+    HMS_BLE_TxStats stats = txStats;
+    unlockTx();
+    return stats;
+}
+
+void HMS_BLE::resetTxStats() {
+    lockTx();
+    size_t inFlight = txStats.inFlight;
+    memset(&txStats, 0, sizeof(txStats));
+    txStats.inFlight = inFlight;
+    txStats.maxInFlight = inFlight;
+    unlockTx();
+}
+#endif
+
+// ========== Indications ==========
+/*
+  Each connection slot has HMS_BLE_INDICATE_DEPTH entries. indicate() copies the value into a free entry of every indicating
+  link (all or none: one full link refuses the call) and pumps the links; the pump hands off whichever entry the order allows
+  and the backend's confirmation comes back through completeIndication() with the entry's token, which carries a generation
+  like the TX credit tokens so a late confirmation for a freed entry is ignored. Hand-off and completion only ever run one pump
+  per link at a time: a caller that finds the pump busy leaves the entry to it, so a synchronous confirmation (desktop) does
+  not recurse.
+*/
+
+#if HMS_BLE_INDICATE_DEPTH
+void HMS_BLE::lockIndications() const {
+    #if defined(HMS_BLE_ARDUINO_ESP32)
+        taskENTER_CRITICAL(&indicationMux);
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+        indicationKey = k_spin_lock(&indicationSpinlock);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        indicationMutex.lock();
+    #endif
+}
+
+void HMS_BLE::unlockIndications() const {
+    #if defined(HMS_BLE_ARDUINO_ESP32)
+        taskEXIT_CRITICAL(&indicationMux);
+    #elif defined(HMS_BLE_ZEPHYR_nRF)
+        k_spin_unlock(&indicationSpinlock, indicationKey);
+    #elif defined(HMS_BLE_PLATFORM_DESKTOP)
+        indicationMutex.unlock();
+    #endif
+}
+
+HMS_BLE_Status HMS_BLE::indicate(HMS_BLE_CharHandle handle, const uint8_t* data, size_t length, HMS_BLE_IndicateCallback onDone) {
+    if(!isConnected()) {
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+
+    if(!data || length == 0 || length > HMS_BLE_MAX_DATA_LENGTH) {
+        return length > HMS_BLE_MAX_DATA_LENGTH ? HMS_BLE_STATUS_ERROR_SEND : HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) {
+        BLE_LOGGER(error, "Invalid characteristic handle 0x%04X", handle.id);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+    if(!(services[svcIdx].characteristics[charIdx].properties & HMS_BLE_PROPERTY_INDICATE)) {
+        BLE_LOGGER(error, "Characteristic %s does not indicate", services[svcIdx].characteristics[charIdx].uuidStr);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    #if HMS_BLE_VALUE_CACHE
+        updateCachedValue(svcIdx, charIdx, data, length);
+    #endif
+    return queueIndication(svcIdx, charIdx, data, length, onDone ? &onDone : nullptr);
+}
+
+HMS_BLE_Status HMS_BLE::queueIndication(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_IndicateCallback* done) {
+    uint16_t handle = encodeHandle(serviceIndex, charIndex).id;
+    uint32_t targets[HMS_BLE_CLIENT_WORDS] = {0};
+    uint32_t links[HMS_BLE_CLIENT_WORDS];
+    bool stalled = false, full = false;
+
+    lockIndications();
+    memcpy(links, services[serviceIndex].indicators[charIndex], sizeof(links));
+    for(int slot = takeLowestSlot(links); slot >= 0; slot = takeLowestSlot(links)) {
+        const IndicationLink& link = indicationLinks[slot];
+        if(link.stalled) {                                                                                  // Waits for a reconnect, nothing more goes to it
+            stalled = true;
+            continue;
+        }
+        if(link.queued + link.inFlight >= HMS_BLE_INDICATE_DEPTH) full = true;
+        targets[slot / 32] |= 1u << (slot % 32);
+    }
+    if(full) {
+        indicationStats.busy++;
+        unlockIndications();
+        return HMS_BLE_STATUS_ERROR_BUSY;
+    }
+
+    int count = 0;
+    memcpy(links, targets, sizeof(links));
+    for(int slot = takeLowestSlot(links); slot >= 0; slot = takeLowestSlot(links)) {
+        IndicationLink& link = indicationLinks[slot];
+        int i = 0;
+        while(link.entries[i].state != HMS_BLE_INDICATION_FREE) i++;
+        HMS_BLE_Indication& entry = link.entries[i];
+        entry.state = HMS_BLE_INDICATION_QUEUED;
+        entry.sequence = link.nextSequence++;
+        entry.handle = handle;
+        entry.length = (uint16_t)length;
+        memcpy(entry.value, data, length);
+        entry.done = done ? *done : nullptr;
+        link.queued++;
+        indicationStats.queued++;
+        indicationStats.pending++;
+        count++;
+    }
+    if(indicationStats.pending > indicationStats.maxPending) indicationStats.maxPending = indicationStats.pending;
+    unlockIndications();
+
+    if(count == 0) {
+        return stalled ? HMS_BLE_STATUS_ERROR_TIMEOUT : HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+    for(int slot = takeLowestSlot(targets); slot >= 0; slot = takeLowestSlot(targets)) {
+        pumpIndications(slot);
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+/*
+  In order: the oldest entry, once nothing is in flight. Per characteristic: the oldest entry of each characteristic that has
+  nothing in flight may go, up to one per ATT bearer, and the characteristic after the one handed off last is preferred so a
+  busy characteristic cannot hold the others back.
+*/
+int HMS_BLE::nextIndication(const IndicationLink& link) const {
+    bool inOrder = indicationOrder == HMS_BLE_INDICATE_IN_ORDER;
+    int parallel = inOrder ? 1 : std::min(HMS_BLE_INDICATE_BEARERS, HMS_BLE_INDICATE_DEPTH);
+    if(link.stalled || link.queued == 0 || link.inFlight >= parallel) return -1;
+
+    int best = -1;
+    for(int i = 0; i < HMS_BLE_INDICATE_DEPTH; i++) {
+        const HMS_BLE_Indication& entry = link.entries[i];
+        if(entry.state != HMS_BLE_INDICATION_QUEUED) continue;
+        if(inOrder) {
+            if(best < 0 || (int32_t)(entry.sequence - link.entries[best].sequence) < 0) best = i;
+            continue;
+        }
+        bool blocked = false;
+        for(int j = 0; j < HMS_BLE_INDICATE_DEPTH && !blocked; j++) {
+            const HMS_BLE_Indication& other = link.entries[j];
+            blocked = j != i && other.state != HMS_BLE_INDICATION_FREE && other.handle == entry.handle &&
+                      (other.state == HMS_BLE_INDICATION_IN_FLIGHT || (int32_t)(other.sequence - entry.sequence) < 0);
+        }
+        if(blocked) continue;
+        if(best < 0 || (uint16_t)(entry.handle - link.lastHandle - 1) < (uint16_t)(link.entries[best].handle - link.lastHandle - 1)) best = i;
+    }
+    return best;
+}
+
+void HMS_BLE::pumpIndications(int slot) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    IndicationLink& link = indicationLinks[slot];
+    lockIndications();
+    if(link.pumping) {                                                                                      // Its next pass sees what changed
+        unlockIndications();
+        return;
+    }
+    link.pumping = true;
+    for(int i = nextIndication(link); i >= 0; i = nextIndication(link)) {
+        HMS_BLE_Indication& entry = link.entries[i];
+        int32_t token = ((int32_t)entry.generation << 8) | i;
+        int serviceIndex, charIndex;
+        if(!decodeHandle({ entry.handle }, &serviceIndex, &charIndex)) {                                    // Stale handle, the database changed under the queue
+            unlockIndications();
+            completeIndication(slot, token, HMS_BLE_STATUS_ERROR_INVALID_CHAR);
+            lockIndications();
+            continue;
+        }
+        if(!isIndicating(slot, serviceIndex, charIndex)) {                                                  // The central turned indications off while it waited
+            unlockIndications();
+            completeIndication(slot, token, HMS_BLE_STATUS_ERROR_NOT_CONNECTED);
+            lockIndications();
+            continue;
+        }
+        entry.state = HMS_BLE_INDICATION_IN_FLIGHT;
+        entry.sentAt = eventClockMicros();
+        link.queued--;
+        link.inFlight++;
+        link.lastHandle = entry.handle;
+        indicationStats.inFlight++;
+        size_t length = entry.length;
+        unlockIndications();
+
+        HMS_BLE_Status status = indicateInternal(slot, serviceIndex, charIndex, entry.value, length, token);
+        trace(HMS_BLE_TRACE_INDICATE, slot, encodeHandle(serviceIndex, charIndex).id, length, status);
+        if(status == HMS_BLE_STATUS_SUCCESS) {
+            CharCounters& counters = charCounters[serviceIndex][charIndex];
+            counters.indications.fetch_add(1, std::memory_order_relaxed);
+            counters.bytesSent.fetch_add((uint32_t)length, std::memory_order_relaxed);
+            lockIndications();
+            indicationStats.sent++;
+            continue;
+        }
+        if(-status < HMS_BLE_STATUS_COUNT) statSendErrors[-status].fetch_add(1, std::memory_order_relaxed);
+
+        lockIndications();
+        if(status == HMS_BLE_STATUS_ERROR_BUSY && entry.state == HMS_BLE_INDICATION_IN_FLIGHT && entry.generation == (uint16_t)(token >> 8)) {
+            entry.state = HMS_BLE_INDICATION_QUEUED;                                                        // No buffer in the stack: stays first in line, loop() retries
+            link.inFlight--;
+            link.queued++;
+            indicationStats.inFlight--;
+            link.retry = true;
+            break;
+        }
+        unlockIndications();
+        completeIndication(slot, token, status);
+        lockIndications();
+    }
+    link.pumping = false;
+    unlockIndications();
+}
+
+void HMS_BLE::completeIndication(int slot, int32_t token, HMS_BLE_Status status) {
+    int index = token & 0xFF;
+    if(token < 0 || index >= HMS_BLE_INDICATE_DEPTH || slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+
+    IndicationLink& link = indicationLinks[slot];
+    lockIndications();
+    HMS_BLE_Indication& entry = link.entries[index];
+    if(entry.state == HMS_BLE_INDICATION_FREE || entry.generation != (uint16_t)(token >> 8)) {             // Timed out or aborted already
+        unlockIndications();
+        return;
+    }
+    uint32_t roundTrip = 0;
+    if(entry.state == HMS_BLE_INDICATION_IN_FLIGHT) {
+        roundTrip = eventClockMicros() - entry.sentAt;
+        link.inFlight--;
+        indicationStats.inFlight--;
+    } else {
+        link.queued--;
+    }
+    HMS_BLE_IndicateCallback done = std::move(entry.done);
+    HMS_BLE_CharHandle handle = { entry.handle };
+    entry.done = nullptr;
+    entry.state = HMS_BLE_INDICATION_FREE;
+    entry.generation++;
+    indicationStats.pending--;
+    if(status == HMS_BLE_STATUS_SUCCESS) {
+        indicationStats.confirmed++;
+        indicationStats.lastRoundTripUs = roundTrip;
+        indicationStats.totalRoundTripUs += roundTrip;
+        if(roundTrip > indicationStats.maxRoundTripUs) indicationStats.maxRoundTripUs = roundTrip;
+    } else if(status == HMS_BLE_STATUS_ERROR_TIMEOUT) {
+        indicationStats.timedOut++;
+    } else {
+        indicationStats.failed++;
+    }
+    unlockIndications();
+    trace(HMS_BLE_TRACE_CONFIRM, slot, handle.id, std::min(roundTrip, (uint32_t)UINT16_MAX), status);
+
+    if(done) done(handle, slot, status, status == HMS_BLE_STATUS_SUCCESS ? roundTrip : 0);
+    pumpIndications(slot);
+}
+
+void HMS_BLE::completeOldestIndication(int serviceIndex, int charIndex, HMS_BLE_Status status) {
+    uint16_t handle = encodeHandle(serviceIndex, charIndex).id;
+    uint32_t now = eventClockMicros(), oldest = 0;
+    int slot = -1;
+    int32_t token = -1;
+    lockIndications();
+    for(int l = 0; l < HMS_BLE_MAX_CLIENTS; l++) {
+        for(int i = 0; i < HMS_BLE_INDICATE_DEPTH; i++) {
+            const HMS_BLE_Indication& entry = indicationLinks[l].entries[i];
+            if(entry.state != HMS_BLE_INDICATION_IN_FLIGHT || entry.handle != handle) continue;
+            if(token < 0 || now - entry.sentAt > oldest) {
+                oldest = now - entry.sentAt;
+                slot = l;
+                token = ((int32_t)entry.generation << 8) | i;
+            }
+        }
+    }
+    unlockIndications();
+    if(token >= 0) completeIndication(slot, token, status);
+}
+
+void HMS_BLE::abortIndications(int slot, HMS_BLE_Status status) {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return;
+    IndicationLink& link = indicationLinks[slot];
+    while(true) {
+        int32_t token = -1;
+        uint32_t sequence = 0;
+        lockIndications();
+        for(int i = 0; i < HMS_BLE_INDICATE_DEPTH; i++) {
+            const HMS_BLE_Indication& entry = link.entries[i];
+            if(entry.state == HMS_BLE_INDICATION_FREE) continue;
+            if(token < 0 || (int32_t)(entry.sequence - sequence) < 0) {
+                sequence = entry.sequence;
+                token = ((int32_t)entry.generation << 8) | i;
+            }
+        }
+        unlockIndications();
+        if(token < 0) break;
+        completeIndication(slot, token, status);                                                            // Oldest first, so callbacks see submission order
+    }
+}
+
+/*
+  A missed confirmation ends the link for indications: ATT allows no further transaction on a bearer after a timeout, so the
+  entry and everything behind it fail with ERROR_TIMEOUT and the link is skipped until it reconnects.
+*/
+void HMS_BLE::serviceIndications() {
+    uint64_t timeoutUs = (uint64_t)indicationTimeoutMs * 1000;
+    for(int slot = 0; slot < HMS_BLE_MAX_CLIENTS; slot++) {
+        IndicationLink& link = indicationLinks[slot];
+        int32_t expired = -1;
+        HMS_BLE_CharHandle handle = HMS_BLE_INVALID_CHAR_HANDLE;
+        lockIndications();
+        if(timeoutUs && link.inFlight && !link.stalled) {
+            uint32_t now = eventClockMicros();
+            for(int i = 0; i < HMS_BLE_INDICATE_DEPTH && expired < 0; i++) {
+                const HMS_BLE_Indication& entry = link.entries[i];
+                if(entry.state == HMS_BLE_INDICATION_IN_FLIGHT && now - entry.sentAt >= timeoutUs) {
+                    expired = ((int32_t)entry.generation << 8) | i;
+                    handle.id = entry.handle;
+                }
+            }
+            if(expired >= 0) link.stalled = true;
+        }
+        bool retry = link.retry && expired < 0;
+        if(retry) link.retry = false;
+        unlockIndications();
+
+        if(expired >= 0) {
+            BLE_LOGGER(warn, "Indication on 0x%04X not confirmed by client %d within %u ms", handle.id, slot, indicationTimeoutMs);
+            completeIndication(slot, expired, HMS_BLE_STATUS_ERROR_TIMEOUT);
+            abortIndications(slot, HMS_BLE_STATUS_ERROR_TIMEOUT);
+            if(indicationTimeoutCallback) indicationTimeoutCallback(handle, slot);
+        } else if(retry) {
+            pumpIndications(slot);
+        }
+    }
+}
+
+uint32_t HMS_BLE::indicationWaitMs() const {
+    uint64_t timeoutUs = (uint64_t)indicationTimeoutMs * 1000;
+    uint32_t now = eventClockMicros();
+    uint32_t waitMs = 0;
+    lockIndications();
+    for(int slot = 0; slot < HMS_BLE_MAX_CLIENTS; slot++) {
+        const IndicationLink& link = indicationLinks[slot];
+        if(link.retry && (!waitMs || waitMs > HMS_BLE_NOTIFY_RETRY_MS)) waitMs = HMS_BLE_NOTIFY_RETRY_MS;
+        if(!timeoutUs || !link.inFlight || link.stalled) continue;
+        for(int i = 0; i < HMS_BLE_INDICATE_DEPTH; i++) {
+            const HMS_BLE_Indication& entry = link.entries[i];
+            if(entry.state != HMS_BLE_INDICATION_IN_FLIGHT) continue;
+            uint32_t elapsed = now - entry.sentAt;
+            uint32_t remaining = elapsed < timeoutUs ? (uint32_t)((timeoutUs - elapsed + 999) / 1000) : 1;
+            if(!waitMs || remaining < waitMs) waitMs = remaining;
+        }
+    }
+    unlockIndications();
+    return waitMs;
+}
+
+size_t HMS_BLE::getPendingIndications(int slot) const {
+    if(slot < 0 || slot >= HMS_BLE_MAX_CLIENTS) return 0;
+    lockIndications();
+    size_t pending = indicationLinks[slot].queued + indicationLinks[slot].inFlight;
+    unlockIndications();
+    return pending;
+}
+
+HMS_BLE_IndicationStats HMS_BLE::getIndicationStats() const {
+    lockIndications();
+    HMS_BLE_IndicationStats stats = indicationStats;
+    unlockIndications();
+    return stats;
+}
+
+void HMS_BLE::resetIndicationStats() {
+    lockIndications();
+    size_t pending = indicationStats.pending, inFlight = indicationStats.inFlight;
+    memset(&indicationStats, 0, sizeof(indicationStats));
+    indicationStats.pending = pending;
+    indicationStats.maxPending = pending;
+    indicationStats.inFlight = inFlight;
+    unlockIndications();
+}
+#endif
+
+// ========== Streams ==========
+
+#if HMS_BLE_MAX_STREAMS
+HMS_BLE_Stream* HMS_BLE::findStream(HMS_BLE_CharHandle handle, bool bind) {
+    HMS_BLE_Stream* freeSlot = nullptr;
+    for(int i = 0; i < HMS_BLE_MAX_STREAMS; i++) {
+        if(streams[i].handle == handle.id) return &streams[i];
+        if(!freeSlot && streams[i].handle == HMS_BLE_INVALID_CHAR_HANDLE.id) freeSlot = &streams[i];
+    }
+    if(bind && freeSlot) freeSlot->handle = handle.id;                                                  // Slots stay bound, HMS_BLE_MAX_STREAMS is a per-characteristic budget
+    return bind ? freeSlot : nullptr;
+}
+
+HMS_BLE_Status HMS_BLE::sendStream(HMS_BLE_CharHandle handle, const uint8_t* data, size_t length, HMS_BLE_StreamCallback onComplete) {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(!data || length == 0) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(!isSubscribed(handle)) return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+
+    HMS_BLE_Stream* stream = findStream(handle, true);
+    if(!stream) {
+        BLE_LOGGER(warn, "No free stream slot (HMS_BLE_MAX_STREAMS=%d)", HMS_BLE_MAX_STREAMS);
+        return HMS_BLE_STATUS_ERROR_BUSY;
+    }
+    if(stream->txActive.load(std::memory_order_acquire)) return HMS_BLE_STATUS_ERROR_BUSY;
+
+    stream->txData = data;
+    stream->txLength = length;
+    stream->txOffset = 0;
+    stream->txSegments = 0;
+    stream->txDone = onComplete;
+    stream->txActive.store(true, std::memory_order_release);                                           // Hands the slot to pumpStreams()
+    signalEvent(HMS_BLE_EVENT_SEND);
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::receiveStream(HMS_BLE_CharHandle handle, uint8_t* buffer, size_t capacity, HMS_BLE_StreamCallback onComplete) {
+    int svcIdx, charIdx;
+    if(!decodeHandle(handle, &svcIdx, &charIdx)) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    if(!buffer || capacity == 0) return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+
+    HMS_BLE_Stream* stream = findStream(handle, true);
+    if(!stream) return HMS_BLE_STATUS_ERROR_BUSY;
+    if(stream->rxActive.load(std::memory_order_acquire)) return HMS_BLE_STATUS_ERROR_BUSY;
+
+    stream->rxBuffer = buffer;
+    stream->rxCapacity = capacity;
+    stream->rxLength = 0;
+    stream->rxExpected = 0;
+    stream->rxStarted = false;
+    stream->rxDone = onComplete;
+    stream->rxActive.store(true, std::memory_order_release);                                           // Hands the slot to the host context
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+bool HMS_BLE::isStreaming(HMS_BLE_CharHandle handle) const {
+    for(int i = 0; i < HMS_BLE_MAX_STREAMS; i++) {
+        if(streams[i].handle == handle.id) return streams[i].txActive.load(std::memory_order_acquire);
+    }
+    return false;
+}
+
+bool HMS_BLE::consumeStreamSegment(int serviceIndex, int charIndex, const uint8_t* data, size_t length) {
+    HMS_BLE_Stream* stream = findStream(encodeHandle(serviceIndex, charIndex), false);
+    if(!stream || !stream->rxActive.load(std::memory_order_acquire)) return false;
+
+    HMS_BLE_Status status = HMS_BLE_STATUS_SUCCESS;
+    bool done = false;
+    uint8_t header = (length > 0) ? data[0] : 0;
+    size_t headerLength = (header & HMS_BLE_STREAM_FIRST) ? 5 : 1;
+
+    if(length < headerLength) {
+        status = HMS_BLE_STATUS_ERROR_PROTOCOL;
+    } else if(header & HMS_BLE_STREAM_FIRST) {                                                          // A new first segment restarts reassembly
+        stream->rxExpected = (size_t)data[1] | ((size_t)data[2] << 8) | ((size_t)data[3] << 16) | ((size_t)data[4] << 24);
+        stream->rxLength = 0;
+        stream->rxStarted = true;
+        if(stream->rxExpected > stream->rxCapacity) status = HMS_BLE_STATUS_ERROR_OVERFLOW;
+    } else if(!stream->rxStarted || (header & HMS_BLE_STREAM_SEQUENCE_MASK) != ((stream->rxSequence + 1) & HMS_BLE_STREAM_SEQUENCE_MASK)) {
+        status = HMS_BLE_STATUS_ERROR_PROTOCOL;                                                         // Segment lost or stream joined mid-way
+    }
+
+    if(status == HMS_BLE_STATUS_SUCCESS) {
+        size_t payload = length - headerLength;
+        if(stream->rxLength + payload > stream->rxExpected) {
+            status = HMS_BLE_STATUS_ERROR_OVERFLOW;
+        } else {
+            memcpy(stream->rxBuffer + stream->rxLength, data + headerLength, payload);
+            stream->rxLength += payload;
+            stream->rxSequence = header & HMS_BLE_STREAM_SEQUENCE_MASK;
+            if(header & HMS_BLE_STREAM_LAST) {
+                done = true;
+                if(stream->rxLength != stream->rxExpected) status = HMS_BLE_STATUS_ERROR_PROTOCOL;
+            }
+        }
+    }
+
+    if(status != HMS_BLE_STATUS_SUCCESS || done) {
+        if(status != HMS_BLE_STATUS_SUCCESS) {
+            BLE_LOGGER(warn, "Stream on handle 0x%04X aborted (%d) after %d bytes", stream->handle, status, stream->rxLength);
+        }
+        HMS_BLE_StreamCallback callback = stream->rxDone;
+        stream->rxActive.store(false, std::memory_order_release);                                      // Callback may re-arm
+        if(callback) callback(HMS_BLE_CharHandle{stream->handle}, status, stream->rxLength);
+    }
+    return true;
+}
+
+void HMS_BLE::pumpStreams() {
+    size_t budget = sendBudget();                                                                       // Shared by the streams, they go to the same links
+    for(int i = 0; i < HMS_BLE_MAX_STREAMS; i++) {
+        HMS_BLE_Stream& stream = streams[i];
+        if(!stream.txActive.load(std::memory_order_acquire)) continue;
+
+        HMS_BLE_CharHandle handle = {stream.handle};
+        int svcIdx, charIdx;
+        HMS_BLE_Status status = HMS_BLE_STATUS_SUCCESS;
+        if(!decodeHandle(handle, &svcIdx, &charIdx)) status = HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+        else if(!isSubscribed(handle))               status = HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+
+        // Segment to the smallest negotiated MTU: ATT notification header is 3 bytes
+        size_t segmentSize = std::min((size_t)getMTU() - 3, sizeof(streamSegment));
+        bool last = false, paused = false;
+        while(status == HMS_BLE_STATUS_SUCCESS && !last) {
+            if(budget == 0) {
+                paused = true;                                                                          // Link batch sent, resume on the next pass
+                break;
+            }
+            size_t headerLength = 1;
+            uint8_t header = stream.txSegments & HMS_BLE_STREAM_SEQUENCE_MASK;
+            if(stream.txSegments == 0) {
+                header |= HMS_BLE_STREAM_FIRST;
+                streamSegment[1] = stream.txLength & 0xFF;
+                streamSegment[2] = (stream.txLength >> 8) & 0xFF;
+                streamSegment[3] = (stream.txLength >> 16) & 0xFF;
+                streamSegment[4] = (stream.txLength >> 24) & 0xFF;
+                headerLength = 5;
+            }
+            size_t payload = std::min(segmentSize - headerLength, stream.txLength - stream.txOffset);
+            last = (stream.txOffset + payload == stream.txLength);
+            if(last) header |= HMS_BLE_STREAM_LAST;
+            streamSegment[0] = header;
+            memcpy(streamSegment + headerLength, stream.txData + stream.txOffset, payload);
+
+            status = stackSend(svcIdx, charIdx, streamSegment, headerLength + payload);
+            if(status == HMS_BLE_STATUS_ERROR_SEND || status == HMS_BLE_STATUS_ERROR_BUSY) break;      // Out of TX buffers: resume on the next pass
+            if(status == HMS_BLE_STATUS_SUCCESS) {
+                stream.txOffset += payload;
+                stream.txSegments++;
+                budget--;
+            }
+        }
+
+        if(!paused && status != HMS_BLE_STATUS_ERROR_SEND && status != HMS_BLE_STATUS_ERROR_BUSY) {               // Finished or failed
+            HMS_BLE_StreamCallback callback = stream.txDone;
+            stream.txActive.store(false, std::memory_order_release);                                   // Callback may start the next stream
+            if(callback) callback(handle, status, stream.txOffset);
+        }
+    }
+}
+#endif
+
+// ========== Legacy Single-Service API (Backward Compatible) ==========
+
+#if HMS_BLE_LEGACY_API
+#if HMS_BLE_RUNTIME_REGISTRATION
+HMS_BLE_Status HMS_BLE::begin(const char* service_uuid, bool backThread) {
+    if(!service_uuid) {
+        BLE_LOGGER(error, "Service UUID cannot be null");
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    if(bleInitialized) {
+        BLE_LOGGER(warn, "BLE already initialized. Call begin() only once");
+        return HMS_BLE_STATUS_ERROR_INIT;
+    }
+
+    // Legacy mode: if characteristics were added via addCharacteristic() without addService(),
     // we need to create the default service now and migrate characteristics
     if(!defaultServiceCreated && characteristicCount > 0) {
         // Create the service with the provided UUID
@@ -434,6 +3394,7 @@ HMS_BLE_Status HMS_BLE::begin(const char* service_uuid, bool backThread) {
         service_uuid, getTotalCharacteristicCount()
     );
 
+    packAdvertising(0);
     HMS_BLE_Status status = init();
     if(status != HMS_BLE_STATUS_SUCCESS) {
         return status;
@@ -453,18 +3414,24 @@ HMS_BLE_Status HMS_BLE::removeCharacteristic(const char* characteristicUUID) {
         return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
     }
 
+    HMS_BLE_UUID uuid;
+    if(!parseUUID(characteristicUUID, &uuid)) {
+        BLE_LOGGER(warn, "Invalid characteristic UUID %s", characteristicUUID);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
     // Search in new services structure
     for(size_t s = 0; s < serviceCount; s++) {
         for(size_t c = 0; c < services[s].characteristicCount; c++) {
-            if(strcmp(services[s].characteristics[c].uuid.c_str(), characteristicUUID) == 0) {
+            if(services[s].characteristics[c].uuid == uuid) {
                 // Shift remaining characteristics
                 for(size_t i = c; i < services[s].characteristicCount - 1; i++) {
-                    services[s].characteristics[i] = services[s].characteristics[i + 1];
+                    runtimeCharacteristics[s][i] = runtimeCharacteristics[s][i + 1];
                 }
                 services[s].characteristicCount--;
                 
                 BLE_LOGGER(debug, "Characteristic removed from service %s: UUID=%s",
-                    services[s].service.uuid.c_str(), characteristicUUID);
+                    services[s].service->uuidStr, characteristicUUID);
                 return HMS_BLE_STATUS_SUCCESS;
             }
         }
@@ -513,6 +3480,12 @@ HMS_BLE_Status HMS_BLE::addCharacteristic(const HMS_BLE_Characteristic* characte
         return HMS_BLE_STATUS_ERROR_MAX_CHARS;
     }
 
+    HMS_BLE_UUID uuid;
+    if(!parseUUID(characteristic->uuid.c_str(), &uuid)) {
+        BLE_LOGGER(error, "Invalid characteristic UUID %s", characteristic->uuid.c_str());
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
     // Check for duplicate UUID in legacy array
     for(size_t i = 0; i < characteristicCount; i++) {
         if(strcmp(characteristics[i].uuid.c_str(), characteristic->uuid.c_str()) == 0) {
@@ -533,10 +3506,11 @@ HMS_BLE_Status HMS_BLE::addCharacteristic(const HMS_BLE_Characteristic* characte
 
     return HMS_BLE_STATUS_SUCCESS;
 }
+#endif
 
 // Legacy sendData - finds characteristic across all services
 HMS_BLE_Status HMS_BLE::sendData(const char* characteristicUUID, const uint8_t* data, size_t length) {
-    if(!bleConnected) {
+    if(!isConnected()) {
         BLE_LOGGER(warn, "Cannot send data, no BLE connection");
         return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
     }
@@ -552,14 +3526,17 @@ HMS_BLE_Status HMS_BLE::sendData(const char* characteristicUUID, const uint8_t*
     }
 
     // Find characteristic across all services
-    for(size_t s = 0; s < serviceCount; s++) {
-        for(size_t c = 0; c < services[s].characteristicCount; c++) {
-            if(strcmp(services[s].characteristics[c].uuid.c_str(), characteristicUUID) == 0) {
-                return sendDataInternal(s, c, data, length);
+    HMS_BLE_UUID uuid;
+    if(parseUUID(characteristicUUID, &uuid)) {
+        for(size_t s = 0; s < serviceCount; s++) {
+            int c = findCharacteristicInService(s, uuid);
+            if(c >= 0) {
+                return submitData(s, c, data, length);
             }
         }
     }
     
     BLE_LOGGER(error, "Characteristic UUID %s not found", characteristicUUID);
     return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
-}
\ No newline at end of file
+}
+#endif
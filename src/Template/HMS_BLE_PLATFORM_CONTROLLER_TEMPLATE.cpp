@@ -8,10 +8,76 @@ void HMS_BLE::stop() {
 
 HMS_BLE_Status HMS_BLE::init() {
     // Platform-specific BLE initialization implementation
-    return HMS_BLE_STATUS_OK;
+    return HMS_BLE_STATUS_SUCCESS;
 }
 
 void HMS_BLE::restartAdvertising() {
-    // Platform-specific BLE restart advertising implementation
+    // Platform-specific BLE restart advertising implementation, with the packets from getAdvertisingPayload()
 }
-#endif // HMS_BLE_ARDUINO_ESP32
\ No newline at end of file
+
+HMS_BLE_Status HMS_BLE::updateAdvertisingInternal() {
+    // Platform-specific update of the advertising data while advertising continues, from getAdvertisingPayload()
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::sendDataInternal(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_SendCallback* done) {
+    // Platform-specific notification/indication implementation; never block, return HMS_BLE_STATUS_ERROR_BUSY when out of TX buffers
+    // and call *done (if set) once the stack sent the value
+    return HMS_BLE_STATUS_ERROR_SEND;
+}
+
+#if HMS_BLE_INDICATE_DEPTH
+HMS_BLE_Status HMS_BLE::indicateInternal(int slot, int serviceIndex, int charIndex, const uint8_t* data, size_t length, int32_t token) {
+    // Platform-specific indication to one connection; never block, return HMS_BLE_STATUS_ERROR_BUSY when out of buffers and
+    // call completeIndication(slot, token, status) once the central confirmed it (or the ATT request failed)
+    return HMS_BLE_STATUS_ERROR_SEND;
+}
+#endif
+
+#if HMS_BLE_LINK_PROFILES
+HMS_BLE_Status HMS_BLE::requestLinkInternal(int slot, const HMS_BLE_LinkProfileParams& params) {
+    // Platform-specific connection parameter, PHY and data length requests (a zero phy or dataLength means leave it); the
+    // stack's answers go to updateConnectionParams(), updateLinkPhy() and updateLinkDataLength()
+    return HMS_BLE_STATUS_ERROR_PROTOCOL;
+}
+#endif
+
+#if HMS_BLE_BROADCAST_SETS
+HMS_BLE_Status HMS_BLE::createBroadcastInternal(int set, const HMS_BLE_BroadcastParams& params) {
+    // Platform-specific non-connectable advertising set (legacy, extended or periodic per params.mode), not started yet;
+    // HMS_BLE_STATUS_ERROR_BUSY when the controller has no set left, HMS_BLE_STATUS_ERROR_PROTOCOL for a mode it lacks
+    return HMS_BLE_STATUS_ERROR_PROTOCOL;
+}
+
+HMS_BLE_Status HMS_BLE::setBroadcastDataInternal(int set, const uint8_t* data, size_t length) {
+    // Platform-specific data update of the set (periodic sets: the periodic train's data), running or not; data is a packed
+    // AD structure that only lives for the call
+    return HMS_BLE_STATUS_ERROR_SEND;
+}
+
+HMS_BLE_Status HMS_BLE::startBroadcastInternal(int set) {
+    // Platform-specific start of the set (and of its periodic train)
+    return HMS_BLE_STATUS_ERROR_START;
+}
+
+HMS_BLE_Status HMS_BLE::stopBroadcastInternal(int set) {
+    // Platform-specific stop of the set, which stays configured for a later start
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+void HMS_BLE::removeBroadcastInternal(int set) {
+    // Platform-specific release of the set
+}
+#endif
+
+uint32_t HMS_BLE::taskStackFree() const {
+    // Platform-specific stack high-water mark of the background task in bytes, 0 when the RTOS cannot tell
+    return 0;
+}
+
+// Connection callbacks: openConnection() on connect, closeConnection() with the HCI reason on disconnect, setSubscribed() on
+// CCC writes (with the indication bit), updateConnectionMTU()/updateConnectionParams() when the stack reports them (getMTU() reads the connection table),
+// updateLinkPhy()/updateLinkDataLength() likewise and applyLinkProfile() after the connection callback (HMS_BLE_LINK_PROFILES),
+// countLinkRead()/countLinkWrite() from the read and write handlers. A write handler offers the value to
+// consumeStreamSegment() and then consumeIngestWrite() (WRITE_NR characteristics) before the write callbacks
+#endif // HMS_BLE_CONTROLLER_TEMPLATE
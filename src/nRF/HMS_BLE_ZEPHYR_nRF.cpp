@@ -5,8 +5,16 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(HMS_BLE_ZEPHYR, LOG_LEVEL_DBG);
 
-// Static connection callbacks structure
+// Static connection callbacks structures
 static struct bt_conn_cb conn_callbacks;
+static struct bt_gatt_cb gatt_callbacks;
+
+#if HMS_BLE_STATIC_ALLOCATION
+    static K_THREAD_STACK_DEFINE(zephyrBleThreadStackArea, HMS_BLE_BACKGROUND_PROCESS_STACK_SIZE);     // Background task stack, no k_malloc()
+    #if HMS_BLE_RUNTIME_REGISTRATION
+        alignas(void*) uint8_t HMS_BLE::zephyrStaticArena[HMS_BLE::zephyrGattLayoutLimit().size()];
+    #endif
+#endif
 
 // Helper to extract MAC address from bt_conn
 static void extractMacAddress(struct bt_conn *conn, uint8_t *mac) {
@@ -26,75 +34,19 @@ static void extractMacAddress(struct bt_conn *conn, uint8_t *mac) {
     }
 }
 
-// Helper to convert hex char to byte
-static uint8_t hexCharToByte(char c) {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-    return 0;
-}
-
-// Helper to check if UUID is a 16-bit UUID (4 hex chars like "181A" or "2A6E")
-static bool is16BitUUID(const char* uuidStr) {
-    if (!uuidStr) return false;
-    size_t len = strlen(uuidStr);
-    // 16-bit UUID is 4 hex chars (e.g., "181A")
-    // Also check for format "0000XXXX-0000-1000-8000-00805F9B34FB" (Bluetooth Base UUID)
-    return (len == 4);
-}
-
-// Helper to convert 16-bit UUID string to uint16_t
-static uint16_t parse16BitUUID(const char* uuidStr) {
-    uint16_t val = 0;
-    for (int i = 0; i < 4 && uuidStr[i] != '\0'; i++) {
-        val = (val << 4) | hexCharToByte(uuidStr[i]);
-    }
-    return val;
-}
-
-// Helper to convert UUID string (e.g., "12345678-1234-1234-1234-123456789012" or "181A") to bt_uuid_128
-// If it's a 16-bit UUID, we still store it as 128-bit but flag it appropriately
-void HMS_BLE::convertUUIDStringToZephyr(const char* uuidStr, struct bt_uuid_128* zephyrUUID) {
-    if (!uuidStr || !zephyrUUID) return;
-
-    // Check if this is a 16-bit UUID
-    if (is16BitUUID(uuidStr)) {
-        // For 16-bit UUIDs, we need to expand to Bluetooth Base UUID
-        // Base UUID: 00000000-0000-1000-8000-00805F9B34FB
-        // 16-bit UUID goes at bytes 2-3 (big-endian) or bytes 12-13 (little-endian in val[])
-        static const uint8_t bt_base_uuid[] = {
-            0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80,
-            0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        };
-        memcpy(zephyrUUID->val, bt_base_uuid, 16);
-        uint16_t uuid16 = parse16BitUUID(uuidStr);
-        zephyrUUID->val[12] = uuid16 & 0xFF;
-        zephyrUUID->val[13] = (uuid16 >> 8) & 0xFF;
-        zephyrUUID->uuid.type = BT_UUID_TYPE_128;
-        return;
-    }
-
-    // Initialize base UUID structure for full 128-bit UUID
-    zephyrUUID->uuid.type = BT_UUID_TYPE_128;
-    
-    // Parse string in reverse order (little-endian for Zephyr)
-    // Format: 8-4-4-4-12 (36 chars total with hyphens)
-    int byteIdx = 15;
-    for (int i = 0; uuidStr[i] != '\0' && byteIdx >= 0; i++) {
-        if (uuidStr[i] == '-') continue;
-        
-        uint8_t high = hexCharToByte(uuidStr[i]);
-        i++;
-        if (uuidStr[i] == '\0') break; // Should not happen for valid UUID
-        uint8_t low = hexCharToByte(uuidStr[i]);
-        
-        zephyrUUID->val[byteIdx--] = (high << 4) | low;
-    }
+// Build a Zephyr UUID (bt_uuid_16/32/128) from the binary UUID into caller storage sized for its variant
+static const struct bt_uuid* toZephyrUUID(const HMS_BLE_UUID& uuid, void* storage) {
+    struct bt_uuid* zephyrUUID = (struct bt_uuid*)storage;
+    bt_uuid_create(zephyrUUID, uuid.encoded(), uuid.size());
+    return zephyrUUID;
 }
 
 HMS_BLE_Status HMS_BLE::init() {
     int err;
 
+    k_sem_init(&zephyrEventSem, 0, 1);                                                                  // Background task wakeup, binary: the events themselves accumulate in pendingEvents
+    k_sem_init(&zephyrTxDoneSem, 0, 1);                                                                 // Credit returned, waiters re-check txFree
+
     // 1. Initialize Bluetooth Stack
     err = bt_enable(NULL);
     if (err) {
@@ -113,34 +65,47 @@ HMS_BLE_Status HMS_BLE::init() {
     // 3. Register Connection Callbacks
     conn_callbacks.connected = zephyrConnectedCallback;
     conn_callbacks.disconnected = zephyrDisconnectedCallback;
+    conn_callbacks.le_param_updated = zephyrParamsUpdatedCallback;
+#if HMS_BLE_LINK_PROFILES && defined(CONFIG_BT_USER_PHY_UPDATE)
+    conn_callbacks.le_phy_updated = zephyrPhyUpdatedCallback;
+#endif
+#if HMS_BLE_LINK_PROFILES && defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    conn_callbacks.le_data_len_updated = zephyrDataLenUpdatedCallback;
+#endif
     bt_conn_cb_register(&conn_callbacks);
+    gatt_callbacks.att_mtu_updated = zephyrMtuUpdatedCallback;
+    bt_gatt_cb_register(&gatt_callbacks);
 
-    // 4. Build GATT Attributes dynamically
+    // 4. Build the GATT database for every service in one arena
     if (buildGattAttributes() != 0) {
         BLE_LOGGER(error, "Failed to build GATT attributes");
         return HMS_BLE_STATUS_ERROR_INIT;
     }
 
-    // 5. Register GATT Service
-    // We need to allocate the service structure dynamically or use a member variable
-    zephyrGattService = new struct bt_gatt_service();
-    zephyrGattService->attrs = zephyrGattAttrs;
-    zephyrGattService->attr_count = zephyrAttrCount;
-    
-    err = bt_gatt_service_register(zephyrGattService);
-    if (err) {
-        BLE_LOGGER(error, "Failed to register GATT service (err %d)", err);
-        return HMS_BLE_STATUS_ERROR_INIT;
+    // 5. Register GATT Services (the bt_gatt_service structs live at the start of the arena)
+    struct bt_gatt_service *gattServices = (struct bt_gatt_service*)zephyrArena;
+    for (size_t s = 0; s < serviceCount; s++) {
+        err = bt_gatt_service_register(&gattServices[s]);
+        if (err) {
+            BLE_LOGGER(error, "Failed to register GATT service %d (err %d)", s, err);
+            releaseGattAttributes();
+            return HMS_BLE_STATUS_ERROR_INIT;
+        }
+        zephyrRegisteredServices++;
+        BLE_LOGGER(info, "GATT Service %s registered with %d attributes", services[s].service->name, gattServices[s].attr_count);
     }
-    BLE_LOGGER(info, "GATT Service registered with %d attributes", zephyrAttrCount);
 
     // 5. Start Advertising
     restartAdvertising();
 
     // 6. Start background task if requested (similar to ESP32 FreeRTOS task)
     if (backgroundProcess) {
-        // Allocate stack dynamically
-        zephyrBleThreadStack = (k_thread_stack_t*)k_malloc(K_THREAD_STACK_LEN(HMS_BLE_BACKGROUND_PROCESS_STACK_SIZE));
+        #if HMS_BLE_STATIC_ALLOCATION
+            zephyrBleThreadStack = zephyrBleThreadStackArea;
+        #else
+            // Allocate stack dynamically
+            zephyrBleThreadStack = (k_thread_stack_t*)k_malloc(K_THREAD_STACK_LEN(HMS_BLE_BACKGROUND_PROCESS_STACK_SIZE));
+        #endif
         if (zephyrBleThreadStack) {
             zephyrBleThreadId = k_thread_create(
                 &zephyrBleThread,
@@ -162,46 +127,49 @@ HMS_BLE_Status HMS_BLE::init() {
     return HMS_BLE_STATUS_SUCCESS;
 }
 
+// Splits a packed packet back into the bt_data entries Zephyr takes, pointing into the packet itself
+static size_t toZephyrAd(const uint8_t* packet, uint8_t length, struct bt_data* entries, size_t capacity) {
+    size_t count = 0;
+    for (uint8_t offset = 0; offset + 1 < length && count < capacity; offset += packet[offset] + 1) {
+        entries[count].type = packet[offset + 1];
+        entries[count].data_len = packet[offset] - 1;
+        entries[count].data = &packet[offset + 2];
+        count++;
+    }
+    return count;
+}
+
+HMS_BLE_Status HMS_BLE::updateAdvertisingInternal() {
+    // The stack copies the data before returning, the snapshot only has to outlive the call
+    HMS_BLE_AdvPayload payload = getAdvertisingPayload();
+    struct bt_data ad[HMS_BLE_ADV_PACKET_LENGTH / 2];
+    struct bt_data sd[HMS_BLE_ADV_PACKET_LENGTH / 2];
+    size_t ad_count = toZephyrAd(payload.advertising, payload.advertisingLength, ad, ARRAY_SIZE(ad));
+    size_t sd_count = toZephyrAd(payload.scanResponse, payload.scanResponseLength, sd, ARRAY_SIZE(sd));
+
+    int err = bt_le_adv_update_data(ad, ad_count, sd, sd_count);
+    if (err == -EAGAIN) {
+        return HMS_BLE_STATUS_SUCCESS;                                                                      // Not advertising, the next start picks it up
+    }
+    if (err) {
+        BLE_LOGGER(warn, "Advertising data update failed (err %d)", err);
+        return HMS_BLE_STATUS_ERROR_SEND;
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
 void HMS_BLE::restartAdvertising() {
     int err;
     
     // Stop any existing advertising
     bt_le_adv_stop();
 
-    // Check if service UUID is a standard 16-bit UUID
-    bool use16BitUUID = is16BitUUID(serviceUUID);
-    uint16_t uuid16 = use16BitUUID ? parse16BitUUID(serviceUUID) : 0;
-    
-    // For 16-bit UUIDs, advertise as 16-bit for proper recognition by apps
-    // Store the 16-bit UUID in little-endian format for advertising
-    uint8_t uuid16_le[2] = { (uint8_t)(uuid16 & 0xFF), (uint8_t)((uuid16 >> 8) & 0xFF) };
-    
-    // Define Advertising Data
-    // Flags: General Discoverable, BR/EDR Not Supported
-    // Service UUID: Use 16-bit or 128-bit based on the service UUID format
-    struct bt_data ad[2];
-    ad[0] = (struct bt_data)BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR));
-    
-    if (use16BitUUID) {
-        ad[1] = (struct bt_data)BT_DATA(BT_DATA_UUID16_ALL, uuid16_le, 2);
-    } else {
-        ad[1] = (struct bt_data)BT_DATA(BT_DATA_UUID128_ALL, zephyrServiceUUID.val, 16);
-    }
-
-    // Define Scan Response Data (Device Name + Manufacturer Data if set)
-    struct bt_data sd[2];
-    int sd_count = 1;
-    sd[0] = (struct bt_data)BT_DATA(BT_DATA_NAME_COMPLETE, deviceName, (uint8_t)strlen(deviceName));
-    
-    // Add manufacturer data if set
-    if (manufacturerDataSet) {
-        static uint8_t mfg_data[8]; // 2 bytes company ID + up to 6 bytes data
-        mfg_data[0] = manufacturerData.manufacturer_id[0];
-        mfg_data[1] = manufacturerData.manufacturer_id[1];
-        memcpy(&mfg_data[2], manufacturerData.data.data(), 6);
-        sd[1] = (struct bt_data)BT_DATA(BT_DATA_MANUFACTURER_DATA, mfg_data, 8);
-        sd_count = 2;
-    }
+    // Advertising data and scan response come prepacked from packAdvertising()
+    HMS_BLE_AdvPayload payload = getAdvertisingPayload();
+    struct bt_data ad[HMS_BLE_ADV_PACKET_LENGTH / 2];
+    struct bt_data sd[HMS_BLE_ADV_PACKET_LENGTH / 2];
+    size_t ad_count = toZephyrAd(payload.advertising, payload.advertisingLength, ad, ARRAY_SIZE(ad));
+    size_t sd_count = toZephyrAd(payload.scanResponse, payload.scanResponseLength, sd, ARRAY_SIZE(sd));
 
     // Start Advertising
     // Note: BT_LE_ADV_CONN uses BT_LE_ADV_OPT_CONNECTABLE which is deprecated in newer Zephyr
@@ -218,7 +186,7 @@ void HMS_BLE::restartAdvertising() {
         NULL
     );
     
-    err = bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), sd, sd_count);
+    err = bt_le_adv_start(&param, ad, ad_count, sd, sd_count);
     if (err) {
         BLE_LOGGER(error, "Advertising failed to start (err %d)", err);
         return;
@@ -228,177 +196,207 @@ void HMS_BLE::restartAdvertising() {
 
 void HMS_BLE::stop() {
     bt_le_adv_stop();
+    #if HMS_BLE_BROADCAST_SETS
+        for (int i = 0; i < HMS_BLE_BROADCAST_SETS; i++) {
+            if (broadcastSets[i].used) removeBroadcast(i);                                                  // Before the background task goes, it may hold a hand-off
+        }
+    #endif
     
     // Stop background thread if running
     if (backgroundProcess && zephyrBleThreadId) {
         k_thread_abort(zephyrBleThreadId);
         zephyrBleThreadId = NULL;
         if (zephyrBleThreadStack) {
-            k_free(zephyrBleThreadStack);
+            #if !HMS_BLE_STATIC_ALLOCATION
+                k_free(zephyrBleThreadStack);
+            #endif
             zephyrBleThreadStack = NULL;
         }
     }
     
     // Note: Zephyr doesn't support full bt_disable() on all controllers
-    if (zephyrConnection) {
-        bt_conn_disconnect(zephyrConnection, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+    for (int i = 0; i < HMS_BLE_MAX_CLIENTS; i++) {
+        if (zephyrConnections[i]) {
+            bt_conn_disconnect(zephyrConnections[i], BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+        }
+    }
+
+    abortTx(HMS_BLE_STATUS_ERROR_NOT_CONNECTED);                                                        // No completions come for a released attribute table
+    releaseGattAttributes();
+}
+
+HMS_BLE::ZephyrGattLayout HMS_BLE::zephyrGattLayout() const {
+    ZephyrGattLayout layout;
+    for (size_t s = 0; s < serviceCount; s++) {
+        layout.addService(*services[s].service);
+        for (size_t c = 0; c < services[s].characteristicCount; c++) {
+            layout.addCharacteristic(services[s].characteristics[c]);
+        }
     }
+    return layout;
 }
 
 int HMS_BLE::buildGattAttributes() {
-    // Calculate total attributes needed:
+    // Attributes per service:
     // 1 for Service Declaration
     // For each characteristic:
     //   1 for Characteristic Declaration
     //   1 for Characteristic Value
     //   1 for CCC (if Notify/Indicate is enabled)
     //   1 for CUD (User Description) if name is present
-    
-    size_t totalAttrs = 1; // Service itself
-    for (size_t i = 0; i < characteristicCount; i++) {
-        totalAttrs += 2; // Decl + Value
-        if (characteristics[i].properties & (HMS_BLE_PROPERTY_NOTIFY | HMS_BLE_PROPERTY_INDICATE)) {
-            totalAttrs += 1; // CCC
-        }
-        if (!characteristics[i].name.empty()) {
-            totalAttrs += 1; // CUD
-        }
+    ZephyrGattLayout layout = zephyrGattLayout();
+
+    // begin<Schema>() hands over a static arena sized by the compiler. The runtime path allocates one of the exact size, or
+    // with HMS_BLE_STATIC_ALLOCATION takes the static arena sized for the limits
+    if (zephyrArena == nullptr) {
+        #if HMS_BLE_STATIC_ALLOCATION && HMS_BLE_RUNTIME_REGISTRATION
+            zephyrArena = zephyrStaticArena;
+            zephyrArenaSize = sizeof(zephyrStaticArena);
+        #elif HMS_BLE_STATIC_ALLOCATION
+            BLE_LOGGER(error, "No GATT arena, begin<Schema>() provides one");
+            return -ENOMEM;
+        #else
+            zephyrArena = (uint8_t*)k_malloc(layout.size());
+            if (zephyrArena == nullptr) {
+                BLE_LOGGER(error, "No heap for the %d byte GATT arena", layout.size());
+                return -ENOMEM;
+            }
+            zephyrArenaSize = layout.size();
+            zephyrArenaOwned = true;
+        #endif
+    }
+    if (zephyrArenaSize < layout.size()) {
+        BLE_LOGGER(error, "GATT arena too small (%d < %d bytes)", zephyrArenaSize, layout.size());
+        return -ENOMEM;
     }
+    memset(zephyrArena, 0, layout.size());
 
-    // Allocate attributes array
-    zephyrGattAttrs = new struct bt_gatt_attr[totalAttrs];
-    zephyrAttrCount = totalAttrs;
-    size_t attrIdx = 0;
+    struct bt_gatt_service *gattServices = (struct bt_gatt_service*)zephyrArena;
+    struct bt_gatt_attr *attrs = (struct bt_gatt_attr*)(zephyrArena + layout.attributeOffset());
+    struct ZephyrCCC *cccs = (struct ZephyrCCC*)(zephyrArena + layout.cccOffset());
+    struct bt_gatt_chrc *declarations = (struct bt_gatt_chrc*)(zephyrArena + layout.declarationOffset());
+    uint8_t *uuids = zephyrArena + layout.uuidOffset();
 
-    // 1. Service Declaration
-    // Check if service UUID is 16-bit standard UUID
-    zephyrServiceUUID16 = is16BitUUID(serviceUUID);
-    if (zephyrServiceUUID16) {
-        zephyrServiceUUID16Val = parse16BitUUID(serviceUUID);
-        zephyrServiceUUID16Struct.uuid.type = BT_UUID_TYPE_16;
-        zephyrServiceUUID16Struct.val = zephyrServiceUUID16Val;
-        zephyrGattAttrs[attrIdx++] = BT_GATT_PRIMARY_SERVICE(&zephyrServiceUUID16Struct);
-    } else {
-        convertUUIDStringToZephyr(serviceUUID, &zephyrServiceUUID);
-        zephyrGattAttrs[attrIdx++] = BT_GATT_PRIMARY_SERVICE(&zephyrServiceUUID);
-    }
+    // Carve in the same order zephyrGattLayout() counted, so every section ends exactly where the next begins
+    ZephyrGattLayout carved;
+    for (size_t s = 0; s < serviceCount; s++) {
+        const HMS_BLE_ServiceDescriptor& svc = services[s];
+        struct bt_gatt_attr *first = attrs;
 
-    // 2. Characteristics
-    for (size_t i = 0; i < characteristicCount; i++) {
-        // Check if characteristic UUID is 16-bit standard UUID
-        zephyrCharUUID16[i] = is16BitUUID(characteristics[i].uuid.c_str());
-        
-        if (zephyrCharUUID16[i]) {
-            uint16_t uuid16 = parse16BitUUID(characteristics[i].uuid.c_str());
-            zephyrCharUUID16Structs[i].uuid.type = BT_UUID_TYPE_16;
-            zephyrCharUUID16Structs[i].val = uuid16;
-        } else {
-            convertUUIDStringToZephyr(characteristics[i].uuid.c_str(), &zephyrCharUUIDs[i]);
-        }
+        // 1. Service Declaration (16/32/128-bit as parsed at registration)
+        *attrs++ = BT_GATT_PRIMARY_SERVICE((void*)toZephyrUUID(svc.service->uuid, uuids + carved.addUUID(svc.service->uuid)));
 
-        // Determine Properties and Permissions
-        uint8_t props = 0;
-        uint8_t perms = 0;
+        // 2. Characteristics
+        for (size_t i = 0; i < svc.characteristicCount; i++) {
+            const HMS_BLE_CharacteristicEntry& chr = svc.characteristics[i];
+            const struct bt_uuid *charValueUUID = toZephyrUUID(chr.uuid, uuids + carved.addUUID(chr.uuid));
 
-        if (characteristics[i].properties & HMS_BLE_PROPERTY_READ) {
-            props |= BT_GATT_CHRC_READ;
-            perms |= BT_GATT_PERM_READ;
-        }
-        if (characteristics[i].properties & HMS_BLE_PROPERTY_WRITE) {
-            props |= BT_GATT_CHRC_WRITE;
-            perms |= BT_GATT_PERM_WRITE;
-        }
-        if (characteristics[i].properties & HMS_BLE_PROPERTY_NOTIFY) {
-            props |= BT_GATT_CHRC_NOTIFY;
-        }
-        if (characteristics[i].properties & HMS_BLE_PROPERTY_INDICATE) {
-            props |= BT_GATT_CHRC_INDICATE;
-        }
+            // Determine Properties and Permissions
+            uint8_t props = 0;
+            uint8_t perms = 0;
 
-        // Characteristic Declaration
-        // We must use a struct bt_gatt_chrc for user_data, not just the properties byte.
-        // The read_chrc callback expects this struct.
-        // Use 16-bit or 128-bit UUID based on what we detected
-        if (zephyrCharUUID16[i]) {
-            zephyrCharDeclarations[i].uuid = (const struct bt_uuid *)&zephyrCharUUID16Structs[i];
-        } else {
-            zephyrCharDeclarations[i].uuid = (const struct bt_uuid *)&zephyrCharUUIDs[i];
-        }
-        zephyrCharDeclarations[i].value_handle = 0; // Stack will fix this up
-        zephyrCharDeclarations[i].properties = props;
-
-        zephyrGattAttrs[attrIdx++] = BT_GATT_ATTRIBUTE(
-            BT_UUID_GATT_CHRC,
-            BT_GATT_PERM_READ,
-            bt_gatt_attr_read_chrc,
-            NULL,
-            &zephyrCharDeclarations[i] // Pass the struct pointer
-        );
-        
-        // Characteristic Value - use 16-bit or 128-bit UUID
-        const struct bt_uuid *charValueUUID;
-        if (zephyrCharUUID16[i]) {
-            charValueUUID = (const struct bt_uuid *)&zephyrCharUUID16Structs[i];
-        } else {
-            charValueUUID = &zephyrCharUUIDs[i].uuid;
-        }
-        
-        zephyrGattAttrs[attrIdx] = BT_GATT_ATTRIBUTE(
-            charValueUUID,
-            perms,
-            zephyrReadCallback,
-            zephyrWriteCallback,
-            (void*)i // Store index as user_data to identify characteristic in callbacks
-        );
-        attrIdx++;
-
-        // CCC (Client Characteristic Configuration)
-        if (props & (BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_INDICATE)) {
-            // Manually construct CCC attribute because BT_GATT_CCC macro is for static definition
-            // and creates a local array which fails in assignment.
-            // We use our pre-allocated zephyrCccCfg array.
-            
-            // Initialize the CCC config for this characteristic
-            // We use our custom ZephyrCCC struct to match Zephyr's internal layout
-            // Zero out the struct first
-            memset(&zephyrCccObjects[i], 0, sizeof(ZephyrCCC));
-            
-            // Set the callbacks
-            zephyrCccObjects[i].cfg_changed = zephyrCccChangedCallback;
-            zephyrCccObjects[i].cfg_write = NULL; 
-            zephyrCccObjects[i].cfg_match = NULL;
-
-            zephyrGattAttrs[attrIdx] = BT_GATT_ATTRIBUTE(
-                BT_UUID_GATT_CCC,
-                BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
-                bt_gatt_attr_read_ccc,
-                bt_gatt_attr_write_ccc,
-                &zephyrCccObjects[i] // Pass the pointer to the custom struct which mimics _bt_gatt_ccc
-            );
-            
-            attrIdx++;
-        }
-        
-        // CUD (Characteristic User Description)
-        if (!characteristics[i].name.empty()) {
-            // Copy name to storage
-            strncpy(zephyrCharUserDesc[i], characteristics[i].name.c_str(), sizeof(zephyrCharUserDesc[i]) - 1);
-            zephyrCharUserDesc[i][sizeof(zephyrCharUserDesc[i]) - 1] = '\0';
-            
-            zephyrGattAttrs[attrIdx] = BT_GATT_ATTRIBUTE(
-                BT_UUID_GATT_CUD,
+            if (chr.properties & HMS_BLE_PROPERTY_READ) {
+                props |= BT_GATT_CHRC_READ;
+                perms |= BT_GATT_PERM_READ;
+            }
+            if (chr.properties & HMS_BLE_PROPERTY_WRITE) {
+                props |= BT_GATT_CHRC_WRITE;
+                perms |= BT_GATT_PERM_WRITE;
+            }
+            if (chr.properties & HMS_BLE_PROPERTY_WRITE_NR) {
+                props |= BT_GATT_CHRC_WRITE_WITHOUT_RESP;                                               // Same write permission, the stack picks the opcode
+                perms |= BT_GATT_PERM_WRITE;
+            }
+            if (chr.properties & HMS_BLE_PROPERTY_NOTIFY) {
+                props |= BT_GATT_CHRC_NOTIFY;
+            }
+            if (chr.properties & HMS_BLE_PROPERTY_INDICATE) {
+                props |= BT_GATT_CHRC_INDICATE;
+            }
+
+            // Characteristic Declaration
+            // We must use a struct bt_gatt_chrc for user_data, not just the properties byte.
+            // The read_chrc callback expects this struct.
+            struct bt_gatt_chrc *declaration = declarations++;
+            declaration->uuid = charValueUUID;
+            declaration->value_handle = 0; // Stack will fix this up
+            declaration->properties = props;
+
+            *attrs++ = BT_GATT_ATTRIBUTE(
+                BT_UUID_GATT_CHRC,
                 BT_GATT_PERM_READ,
-                bt_gatt_attr_read_cud,
+                bt_gatt_attr_read_chrc,
                 NULL,
-                zephyrCharUserDesc[i] // Pass the string pointer
+                declaration // Pass the struct pointer
             );
-            attrIdx++;
+
+            // Characteristic Value
+            zephyrValueAttrIndex[s][i] = (uint16_t)(attrs - first);                                    // bt_gatt_notify_cb() needs the value attribute
+            *attrs++ = BT_GATT_ATTRIBUTE(
+                charValueUUID,
+                perms,
+                zephyrReadCallback,
+                zephyrWriteCallback,
+                (void*)(uintptr_t)encodeHandle(s, i).id // Handle id as user_data, decoded in the callbacks
+            );
+
+            // CCC (Client Characteristic Configuration), right after the value: the CCC callback finds its characteristic there
+            if (props & (BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_INDICATE)) {
+                // Manually construct CCC attribute because BT_GATT_CCC macro is for static definition
+                // and creates a local array which fails in assignment.
+                // We use our custom ZephyrCCC struct to match Zephyr's internal layout (zeroed with the arena)
+                struct ZephyrCCC *ccc = cccs++;
+                ccc->cfg_changed = zephyrCccChangedCallback;
+                ccc->cfg_write = zephyrCccWriteCallback;                                               // Per connection, cfg_changed only sees the aggregate
+
+                *attrs++ = BT_GATT_ATTRIBUTE(
+                    BT_UUID_GATT_CCC,
+                    BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                    bt_gatt_attr_read_ccc,
+                    bt_gatt_attr_write_ccc,
+                    ccc // Pass the pointer to the custom struct which mimics _bt_gatt_ccc
+                );
+            }
+
+            // CUD (Characteristic User Description)
+            if (chr.name[0] != '\0') {
+                *attrs++ = BT_GATT_ATTRIBUTE(
+                    BT_UUID_GATT_CUD,
+                    BT_GATT_PERM_READ,
+                    bt_gatt_attr_read_cud,
+                    NULL,
+                    (void*)chr.name // Entry outlives the attribute (runtime pool or constexpr schema), no copy needed
+                );
+            }
         }
+
+        gattServices[s].attrs = first;
+        gattServices[s].attr_count = attrs - first;
     }
 
+    BLE_LOGGER(info, "GATT arena: %d bytes for %d services, %d characteristics, %d attributes",
+        layout.size(), layout.services, layout.characteristics, layout.attributes
+    );
     return 0;
 }
 
+void HMS_BLE::releaseGattAttributes() {
+    // Unregister before the arena goes away, the stack walks the attribute tables on every ATT request
+    struct bt_gatt_service *gattServices = (struct bt_gatt_service*)zephyrArena;
+    while (zephyrRegisteredServices > 0) {
+        bt_gatt_service_unregister(&gattServices[--zephyrRegisteredServices]);
+    }
+
+    #if !HMS_BLE_STATIC_ALLOCATION
+        if (zephyrArenaOwned) {
+            k_free(zephyrArena);
+        }
+    #endif
+    zephyrArena = nullptr;                                                                              // begin<Schema>() hands its static arena over again
+    zephyrArenaSize = 0;
+    zephyrArenaOwned = false;
+}
+
 void HMS_BLE::zephyrConnectedCallback(struct bt_conn *conn, uint8_t err) {
     if (err) {
         BLE_LOGGER(error, "Connection failed (err %u)", err);
@@ -406,17 +404,37 @@ void HMS_BLE::zephyrConnectedCallback(struct bt_conn *conn, uint8_t err) {
     }
 
     if (instance) {
-        instance->zephyrConnection = bt_conn_ref(conn);
-        instance->bleConnected = true;
+        uint8_t mac[6];
+        extractMacAddress(conn, mac);
+        int slot = instance->openConnection(bt_conn_index(conn), mac);                                 // Connection index is stable for the link's lifetime
+        if (slot < 0) {
+            bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);                                 // CONFIG_BT_MAX_CONN above HMS_BLE_MAX_CLIENTS
+            return;
+        }
+        instance->zephyrConnections[slot] = bt_conn_ref(conn);
+
+        struct bt_conn_info info;
+        if (bt_conn_get_info(conn, &info) == 0) {
+            instance->updateConnectionParams(slot, info.le.interval, info.le.latency, info.le.timeout);
+#if HMS_BLE_LINK_PROFILES && defined(CONFIG_BT_USER_PHY_UPDATE)
+            instance->updateLinkPhy(slot, info.le.phy->tx_phy, info.le.phy->rx_phy);
+#endif
+#if HMS_BLE_LINK_PROFILES && defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+            instance->updateLinkDataLength(slot, info.le.data_len->tx_max_len, info.le.data_len->rx_max_len);
+#endif
+        }
+        instance->updateConnectionMTU(slot, bt_gatt_get_mtu(conn));
         instance->oldConnected = true; // To prevent immediate disconnect logic
+        instance->signalEvent(HMS_BLE_EVENT_CONNECT);
         
-        BLE_LOGGER(info, "Device Connected");
+        BLE_LOGGER(info, "Device Connected (index %u, slot %d)", bt_conn_index(conn), slot);
         
         if (instance->connectionCallback) {
-            uint8_t mac[6];
-            extractMacAddress(conn, mac);
             instance->connectionCallback(true, mac);
         }
+#if HMS_BLE_LINK_PROFILES
+        instance->applyLinkProfile(slot);
+#endif
     }
 }
 
@@ -427,11 +445,14 @@ void HMS_BLE::zephyrDisconnectedCallback(struct bt_conn *conn, uint8_t reason) {
         uint8_t mac[6];
         extractMacAddress(conn, mac);
         
-        if (instance->zephyrConnection) {
-            bt_conn_unref(instance->zephyrConnection);
-            instance->zephyrConnection = NULL;
-        }
-        instance->bleConnected = false;
+        int slot = instance->findConnection(bt_conn_index(conn));
+        if (slot < 0) return;                                                                           // Refused in zephyrConnectedCallback()
+        struct bt_conn *link = instance->zephyrConnections[slot];
+        instance->closeConnection(slot, reason);                                                        // Subscription bits first, senders stop picking this slot
+        instance->zephyrConnections[slot] = NULL;
+        instance->abortTx(HMS_BLE_STATUS_ERROR_NOT_CONNECTED, slot);                                    // The stack drops queued notifications without calling func
+        bt_conn_unref(link);
+        instance->signalEvent(HMS_BLE_EVENT_DISCONNECT);
         
         if (instance->connectionCallback) {
             instance->connectionCallback(false, mac);
@@ -439,12 +460,233 @@ void HMS_BLE::zephyrDisconnectedCallback(struct bt_conn *conn, uint8_t reason) {
     }
 }
 
+void HMS_BLE::zephyrParamsUpdatedCallback(struct bt_conn *conn, uint16_t interval, uint16_t latency, uint16_t timeout) {
+    if (instance) {
+        instance->updateConnectionParams(instance->findConnection(bt_conn_index(conn)), interval, latency, timeout);
+    }
+}
+
+void HMS_BLE::zephyrMtuUpdatedCallback(struct bt_conn *conn, uint16_t tx, uint16_t rx) {
+    if (instance) {
+        instance->updateConnectionMTU(instance->findConnection(bt_conn_index(conn)), std::min(tx, rx));
+    }
+}
+
+#if HMS_BLE_LINK_PROFILES
+/*
+  Three independent LL procedures; each one the central accepts comes back through its own callback. A central that turns
+  down the parameter update does not call back at all, getLinkInfo().matched stays false. BT_GAP_LE_PHY_* are the same bits
+  as HMS_BLE_Phy. The PHY and data length requests need CONFIG_BT_USER_PHY_UPDATE and CONFIG_BT_USER_DATA_LEN_UPDATE.
+*/
+HMS_BLE_Status HMS_BLE::requestLinkInternal(int slot, const HMS_BLE_LinkProfileParams& params) {
+    struct bt_conn *conn = zephyrConnections[slot];
+    if (!conn) {
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+
+    struct bt_le_conn_param connParams = {};
+    connParams.interval_min = params.minInterval;
+    connParams.interval_max = params.maxInterval;
+    connParams.latency = params.latency;
+    connParams.timeout = params.supervisionTimeout;
+    int err = bt_conn_le_param_update(conn, &connParams);
+    if (err && err != -EALREADY) {                                                                     // -EALREADY: the link runs with them already
+        BLE_LOGGER(warn, "Connection parameter update failed (err %d)", err);
+        return err == -ENOTCONN ? HMS_BLE_STATUS_ERROR_NOT_CONNECTED : HMS_BLE_STATUS_ERROR_PROTOCOL;
+    }
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+    if (params.phy) {
+        struct bt_conn_le_phy_param phyParams = {};
+        phyParams.options = BT_CONN_LE_PHY_OPT_NONE;
+        phyParams.pref_tx_phy = params.phy;
+        phyParams.pref_rx_phy = params.phy;
+        err = bt_conn_le_phy_update(conn, &phyParams);
+        if (err) {
+            BLE_LOGGER(warn, "PHY update failed (err %d)", err);
+            return HMS_BLE_STATUS_ERROR_PROTOCOL;
+        }
+    }
+#endif
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    if (params.dataLength) {
+        struct bt_conn_le_data_len_param lengthParams = {};
+        lengthParams.tx_max_len = params.dataLength;
+        lengthParams.tx_max_time = BT_GAP_DATA_TIME_MAX;                                               // Room for the length on any PHY, the controller trims it
+        err = bt_conn_le_data_len_update(conn, &lengthParams);
+        if (err) {
+            BLE_LOGGER(warn, "Data length update failed (err %d)", err);
+            return HMS_BLE_STATUS_ERROR_PROTOCOL;
+        }
+    }
+#endif
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+void HMS_BLE::zephyrPhyUpdatedCallback(struct bt_conn *conn, struct bt_conn_le_phy_info *param) {
+    if (instance) {
+        instance->updateLinkPhy(instance->findConnection(bt_conn_index(conn)), param->tx_phy, param->rx_phy);
+    }
+}
+#endif
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+void HMS_BLE::zephyrDataLenUpdatedCallback(struct bt_conn *conn, struct bt_conn_le_data_len_info *info) {
+    if (instance) {
+        instance->updateLinkDataLength(instance->findConnection(bt_conn_index(conn)), info->tx_max_len, info->rx_max_len);
+    }
+}
+#endif
+#endif
+
+#if HMS_BLE_BROADCAST_SETS
+/*
+  Each broadcast set is an extended advertising set of its own (CONFIG_BT_EXT_ADV), next to the connectable legacy one
+  bt_le_adv_start() runs. A legacy broadcast is a non-connectable, non-scannable set with legacy PDUs; an extended one
+  carries its frame in AUX_ADV_IND on the secondary PHY; a periodic one (CONFIG_BT_PER_ADV) keeps the extended set empty
+  and carries the frame in the periodic train. The stack copies the data in set_data, so updates need no buffer of ours.
+*/
+HMS_BLE_Status HMS_BLE::createBroadcastInternal(int set, const HMS_BLE_BroadcastParams& params) {
+    uint32_t options = 0;
+    if (params.mode != HMS_BLE_BROADCAST_LEGACY) {
+        options = BT_LE_ADV_OPT_EXT_ADV;
+        if (params.phy == HMS_BLE_PHY_CODED) {
+            options |= BT_LE_ADV_OPT_CODED;                                                                 // Coded primary and secondary
+        } else if (params.phy != HMS_BLE_PHY_2M) {
+            options |= BT_LE_ADV_OPT_NO_2M;                                                                 // 1M secondary, the default is 2M
+        }
+    }
+    struct bt_le_adv_param param = BT_LE_ADV_PARAM_INIT(options, params.interval, params.interval, NULL);
+    param.sid = (uint8_t)set;
+
+    struct bt_le_ext_adv *adv = NULL;
+    int err = bt_le_ext_adv_create(&param, NULL, &adv);
+    if (err) {
+        BLE_LOGGER(warn, "Advertising set create failed (err %d)", err);
+        return err == -ENOMEM ? HMS_BLE_STATUS_ERROR_BUSY : HMS_BLE_STATUS_ERROR_PROTOCOL;                // -ENOMEM: CONFIG_BT_EXT_ADV_MAX_ADV_SET reached
+    }
+
+    if (params.mode == HMS_BLE_BROADCAST_PERIODIC) {
+#if defined(CONFIG_BT_PER_ADV)
+        struct bt_le_per_adv_param perParam = BT_LE_PER_ADV_PARAM_INIT(params.periodicInterval, params.periodicInterval, 0);
+        err = bt_le_per_adv_set_param(adv, &perParam);
+        if (err) {
+            BLE_LOGGER(warn, "Periodic advertising parameters refused (err %d)", err);
+        }
+#else
+        err = -ENOTSUP;
+        BLE_LOGGER(warn, "Periodic broadcast needs CONFIG_BT_PER_ADV");
+#endif
+        if (err) {
+            bt_le_ext_adv_delete(adv);
+            return HMS_BLE_STATUS_ERROR_PROTOCOL;
+        }
+    }
+    zephyrBroadcastSets[set] = adv;
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::setBroadcastDataInternal(int set, const uint8_t* data, size_t length) {
+    struct bt_data ad[HMS_BLE_BROADCAST_DATA_LENGTH / 2];
+    size_t ad_count = toZephyrAd(data, (uint8_t)length, ad, ARRAY_SIZE(ad));
+    int err;
+#if defined(CONFIG_BT_PER_ADV)
+    if (broadcastSets[set].params.mode == HMS_BLE_BROADCAST_PERIODIC) {
+        err = bt_le_per_adv_set_data(zephyrBroadcastSets[set], ad, ad_count);
+    } else
+#endif
+    {
+        err = bt_le_ext_adv_set_data(zephyrBroadcastSets[set], ad, ad_count, NULL, 0);
+    }
+    if (err) {
+        BLE_LOGGER(warn, "Broadcast data update failed (err %d)", err);
+        return HMS_BLE_STATUS_ERROR_SEND;
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::startBroadcastInternal(int set) {
+    int err = 0;
+#if defined(CONFIG_BT_PER_ADV)
+    if (broadcastSets[set].params.mode == HMS_BLE_BROADCAST_PERIODIC) {
+        err = bt_le_per_adv_start(zephyrBroadcastSets[set]);                                               // The train starts with the extended set that announces it
+    }
+#endif
+    if (!err) {
+        err = bt_le_ext_adv_start(zephyrBroadcastSets[set], BT_LE_EXT_ADV_START_DEFAULT);
+    }
+    if (err) {
+        BLE_LOGGER(warn, "Broadcast start failed (err %d)", err);
+        return HMS_BLE_STATUS_ERROR_START;
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+HMS_BLE_Status HMS_BLE::stopBroadcastInternal(int set) {
+#if defined(CONFIG_BT_PER_ADV)
+    if (broadcastSets[set].params.mode == HMS_BLE_BROADCAST_PERIODIC) {
+        bt_le_per_adv_stop(zephyrBroadcastSets[set]);
+    }
+#endif
+    int err = bt_le_ext_adv_stop(zephyrBroadcastSets[set]);
+    if (err) {
+        BLE_LOGGER(warn, "Broadcast stop failed (err %d)", err);
+        return HMS_BLE_STATUS_ERROR_PROTOCOL;
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+void HMS_BLE::removeBroadcastInternal(int set) {
+    if (zephyrBroadcastSets[set]) {
+        bt_le_ext_adv_delete(zephyrBroadcastSets[set]);
+        zephyrBroadcastSets[set] = NULL;
+    }
+}
+#endif
+
 ssize_t HMS_BLE::zephyrReadCallback(
     struct bt_conn *conn, const struct bt_gatt_attr *attr,void *buf, uint16_t len, uint16_t offset
 ) {
-    // Retrieve characteristic index from user_data
-    int charIndex = (int)((intptr_t)attr->user_data);
+    // Retrieve the characteristic handle from user_data
+    uint16_t handle = (uint16_t)(uintptr_t)attr->user_data;
+    int serviceIndex = handle >> 8, charIndex = handle & 0xFF;
+
+    if (instance && instance->readIntoCallback) {
+        // Zero-copy: the application writes straight into the ATT response, sized by the negotiated MTU, so the value
+        // ends with that response. A read blob after a full response gets the empty end, any other offset is an error
+        if (offset > 0) {
+            bool atEnd = instance->zephyrReadIntoHandle == handle && offset == instance->zephyrReadIntoLength;
+            return atEnd ? 0 : BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+        }
+        uint8_t mac[6];
+        extractMacAddress(conn, mac);
+        instance->countLinkRead(instance->findConnection(bt_conn_index(conn)), serviceIndex, charIndex);
+        size_t length = instance->deliverReadInto(serviceIndex, charIndex, (uint8_t*)buf, len, mac);
+        instance->zephyrReadIntoHandle = handle;
+        instance->zephyrReadIntoLength = (uint16_t)length;
+        return length;
+    }
     
+    if (instance && offset == 0) {
+        instance->countLinkRead(instance->findConnection(bt_conn_index(conn)), serviceIndex, charIndex);
+    }
+
+    #if HMS_BLE_VALUE_CACHE
+    if (instance) {
+        // Offset 0 starts a read: refresh per policy and snapshot, read blobs of the same value are served from the snapshot
+        if (offset == 0 || instance->zephyrReadSnapshotHandle != handle) {
+            uint8_t mac[6];
+            extractMacAddress(conn, mac);
+            instance->beginCachedRead(serviceIndex, charIndex, mac);
+            instance->zephyrReadSnapshotLength = instance->readCachedValue(serviceIndex, charIndex, instance->zephyrReadSnapshot, sizeof(instance->zephyrReadSnapshot));
+            instance->zephyrReadSnapshotHandle = handle;
+        }
+        return bt_gatt_attr_read(conn, attr, buf, len, offset, instance->zephyrReadSnapshot, instance->zephyrReadSnapshotLength);
+    }
+    #endif
+
     if (instance && instance->readCallback) {
         // Call user callback to update data if needed
         // Note: This is a blocking call in Zephyr context
@@ -468,7 +710,8 @@ ssize_t HMS_BLE::zephyrReadCallback(
         extractMacAddress(conn, mac);
         
         instance->readCallback(
-            instance->characteristics[charIndex].uuid.c_str(), 
+            instance->services[serviceIndex].service->uuidStr,
+            instance->services[serviceIndex].characteristics[charIndex].uuidStr,
             tempBuf, &outLen, mac
         );
                                
@@ -481,22 +724,44 @@ ssize_t HMS_BLE::zephyrReadCallback(
 ssize_t HMS_BLE::zephyrWriteCallback(
     struct bt_conn *conn, const struct bt_gatt_attr *attr,const void *buf, uint16_t len, uint16_t offset, uint8_t flags
 ) {
-    int charIndex = (int)((intptr_t)attr->user_data);
+    uint16_t handle = (uint16_t)(uintptr_t)attr->user_data;
+    int serviceIndex = handle >> 8, charIndex = handle & 0xFF;
+
+    int slot = instance ? instance->findConnection(bt_conn_index(conn)) : -1;
+    if (instance) {
+        instance->countLinkWrite(slot, serviceIndex, charIndex, len);
+    }
     
+    if (instance && instance->consumeStreamSegment(serviceIndex, charIndex, (const uint8_t*)buf, len)) {
+        return len;
+    }
+
+    // Write commands to WRITE_NR characteristics hand off to the ingest ring (BT RX thread is the single producer); a full
+    // ring drops the command, which is counted. Write requests take the path below so the central's ATT response is honest
+    if (instance && (flags & BT_GATT_WRITE_FLAG_CMD) &&
+        instance->consumeIngestWrite(slot, serviceIndex, charIndex, (const uint8_t*)buf, len)) {
+        return len;
+    }
+
+    if (instance && instance->writeViewCallback) {
+        uint8_t mac[6];
+        extractMacAddress(conn, mac);
+        instance->deliverWriteView(serviceIndex, charIndex, (const uint8_t*)buf, len, mac);                            // buf is the ATT PDU payload, no copy
+        return len;
+    }
+
     if (instance) {
-        // Copy data to instance buffer (limited by max length)
-        size_t copyLen = (len > HMS_BLE_MAX_DATA_LENGTH) ? HMS_BLE_MAX_DATA_LENGTH : len;
-        memcpy(instance->data, buf, copyLen);
-        instance->dataLength = copyLen;
-        instance->received = true; // Flag for loop()
+        // Receive ring + per-service and legacy shared buffers (BT RX thread is the single producer)
+        instance->storeReceivedData(serviceIndex, charIndex, (const uint8_t*)buf, len);
         
-        BLE_LOGGER(debug, "Write received on char %d, len %d", charIndex, len);
+        BLE_LOGGER(debug, "Write received on service %d char %d, len %d", serviceIndex, charIndex, len);
 
         if (instance->writeCallback) {
             uint8_t mac[6];
             extractMacAddress(conn, mac);
             instance->writeCallback(
-                instance->characteristics[charIndex].uuid.c_str(), 
+                instance->services[serviceIndex].service->uuidStr,
+                instance->services[serviceIndex].characteristics[charIndex].uuidStr,
                 (const uint8_t*)buf, len, mac
             );
         }
@@ -505,48 +770,304 @@ ssize_t HMS_BLE::zephyrWriteCallback(
     return len;
 }
 
-void HMS_BLE::zephyrCccChangedCallback(const struct bt_gatt_attr *attr, uint16_t value) {
-    // Find which characteristic this CCC belongs to
-    // This is hard because attr->user_data points to the CCC cfg array, not the char index
-    // We can iterate our attributes to find the match
-    
-    if (!instance) return;
+ssize_t HMS_BLE::zephyrCccWriteCallback(struct bt_conn *conn, const struct bt_gatt_attr *attr, uint16_t value) {
+    if (!instance) return sizeof(value);
+
+    // buildGattAttributes() places every CCC right after its characteristic value, whose user_data is the handle id
+    uint16_t handle = (uint16_t)(uintptr_t)(attr - 1)->user_data;
+    int serviceIndex = handle >> 8, charIndex = handle & 0xFF;
+    int slot = instance->findConnection(bt_conn_index(conn));
+    if (slot < 0) return sizeof(value);
+
+    bool enabled = (value & (BT_GATT_CCC_NOTIFY | BT_GATT_CCC_INDICATE)) != 0;
+    bool changed = instance->isSubscribed(slot, serviceIndex, charIndex) != enabled;
+    BLE_LOGGER(info, "Notifications %s for service %d char %d (slot %d)", enabled ? "enabled" : "disabled", serviceIndex, charIndex, slot);
+
+    instance->setSubscribed(slot, serviceIndex, charIndex, enabled, (value & BT_GATT_CCC_INDICATE) != 0);
+    instance->signalEvent(HMS_BLE_EVENT_SUBSCRIBE);
     
-    int charIndex = -1;
-    // Simple search: check address of CCC cfg
-    for (int i = 0; i < HMS_BLE_MAX_CHARACTERISTICS; i++) {
-        if (attr->user_data == &instance->zephyrCccObjects[i]) {
-            charIndex = i;
-            break;
-        }
+    if (changed && instance->notifyCallback) {
+        uint8_t mac[6];
+        extractMacAddress(conn, mac);
+        instance->notifyCallback(instance->services[serviceIndex].service->uuidStr,
+                                 instance->services[serviceIndex].characteristics[charIndex].uuidStr,
+                                 enabled, mac);
     }
-    
-    if (charIndex >= 0) {
-        bool enabled = (value == BT_GATT_CCC_NOTIFY || value == BT_GATT_CCC_INDICATE);
-        BLE_LOGGER(info, "Notifications %s for char %d", enabled ? "enabled" : "disabled", charIndex);
-        
+    return sizeof(value);
+}
+
+/*
+  Called with the value aggregated over all connections, and without a connection: after zephyrCccWriteCallback() for a
+  write, but alone when a bonded peer reconnects and the stack restores its stored CCC. Resync every slot from the stack.
+*/
+void HMS_BLE::zephyrCccChangedCallback(const struct bt_gatt_attr *attr, uint16_t value) {
+    (void)value;                                                                                        // Aggregated over the links, each slot is read back below
+    if (!instance) return;
+
+    uint16_t handle = (uint16_t)(uintptr_t)(attr - 1)->user_data;
+    int serviceIndex = handle >> 8, charIndex = handle & 0xFF;
+
+    for (int slot = 0; slot < HMS_BLE_MAX_CLIENTS; slot++) {
+        struct bt_conn *conn = instance->zephyrConnections[slot];
+        if (!conn) continue;
+        bool enabled = bt_gatt_is_subscribed(conn, attr - 1, BT_GATT_CCC_NOTIFY | BT_GATT_CCC_INDICATE);
+        bool indicate = HMS_BLE_INDICATE_DEPTH && bt_gatt_is_subscribed(conn, attr - 1, BT_GATT_CCC_INDICATE);
+        if (instance->isSubscribed(slot, serviceIndex, charIndex) == enabled && instance->isIndicating(slot, serviceIndex, charIndex) == indicate) continue;
+
+        BLE_LOGGER(info, "Notifications %s for service %d char %d (slot %d, restored)", enabled ? "enabled" : "disabled", serviceIndex, charIndex, slot);
+        instance->setSubscribed(slot, serviceIndex, charIndex, enabled, indicate);
+        instance->signalEvent(HMS_BLE_EVENT_SUBSCRIBE);
         if (instance->notifyCallback) {
-            // CCC callback doesn't provide the connection directly
-            // Use the stored connection if available
             uint8_t mac[6];
-            if (instance->zephyrConnection) {
-                extractMacAddress(instance->zephyrConnection, mac);
+            extractMacAddress(conn, mac);
+            instance->notifyCallback(instance->services[serviceIndex].service->uuidStr,
+                                     instance->services[serviceIndex].characteristics[charIndex].uuidStr,
+                                     enabled, mac);
+        }
+    }
+}
+
+uint32_t HMS_BLE::taskStackFree() const {
+    #if defined(CONFIG_THREAD_STACK_INFO)
+        size_t unused = 0;
+        if (zephyrBleThreadId && k_thread_stack_space_get(zephyrBleThreadId, &unused) == 0) return (uint32_t)unused;
+    #endif
+    return 0;                                                                                           // No background thread, or CONFIG_THREAD_STACK_INFO off
+}
+
+// The link had no ACL buffer for the PDU right now, unlike a refusal that retrying cannot fix
+static bool isBusyError(int err) {
+    return err == -ENOMEM || err == -ENOBUFS || err == -EAGAIN;
+}
+
+/*
+  Notifications go out through bt_gatt_notify_cb() with a completion callback, one TX credit each. Without the credit check
+  bt_gatt_notify() would block the caller for an ACL buffer (or fail with -ENOMEM from the system workqueue) once the
+  controller's HMS_BLE_TX_CREDITS buffers are in flight.
+*/
+HMS_BLE_Status HMS_BLE::sendDataInternal(int serviceIndex, int charIndex, const uint8_t* data, size_t length, const HMS_BLE_SendCallback* done) {
+    if (serviceIndex < 0 || serviceIndex >= (int)serviceCount) {
+        BLE_LOGGER(error, "Invalid service index: %d", serviceIndex);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    if (charIndex < 0 || charIndex >= (int)services[serviceIndex].characteristicCount) {
+        BLE_LOGGER(error, "Invalid characteristic index: %d for service %d", charIndex, serviceIndex);
+        return HMS_BLE_STATUS_ERROR_INVALID_CHAR;
+    }
+
+    HMS_BLE_CharHandle handle = encodeHandle(serviceIndex, charIndex);
+    if (connectedCount == 0 || !zephyrArena) {
+        BLE_LOGGER(warn, "No connected clients to notify for %s", services[serviceIndex].characteristics[charIndex].uuidStr);
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+
+    if (!hasSubscribers(serviceIndex, charIndex)) {
+        BLE_LOGGER(debug, "No clients subscribed to %s, skipping notification", services[serviceIndex].characteristics[charIndex].uuidStr);
+        if (done && *done) (*done)(handle, HMS_BLE_STATUS_SUCCESS);
+        return HMS_BLE_STATUS_SUCCESS;
+    }
+
+    if (!(services[serviceIndex].characteristics[charIndex].properties & HMS_BLE_PROPERTY_NOTIFY)) {
+        BLE_LOGGER(warn, "%s only indicates, indications are not sent by sendData()", services[serviceIndex].characteristics[charIndex].uuidStr);
+        return HMS_BLE_STATUS_ERROR_SEND;
+    }
+
+    // A partly refused send goes first, later values must not overtake it on the links that still owe it
+    if (!zephyrRetryNotifications()) {
+        return HMS_BLE_STATUS_ERROR_BUSY;
+    }
+
+    // One credit covers the fan-out: it returns when the last subscribed link has reported its PDU sent
+    uint32_t links[HMS_BLE_CLIENT_WORDS];
+    memcpy(links, services[serviceIndex].subscribers[charIndex], sizeof(links));
+    int32_t token = acquireTxCredit(handle, done, links);
+    if (token < 0) {
+        return HMS_BLE_STATUS_ERROR_BUSY;
+    }
+
+    struct bt_gatt_service *gattServices = (struct bt_gatt_service*)zephyrArena;
+    struct bt_gatt_notify_params params;
+    memset(&params, 0, sizeof(params));
+    params.attr = &gattServices[serviceIndex].attrs[zephyrValueAttrIndex[serviceIndex][charIndex]];
+    params.data = data;
+    params.func = zephyrNotifyComplete;
+    params.user_data = (void*)(intptr_t)token;
+
+    uint32_t pending[HMS_BLE_CLIENT_WORDS], refused[HMS_BLE_CLIENT_WORDS] = {0}, owed[HMS_BLE_CLIENT_WORDS] = {0};
+    memcpy(pending, links, sizeof(pending));
+    int queued = 0, err = 0;
+    bool busy = false;
+    for (int i = takeLowestSlot(pending); i >= 0; i = takeLowestSlot(pending)) {
+        struct bt_conn *conn = zephyrConnections[i];
+        params.len = (uint16_t)std::min(length, (size_t)connections[i].mtu - 3);
+        int linkErr = conn ? bt_gatt_notify_cb(conn, &params) : -ENOTCONN;                              // Copies the value into an ACL buffer (NULL would notify every link)
+        if (linkErr == 0) {
+            countLinkSend(i, params.len);
+            queued++;
+        } else if (isBusyError(linkErr)) {
+            owed[i / 32] |= 1u << (i % 32);
+            busy = true;
+        } else {
+            refused[i / 32] |= 1u << (i % 32);
+            err = linkErr;
+        }
+    }
+
+    HMS_BLE_Status status = (err == -ENOTCONN) ? HMS_BLE_STATUS_ERROR_NOT_CONNECTED : HMS_BLE_STATUS_ERROR_SEND;
+    if (queued == 0) {
+        cancelTxCredit(token);
+        if (busy) return HMS_BLE_STATUS_ERROR_BUSY;                                                     // Nobody took it, the caller's retry duplicates nothing
+        BLE_LOGGER(warn, "Notification on %s failed (err %d)", services[serviceIndex].characteristics[charIndex].uuidStr, err);
+        return status;
+    }
+
+    // Reached some centrals: the call succeeded. Links out of ACL buffers keep the credit and get this PDU again from
+    // zephyrRetryNotifications(), never the ones that took it; onSent reports the other refusals
+    for (int i = takeLowestSlot(refused); i >= 0; i = takeLowestSlot(refused)) {
+        completeTx(token, status, i);
+    }
+    if (busy) {
+        lockTx();
+        bool claimed = zephyrRetryToken.load(std::memory_order_relaxed) == -1;
+        if (claimed) zephyrRetryToken.store(-2, std::memory_order_relaxed);
+        unlockTx();
+        if (!claimed) {                                                                                 // Another sender's partial send got there first
+            for (int i = takeLowestSlot(owed); i >= 0; i = takeLowestSlot(owed)) {
+                completeTx(token, HMS_BLE_STATUS_ERROR_BUSY, i);
+            }
+            return HMS_BLE_STATUS_SUCCESS;
+        }
+        zephyrRetryHandle = handle.id;
+        zephyrRetryLength = (uint16_t)std::min(length, sizeof(zephyrRetryValue));
+        memcpy(zephyrRetryValue, data, zephyrRetryLength);
+        lockTx();
+        memcpy(zephyrRetryLinks, owed, sizeof(zephyrRetryLinks));
+        zephyrRetryToken.store(token, std::memory_order_relaxed);
+        txWaiting.store(true, std::memory_order_relaxed);                                               // The next returned credit wakes the background task to retry
+        unlockTx();
+    }
+    return HMS_BLE_STATUS_SUCCESS;
+}
+
+/*
+  A send that some links took while others had no ACL buffer keeps its credit, and only the links that refused it get the
+  same PDU from here. Until they all took it (or dropped) every later send is ERROR_BUSY, so nothing overtakes it on those
+  links and a stream's segments stay in sequence. The caller holding the -2 claim owns the value and the link mask.
+*/
+bool HMS_BLE::zephyrRetryNotifications() {
+    lockTx();
+    int32_t token = zephyrRetryToken.load(std::memory_order_relaxed);
+    if (token < 0) {
+        unlockTx();
+        return token == -1;                                                                             // -2: another thread is storing or retrying it
+    }
+    HMS_BLE_TxSlot& tx = txSlots[token & 0xFF];
+    bool live = tx.used && tx.generation == (uint16_t)(token >> 8);
+    uint32_t links[HMS_BLE_CLIENT_WORDS];
+    for (int w = 0; w < HMS_BLE_CLIENT_WORDS; w++) {
+        links[w] = live ? (zephyrRetryLinks[w] & tx.links[w]) : 0;                                      // abortTx() already reported the links that dropped
+    }
+    zephyrRetryToken.store(-2, std::memory_order_relaxed);
+    unlockTx();
+
+    int serviceIndex, charIndex;
+    uint32_t owed[HMS_BLE_CLIENT_WORDS] = {0};
+    if (zephyrArena && decodeHandle({ zephyrRetryHandle }, &serviceIndex, &charIndex)) {
+        struct bt_gatt_service *gattServices = (struct bt_gatt_service*)zephyrArena;
+        struct bt_gatt_notify_params params;
+        memset(&params, 0, sizeof(params));
+        params.attr = &gattServices[serviceIndex].attrs[zephyrValueAttrIndex[serviceIndex][charIndex]];
+        params.data = zephyrRetryValue;
+        params.func = zephyrNotifyComplete;
+        params.user_data = (void*)(intptr_t)token;
+        for (int i = takeLowestSlot(links); i >= 0; i = takeLowestSlot(links)) {
+            struct bt_conn *conn = zephyrConnections[i];
+            params.len = (uint16_t)std::min((size_t)zephyrRetryLength, (size_t)connections[i].mtu - 3);
+            int linkErr = conn ? bt_gatt_notify_cb(conn, &params) : -ENOTCONN;
+            if (linkErr == 0) {
+                countLinkSend(i, params.len);
+            } else if (isBusyError(linkErr)) {
+                owed[i / 32] |= 1u << (i % 32);
             } else {
-                memset(mac, 0, 6);
+                completeTx(token, linkErr == -ENOTCONN ? HMS_BLE_STATUS_ERROR_NOT_CONNECTED : HMS_BLE_STATUS_ERROR_SEND, i);
             }
-            instance->notifyCallback(instance->characteristics[charIndex].uuid.c_str(), 
-                                     enabled, mac);
+        }
+    } else {
+        for (int i = takeLowestSlot(links); i >= 0; i = takeLowestSlot(links)) {
+            completeTx(token, HMS_BLE_STATUS_ERROR_INVALID_CHAR, i);                                    // Database released under the retry
         }
     }
+
+    bool done = true;
+    for (int w = 0; w < HMS_BLE_CLIENT_WORDS; w++) {
+        if (owed[w]) done = false;
+    }
+    lockTx();
+    memcpy(zephyrRetryLinks, owed, sizeof(zephyrRetryLinks));
+    zephyrRetryToken.store(done ? -1 : token, std::memory_order_relaxed);
+    if (!done) txWaiting.store(true, std::memory_order_relaxed);
+    unlockTx();
+    return done;
+}
+
+void HMS_BLE::zephyrNotifyComplete(struct bt_conn *conn, void *user_data) {
+    if (instance) {
+        int link = instance->findConnection(bt_conn_index(conn));
+        instance->completeTx((int32_t)(intptr_t)user_data, HMS_BLE_STATUS_SUCCESS, link);             // TX context: the controller reported the PDU sent
+    }
+}
+
+#if HMS_BLE_INDICATE_DEPTH
+/*
+  bt_gatt_indicate() keeps the params until the confirmation, so each indication entry has its own block; the stack calls
+  zephyrIndicateComplete() with it once the central confirmed (err 0), the ATT request failed, or the link dropped. With EATT
+  the stack spreads outstanding indications over the enhanced bearers, one per bearer.
+*/
+HMS_BLE_Status HMS_BLE::indicateInternal(int slot, int serviceIndex, int charIndex, const uint8_t* data, size_t length, int32_t token) {
+    struct bt_conn *conn = zephyrConnections[slot];
+    if (!conn || !zephyrArena) {
+        return HMS_BLE_STATUS_ERROR_NOT_CONNECTED;
+    }
+
+    int index = token & 0xFF;
+    struct bt_gatt_service *gattServices = (struct bt_gatt_service*)zephyrArena;
+    struct bt_gatt_indicate_params *params = &zephyrIndicateParams[slot][index];
+    memset(params, 0, sizeof(*params));
+    params->attr = &gattServices[serviceIndex].attrs[zephyrValueAttrIndex[serviceIndex][charIndex]];
+    params->func = zephyrIndicateComplete;
+    params->data = data;                                                                               // Copied into the ATT buffer by bt_gatt_indicate()
+    params->len = (uint16_t)std::min(length, (size_t)connections[slot].mtu - 3);
+    zephyrIndicateTokens[slot][index] = token;
+
+    int err = bt_gatt_indicate(conn, params);
+    if (err == 0) {
+        countLinkSend(slot, params->len);
+        return HMS_BLE_STATUS_SUCCESS;
+    }
+    if (err == -ENOMEM || err == -ENOBUFS || err == -EAGAIN) {
+        return HMS_BLE_STATUS_ERROR_BUSY;
+    }
+    BLE_LOGGER(warn, "Indication on %s failed (err %d)", services[serviceIndex].characteristics[charIndex].uuidStr, err);
+    return err == -ENOTCONN ? HMS_BLE_STATUS_ERROR_NOT_CONNECTED : HMS_BLE_STATUS_ERROR_SEND;
+}
+
+void HMS_BLE::zephyrIndicateComplete(struct bt_conn *conn, struct bt_gatt_indicate_params *params, uint8_t err) {
+    if (!instance) return;
+    int slot = instance->findConnection(bt_conn_index(conn));
+    if (slot < 0) return;                                                                               // Disconnected: closeConnection() failed the entry already
+    int index = (int)(params - instance->zephyrIndicateParams[slot]);
+    if (index < 0 || index >= HMS_BLE_INDICATE_DEPTH) return;
+    instance->completeIndication(slot, instance->zephyrIndicateTokens[slot][index], err ? HMS_BLE_STATUS_ERROR_SEND : HMS_BLE_STATUS_SUCCESS);
 }
+#endif
 
 void HMS_BLE::zephyrBleTask(void* p1, void* p2, void* p3) {
     HMS_BLE* pThis = HMS_BLE::instance;
     if(!pThis) return;
     
     while(true) {
-        pThis->loop();
-        k_msleep(10);
+        pThis->backgroundStep();                                                                        // Blocks in k_sem_take() until signalEvent()
     }
 }
 
@@ -0,0 +1,211 @@
+/*
+  Host-side decoder for HMS_BLE::dumpLog() output (target HMS_BLE_log_decode). A deferred record holds only the format id
+  (FNV-1a of the format string) and the raw arguments, so the decoder rebuilds the id -> format table by scanning the given
+  sources for BLE_LOGGER(level, "format"...) calls, hashing each literal the way HMS_BLE_LogFormatId() does, and formats
+  every record with HMS_BLE_LogFormat(), the same code flushLog() runs on the device. Pass the sources the firmware was
+  built from; a record whose id is not in the table is printed as raw payload bytes.
+
+  Usage: HMS_BLE_log_decode dump.bin <source files or directories...>
+         HMS_BLE_log_decode --list <source files or directories...>
+  --list prints the id/level/format table only. Use - as dump.bin to read stdin.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "HMS_BLE.h"
+
+struct Format {
+    uint8_t level;
+    std::string text;
+    std::string where;                                                                                      // file:line of the first call site
+};
+
+static const char* levelName(uint8_t level) {
+    static const char* const names[] = { "debug", "info", "warn", "error" };
+    return level < 4 ? names[level] : "?";
+}
+
+static int levelOf(const std::string& name) {
+    if(name == "debug") return HMS_BLE_LOG_debug;
+    if(name == "info")  return HMS_BLE_LOG_info;
+    if(name == "warn")  return HMS_BLE_LOG_warn;
+    if(name == "error") return HMS_BLE_LOG_error;
+    return -1;
+}
+
+static void skipSpace(const std::string& s, size_t& i) {
+    while(i < s.size()) {
+        if(isspace((unsigned char)s[i]) || s[i] == '\\') i++;                                              // Line continuations inside macros
+        else if(s.compare(i, 2, "//") == 0) i = s.find('\n', i) == std::string::npos ? s.size() : s.find('\n', i);
+        else if(s.compare(i, 2, "/*") == 0) i = s.find("*/", i) == std::string::npos ? s.size() : s.find("*/", i) + 2;
+        else break;
+    }
+}
+
+// One string literal at s[i] (after the opening quote), escapes resolved; false when it is not terminated
+static bool readLiteral(const std::string& s, size_t& i, std::string& out) {
+    while(i < s.size() && s[i] != '"') {
+        char c = s[i++];
+        if(c == '\n') return false;
+        if(c != '\\' || i >= s.size()) {
+            out += c;
+            continue;
+        }
+        char e = s[i++];
+        switch(e) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': {
+                int value = e - '0';
+                for(int k = 0; k < 2 && i < s.size() && s[i] >= '0' && s[i] <= '7'; k++) value = value * 8 + (s[i++] - '0');
+                out += (char)value;
+                break;
+            }
+            case 'x': {
+                int value = 0;
+                while(i < s.size() && isxdigit((unsigned char)s[i])) value = value * 16 + (isdigit((unsigned char)s[i]) ? s[i] - '0' : (tolower(s[i]) - 'a' + 10)), i++;
+                out += (char)value;
+                break;
+            }
+            default: out += e; break;                                                                       // \" \\ \' \?
+        }
+    }
+    if(i >= s.size()) return false;
+    i++;
+    return true;
+}
+
+static void scanSource(const std::filesystem::path& path, std::map<uint32_t, Format>& formats, size_t& collisions) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string s = buffer.str();
+
+    for(size_t at = s.find("BLE_LOGGER("); at != std::string::npos; at = s.find("BLE_LOGGER(", at + 1)) {
+        if(at > 0 && (isalnum((unsigned char)s[at - 1]) || s[at - 1] == '_')) continue;
+        size_t i = at + strlen("BLE_LOGGER(");
+        skipSpace(s, i);
+        size_t nameStart = i;
+        while(i < s.size() && (isalnum((unsigned char)s[i]) || s[i] == '_')) i++;
+        int level = levelOf(s.substr(nameStart, i - nameStart));
+        skipSpace(s, i);
+        if(level < 0 || i >= s.size() || s[i] != ',') continue;                                            // The macro definitions themselves
+        i++;
+        skipSpace(s, i);
+
+        std::string text;
+        bool literal = false;
+        while(i < s.size() && s[i] == '"') {                                                                // Adjacent literals are one string
+            i++;
+            if(!readLiteral(s, i, text)) break;
+            literal = true;
+            skipSpace(s, i);
+        }
+        if(!literal) continue;
+
+        uint32_t id = HMS_BLE_LogFormatId(text.c_str());
+        std::string where = path.string() + ":" + std::to_string(std::count(s.begin(), s.begin() + at, '\n') + 1);
+        auto found = formats.find(id);
+        if(found == formats.end()) {
+            formats[id] = { (uint8_t)level, text, where };
+        } else if(found->second.text != text) {
+            fprintf(stderr, "id 0x%08X collision: %s and %s, records with it will use the first format\n", id,
+                found->second.where.c_str(), where.c_str());
+            collisions++;
+        }
+    }
+}
+
+static void scanPath(const std::filesystem::path& path, std::map<uint32_t, Format>& formats, size_t& collisions) {
+    static const char* const extensions[] = { ".cpp", ".cc", ".c", ".h", ".hpp", ".ino" };
+    std::error_code error;
+    if(std::filesystem::is_directory(path, error)) {
+        for(const auto& entry : std::filesystem::recursive_directory_iterator(path, error)) {
+            if(entry.is_regular_file()) scanPath(entry.path(), formats, collisions);
+        }
+        return;
+    }
+    std::string extension = path.extension().string();
+    for(const char* known : extensions) {
+        if(extension == known) {
+            scanSource(path, formats, collisions);
+            return;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        fprintf(stderr, "usage: %s dump.bin|--list <source files or directories...>\n", argv[0]);
+        return 2;
+    }
+    bool listOnly = !strcmp(argv[1], "--list");
+
+    std::map<uint32_t, Format> formats;
+    size_t collisions = 0;
+    for(int i = 2; i < argc; i++) scanPath(argv[i], formats, collisions);
+
+    if(listOnly) {
+        printf("%-10s %-5s %s\n", "id", "level", "format");
+        for(const auto& entry : formats) printf("0x%08X %-5s \"%s\"\n", entry.first, levelName(entry.second.level), entry.second.text.c_str());
+        printf("%zu formats, %zu collisions\n", formats.size(), collisions);
+        return collisions ? 1 : 0;
+    }
+
+    FILE* in = strcmp(argv[1], "-") ? fopen(argv[1], "rb") : stdin;
+    if(!in) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    HMS_BLE_LogDumpHeader header;
+    if(fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, "HMSLOG\0\0", sizeof(header.magic)) != 0) {
+        fprintf(stderr, "not an HMS_BLE log dump\n");
+        return 1;
+    }
+    const size_t fixed = offsetof(HMS_BLE_LogRecord, payload);
+    if(header.version != HMS_BLE_LOG_FORMAT_VERSION || header.recordSize < fixed) {
+        fprintf(stderr, "log format %u (%u-byte records), this decoder reads %u\n", header.version, header.recordSize, HMS_BLE_LOG_FORMAT_VERSION);
+        return 1;
+    }
+
+    printf("HMS_BLE log: %u records, %u lost since start, %zu formats from the sources\n", header.count, header.lost, formats.size());
+    std::vector<uint8_t> record(header.recordSize);
+    uint32_t start = 0, expected = 0;
+    size_t unknown = 0;
+    for(uint32_t n = 0; n < header.count; n++) {
+        if(fread(record.data(), record.size(), 1, in) != 1) {
+            fprintf(stderr, "dump truncated: %u of %u records\n", n, header.count);
+            break;
+        }
+        HMS_BLE_LogRecord r;                                                                                // Fixed part only, the payload stays in record
+        memcpy(&r, record.data(), fixed);
+        const uint8_t* payload = record.data() + fixed;
+        size_t length = std::min((size_t)r.length, record.size() - fixed);
+
+        if(n == 0) start = r.timestamp;
+        else if(r.sequence != expected) printf("%10s ... %u record(s) lost\n", "", r.sequence - expected);
+        expected = r.sequence + 1;
+
+        char line[512];
+        auto found = formats.find(r.id);
+        if(found != formats.end()) {
+            HMS_BLE_LogFormat(found->second.text.c_str(), payload, length, line, sizeof(line));
+        } else {
+            int used = snprintf(line, sizeof(line), "<format 0x%08X not in the sources>", r.id);
+            for(size_t k = 0; k < length && used < (int)sizeof(line) - 4; k++) used += snprintf(line + used, sizeof(line) - used, " %02X", payload[k]);
+            unknown++;
+        }
+        printf("%10u %12u  %-5s %s\n", r.sequence, r.timestamp - start, levelName(r.level), line);
+    }
+    if(in != stdin) fclose(in);
+    if(unknown) fprintf(stderr, "%zu record(s) with a format id not found, pass the sources the firmware was built from\n", unknown);
+    return 0;
+}
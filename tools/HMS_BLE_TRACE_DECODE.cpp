@@ -0,0 +1,135 @@
+/*
+  Host-side decoder for HMS_BLE::dumpTrace() output (target HMS_BLE_trace_decode). Reads one dump (file or stdin) and prints
+  a timeline: time since the first record, delta to the previous one, event, connection slot, characteristic, and the
+  event's length/status fields decoded as documented in HMS_BLE_TraceEventId. Gaps in the sequence numbers, where records
+  were overwritten or skipped while being written, are marked in place.
+
+  Usage: HMS_BLE_trace_decode [--summary] [dump.bin]
+  --summary prints only the per-event counts.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "HMS_BLE.h"
+
+static const char* eventName(uint8_t event) {
+    switch(event) {
+        case HMS_BLE_TRACE_CONNECT:    return "CONNECT";
+        case HMS_BLE_TRACE_DISCONNECT: return "DISCONNECT";
+        case HMS_BLE_TRACE_SUBSCRIBE:  return "SUBSCRIBE";
+        case HMS_BLE_TRACE_WRITE:      return "WRITE";
+        case HMS_BLE_TRACE_READ:       return "READ";
+        case HMS_BLE_TRACE_NOTIFY:     return "NOTIFY";
+        case HMS_BLE_TRACE_TX_DONE:    return "TX_DONE";
+        case HMS_BLE_TRACE_QUEUE:      return "QUEUE";
+        case HMS_BLE_TRACE_TASK:       return "TASK";
+        case HMS_BLE_TRACE_MTU:        return "MTU";
+        case HMS_BLE_TRACE_INDICATE:   return "INDICATE";
+        case HMS_BLE_TRACE_CONFIRM:    return "CONFIRM";
+        case HMS_BLE_TRACE_LINK:       return "LINK";
+        case HMS_BLE_TRACE_BROADCAST:  return "BROADCAST";
+        default:                       return "?";
+    }
+}
+
+static const char* statusName(int16_t status) {
+    static const char* const names[HMS_BLE_STATUS_COUNT] = {
+        "SUCCESS", "ERROR_INIT", "ERROR_SEND", "ERROR_START", "ERROR_UNKNOWN", "ERROR_MAX_CHARS",
+        "ERROR_INVALID_CHAR", "ERROR_NOT_CONNECTED", "ERROR_BUSY", "ERROR_OVERFLOW", "ERROR_PROTOCOL",
+        "ERROR_TIMEOUT"
+    };
+    return (status <= 0 && -status < HMS_BLE_STATUS_COUNT) ? names[-status] : "?";
+}
+
+// The event-specific columns, see HMS_BLE_TraceEventId
+static void describe(const HMS_BLE_TraceRecord& r, char* out, size_t size) {
+    switch(r.event) {
+        case HMS_BLE_TRACE_CONNECT:
+            if(r.status < 0) snprintf(out, size, "conn 0x%04X refused, table full", r.length);
+            else             snprintf(out, size, "conn 0x%04X", r.length);
+            break;
+        case HMS_BLE_TRACE_DISCONNECT: snprintf(out, size, "conn 0x%04X reason 0x%02X", r.length, r.status & 0xFF); break;
+        case HMS_BLE_TRACE_SUBSCRIBE:  snprintf(out, size, "%s", r.length == 2 ? "indications" : r.length ? "on" : "off"); break;
+        case HMS_BLE_TRACE_WRITE:
+        case HMS_BLE_TRACE_READ:       snprintf(out, size, "%u B", r.length); break;
+        case HMS_BLE_TRACE_NOTIFY:     snprintf(out, size, "%u B %s", r.length, statusName(r.status)); break;
+        case HMS_BLE_TRACE_TX_DONE:    snprintf(out, size, "%s", statusName(r.status)); break;
+        case HMS_BLE_TRACE_QUEUE:      snprintf(out, size, "%u B%s", r.length, r.status ? " coalesced" : ""); break;
+        case HMS_BLE_TRACE_TASK:       snprintf(out, size, "events 0x%02X latency %d us", r.length, r.status); break;
+        case HMS_BLE_TRACE_MTU:        snprintf(out, size, "%u", r.length); break;
+        case HMS_BLE_TRACE_INDICATE:   snprintf(out, size, "%u B %s", r.length, statusName(r.status)); break;
+        case HMS_BLE_TRACE_CONFIRM:    snprintf(out, size, "%s rtt %u us", statusName(r.status), r.length); break;
+        case HMS_BLE_TRACE_LINK:
+            if(r.status < 0) snprintf(out, size, "interval %.2f ms, refused %s", r.length * 1.25, statusName(r.status));
+            else             snprintf(out, size, "interval %.2f ms%s%s%s%s", r.length * 1.25, (r.status & HMS_BLE_LINK_CHANGE_PARAMS) ? " params" : "",
+                (r.status & HMS_BLE_LINK_CHANGE_PHY) ? " phy" : "", (r.status & HMS_BLE_LINK_CHANGE_DATA_LENGTH) ? " data-length" : "",
+                (r.status & HMS_BLE_LINK_CHANGE_MTU) ? " mtu" : "");
+            break;
+        case HMS_BLE_TRACE_BROADCAST:  snprintf(out, size, "%u B %s", r.length, statusName(r.status)); break;
+        default:                       snprintf(out, size, "length %u status %d", r.length, r.status); break;
+    }
+}
+
+int main(int argc, char** argv) {
+    bool summaryOnly = false;
+    const char* path = nullptr;
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--summary")) summaryOnly = true;
+        else if(argv[i][0] != '-' && !path) path = argv[i];
+        else {
+            fprintf(stderr, "usage: %s [--summary] [dump.bin]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    FILE* in = path ? fopen(path, "rb") : stdin;
+    if(!in) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    HMS_BLE_TraceDumpHeader header;
+    if(fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, "HMSTRACE", sizeof(header.magic)) != 0) {
+        fprintf(stderr, "not an HMS_BLE trace dump\n");
+        return 1;
+    }
+    if(header.version != HMS_BLE_TRACE_FORMAT_VERSION || header.recordSize != sizeof(HMS_BLE_TraceRecord)) {
+        fprintf(stderr, "trace format %u (%u-byte records), this decoder reads %u (%zu-byte records)\n",
+            header.version, header.recordSize, HMS_BLE_TRACE_FORMAT_VERSION, sizeof(HMS_BLE_TraceRecord));
+        return 1;
+    }
+    std::vector<HMS_BLE_TraceRecord> records(header.count);
+    size_t count = header.count ? fread(records.data(), sizeof(HMS_BLE_TraceRecord), header.count, in) : 0;
+    if(path) fclose(in);
+    if(count != header.count) fprintf(stderr, "dump truncated: %zu of %u records\n", count, header.count);
+    records.resize(count);
+
+    printf("HMS_BLE trace: %zu records, %u earlier records overwritten or skipped\n", count, header.dropped);
+    uint32_t perEvent[256] = {0};
+    for(const HMS_BLE_TraceRecord& r : records) perEvent[r.event]++;
+
+    if(!summaryOnly && count) {
+        printf("%10s %12s %10s  %-10s %4s %7s  %s\n", "seq", "time (us)", "delta", "event", "slot", "char", "detail");
+        uint32_t start = records[0].timestamp, previous = start, expected = records[0].sequence;
+        for(const HMS_BLE_TraceRecord& r : records) {
+            if(r.sequence != expected) printf("%10s ... %u record(s) missing\n", "", r.sequence - expected);
+            char slot[8], handle[16], detail[64];
+            if(r.slot == 0xFF) snprintf(slot, sizeof(slot), "-");
+            else               snprintf(slot, sizeof(slot), "%u", r.slot);
+            if(r.handle == 0xFFFF) snprintf(handle, sizeof(handle), "-");
+            else                   snprintf(handle, sizeof(handle), "%u/%u", r.handle >> 8, r.handle & 0xFF);
+            describe(r, detail, sizeof(detail));
+            printf("%10u %12u %+10d  %-10s %4s %7s  %s\n", r.sequence, r.timestamp - start, (int32_t)(r.timestamp - previous),
+                eventName(r.event), slot, handle, detail);
+            previous = r.timestamp;
+            expected = r.sequence + 1;
+        }
+    }
+
+    printf("%-12s %10s\n", "event", "records");
+    for(int e = 0; e < 256; e++) {
+        if(perEvent[e]) printf("%-12s %10u\n", eventName((uint8_t)e), perEvent[e]);
+    }
+    return 0;
+}